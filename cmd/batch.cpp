@@ -0,0 +1,534 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software) for Accusoft	        **
+** All Rights Reserved							**
+**************************************************************************
+
+This source file is part of difftest_ng, a universal image measuring
+and conversion framework.
+
+    difftest_ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    difftest_ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with difftest_ng.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+/*
+ * Batch mode
+ *
+ * $Id: batch.cpp,v 1.1 2022/09/07 09:14:51 thor Exp $
+ *
+ * This class reads the list of image pairs to compare in batch mode,
+ * keeps the original images shared by several pairs loaded, and
+ * writes the results, one row per pair, in list order.
+ */
+
+/// Includes
+#include "cmd/batch.hpp"
+#include "std/stdio.hpp"
+#include "std/stdlib.hpp"
+#include "std/string.hpp"
+#include "std/ctype.hpp"
+#include "std/assert.hpp"
+#include "img/imglayout.hpp"
+#include <new>
+///
+
+/// Batch::Batch
+// Read the list of image pairs from the given file, or from stdin
+// if the name is "-".
+Batch::Batch(const char *filename,Format format)
+  : m_pPairs(NULL), m_ulPairs(0), m_pReferences(NULL), m_ulReferences(0),
+    m_pcBuffer(NULL), m_Format(format), m_ulColumns(0), m_ppcNames(NULL),
+    m_ulWritten(0), m_ulFailed(0)
+{
+  m_cError[0] = 0;
+
+  try {
+    ReadList(filename);
+    ParseList();
+    CollectReferences();
+  } catch(...) {
+    delete[] m_pReferences;
+    delete[] m_pPairs;
+    delete[] m_pcBuffer;
+    throw;
+  }
+}
+///
+
+/// Batch::~Batch
+Batch::~Batch(void)
+{
+  ULONG i;
+
+  if (m_pReferences) {
+    for(i = 0;i < m_ulReferences;i++) {
+      delete m_pReferences[i].m_pImage;
+      delete m_pReferences[i].m_pLock;
+      delete[] m_pReferences[i].m_pcError;
+    }
+    delete[] m_pReferences;
+  }
+  if (m_pPairs) {
+    for(i = 0;i < m_ulPairs;i++) {
+      delete[] m_pPairs[i].m_pcRow;
+    }
+    delete[] m_pPairs;
+  }
+  delete[] m_ppcNames;
+  delete[] m_pcBuffer;
+}
+///
+
+/// Batch::ReadList
+// Read the list file into the buffer.
+void Batch::ReadList(const char *filename)
+{
+  FILE *file  = stdin;
+  size_t size = 4096;
+  size_t used = 0;
+  size_t got;
+
+  if (strcmp(filename,"-")) {
+    file = fopen(filename,"rb");
+    if (file == NULL)
+      throw "cannot open the batch list";
+  }
+
+  try {
+    m_pcBuffer = new char[size + 1];
+    while((got = fread(m_pcBuffer + used,1,size - used,file)) > 0) {
+      used += got;
+      if (used == size) {
+	char *grown = new char[2 * size + 1];
+	memcpy(grown,m_pcBuffer,used);
+	delete[] m_pcBuffer;
+	m_pcBuffer = grown;
+	size      *= 2;
+      }
+    }
+    if (ferror(file))
+      throw "error reading the batch list";
+    m_pcBuffer[used] = 0;
+  } catch(...) {
+    if (file != stdin)
+      fclose(file);
+    throw;
+  }
+
+  if (file != stdin)
+    fclose(file);
+}
+///
+
+/// Batch::ParseList
+// Split the buffer into pairs. Each line holds the original and the
+// distorted image, separated by a tab, or by white space if there is
+// no tab. Empty lines and lines starting with '#' are ignored.
+void Batch::ParseList(void)
+{
+  ULONG lines = 1;
+  ULONG line  = 0;
+  char *p;
+
+  for(p = m_pcBuffer;*p;p++) {
+    if (*p == '\n')
+      lines++;
+  }
+  m_pPairs = new struct Pair[lines];
+
+  p = m_pcBuffer;
+  while(*p) {
+    char *start = p;
+    char *end,*org,*dst,*sep;
+    bool tabbed;
+    //
+    line++;
+    while(*p && *p != '\n')
+      p++;
+    end = p;
+    if (*p)
+      *p++ = 0;
+    //
+    // Strip trailing and leading white space.
+    while(end > start && isspace(end[-1]))
+      *--end = 0;
+    while(isspace(*start))
+      start++;
+    if (*start == 0 || *start == '#')
+      continue;
+    //
+    org    = start;
+    sep    = strchr(org,'\t');
+    tabbed = (sep != NULL);
+    if (!tabbed) {
+      sep = org;
+      while(*sep && !isspace(*sep))
+	sep++;
+    }
+    dst = sep;
+    while(isspace(*dst))
+      dst++;
+    *sep = 0;
+    //
+    if (*dst == 0 || (!tabbed && strpbrk(dst," \t\v\f"))) {
+      sprintf(m_cError,"line %lu of the batch list does not contain two file names",
+	      (unsigned long)line);
+      throw (const char *)m_cError;
+    }
+    //
+    m_pPairs[m_ulPairs].m_pcOriginal  = org;
+    m_pPairs[m_ulPairs].m_pcDistorted = dst;
+    m_pPairs[m_ulPairs].m_ulReference = 0;
+    m_pPairs[m_ulPairs].m_pcRow       = NULL;
+    m_ulPairs++;
+  }
+
+  if (m_ulPairs == 0)
+    throw "the batch list does not contain any image pairs";
+}
+///
+
+/// Batch::CompareOriginals
+// Compare two pairs by the name of their original.
+int Batch::CompareOriginals(const void *a,const void *b)
+{
+  const struct Pair *pa = *(const struct Pair * const *)a;
+  const struct Pair *pb = *(const struct Pair * const *)b;
+
+  return strcmp(pa->m_pcOriginal,pb->m_pcOriginal);
+}
+///
+
+/// Batch::CollectReferences
+// Find the distinct originals, and count by how many pairs each of
+// them is used.
+void Batch::CollectReferences(void)
+{
+  struct Pair **sorted = new struct Pair *[m_ulPairs];
+  ULONG i;
+
+  for(i = 0;i < m_ulPairs;i++) {
+    sorted[i] = m_pPairs + i;
+  }
+  qsort(sorted,m_ulPairs,sizeof(struct Pair *),&CompareOriginals);
+
+  for(i = 0;i < m_ulPairs;i++) {
+    if (i == 0 || strcmp(sorted[i-1]->m_pcOriginal,sorted[i]->m_pcOriginal))
+      m_ulReferences++;
+    sorted[i]->m_ulReference = m_ulReferences - 1;
+  }
+
+  try {
+    m_pReferences = new struct Reference[m_ulReferences];
+  } catch(...) {
+    delete[] sorted;
+    throw;
+  }
+  for(i = 0;i < m_ulReferences;i++) {
+    m_pReferences[i].m_pcName  = NULL;
+    m_pReferences[i].m_pImage  = NULL;
+    m_pReferences[i].m_ulUsers = 0;
+    m_pReferences[i].m_pLock   = NULL;
+    m_pReferences[i].m_bLoaded = false;
+    m_pReferences[i].m_pcError = NULL;
+  }
+  for(i = 0;i < m_ulPairs;i++) {
+    struct Reference &ref = m_pReferences[m_pPairs[i].m_ulReference];
+    ref.m_pcName = m_pPairs[i].m_pcOriginal;
+    ref.m_ulUsers++;
+  }
+
+  delete[] sorted;
+}
+///
+
+/// Batch::AcquireOriginal
+// Return the original image of the given pair, load it if this is
+// the first pair using it. The specs are those to load the image
+// with, and receive the specs after loading. The image is shared,
+// and must not be modified. Throws if the image cannot be loaded.
+class ImageLayout *Batch::AcquireOriginal(ULONG pair,struct ImgSpecs &specs)
+{
+  struct Reference &ref = m_pReferences[m_pPairs[pair].m_ulReference];
+  class Mutex *lock;
+
+  m_Lock.Lock();
+  if (ref.m_pLock == NULL) {
+    try {
+      ref.m_pLock = new class Mutex;
+    } catch(...) {
+      m_Lock.Unlock();
+      throw;
+    }
+  }
+  lock = ref.m_pLock;
+  m_Lock.Unlock();
+  //
+  // Pairs sharing the original wait here until it is loaded.
+  lock->Lock();
+  if (!ref.m_bLoaded) {
+    const char *error = NULL;
+    ref.m_Specs = specs;
+    try {
+      ref.m_pImage = ImageLayout::LoadImage(ref.m_pcName,ref.m_Specs);
+    } catch(const char *msg) {
+      error = msg;
+    } catch(const std::bad_alloc &) {
+      error = "out of memory";
+    } catch(...) {
+      error = "unknown error loading the original image";
+    }
+    if (error) {
+      char *copy = new(std::nothrow) char[strlen(error) + 1];
+      if (copy)
+	strcpy(copy,error);
+      ref.m_pcError = copy;
+    }
+    ref.m_bLoaded = true;
+  }
+  lock->Unlock();
+
+  if (ref.m_pImage == NULL) {
+    if (ref.m_pcError)
+      throw (const char *)ref.m_pcError;
+    throw "cannot load the original image";
+  }
+
+  specs = ref.m_Specs;
+  return ref.m_pImage;
+}
+///
+
+/// Batch::ReleaseOriginal
+// Indicate that the given pair no longer needs its original. The
+// image is released once the last pair using it is done.
+void Batch::ReleaseOriginal(ULONG pair)
+{
+  struct Reference &ref = m_pReferences[m_pPairs[pair].m_ulReference];
+
+  m_Lock.Lock();
+  assert(ref.m_ulUsers > 0);
+  if (--ref.m_ulUsers == 0) {
+    delete ref.m_pImage;
+    delete ref.m_pLock;
+    ref.m_pImage = NULL;
+    ref.m_pLock  = NULL;
+  }
+  m_Lock.Unlock();
+}
+///
+
+/// Batch::Append
+// Append raw text to the row.
+void Batch::Append(char *&row,size_t &size,size_t &used,const char *str)
+{
+  size_t len = strlen(str);
+
+  if (used + len + 1 > size) {
+    size_t newsize = 2 * size + len + 1;
+    char *grown    = new char[newsize];
+    if (row)
+      memcpy(grown,row,used);
+    delete[] row;
+    row  = grown;
+    size = newsize;
+  }
+  memcpy(row + used,str,len + 1);
+  used += len;
+}
+///
+
+/// Batch::AppendString
+// Append a file name or error text to the row, quoted as required
+// by the output format.
+void Batch::AppendString(char *&row,size_t &size,size_t &used,const char *str) const
+{
+  char c[8];
+
+  switch(m_Format) {
+  case TSV:
+    Append(row,size,used,str);
+    break;
+  case CSV:
+    if (strpbrk(str,",\"\r\n") == NULL) {
+      Append(row,size,used,str);
+      break;
+    }
+    Append(row,size,used,"\"");
+    for(c[1] = 0;*str;str++) {
+      c[0] = *str;
+      Append(row,size,used,(*str == '"')?("\"\""):(c));
+    }
+    Append(row,size,used,"\"");
+    break;
+  case JSON:
+    Append(row,size,used,"\"");
+    for(;*str;str++) {
+      if (*str == '"') {
+	Append(row,size,used,"\\\"");
+      } else if (*str == '\\') {
+	Append(row,size,used,"\\\\");
+      } else if ((unsigned char)*str < 0x20) {
+	sprintf(c,"\\u%04x",(unsigned char)*str);
+	Append(row,size,used,c);
+      } else {
+	c[0] = *str;
+	c[1] = 0;
+	Append(row,size,used,c);
+      }
+    }
+    Append(row,size,used,"\"");
+    break;
+  }
+}
+///
+
+/// Batch::WriteHeader
+// Write the header, given the names of the result columns.
+void Batch::WriteHeader(const char **names,ULONG columns)
+{
+  char *row   = NULL;
+  size_t size = 0;
+  size_t used = 0;
+  const char *sep = (m_Format == TSV)?("\t"):(",");
+  ULONG i;
+
+  m_ulColumns = columns;
+  m_ppcNames  = new const char *[columns + 1];
+  for(i = 0;i < columns;i++) {
+    m_ppcNames[i] = names[i];
+  }
+
+  if (m_Format == JSON) {
+    printf("[");
+    return;
+  }
+
+  try {
+    Append(row,size,used,"original");
+    Append(row,size,used,sep);
+    Append(row,size,used,"distorted");
+    for(i = 0;i < columns;i++) {
+      Append(row,size,used,sep);
+      AppendString(row,size,used,names[i]);
+    }
+    Append(row,size,used,sep);
+    Append(row,size,used,"error");
+    printf("%s\n",row);
+  } catch(...) {
+    delete[] row;
+    throw;
+  }
+  delete[] row;
+}
+///
+
+/// Batch::Report
+// Deliver the results of a pair. Only the first count columns are
+// available if an error is given.
+void Batch::Report(ULONG pair,const double *values,ULONG count,const char *error)
+{
+  char *row   = NULL;
+  size_t size = 0;
+  size_t used = 0;
+  const char *sep = (m_Format == TSV)?("\t"):(",");
+  char number[64];
+  ULONG i;
+
+  try {
+    if (m_Format == JSON) {
+      Append(row,size,used,"{\"original\":");
+      AppendString(row,size,used,m_pPairs[pair].m_pcOriginal);
+      Append(row,size,used,",\"distorted\":");
+      AppendString(row,size,used,m_pPairs[pair].m_pcDistorted);
+      Append(row,size,used,",\"results\":[");
+      for(i = 0;i < count;i++) {
+	Append(row,size,used,(i)?(",{\"meter\":"):("{\"meter\":"));
+	AppendString(row,size,used,m_ppcNames[i]);
+	sprintf(number,"%g",values[i]);
+	//
+	// Infinite PSNRs are common, but JSON has no numbers for them.
+	if (isalpha(number[(number[0] == '-')?1:0])) {
+	  Append(row,size,used,",\"value\":\"");
+	  Append(row,size,used,number);
+	  Append(row,size,used,"\"}");
+	} else {
+	  Append(row,size,used,",\"value\":");
+	  Append(row,size,used,number);
+	  Append(row,size,used,"}");
+	}
+      }
+      Append(row,size,used,"],\"error\":");
+      if (error) {
+	AppendString(row,size,used,error);
+      } else {
+	Append(row,size,used,"null");
+      }
+      Append(row,size,used,"}");
+    } else {
+      AppendString(row,size,used,m_pPairs[pair].m_pcOriginal);
+      Append(row,size,used,sep);
+      AppendString(row,size,used,m_pPairs[pair].m_pcDistorted);
+      for(i = 0;i < m_ulColumns;i++) {
+	Append(row,size,used,sep);
+	if (i < count) {
+	  sprintf(number,"%g",values[i]);
+	  Append(row,size,used,number);
+	}
+      }
+      Append(row,size,used,sep);
+      if (error)
+	AppendString(row,size,used,error);
+    }
+  } catch(...) {
+    delete[] row;
+    throw;
+  }
+
+  m_Lock.Lock();
+  if (error) {
+    fprintf(stderr,"*** Program failed on %s %s : %s ***\n",
+	    m_pPairs[pair].m_pcOriginal,m_pPairs[pair].m_pcDistorted,error);
+    m_ulFailed++;
+  }
+  m_pPairs[pair].m_pcRow = row;
+  Flush();
+  m_Lock.Unlock();
+}
+///
+
+/// Batch::Flush
+// Write all rows whose predecessors are written. Requires the lock.
+void Batch::Flush(void)
+{
+  while(m_ulWritten < m_ulPairs && m_pPairs[m_ulWritten].m_pcRow) {
+    if (m_Format == JSON) {
+      printf("%s\n%s",(m_ulWritten)?(","):(""),m_pPairs[m_ulWritten].m_pcRow);
+    } else {
+      printf("%s\n",m_pPairs[m_ulWritten].m_pcRow);
+    }
+    delete[] m_pPairs[m_ulWritten].m_pcRow;
+    m_pPairs[m_ulWritten].m_pcRow = NULL;
+    m_ulWritten++;
+  }
+}
+///
+
+/// Batch::WriteFooter
+// Write the end of the output once all pairs are reported.
+void Batch::WriteFooter(void)
+{
+  if (m_Format == JSON)
+    printf("\n]\n");
+  fflush(stdout);
+}
+///
@@ -0,0 +1,199 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software) for Accusoft	        **
+** All Rights Reserved							**
+**************************************************************************
+
+This source file is part of difftest_ng, a universal image measuring
+and conversion framework.
+
+    difftest_ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    difftest_ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with difftest_ng.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+/*
+ * Batch mode
+ *
+ * $Id: batch.hpp,v 1.1 2022/09/07 09:14:51 thor Exp $
+ *
+ * This class reads the list of image pairs to compare in batch mode,
+ * keeps the original images shared by several pairs loaded, and
+ * writes the results, one row per pair, in list order.
+ */
+
+#ifndef CMD_BATCH_HPP
+#define CMD_BATCH_HPP
+
+/// Includes
+#include "interface/types.hpp"
+#include "img/imgspecs.hpp"
+#include "tools/threadpool.hpp"
+///
+
+/// Forwards
+class ImageLayout;
+///
+
+/// class Batch
+// This class reads the list of image pairs to compare in batch mode,
+// keeps the original images shared by several pairs loaded, and
+// writes the results, one row per pair, in list order.
+class Batch {
+public:
+  //
+  // Output formats of the results.
+  enum Format {
+    CSV,
+    TSV,
+    JSON
+  };
+  //
+private:
+  //
+  // An image pair of the list.
+  struct Pair {
+    //
+    // The file names, pointing into the list buffer.
+    const char       *m_pcOriginal;
+    const char       *m_pcDistorted;
+    //
+    // The index of the original in the reference list.
+    ULONG             m_ulReference;
+    //
+    // The formatted result row once available, NULL before.
+    char             *m_pcRow;
+  }                  *m_pPairs;
+  //
+  // Number of pairs in the list.
+  ULONG               m_ulPairs;
+  //
+  // An original image, possibly shared by several pairs.
+  struct Reference {
+    //
+    // The file name.
+    const char       *m_pcName;
+    //
+    // The image if loaded, and the specifications after loading.
+    class ImageLayout *m_pImage;
+    struct ImgSpecs   m_Specs;
+    //
+    // Number of pairs that have not yet released the image.
+    ULONG             m_ulUsers;
+    //
+    // Serializes loading, created by the first user.
+    class Mutex      *m_pLock;
+    //
+    // Set once loading has been attempted, and the error if it failed.
+    bool              m_bLoaded;
+    char             *m_pcError;
+  }                  *m_pReferences;
+  //
+  // Number of distinct originals.
+  ULONG               m_ulReferences;
+  //
+  // The contents of the list file.
+  char               *m_pcBuffer;
+  //
+  // The output format, and the number of result columns.
+  Format              m_Format;
+  ULONG               m_ulColumns;
+  //
+  // The column names, only used for JSON.
+  const char        **m_ppcNames;
+  //
+  // Number of rows written so far, and number of failed pairs.
+  ULONG               m_ulWritten;
+  ULONG               m_ulFailed;
+  //
+  // Protects the references and the output.
+  class Mutex         m_Lock;
+  //
+  // Error message for parsing errors.
+  char                m_cError[256];
+  //
+  // Read the list file into the buffer.
+  void ReadList(const char *filename);
+  //
+  // Split the buffer into pairs.
+  void ParseList(void);
+  //
+  // Find the distinct originals.
+  void CollectReferences(void);
+  //
+  // Compare two pairs by the name of their original.
+  static int CompareOriginals(const void *a,const void *b);
+  //
+  // Append a file name or error text to the row, quoted as required
+  // by the output format.
+  void AppendString(char *&row,size_t &size,size_t &used,const char *str) const;
+  //
+  // Append raw text to the row.
+  static void Append(char *&row,size_t &size,size_t &used,const char *str);
+  //
+  // Write all rows whose predecessors are written. Requires the lock.
+  void Flush(void);
+  //
+public:
+  //
+  // Read the list of image pairs from the given file, or from stdin
+  // if the name is "-".
+  Batch(const char *filename,Format format);
+  //
+  ~Batch(void);
+  //
+  // Return the number of pairs in the list.
+  ULONG PairsOf(void) const
+  {
+    return m_ulPairs;
+  }
+  //
+  // Return the file names of the given pair.
+  const char *OriginalOf(ULONG pair) const
+  {
+    return m_pPairs[pair].m_pcOriginal;
+  }
+  //
+  const char *DistortedOf(ULONG pair) const
+  {
+    return m_pPairs[pair].m_pcDistorted;
+  }
+  //
+  // Return the number of pairs that failed.
+  ULONG FailedOf(void) const
+  {
+    return m_ulFailed;
+  }
+  //
+  // Return the original image of the given pair, load it if this is
+  // the first pair using it. The specs are those to load the image
+  // with, and receive the specs after loading. The image is shared,
+  // and must not be modified. Throws if the image cannot be loaded.
+  class ImageLayout *AcquireOriginal(ULONG pair,struct ImgSpecs &specs);
+  //
+  // Indicate that the given pair no longer needs its original. This
+  // must be called once for each pair, even if acquiring failed.
+  void ReleaseOriginal(ULONG pair);
+  //
+  // Write the header, given the names of the result columns.
+  void WriteHeader(const char **names,ULONG columns);
+  //
+  // Deliver the results of a pair. Only the first count columns are
+  // available if an error is given.
+  void Report(ULONG pair,const double *values,ULONG count,const char *error);
+  //
+  // Write the end of the output once all pairs are reported.
+  void WriteFooter(void);
+};
+///
+
+///
+#endif
@@ -0,0 +1,814 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software) for Accusoft	        **
+** All Rights Reserved							**
+**************************************************************************
+
+This source file is part of difftest_ng, a universal image measuring
+and conversion framework.
+
+    difftest_ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    difftest_ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with difftest_ng.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+/*
+ * Micro-benchmarks of the loaders, savers, meters and filters on
+ * synthesized images. Prints one result row per case.
+ *
+ * $Id: bench.cpp,v 1.1 2022/09/21 10:12:44 thor Exp $
+ */
+
+/// Includes
+#include "std/stdio.hpp"
+#include "std/string.hpp"
+#include "std/stdlib.hpp"
+#include "std/unistd.hpp"
+#include "std/assert.hpp"
+#include "interface/types.hpp"
+#include "img/imglayout.hpp"
+#include "img/imgspecs.hpp"
+#include "img/blankimg.hpp"
+#include "diff/meter.hpp"
+#include "diff/statistics.hpp"
+#include "diff/spectrum.hpp"
+#include "diff/psnr.hpp"
+#include "diff/thres.hpp"
+#include "diff/histogram.hpp"
+#include "diff/stripe.hpp"
+#include "diff/maxfreq.hpp"
+#include "diff/ycbcr.hpp"
+#include "diff/downsampler.hpp"
+#include "diff/upsampler.hpp"
+#include "diff/tobayer.hpp"
+#include "diff/debayer.hpp"
+#include "tools/threadpool.hpp"
+#include <new>
+#include <time.h>
+#if HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+///
+
+/// Defines
+#define MAX_SIZES 8
+#define MAX_REPS  64
+///
+
+/// struct SampleType
+// The sample types the images are synthesized with.
+static const struct SampleType {
+  const char *m_pcName;
+  UBYTE       m_ucBits;
+  bool        m_bFloat;
+} SampleTypes[] = {
+  {"8bit"  , 8,false},
+  {"16bit" ,16,false},
+  {"float" ,32,true },
+  {NULL    , 0,false}
+};
+///
+
+/// struct FileCase
+// The file formats the loaders and savers are timed with.
+static const struct FileCase {
+  const char                 *m_pcName;
+  const char                 *m_pcExtension;
+  ImgSpecs::CompressionType   m_Compression;
+} FileCases[] = {
+  {"ppm"         ,".ppm",ImgSpecs::Uncompressed},
+  {"pfm"         ,".pfm",ImgSpecs::Uncompressed},
+  {"pgx"         ,".pgx",ImgSpecs::Uncompressed},
+  {"bmp"         ,".bmp",ImgSpecs::Uncompressed},
+  {"tif"         ,".tif",ImgSpecs::Uncompressed},
+  {"tif-lzw"     ,".tif",ImgSpecs::LZW         },
+  {"tif-packbits",".tif",ImgSpecs::PackBits    },
+  {"dpx"         ,".dpx",ImgSpecs::Uncompressed},
+  {"hdr"         ,".hdr",ImgSpecs::Uncompressed},
+  {NULL          ,NULL  ,ImgSpecs::Uncompressed}
+};
+///
+
+/// struct MeterCase
+// The meters and pipelines to time. The steps are named as the
+// command line options that create them, the preparation is run
+// before the timer starts.
+static const struct MeterCase {
+  const char *m_pcName;
+  const char *m_pcPrepare;
+  const char *m_pcSteps;
+} MeterCases[] = {
+  {"psnr"          ,NULL         ,"psnr"               },
+  {"pae"           ,NULL         ,"pae"                },
+  {"mae"           ,NULL         ,"mae"                },
+  {"thres"         ,NULL         ,"thres"              },
+  {"stripe"        ,NULL         ,"stripe"             },
+  {"maxfreqr"      ,NULL         ,"maxfreqr"           },
+  {"toycbcr"       ,NULL         ,"toycbcr"            },
+  {"csub"          ,NULL         ,"csub"               },
+  {"cup"           ,"csub"       ,"cup"                },
+  {"rgbtobayer"    ,NULL         ,"rgbtobayer"         },
+  {"debayer"       ,"rgbtobayer" ,"debayer"            },
+  {"debayerahd"    ,"rgbtobayer" ,"debayerahd"         },
+  {"toycbcr+psnr"  ,NULL         ,"toycbcr psnr"       },
+  {"csub+cup+psnr" ,NULL         ,"csub cup psnr"      },
+  {"psnr+pae+mae+thres",NULL     ,"psnr pae mae thres" },
+  {NULL            ,NULL         ,NULL                 }
+};
+///
+
+/// struct Options
+// The settings of the benchmark run.
+struct Options {
+  //
+  // Number of timed repetitions, and of untimed runs before.
+  ULONG       m_ulReps;
+  ULONG       m_ulWarmup;
+  //
+  // The image sizes.
+  ULONG       m_ulWidth[MAX_SIZES];
+  ULONG       m_ulHeight[MAX_SIZES];
+  ULONG       m_ulSizes;
+  //
+  // Only run cases whose name contains this string.
+  const char *m_pcFilter;
+  //
+  // The directory for the files of the loaders and savers.
+  const char *m_pcDirectory;
+  //
+  // Print json lines instead of csv.
+  bool        m_bJSON;
+  //
+  Options(void)
+    : m_ulReps(5), m_ulWarmup(1), m_ulSizes(0), m_pcFilter(NULL),
+#ifdef P_tmpdir
+      m_pcDirectory(P_tmpdir),
+#else
+      m_pcDirectory("."),
+#endif
+      m_bJSON(false)
+  { }
+};
+///
+
+/// TimeOf
+// Return a wall clock time stamp in seconds.
+static double TimeOf(void)
+{
+#if defined(HAVE_GETTIMEOFDAY) && HAVE_SYS_TIME_H
+  struct timeval tv;
+
+  gettimeofday(&tv,NULL);
+
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+#else
+  return double(clock()) / CLOCKS_PER_SEC;
+#endif
+}
+///
+
+/// class BenchImg
+// A blank image of a given sample type filled with a synthesized
+// pattern, a smooth ramp with some noise on top. Images of
+// different seeds differ by the noise alone.
+class BenchImg : public BlankImg {
+  //
+  // Fill a component with the pattern.
+  template<typename T>
+  static void Synthesize(T *data,ULONG bpp,ULONG bpr,ULONG w,ULONG h,UWORD comp,
+			 double max,double noise,ULONG &seed);
+  //
+public:
+  BenchImg(ULONG width,ULONG height,UWORD depth,const struct SampleType &type,ULONG seed);
+};
+///
+
+/// BenchImg::Synthesize
+template<typename T>
+void BenchImg::Synthesize(T *data,ULONG bpp,ULONG bpr,ULONG w,ULONG h,UWORD comp,
+			  double max,double noise,ULONG &seed)
+{
+  ULONG x,y;
+
+  for(y = 0;y < h;y++) {
+    T *p = data;
+    for(x = 0;x < w;x++) {
+      double v;
+      seed = (seed * 1664525UL + 1013904223UL) & MAX_ULONG;
+      v    = max * ((x * 3 + y * 2 + comp * 341) & 1023) / 1023.0;
+      v   += noise * (double((seed >> 16) & 15) - 7.5);
+      if (v < 0.0)
+	v = 0.0;
+      if (v > max)
+	v = max;
+      *p = T(v);
+      p  = (T *)((UBYTE *)p + bpp);
+    }
+    data = (T *)((UBYTE *)data + bpr);
+  }
+}
+///
+
+/// BenchImg::BenchImg
+BenchImg::BenchImg(ULONG width,ULONG height,UWORD depth,const struct SampleType &type,ULONG seed)
+  : BlankImg(width,height,depth)
+{
+  UWORD d;
+
+  CreateComponents(width,height,depth);
+  for(d = 0;d < depth;d++) {
+    m_pComponent[d].m_ucBits = type.m_ucBits;
+    m_pComponent[d].m_bFloat = type.m_bFloat;
+  }
+  BlankSeparate();
+  //
+  for(d = 0;d < depth;d++) {
+    ULONG bpp = BytesPerPixel(d);
+    ULONG bpr = BytesPerRow(d);
+    if (type.m_bFloat) {
+      Synthesize((FLOAT *)DataOf(d),bpp,bpr,width,height,d,1.0,1.0 / 256,seed);
+    } else if (type.m_ucBits > 8) {
+      Synthesize((UWORD *)DataOf(d),bpp,bpr,width,height,d,(1UL << type.m_ucBits) - 1,256,seed);
+    } else {
+      Synthesize((UBYTE *)DataOf(d),bpp,bpr,width,height,d,(1UL << type.m_ucBits) - 1,1,seed);
+    }
+  }
+}
+///
+
+/// class Benchmark
+// A single case to time. Setup and Cleanup run around each
+// repetition, only Run is timed.
+class Benchmark {
+  //
+public:
+  virtual ~Benchmark(void)
+  { }
+  //
+  virtual void Setup(class ImageLayout *,class ImageLayout *)
+  { }
+  //
+  virtual void Run(void) = 0;
+  //
+  virtual void Cleanup(void)
+  { }
+};
+///
+
+/// class SaveBench
+// Times saving the original image in a file format.
+class SaveBench : public Benchmark {
+  //
+  const char        *m_pcFile;
+  struct ImgSpecs    m_Specs;
+  class ImageLayout *m_pImg;
+  //
+public:
+  SaveBench(const char *file,const struct ImgSpecs &specs)
+    : m_pcFile(file), m_Specs(specs), m_pImg(NULL)
+  { }
+  //
+  virtual void Setup(class ImageLayout *org,class ImageLayout *)
+  {
+    m_pImg = org;
+  }
+  //
+  virtual void Run(void)
+  {
+    m_pImg->SaveImage(m_pcFile,m_Specs);
+  }
+};
+///
+
+/// class LoadBench
+// Times loading a file saved before.
+class LoadBench : public Benchmark {
+  //
+  const char        *m_pcFile;
+  class ImageLayout *m_pImg;
+  //
+public:
+  LoadBench(const char *file)
+    : m_pcFile(file), m_pImg(NULL)
+  { }
+  //
+  virtual ~LoadBench(void)
+  {
+    delete m_pImg;
+  }
+  //
+  virtual void Run(void)
+  {
+    struct ImgSpecs specs;
+
+    m_pImg = ImageLayout::LoadImage(m_pcFile,specs);
+  }
+  //
+  virtual void Cleanup(void)
+  {
+    delete m_pImg;
+    m_pImg = NULL;
+  }
+};
+///
+
+/// class MeterBench
+// Times running a list of meters on copies of the images, as the
+// agenda of difftest_ng would.
+class MeterBench : public Benchmark {
+  //
+  const struct MeterCase *m_pCase;
+  class ImageLayout      *m_pOrg;
+  class ImageLayout      *m_pDst;
+  class Meter            *m_pAgenda;
+  class Statistics        m_Stats;
+  class Spectrum          m_Spectrum;
+  //
+  // Create the meter named by the step.
+  static class Meter *MeterOf(const char *step);
+  //
+  // Create the meters of a space separated list of steps.
+  class Meter *AgendaOf(const char *steps);
+  //
+  // Run a list of meters on the images.
+  void RunAgenda(class Meter *m);
+  //
+  // Delete a list of meters.
+  static void Delete(class Meter *&m);
+  //
+public:
+  MeterBench(const struct MeterCase *mc)
+    : m_pCase(mc), m_pOrg(NULL), m_pDst(NULL), m_pAgenda(NULL)
+  { }
+  //
+  virtual ~MeterBench(void)
+  {
+    Cleanup();
+  }
+  //
+  virtual void Setup(class ImageLayout *org,class ImageLayout *dst);
+  //
+  virtual void Run(void)
+  {
+    RunAgenda(m_pAgenda);
+  }
+  //
+  virtual void Cleanup(void);
+};
+///
+
+/// MeterBench::MeterOf
+class Meter *MeterBench::MeterOf(const char *step)
+{
+  if (!strcmp(step,"psnr")) {
+    return new class PSNR(PSNR::Mean);
+  } else if (!strcmp(step,"pae")) {
+    return new class Thres(Thres::Peak);
+  } else if (!strcmp(step,"mae")) {
+    return new class Thres(Thres::Avg);
+  } else if (!strcmp(step,"thres")) {
+    return new class Histogram(LONG(4));
+  } else if (!strcmp(step,"stripe")) {
+    return new class Stripe();
+  } else if (!strcmp(step,"maxfreqr")) {
+    return new class MaxFreq(MaxFreq::MaxR);
+  } else if (!strcmp(step,"toycbcr")) {
+    return new class YCbCr(false,false,false,YCbCr::YCbCr_Trafo);
+  } else if (!strcmp(step,"csub")) {
+    return new class Downsampler(2,2,true);
+  } else if (!strcmp(step,"cup")) {
+    return new class Upsampler(2,2,true,Upsampler::Centered);
+  } else if (!strcmp(step,"rgbtobayer")) {
+    return new class ToBayer(ToBayer::RGGB);
+  } else if (!strcmp(step,"debayer")) {
+    return new class Debayer(Debayer::Bilinear,Debayer::RGGB);
+  } else if (!strcmp(step,"debayerahd")) {
+    return new class Debayer(Debayer::ADH,Debayer::RGGB);
+  }
+
+  assert(!"unknown benchmark step");
+  return NULL;
+}
+///
+
+/// MeterBench::AgendaOf
+class Meter *MeterBench::AgendaOf(const char *steps)
+{
+  class Meter *agenda = NULL;
+  class Meter **last  = &agenda;
+  char step[32];
+
+  try {
+    while(steps && *steps) {
+      size_t len = strcspn(steps," ");
+      assert(len < sizeof(step));
+      memcpy(step,steps,len);
+      step[len] = 0;
+      *last     = MeterOf(step);
+      (*last)->AttachStatistics(&m_Stats);
+      (*last)->AttachSpectrum(&m_Spectrum);
+      last      = &((*last)->NextOf());
+      steps    += len;
+      while(*steps == ' ')
+	steps++;
+    }
+  } catch(...) {
+    Delete(agenda);
+    throw;
+  }
+
+  return agenda;
+}
+///
+
+/// MeterBench::RunAgenda
+void MeterBench::RunAgenda(class Meter *m)
+{
+  double val = 0.0;
+
+  for(;m;m = m->NextOf()) {
+    if (m->NameOf())
+      m_pOrg->TestIfCompatible(m_pDst);
+    val = m->Measure(m_pOrg,m_pDst,val);
+    if (m->NameOf() == NULL && !m->isReadOnly()) {
+      m_Stats.Invalidate();
+      m_Spectrum.Invalidate();
+    }
+  }
+}
+///
+
+/// MeterBench::Delete
+void MeterBench::Delete(class Meter *&m)
+{
+  while(m) {
+    class Meter *next = m->NextOf();
+    delete m;
+    m = next;
+  }
+}
+///
+
+/// MeterBench::Setup
+// Copy the images such that filters can modify them, and run the
+// preparation steps.
+void MeterBench::Setup(class ImageLayout *org,class ImageLayout *dst)
+{
+  class Meter *prep = NULL;
+
+  m_pOrg = ImageLayout::CopyImage(org);
+  m_pDst = ImageLayout::CopyImage(dst);
+  m_Stats.Invalidate();
+  m_Spectrum.Invalidate();
+  //
+  if (m_pCase->m_pcPrepare) {
+    prep = AgendaOf(m_pCase->m_pcPrepare);
+    try {
+      RunAgenda(prep);
+    } catch(...) {
+      Delete(prep);
+      throw;
+    }
+    Delete(prep);
+  }
+  //
+  m_pAgenda = AgendaOf(m_pCase->m_pcSteps);
+}
+///
+
+/// MeterBench::Cleanup
+void MeterBench::Cleanup(void)
+{
+  Delete(m_pAgenda);
+  delete m_pOrg;
+  m_pOrg = NULL;
+  delete m_pDst;
+  m_pDst = NULL;
+}
+///
+
+/// Measure
+// Run a case the given number of times after the warm-up runs, and
+// return the best and the median time of a run in seconds. Returns
+// an error message, or NULL on success.
+static const char *Measure(class Benchmark *b,const struct Options &opts,
+			   class ImageLayout *org,class ImageLayout *dst,
+			   double &best,double &median)
+{
+  double times[MAX_REPS];
+  ULONG i,j,runs = opts.m_ulWarmup + opts.m_ulReps;
+
+  try {
+    for(i = 0;i < runs;i++) {
+      double start;
+      try {
+	b->Setup(org,dst);
+	start = TimeOf();
+	b->Run();
+	if (i >= opts.m_ulWarmup)
+	  times[i - opts.m_ulWarmup] = TimeOf() - start;
+      } catch(...) {
+	b->Cleanup();
+	throw;
+      }
+      b->Cleanup();
+    }
+  } catch(const char *error) {
+    return error;
+  } catch(const std::bad_alloc &) {
+    return "out of memory";
+  }
+  //
+  // Sort the times, there are only a few.
+  for(i = 1;i < opts.m_ulReps;i++) {
+    double t = times[i];
+    for(j = i;j > 0 && times[j - 1] > t;j--)
+      times[j] = times[j - 1];
+    times[j] = t;
+  }
+  best   = times[0];
+  median = (opts.m_ulReps & 1)?(times[opts.m_ulReps >> 1]):
+    (0.5 * (times[(opts.m_ulReps >> 1) - 1] + times[opts.m_ulReps >> 1]));
+
+  return NULL;
+}
+///
+
+/// Report
+// Print the result row of a case.
+static void Report(const struct Options &opts,const char *group,const char *name,
+		   const struct SampleType &type,ULONG w,ULONG h,
+		   const char *error,double best,double median)
+{
+  double mpix = (error || median <= 0.0)?(0.0):(w * double(h) / median * 1e-6);
+
+  if (error) {
+    // Some messages come with a line feed, some do not.
+    int len = int(strcspn(error,"\n"));
+    fprintf(stderr,"%s %s %s %lux%lu failed: %.*s\n",group,name,type.m_pcName,
+	    (unsigned long)w,(unsigned long)h,len,error);
+  }
+
+  if (opts.m_bJSON) {
+    printf("{\"group\":\"%s\",\"case\":\"%s\",\"type\":\"%s\",\"width\":%lu,\"height\":%lu,"
+	   "\"warmup\":%lu,\"reps\":%lu,\"best_ms\":%.3f,\"median_ms\":%.3f,\"mpix_s\":%.2f,"
+	   "\"status\":\"%s\"}\n",
+	   group,name,type.m_pcName,(unsigned long)w,(unsigned long)h,
+	   (unsigned long)opts.m_ulWarmup,(unsigned long)opts.m_ulReps,
+	   best * 1e3,median * 1e3,mpix,(error)?("failed"):("ok"));
+  } else {
+    printf("%s,%s,%s,%lu,%lu,%lu,%lu,%.3f,%.3f,%.2f,%s\n",
+	   group,name,type.m_pcName,(unsigned long)w,(unsigned long)h,
+	   (unsigned long)opts.m_ulWarmup,(unsigned long)opts.m_ulReps,
+	   best * 1e3,median * 1e3,mpix,(error)?("failed"):("ok"));
+  }
+  fflush(stdout);
+}
+///
+
+/// RemoveFile
+// Remove a file written by a saver, for pgx including the component
+// files next to it.
+static void RemoveFile(const char *file,UWORD depth)
+{
+  const char *ext = strrchr(file,'.');
+
+  if (ext && !strcmp(ext,".pgx")) {
+    char buffer[1024 + 16];
+    UWORD d;
+    for(d = 0;d < depth;d++) {
+      sprintf(buffer,"%s_%d.raw",file,d);
+      remove(buffer);
+      sprintf(buffer,"%s_%d.h",file,d);
+      remove(buffer);
+    }
+  }
+  remove(file);
+}
+///
+
+/// Selected
+// Check whether a case is selected by the filter.
+static bool Selected(const struct Options &opts,const char *group,const char *name)
+{
+  return opts.m_pcFilter == NULL || strstr(group,opts.m_pcFilter) || strstr(name,opts.m_pcFilter);
+}
+///
+
+/// RunFileCases
+// Time the savers and loaders on an image pair.
+static void RunFileCases(const struct Options &opts,const struct SampleType &type,
+			 class ImageLayout *org,class ImageLayout *dst)
+{
+  const struct FileCase *fc;
+  char file[1024];
+
+  for(fc = FileCases;fc->m_pcName;fc++) {
+    const char *error;
+    double best   = 0.0;
+    double median = 0.0;
+    struct ImgSpecs specs;
+    //
+    if (!Selected(opts,"save",fc->m_pcName) && !Selected(opts,"load",fc->m_pcName))
+      continue;
+    //
+    snprintf(file,sizeof(file),"%s/bench_%lu_%s%s",opts.m_pcDirectory,
+	     (unsigned long)getpid(),fc->m_pcName,fc->m_pcExtension);
+    specs.Compression = fc->m_Compression;
+    {
+      class SaveBench save(file,specs);
+      error = Measure(&save,opts,org,dst,best,median);
+      if (Selected(opts,"save",fc->m_pcName))
+	Report(opts,"save",fc->m_pcName,type,org->WidthOf(),org->HeightOf(),error,best,median);
+    }
+    if (error == NULL && Selected(opts,"load",fc->m_pcName)) {
+      class LoadBench load(file);
+      error = Measure(&load,opts,org,dst,best,median);
+      Report(opts,"load",fc->m_pcName,type,org->WidthOf(),org->HeightOf(),error,best,median);
+    }
+    RemoveFile(file,org->DepthOf());
+  }
+}
+///
+
+/// RunMeterCases
+// Time the meters and pipelines on an image pair.
+static void RunMeterCases(const struct Options &opts,const struct SampleType &type,
+			  class ImageLayout *org,class ImageLayout *dst)
+{
+  const struct MeterCase *mc;
+
+  for(mc = MeterCases;mc->m_pcName;mc++) {
+    const char *group = (strchr(mc->m_pcSteps,' '))?("pipeline"):("meter");
+    const char *error;
+    double best   = 0.0;
+    double median = 0.0;
+    //
+    if (!Selected(opts,group,mc->m_pcName))
+      continue;
+    //
+    {
+      class MeterBench bench(mc);
+      error = Measure(&bench,opts,org,dst,best,median);
+    }
+    Report(opts,group,mc->m_pcName,type,org->WidthOf(),org->HeightOf(),error,best,median);
+  }
+}
+///
+
+/// Usage
+static void Usage(const char *progname)
+{
+  fprintf(stderr,
+	  "Usage: %s [options]\n"
+	  "Times the loaders, savers, meters and filters of difftest_ng on synthesized\n"
+	  "three-component images of 8 bit, 16 bit and floating point samples, and prints\n"
+	  "one line per case: group,case,type,width,height,warmup,reps,best_ms,median_ms,\n"
+	  "mpix_s,status where mpix_s is derived from the median time.\n\n"
+	  "--reps n           : number of timed repetitions of each case (default 5)\n"
+	  "--warmup n         : number of untimed runs before (default 1)\n"
+	  "--size wxh         : image size, may be given up to %d times\n"
+	  "                     (default 512x512, 1920x1080 and 3840x2160)\n"
+	  "--filter str       : only run cases whose group or name contains str\n"
+	  "--tmpdir dir       : directory for the files of the loaders and savers\n"
+	  "--threads n        : distribute the measurements over n threads, 0 for one per processor\n"
+	  "--json             : print json lines instead of csv\n",
+	  progname,MAX_SIZES);
+}
+///
+
+/// ParseLong
+static long ParseLong(const char *str)
+{
+  char *endptr;
+  long val;
+
+  if (str == NULL)
+    throw "insufficient arguments";
+
+  val = strtol(str,&endptr,0);
+
+  if (*endptr)
+    throw "argument is not a number";
+
+  return val;
+}
+///
+
+/// main
+int main(int argc,char **argv)
+{
+  const char *progname = argv[0];
+  struct Options opts;
+  ULONG s;
+  int rc = 0;
+
+  try {
+    while(argc > 1) {
+      const char *arg = argv[1];
+      if (!strcmp(arg,"--help")) {
+	Usage(progname);
+	return 0;
+      } else if (!strcmp(arg,"--reps")) {
+	long n = ParseLong(argv[2]);
+	if (n <= 0 || n > MAX_REPS)
+	  throw "--reps requires a positive number of repetitions of at most 64";
+	opts.m_ulReps = n;
+	argc--;
+	argv++;
+      } else if (!strcmp(arg,"--warmup")) {
+	long n = ParseLong(argv[2]);
+	if (n < 0)
+	  throw "--warmup requires a non-negative argument";
+	opts.m_ulWarmup = n;
+	argc--;
+	argv++;
+      } else if (!strcmp(arg,"--size")) {
+	char *end;
+	long w,h;
+	if (argc < 3)
+	  throw "--size requires the image size as argument";
+	if (opts.m_ulSizes >= MAX_SIZES)
+	  throw "too many image sizes";
+	w = strtol(argv[2],&end,10);
+	if (*end != 'x')
+	  throw "--size requires an argument of the form <width>x<height>";
+	h = strtol(end + 1,&end,10);
+	if (*end || w <= 0 || h <= 0)
+	  throw "--size requires an argument of the form <width>x<height>";
+	opts.m_ulWidth[opts.m_ulSizes]  = w;
+	opts.m_ulHeight[opts.m_ulSizes] = h;
+	opts.m_ulSizes++;
+	argc--;
+	argv++;
+      } else if (!strcmp(arg,"--filter")) {
+	if (argc < 3)
+	  throw "--filter requires a string argument";
+	opts.m_pcFilter = argv[2];
+	argc--;
+	argv++;
+      } else if (!strcmp(arg,"--tmpdir")) {
+	if (argc < 3)
+	  throw "--tmpdir requires a directory name as argument";
+	opts.m_pcDirectory = argv[2];
+	argc--;
+	argv++;
+      } else if (!strcmp(arg,"--threads")) {
+	long t = ParseLong(argv[2]);
+	if (t < 0)
+	  throw "--threads requires a non-negative argument";
+	ThreadPool::SetThreadCount(t);
+	argc--;
+	argv++;
+      } else if (!strcmp(arg,"--json")) {
+	opts.m_bJSON = true;
+      } else {
+	Usage(progname);
+	throw "unknown command line option";
+      }
+      argc--;
+      argv++;
+    }
+    //
+    if (opts.m_ulSizes == 0) {
+      opts.m_ulWidth[0] = 512;  opts.m_ulHeight[0] = 512;
+      opts.m_ulWidth[1] = 1920; opts.m_ulHeight[1] = 1080;
+      opts.m_ulWidth[2] = 3840; opts.m_ulHeight[2] = 2160;
+      opts.m_ulSizes    = 3;
+    }
+    //
+    if (!opts.m_bJSON)
+      printf("group,case,type,width,height,warmup,reps,best_ms,median_ms,mpix_s,status\n");
+    //
+    for(s = 0;s < opts.m_ulSizes;s++) {
+      const struct SampleType *type;
+      for(type = SampleTypes;type->m_pcName;type++) {
+	class BenchImg org(opts.m_ulWidth[s],opts.m_ulHeight[s],3,*type,1);
+	class BenchImg dst(opts.m_ulWidth[s],opts.m_ulHeight[s],3,*type,2);
+	//
+	RunFileCases(opts,*type,&org,&dst);
+	RunMeterCases(opts,*type,&org,&dst);
+      }
+    }
+  } catch(const char *error) {
+    fprintf(stderr,"Program failed: %s\n",error);
+    rc = 10;
+  } catch(const std::bad_alloc &err) {
+    fprintf(stderr,"Program run out of memory\n");
+    rc = 15;
+  } catch(...) {
+    fprintf(stderr,"Caught unknown exception\n");
+    rc = 20;
+  }
+
+  return rc;
+}
+///
@@ -65,6 +65,8 @@ and conversion framework.
 #include "diff/stripe.hpp"
 #include "diff/add.hpp"
 #include "diff/peakpos.hpp"
+#include "diff/identical.hpp"
+#include "diff/hash.hpp"
 #include "diff/mapping.hpp"
 #include "diff/downsampler.hpp"
 #include "diff/upsampler.hpp"
@@ -78,8 +80,15 @@ and conversion framework.
 #include "diff/whitebalance.hpp"
 #include "diff/fromgrey.hpp"
 #include "diff/butterfly.hpp"
+#include "diff/statistics.hpp"
+#include "diff/spectrum.hpp"
+#include "tools/threadpool.hpp"
+#include "tools/fft.hpp"
+#include "cmd/batch.hpp"
+#include "cmd/sequence.hpp"
 #include "img/imglayout.hpp"
 #include "img/imgspecs.hpp"
+#include "img/cachedimg.hpp"
 #include <new>
 ///
 
@@ -88,6 +97,7 @@ and conversion framework.
 void Usage(const char *progname)
 {
   fprintf(stderr,"Usage: %s [options] original distorted\n"
+	  "       %s [options] --batch list\n"
 	  "where original and distorted are ppm,pbm,pgm,pfm,pfs,bmp,pgx,tif,png,exr,rgbe or raw (craw,v12,yuv) images\n"
 	  "and options are one or more of\n"
 	  "--psnr             : measure the psnr with equal weights over all components\n"
@@ -115,7 +125,10 @@ void Usage(const char *progname)
 	  "--drift            : find the mean error (drift) between original and distorted\n"
 	  "--mae              : find the mean absolute error\n"
 	  "--pae              : find the peak absolute error\n"
+	  "--identical        : check whether the images are identical bit by bit (1 = yes, 0 = no)\n"
 	  "--stripe           : measure a striping indicator that detects horizontal or vertical artifacts\n"
+	  "--stripeprofile f  : measure the striping indicator, and write the mean square error of each row\n"
+	  "                     and column to file f, '-' for stdout\n"
 	  "--width            : print the width of the images\n"
 	  "--height           : print the height of the images\n"
 	  "--depth            : print the number of components of the images\n"
@@ -131,24 +144,23 @@ void Usage(const char *progname)
 	  "--notmask roi      : mask the source image by the inverse of the mask\n"
 	  "--convert target   : save the original image unaltered, but possibly in a new format\n"
 	  "--merge target     : merge the two images together, add second as components of first\n"
-#ifdef USE_GSL
 	  "--fft target       : save the fft of the difference image\n"
 	  "--wfft target      : save the windowed fft of the difference image\n"
 	  "--filt x y r dst   : run a radial filter around frequency x,y with radius r, saves the filtered image as dst\n"
 	  "--nfilt x y r dst  : similar to --filt, but the output is normalized to the full range\n"
 	  "--comb x y r dst   : apply a comb filter in direction x y and radius r\n"
 	  "--ncomb x y r dst  : similar to --comb, but the output is normalized to the full range\n"
-#endif
 	  "--hist target      : generate a histogram plot. If \"target\" is -, write to stdout\n"
+	  "--hash target      : write a 128 bit hash of the samples of both images to target, - for stdout.\n"
+	  "                     The hash does not depend on the file format\n"
+	  "--hashseed s trgt  : similar to --hash, but seed the hash function with s\n"
 	  "--thres threshold  : compute the ratio of pixels whose difference is > than threshold\n"
 	  "--colorhist size   : generate reduced histogram separately for each component using the given bucket size\n"
-#ifdef USE_GSL
 	  "--maxfreqr         : locate the absolute value of the most exposed frequency in the error image\n"
 	  "--maxfreqx         : locate the horizontal component of the most exposed frequency in the error image\n"
 	  "--maxfreqy         : locate the vertical component of the most exposed frequency in the error image\n"
 	  "--maxfreqv         : compute the domination ratio of the most exposed frequency in the error image\n"
 	  "--patternidx       : scan the FFT for suspicious patterns and output the likeliness of errors\n"
-#endif
 	  "--toflt dst        : save a floating point version of the source image\n"
 	  "--asflt            : convert to floating point before proceeding (run as filter)\n"
 	  "--tohfl dst        : save a half-float version of the source image\n"
@@ -284,8 +296,25 @@ void Usage(const char *progname)
 	  "--isreducedrange   : override automatic range detection, source has head/toe region\n"
 	  "--littleendian     : use little endian output if applicable\n"
 	  "--bigendian        : use big endian output if applicable\n"
+	  "--compress method  : compress tiff output with lzw, packbits or none (default)\n"
+	  "--predictor        : use horizontal prediction for lzw compressed integer tiff output\n"
+	  "--rowsperstrip n   : write tiff output in strips of n rows, compressed in parallel\n"
 	  "--toabsradiance    : multiply floating point samples by recorded radiance scale to convert to absolute radiance\n"
 	  "--brief            : use a brief (only numeric) output format\n"
+	  "--stream rows      : read the images in stripes of the given number of rows instead of\n"
+	  "                     loading them completely. Only for meters that use point-wise statistics\n"
+	  "                     alone, and for pnm, pfm, striped tiff and interleaved raw images\n"
+	  "--threads n        : distribute the measurements over n threads, 0 for one per processor (default)\n"
+	  "--batch list       : compare all image pairs in the list file instead of the two image arguments,\n"
+	  "                     one pair per line, separated by a tab or white space. '-' reads stdin.\n"
+	  "                     The pairs are distributed over the threads, originals shared by several\n"
+	  "                     pairs are loaded once, and one result row is printed per pair.\n"
+	  "--batchformat fmt  : format of the batch results, csv (default), tsv or json\n"
+	  "--cache-dir dir    : keep the decoded source images in the given directory, and map them\n"
+	  "                     from there instead of decoding them again in later runs. Raw and PGX\n"
+	  "                     images are not cached\n"
+	  "--exact-transfer   : compute the transfer functions of the conversions above by the math library\n"
+	  "                     instead of looking them up in tables, for validation\n"
 	  ">,>=,==,!=,<=,< t  : last result must be larger, larger or equal, equal, not equal,\n"
 	  "                     smaller or equal or smaller than given threshold t.\n"
 	  "                     Attention: Quoting required when used from the shell.\n"
@@ -294,10 +323,21 @@ void Usage(const char *progname)
 	  "given dimensions. This image can be filled with any other color by --fill, see above.\n"
 	  "If the distorted image file name equals '-', then the image is replaced by a blank image\n"
 	  "\n"
+	  "If the name of a raw image is followed by '#frames=first-last', the file is read as a sequence\n"
+	  "of frames stored back to back, and the frames are compared pair by pair. The results are printed\n"
+	  "for each frame, followed by their mean and their minimum. If last is omitted, the sequence ends\n"
+	  "at the end of the file. An image without frame range takes the frames of the other image.\n"
+	  "\n"
+	  "In batch mode, empty lines and lines starting with '#' in the list are ignored. Each result\n"
+	  "row holds the two file names, one column per meter that prints a result, and an error\n"
+	  "column that is empty if the pair was measured successfully. Comparison operators fail the\n"
+	  "pair they are evaluated on, not the batch. The program returns an error code if any pair\n"
+	  "failed. Options that write files write them again for each pair.\n"
+	  "\n"
 	  "--help             : print this page\n"
 	  "--rawhelp          : print help on raw image formatting. First time users: PLEASE READ THIS.\n"
 	  "\n",
-	  progname
+	  progname,progname
 	  );
 }
 ///
@@ -546,6 +586,8 @@ class Meter *ParseMetrics(int &,char **&argv)
     return new class Thres(Thres::Toe);
   } else if (!strcmp(arg,"--head")) {
     return new class Thres(Thres::Head);
+  } else if (!strcmp(arg,"--identical")) {
+    return new class Identical();
   }
 
   return NULL;
@@ -590,8 +632,7 @@ class Meter *ParseProperties(int &argc,char **&argv)
 ///
 
 /// ParseFFT
-// Parse FFT related features that require the GSL
-#ifdef USE_GSL
+// Parse FFT related features.
 class Meter *ParseFFT(int &argc,char **&argv)
 {
   class Meter *m = NULL;
@@ -665,7 +706,6 @@ class Meter *ParseFFT(int &argc,char **&argv)
 
   return m;
 }
-#endif
 ///
 
 /// ParseColor
@@ -1482,264 +1522,917 @@ class Meter *ParseTotal(int &argc,char **&argv)
 }
 ///
 
-/// main
-int main(int argc,char **argv)
+/// struct Session
+// Everything the agenda of meters works on: the meters parsed from the
+// options, the image specifications the options modify, the copies
+// of the images --restore goes back to and the statistics shared by
+// the meters. In batch mode, each thread runs a session of its own.
+struct Session {
+  //
+  // The meters in the order they run.
+  class Meter       *m_pAgenda;
+  //
+  // The crop starting the agenda if its window is handed to the
+  // loaders, which then may read the window alone.
+  class Crop        *m_pCrop;
+  //
+  // The specifications of the original, the distorted and the
+  // output images.
+  struct ImgSpecs    m_Spec1,m_Spec2,m_SpecOut;
+  //
+  // The specifications as set by the options, before loading.
+  struct ImgSpecs    m_OptSpec1,m_OptSpec2,m_OptSpecOut;
+  //
+  // Copies of the images as loaded, for --restore.
+  class ImageLayout *m_pOrgCopy;
+  class ImageLayout *m_pDstCopy;
+  //
+  // The point-wise statistics shared by all meters.
+  class Statistics   m_Stats;
+  //
+  // The transformations of the difference image shared by all
+  // spectral meters.
+  class Spectrum     m_Spectrum;
+  //
+  // Only print the numbers.
+  bool               m_bBrief;
+  //
+  // Set if all meters can measure more than one image pair.
+  bool               m_bReusable;
+  //
+  // Set if a filter on the agenda may modify the images.
+  bool               m_bFilters;
+  //
+  // Set if --restore is on the agenda and thus needs the copies.
+  bool               m_bRestore;
+  //
+  // The list of image pairs in batch mode, and the output format.
+  const char        *m_pcBatch;
+  Batch::Format      m_Format;
+  //
+  // The height of the stripes the images are read in, or zero to
+  // load them completely.
+  ULONG              m_ulStripe;
+  //
+  Session(void)
+    : m_pAgenda(NULL), m_pCrop(NULL), m_pOrgCopy(NULL), m_pDstCopy(NULL), m_bBrief(false),
+      m_bReusable(true), m_bFilters(false), m_bRestore(false),
+      m_pcBatch(NULL), m_Format(Batch::CSV), m_ulStripe(0)
+  { }
+  //
+  ~Session(void)
+  {
+    class Meter *m;
+
+    delete m_pOrgCopy;
+    delete m_pDstCopy;
+
+    while((m = m_pAgenda)) {
+      m_pAgenda = m->NextOf();
+      delete m;
+    }
+  }
+};
+///
+
+/// ParseOptions
+// Parse the options into the session and return false if only help
+// was requested. On return, argc and argv point to the image
+// arguments. Options that set process wide state only take effect
+// if global is set, sessions that are parsed anew for later pairs,
+// possibly from worker threads, leave it alone.
+bool ParseOptions(int &argc,char **&argv,struct Session &s,const char *progname,bool global = true)
 {
-  class Meter *agenda = NULL,*last = NULL,*m;
-  const char *org = NULL;
-  const char *dst = NULL;
-  const char *name = argv[0];
-  class ImageLayout *orgimg = NULL;
-  class ImageLayout *dstimg = NULL;
-  class ImageLayout *orgcpy = NULL;
-  class ImageLayout *dstcpy = NULL;
-  struct ImgSpecs spec1,spec2,specout;
-  bool  brief = false;
-  int   rc    = 0;
+  class Meter *last = NULL,*m;
 
-  try {
-    while(argc > 1) {
-      const char *arg = argv[1];
-      //
-      // No meter yet.
-      m = NULL;
-      if (arg[0] == '-' && arg[1] != '/') {
-	if (!strcmp(arg,"--help")) {
-	  Usage(argv[0]);
-	  return 0;
-	} else if (!strcmp(arg,"--rawhelp")) {
-	  RawHelp();
-	  return 0;
-	} else if ((m = ParseMetrics(argc,argv))) {
-	  // Done with it.
-	} else if (!strcmp(arg,"--stripe")) {
-	  m = new class Stripe();
-	} else if ((m = ParseProperties(argc,argv))) {
-	  // Done with it.
-	} else if (!strcmp(arg,"--diff") || !strcmp(arg,"-i")) {
-	  if (argc < 3)
-	    throw "--diff requires the target file name as argument";
-	  m = new class DiffImg(argv[2],specout,true);
-	  argc--;
-	  argv++;
-	} else if (!strcmp(arg,"--rawdiff") || !strcmp(arg,"-i")) {
-	  if (argc < 3)
-	    throw "--rawdiff requires the target file name as argument";
-	  m = new class DiffImg(argv[2],specout,false);
-	  argc--;
-	  argv++;
-	} else if (!strcmp(arg,"--sdiff")) {
-	  if (argc < 4)
-	    throw "--sdiff requires a scale and the target file name as argument";
-	  m = new class DiffImg(argv[3],specout,false,ParseDouble(argv[2]));
-	  argc -= 2;
-	  argv += 2;
-	} else if (!strcmp(arg,"--butterfly")) {
-	  if (argc < 3)
-	    throw "--butterfly requires the target file name as argument";
-	  m = new class Butterfly(argv[2],specout);
-	  argc--;
-	  argv++;
-	} else if (!strcmp(arg,"--suppress")) {
-	  double t;
-	  if (argc < 3)
-	    throw "--suppress requires a threshold as argument";
-	  t = ParseDouble(argv[2]);
-	  if (t < 0.0)
-	    throw "--suppress requires a non-negative argument";
-	  m = new class Suppress(t);
-	  argc--;
-	  argv++;
-	} else if (!strcmp(arg,"--mask") || !strcmp(arg,"-R")) {
-	  if (argc < 3)
-	    throw "--mask requires the mask file name as argument";
-	  m = new class Mask(argv[2],false);
-	  argc--;
-	  argv++;
-	} else if (!strcmp(arg,"--notmask")) {
-	  if (argc < 3)
-	    throw "--notmask requires the mask file name as argument";
-	  m = new class Mask(argv[2],true);
-	  argc--;
-	  argv++;	  
-	} else if (!strcmp(arg,"--convert")) {
-	  if (argc < 3)
-	    throw "--convert requires the target file name as argument";
-	  m = new class ConvertImg(argv[2],specout);
-	  argc--;
-	  argv++;
-	} else if (!strcmp(arg,"--merge")) {
-	  if (argc < 3)
-	    throw "--merge requires the target file name as argument";
-	  m = new class AddImg(argv[2],specout);
-	  argc--;
-	  argv++;
-#ifdef USE_GSL
-	} else if ((m = ParseFFT(argc,argv))) {
-	  // done with it.
-#endif
-	} else if (!strcmp(arg,"--hist")) {
-	  if (argc < 3)
-	    throw "--hist requires a file name as argument";
-	  m = new class Histogram(argv[2]);
-	  argc--;
-	  argv++;
-	} else if (!strcmp(arg,"--thres")) {
-	  long t;
-	  if (argc < 3)
-	    throw "--thres requires a threshold as argument";
-	  t = ParseLong(argv[2]);
-	  if (t < 0)
-	    throw "--thres requires a non-negative threshold";
-	  m = new class Histogram(t);
-	  argc--;
-	  argv++;
-	} else if (!strcmp(arg,"--colorhist")) {
-	  double b;
-	  if (argc < 3)
-	    throw "--colorhist requires a bucket size as argument";
-	  b = ParseDouble(argv[2]);
-	  if (b <= 0.0)
-	    throw "--colorhist requries a positive bucket size";
-	  m = new class ColorHistogram(1.0 / b);
-	  argc--;
-	  argv++;
-	} else if ((m = ParseColor(argc,argv,specout))) {
-	  // done with it.
-	} else if ((m = ParseBayer(argc,argv))) {
-	  // done with it.
-	} else if ((m = ParseConversions(argc,argv,specout))) {
-	  // done with it.
-	} else if ((m = ParseTransferFunctions(argc,argv,specout))) {
-	  // done with it.
-	} else if ((m = ParseTotal(argc,argv))) {
-	  // done with it.
-	} else if ((m = ParseGeometric(argc,argv,spec1,spec2))) {
-	  // done with it.
-	} else if ((m = ParseSubsampling(argc,argv))) {
-	  // Done with it.
-	} else if ((m = ParseComponent(argc,argv))) {
-	  // done with it.
-	} else if (!strcmp(arg,"--restore")) {
-	  m = new class Restore(orgcpy,dstcpy);
-	} else if (!strcmp(arg,"--raw")) {
-	  specout.ASCII = ImgSpecs::No;
-	} else if (!strcmp(arg,"--ascii")) {
-	  specout.ASCII = ImgSpecs::Yes;
-	} else if (!strcmp(arg,"--interleaved")) {
-	  specout.Interleaved = ImgSpecs::Yes;
-	} else if (!strcmp(arg,"--separate")) {
-	  specout.Interleaved = ImgSpecs::No;
-	} else if (!strcmp(arg,"--littleendian")) {
-	  specout.LittleEndian = ImgSpecs::Yes;
-	} else if (!strcmp(arg,"--bigendian")) {
-	  specout.LittleEndian = ImgSpecs::No;
-	} else if (!strcmp(arg,"--toabsradiance")) {
-	  spec1.AbsoluteRadiance = ImgSpecs::Yes;
-	  spec2.AbsoluteRadiance = ImgSpecs::Yes;
-	} else if (!strcmp(arg,"--isyuv")) {
-	  spec1.YUVEncoded = ImgSpecs::Yes;
-	  spec2.YUVEncoded = ImgSpecs::Yes;
-	} else if (!strcmp(arg,"--isrgb")) {
-	  spec1.YUVEncoded = ImgSpecs::No;
-	  spec2.YUVEncoded = ImgSpecs::No;
-	} else if (!strcmp(arg,"--isfullrange")) {
-	  spec1.FullRange  = ImgSpecs::Yes;
-	  spec2.FullRange  = ImgSpecs::Yes;
-	} else if (!strcmp(arg,"--isreducedrange")) {
-	  spec1.FullRange  = ImgSpecs::No;
-	  spec2.FullRange  = ImgSpecs::No;
-	} else if (!strcmp(arg,"--brief")) {
-	  brief = true;
-	} else {
-	  Usage(name);
-	  throw "unknown command line option";
-	}
+  while(argc > 1) {
+    const char *arg = argv[1];
+    //
+    // No meter yet.
+    m = NULL;
+    if (arg[0] == '-' && arg[1] != '/') {
+      if (!strcmp(arg,"--help")) {
+	Usage(argv[0]);
+	return false;
+      } else if (!strcmp(arg,"--rawhelp")) {
+	RawHelp();
+	return false;
+      } else if ((m = ParseMetrics(argc,argv))) {
+	// Done with it.
+      } else if (!strcmp(arg,"--stripe")) {
+	m = new class Stripe();
+      } else if (!strcmp(arg,"--stripeprofile")) {
+	if (argc < 3)
+	  throw "--stripeprofile requires a file name as argument";
+	m = new class Stripe(argv[2]);
+	argc--;
 	argv++;
+      } else if ((m = ParseProperties(argc,argv))) {
+	// Done with it.
+      } else if (!strcmp(arg,"--diff") || !strcmp(arg,"-i")) {
+	if (argc < 3)
+	  throw "--diff requires the target file name as argument";
+	m = new class DiffImg(argv[2],s.m_SpecOut,true);
 	argc--;
-      } else if (!strcmp(arg,">")) {
-	m = new Compare(Compare::Greater,ParseDouble(argv[2]));
-	argv += 2;
-	argc -= 2;
-      } else if (!strcmp(arg,">=")) {
-	m = new Compare(Compare::GreaterEqual,ParseDouble(argv[2]));
-	argv += 2;
-	argc -= 2;
-      } else if (!strcmp(arg,"==")) {
-	m = new Compare(Compare::Equal,ParseDouble(argv[2]));
-	argv += 2;
-	argc -= 2;
-      } else if (!strcmp(arg,"!=")) {
-	m = new Compare(Compare::NotEqual,ParseDouble(argv[2]));
-	argv += 2;
+	argv++;
+      } else if (!strcmp(arg,"--rawdiff") || !strcmp(arg,"-i")) {
+	if (argc < 3)
+	  throw "--rawdiff requires the target file name as argument";
+	m = new class DiffImg(argv[2],s.m_SpecOut,false);
+	argc--;
+	argv++;
+      } else if (!strcmp(arg,"--sdiff")) {
+	if (argc < 4)
+	  throw "--sdiff requires a scale and the target file name as argument";
+	m = new class DiffImg(argv[3],s.m_SpecOut,false,ParseDouble(argv[2]));
 	argc -= 2;
-      } else if (!strcmp(arg,"<=")) {
-	m = new Compare(Compare::SmallerEqual,ParseDouble(argv[2]));
 	argv += 2;
+      } else if (!strcmp(arg,"--butterfly")) {
+	if (argc < 3)
+	  throw "--butterfly requires the target file name as argument";
+	m = new class Butterfly(argv[2],s.m_SpecOut);
+	argc--;
+	argv++;
+      } else if (!strcmp(arg,"--suppress")) {
+	double t;
+	if (argc < 3)
+	  throw "--suppress requires a threshold as argument";
+	t = ParseDouble(argv[2]);
+	if (t < 0.0)
+	  throw "--suppress requires a non-negative argument";
+	m = new class Suppress(t);
+	argc--;
+	argv++;
+      } else if (!strcmp(arg,"--mask") || !strcmp(arg,"-R")) {
+	if (argc < 3)
+	  throw "--mask requires the mask file name as argument";
+	m = new class Mask(argv[2],false);
+	argc--;
+	argv++;
+      } else if (!strcmp(arg,"--notmask")) {
+	if (argc < 3)
+	  throw "--notmask requires the mask file name as argument";
+	m = new class Mask(argv[2],true);
+	argc--;
+	argv++;	  
+      } else if (!strcmp(arg,"--convert")) {
+	if (argc < 3)
+	  throw "--convert requires the target file name as argument";
+	m = new class ConvertImg(argv[2],s.m_SpecOut);
+	argc--;
+	argv++;
+      } else if (!strcmp(arg,"--merge")) {
+	if (argc < 3)
+	  throw "--merge requires the target file name as argument";
+	m = new class AddImg(argv[2],s.m_SpecOut);
+	argc--;
+	argv++;
+      } else if ((m = ParseFFT(argc,argv))) {
+	// done with it.
+      } else if (!strcmp(arg,"--hash")) {
+	if (argc < 3)
+	  throw "--hash requires a file name as argument";
+	m = new class Hash(argv[2]);
+	argc--;
+	argv++;
+      } else if (!strcmp(arg,"--hashseed")) {
+	long seed;
+	if (argc < 4)
+	  throw "--hashseed requires a seed and a file name as arguments";
+	seed = ParseLong(argv[2]);
+	m = new class Hash(argv[3],UQUAD(seed));
 	argc -= 2;
-      } else if (!strcmp(arg,"<")) {
-	m = new Compare(Compare::Smaller,ParseDouble(argv[2]));
 	argv += 2;
-	argc -= 2;
-      } else break;
-      //
-      // Created a new meter to be attached?
-      if (m) {
-	if (agenda == NULL) {
-	  agenda = m;
-	  last   = m;
+      } else if (!strcmp(arg,"--hist")) {
+	if (argc < 3)
+	  throw "--hist requires a file name as argument";
+	m = new class Histogram(argv[2]);
+	argc--;
+	argv++;
+      } else if (!strcmp(arg,"--thres")) {
+	long t;
+	if (argc < 3)
+	  throw "--thres requires a threshold as argument";
+	t = ParseLong(argv[2]);
+	if (t < 0)
+	  throw "--thres requires a non-negative threshold";
+	m = new class Histogram(t);
+	argc--;
+	argv++;
+      } else if (!strcmp(arg,"--colorhist")) {
+	double b;
+	if (argc < 3)
+	  throw "--colorhist requires a bucket size as argument";
+	b = ParseDouble(argv[2]);
+	if (b <= 0.0)
+	  throw "--colorhist requries a positive bucket size";
+	m = new class ColorHistogram(1.0 / b);
+	argc--;
+	argv++;
+      } else if ((m = ParseColor(argc,argv,s.m_SpecOut))) {
+	// done with it.
+      } else if ((m = ParseBayer(argc,argv))) {
+	// done with it.
+      } else if ((m = ParseConversions(argc,argv,s.m_SpecOut))) {
+	// done with it.
+      } else if ((m = ParseTransferFunctions(argc,argv,s.m_SpecOut))) {
+	// done with it.
+      } else if ((m = ParseTotal(argc,argv))) {
+	// done with it.
+      } else if ((m = ParseGeometric(argc,argv,s.m_Spec1,s.m_Spec2))) {
+	// Note a crop starting the agenda.
+	if (s.m_pAgenda == NULL && (!strcmp(arg,"--crop") || !strcmp(arg,"--cropd")))
+	  s.m_pCrop = (class Crop *)m;
+      } else if ((m = ParseSubsampling(argc,argv))) {
+	// A chroma subsampling right after a conversion to YCbCr is
+	// run by the conversion.
+	if (last && !strcmp(arg,"--csub") && last->FuseSubsampling((class Downsampler *)m))
+	  m = NULL;
+      } else if ((m = ParseComponent(argc,argv))) {
+	// done with it.
+      } else if (!strcmp(arg,"--restore")) {
+	m = new class Restore(s.m_pOrgCopy,s.m_pDstCopy);
+	s.m_bRestore = true;
+      } else if (!strcmp(arg,"--raw")) {
+	s.m_SpecOut.ASCII = ImgSpecs::No;
+      } else if (!strcmp(arg,"--ascii")) {
+	s.m_SpecOut.ASCII = ImgSpecs::Yes;
+      } else if (!strcmp(arg,"--interleaved")) {
+	s.m_SpecOut.Interleaved = ImgSpecs::Yes;
+      } else if (!strcmp(arg,"--separate")) {
+	s.m_SpecOut.Interleaved = ImgSpecs::No;
+      } else if (!strcmp(arg,"--littleendian")) {
+	s.m_SpecOut.LittleEndian = ImgSpecs::Yes;
+      } else if (!strcmp(arg,"--bigendian")) {
+	s.m_SpecOut.LittleEndian = ImgSpecs::No;
+      } else if (!strcmp(arg,"--compress")) {
+	if (argc < 3)
+	  throw "--compress requires lzw, packbits or none as argument";
+	if (!strcmp(argv[2],"lzw")) {
+	  s.m_SpecOut.Compression = ImgSpecs::LZW;
+	} else if (!strcmp(argv[2],"packbits")) {
+	  s.m_SpecOut.Compression = ImgSpecs::PackBits;
+	} else if (!strcmp(argv[2],"none")) {
+	  s.m_SpecOut.Compression = ImgSpecs::Uncompressed;
+	} else {
+	  throw "--compress requires lzw, packbits or none as argument";
+	}
+	argc--;
+	argv++;
+      } else if (!strcmp(arg,"--predictor")) {
+	s.m_SpecOut.Predictor = ImgSpecs::Yes;
+      } else if (!strcmp(arg,"--rowsperstrip")) {
+	long r;
+	if (argc < 3)
+	  throw "--rowsperstrip requires the number of rows as argument";
+	r = ParseLong(argv[2]);
+	if (r <= 0)
+	  throw "--rowsperstrip requires a positive argument";
+	s.m_SpecOut.RowsPerStrip = r;
+	argc--;
+	argv++;
+      } else if (!strcmp(arg,"--toabsradiance")) {
+	s.m_Spec1.AbsoluteRadiance = ImgSpecs::Yes;
+	s.m_Spec2.AbsoluteRadiance = ImgSpecs::Yes;
+      } else if (!strcmp(arg,"--isyuv")) {
+	s.m_Spec1.YUVEncoded = ImgSpecs::Yes;
+	s.m_Spec2.YUVEncoded = ImgSpecs::Yes;
+      } else if (!strcmp(arg,"--isrgb")) {
+	s.m_Spec1.YUVEncoded = ImgSpecs::No;
+	s.m_Spec2.YUVEncoded = ImgSpecs::No;
+      } else if (!strcmp(arg,"--isfullrange")) {
+	s.m_Spec1.FullRange  = ImgSpecs::Yes;
+	s.m_Spec2.FullRange  = ImgSpecs::Yes;
+      } else if (!strcmp(arg,"--isreducedrange")) {
+	s.m_Spec1.FullRange  = ImgSpecs::No;
+	s.m_Spec2.FullRange  = ImgSpecs::No;
+      } else if (!strcmp(arg,"--brief")) {
+	s.m_bBrief = true;
+      } else if (!strcmp(arg,"--batch")) {
+	if (argc < 3)
+	  throw "--batch requires the file name of the list of image pairs as argument";
+	s.m_pcBatch = argv[2];
+	argc--;
+	argv++;
+      } else if (!strcmp(arg,"--batchformat")) {
+	if (argc < 3)
+	  throw "--batchformat requires csv, tsv or json as argument";
+	if (!strcmp(argv[2],"csv")) {
+	  s.m_Format = Batch::CSV;
+	} else if (!strcmp(argv[2],"tsv")) {
+	  s.m_Format = Batch::TSV;
+	} else if (!strcmp(argv[2],"json")) {
+	  s.m_Format = Batch::JSON;
 	} else {
-	  assert(last);
-	  last->NextOf() = m;
-	  last           = m;
+	  throw "--batchformat requires csv, tsv or json as argument";
 	}
+	argc--;
+	argv++;
+      } else if (!strcmp(arg,"--stream")) {
+	long r;
+	if (argc < 3)
+	  throw "--stream requires the number of rows per stripe as argument";
+	r = ParseLong(argv[2]);
+	if (r <= 0)
+	  throw "--stream requires a positive number of rows";
+	// Stripes must start at a band boundary of the statistics.
+	s.m_ulStripe = (ULONG(r) + Statistics::BandHeight - 1) & ~ULONG(Statistics::BandHeight - 1);
+	argc--;
+	argv++;
+      } else if (!strcmp(arg,"--threads")) {
+	long t;
+	if (argc < 3)
+	  throw "--threads requires the number of threads as argument";
+	t = ParseLong(argv[2]);
+	if (t < 0)
+	  throw "--threads requires a non-negative argument";
+	if (global)
+	  ThreadPool::SetThreadCount(t);
+	argc--;
+	argv++;
+      } else if (!strcmp(arg,"--cache-dir")) {
+	if (argc < 3)
+	  throw "--cache-dir requires the cache directory as argument";
+	if (global)
+	  CachedImg::SetDirectory(argv[2]);
+	argc--;
+	argv++;
+      } else if (!strcmp(arg,"--exact-transfer")) {
+	if (global)
+	  Mapping::SetExactTransfer(true);
+      } else {
+	Usage(progname);
+	throw "unknown command line option";
+      }
+      argv++;
+      argc--;
+    } else if (!strcmp(arg,">")) {
+      m = new Compare(Compare::Greater,ParseDouble(argv[2]));
+      argv += 2;
+      argc -= 2;
+    } else if (!strcmp(arg,">=")) {
+      m = new Compare(Compare::GreaterEqual,ParseDouble(argv[2]));
+      argv += 2;
+      argc -= 2;
+    } else if (!strcmp(arg,"==")) {
+      m = new Compare(Compare::Equal,ParseDouble(argv[2]));
+      argv += 2;
+      argc -= 2;
+    } else if (!strcmp(arg,"!=")) {
+      m = new Compare(Compare::NotEqual,ParseDouble(argv[2]));
+      argv += 2;
+      argc -= 2;
+    } else if (!strcmp(arg,"<=")) {
+      m = new Compare(Compare::SmallerEqual,ParseDouble(argv[2]));
+      argv += 2;
+      argc -= 2;
+    } else if (!strcmp(arg,"<")) {
+      m = new Compare(Compare::Smaller,ParseDouble(argv[2]));
+      argv += 2;
+      argc -= 2;
+    } else break;
+    //
+    // Created a new meter to be attached?
+    if (m) {
+      if (s.m_pAgenda == NULL) {
+	s.m_pAgenda = m;
+	last   = m;
+      } else {
+	assert(last);
+	last->NextOf() = m;
+	last           = m;
       }
     }
-    if (argc == 3) {
-      org = argv[1];
-      dst = argv[2];
+  }
+  if (s.m_pAgenda == NULL) {
+    // Default: PSNR
+    s.m_pAgenda = new class PSNR(PSNR::Mean);
+  }
+  //
+  // Let the meters register the statistics they need such that
+  // all of them are collected in a single pass, and share the
+  // transformations.
+  for(m = s.m_pAgenda;m;m = m->NextOf()) {
+    m->AttachStatistics(&s.m_Stats);
+    m->AttachSpectrum(&s.m_Spectrum);
+    if (!m->isReusable())
+      s.m_bReusable = false;
+    if (m->NameOf() == NULL && !m->isReadOnly())
+      s.m_bFilters  = true;
+  }
+  //
+  // Unless --restore needs the complete images, the window of a crop
+  // starting the agenda goes to the loaders.
+  if (s.m_pCrop) {
+    if (s.m_bRestore) {
+      s.m_pCrop = NULL;
     } else {
-      Usage(name);
-      throw "requires exactly two mandatory arguments, original and distorted image";
+      s.m_pCrop->PushDown(s.m_Spec1,s.m_Spec2);
     }
-    if (agenda == NULL) {
-      // Default: PSNR
-      agenda = new class PSNR(PSNR::Mean);
+  }
+  //
+  s.m_OptSpec1   = s.m_Spec1;
+  s.m_OptSpec2   = s.m_Spec2;
+  s.m_OptSpecOut = s.m_SpecOut;
+
+  return true;
+}
+///
+
+/// RunAgenda
+// Run the agenda of the session on an image pair. The results are
+// printed, or, in batch mode, stored in values, of which count are
+// available on return, or when a meter fails.
+void RunAgenda(struct Session &s,class ImageLayout *orgimg,class ImageLayout *dstimg,
+	       double *values,ULONG &count)
+{
+  class Meter *m = s.m_pAgenda;
+  double val     = 0.0;
+
+  // The loaders may have read the window of the crop starting the
+  // agenda alone, then only the other images are cropped.
+  if (s.m_pCrop) {
+    assert(m == s.m_pCrop);
+    s.m_pCrop->CropLoaded(orgimg,s.m_Spec1,dstimg,s.m_Spec2);
+    m = m->NextOf();
+  }
+  
+  for(;m;m = m->NextOf()) {
+    const char *name = m->NameOf();
+
+    if (name) {
+      // A real measurement. Compare the image dimensions.
+      // Compare the images, at least the dimensions and the precisions must be
+      // equal.
+      orgimg->TestIfCompatible(dstimg);
     }
-    assert(org && dst);
-    orgimg = ImageLayout::LoadImage(org,spec1);
-    if (!strcmp(dst,"-")) { 
+
+    val = m->Measure(orgimg,dstimg,val);
+    if (name) {
+      if (values) {
+	values[count++] = val;
+      } else if (s.m_bBrief) {
+	printf("%g\n",val);
+      } else {
+	printf("%s:\t%g\n",name,val);
+      }
+    } else if (!m->isReadOnly()) {
+      // Filters may have modified the images.
+      s.m_Stats.Invalidate();
+      s.m_Spectrum.Invalidate();
+    }
+  }
+}
+///
+
+/// RunStripes
+// Run the agenda of the session on an image pair read in stripes. The
+// statistics are collected stripe by stripe, the meters then run on
+// layouts describing the complete images.
+void RunStripes(struct Session &s,const char *org,const char *dst)
+{
+  class ImageLayout *orgimg = NULL;
+  class ImageLayout *dstimg = NULL;
+  class Meter *m;
+  ULONG results = 0;
+  
+  for(m = s.m_pAgenda;m;m = m->NextOf()) {
+    if (!m->isStreamable())
+      throw "--stream only works with meters that require the point-wise statistics alone";
+  }
+  if (!strcmp(dst,"-"))
+    throw "--stream requires a distorted image";
+  //
+  try {
+    ULONG y = 0;
+    //
+    orgimg = ImageLayout::OpenStripes(org,s.m_Spec1);
+    dstimg = ImageLayout::OpenStripes(dst,s.m_Spec2);
+    //
+    // Keep the layouts of the complete images for the meters.
+    class ImageLayout orghdr(*orgimg);
+    class ImageLayout dsthdr(*dstimg);
+    //
+    orghdr.TestIfCompatible(&dsthdr);
+    s.m_SpecOut.MergeSpecs(s.m_Spec1,s.m_Spec2);
+    //
+    s.m_Stats.BeginStripes(&orghdr,&dsthdr);
+    while(y < orghdr.HeightOf()) {
+      ULONG rows = orgimg->ReadStripe(s.m_ulStripe);
+      if (dstimg->ReadStripe(s.m_ulStripe) != rows || rows == 0)
+	throw "unexpected end of image data while reading stripes";
+      s.m_Stats.CollectStripe(orgimg,dstimg,y);
+      y += rows;
+    }
+    s.m_Stats.EndStripes();
+    //
+    RunAgenda(s,&orghdr,&dsthdr,NULL,results);
+  } catch(...) {
+    delete orgimg;
+    delete dstimg;
+    throw;
+  }
+  delete orgimg;
+  delete dstimg;
+}
+///
+
+/// RunSequence
+// Run the agenda of the session on the frames of two raw image
+// sequences, pair by pair, and print the results of each pair, their
+// mean and their minimum. Sessions whose meters cannot measure a
+// second pair are parsed anew for each pair from argc and argv.
+void RunSequence(struct Session &session,const char *org,const char *dst,
+		 int argc,char **argv,const char *progname)
+{
+  class Sequence seq(org,dst,session.m_OptSpec1,session.m_OptSpec2);
+  struct Session *s         = &session;
+  class ImageLayout *orgimg = NULL;
+  class ImageLayout *dstimg = NULL;
+  const char **names        = NULL;
+  double *values            = NULL;
+  double *sum               = NULL;
+  double *min               = NULL;
+  ULONG columns             = 0;
+  ULONG pair,i;
+  class Meter *m;
+  
+  if (session.m_ulStripe)
+    throw "--stream cannot be combined with image sequences";
+  //
+  for(m = session.m_pAgenda;m;m = m->NextOf()) {
+    if (m->NameOf())
+      columns++;
+  }
+  //
+  try {
+    names   = new const char *[columns + 1];
+    values  = new double[columns + 1];
+    sum     = new double[columns + 1];
+    min     = new double[columns + 1];
+    columns = 0;
+    for(m = session.m_pAgenda;m;m = m->NextOf()) {
+      if (m->NameOf()) {
+	names[columns] = m->NameOf();
+	sum[columns]   = 0.0;
+	min[columns]   = HUGE_VAL;
+	columns++;
+      }
+    }
+    //
+    seq.Start();
+    for(pair = 0;seq.NextFrame(orgimg,dstimg,session.m_Spec1,session.m_Spec2);pair++) {
+      ULONG count = 0;
+      //
+      if (pair > 0) {
+	// Meters that keep state are created anew for each pair.
+	if (!session.m_bReusable) {
+	  struct Session *n = new struct Session;
+	  int ac = argc;
+	  char **av = argv;
+	  if (s != &session)
+	    delete s;
+	  s = n;
+	  ParseOptions(ac,av,*s,progname,false);
+	  s->m_Spec1 = session.m_Spec1;
+	  s->m_Spec2 = session.m_Spec2;
+	}
+	//
+	// The frames of the previous pair may have been at the same
+	// addresses, so the statistics cannot tell.
+	s->m_Stats.Invalidate();
+	s->m_Spectrum.Invalidate();
+      }
+      if (s->m_bRestore) {
+	s->m_pOrgCopy = new ImageLayout(*orgimg);
+	s->m_pDstCopy = new ImageLayout(*dstimg);
+      }
+      s->m_SpecOut = s->m_OptSpecOut;
+      s->m_SpecOut.MergeSpecs(s->m_Spec1,s->m_Spec2);
+      //
+      RunAgenda(*s,orgimg,dstimg,values,count);
+      //
+      for(i = 0;i < count;i++) {
+	if (s->m_bBrief) {
+	  printf("%g\n",values[i]);
+	} else {
+	  printf("%s[%lu]:\t%g\n",names[i],(unsigned long)seq.FrameOf(pair),values[i]);
+	}
+	sum[i] += values[i];
+	if (values[i] < min[i])
+	  min[i] = values[i];
+      }
+      //
+      delete s->m_pOrgCopy;
+      delete s->m_pDstCopy;
+      s->m_pOrgCopy = NULL;
+      s->m_pDstCopy = NULL;
+      delete orgimg;
+      delete dstimg;
+      orgimg = NULL;
+      dstimg = NULL;
+    }
+    //
+    for(i = 0;i < columns;i++) {
+      if (session.m_bBrief) {
+	printf("%g\n",sum[i] / pair);
+      } else {
+	printf("%s (mean):\t%g\n",names[i],sum[i] / pair);
+      }
+    }
+    for(i = 0;i < columns;i++) {
+      if (session.m_bBrief) {
+	printf("%g\n",min[i]);
+      } else {
+	printf("%s (min):\t%g\n",names[i],min[i]);
+      }
+    }
+  } catch(...) {
+    delete s->m_pOrgCopy;
+    delete s->m_pDstCopy;
+    s->m_pOrgCopy = NULL;
+    s->m_pDstCopy = NULL;
+    delete orgimg;
+    delete dstimg;
+    if (s != &session)
+      delete s;
+    delete[] names;
+    delete[] values;
+    delete[] sum;
+    delete[] min;
+    throw;
+  }
+  if (s != &session)
+    delete s;
+  delete[] names;
+  delete[] values;
+  delete[] sum;
+  delete[] min;
+}
+///
+
+/// class BatchJob
+// Runs the image pairs of a batch, one pair per slice. Each worker
+// runs a session of its own, parsed from the same options. Sessions
+// whose meters cannot measure a second pair are parsed anew for each
+// pair.
+class BatchJob : public Job {
+  //
+  // The list of pairs, the reference cache and the output.
+  class Batch      &m_Batch;
+  //
+  // The options to parse the sessions from.
+  int               m_iArgc;
+  char            **m_ppcArgv;
+  const char       *m_pcProgName;
+  //
+  // The sessions, one per worker, created on demand.
+  struct Session  **m_ppSession;
+  ULONG             m_ulWorkers;
+  //
+  // Number of result columns.
+  ULONG             m_ulColumns;
+  //
+  // Create a new session from the options.
+  struct Session *CreateSession(void)
+  {
+    struct Session *s = new struct Session;
+    int argc          = m_iArgc;
+    char **argv       = m_ppcArgv;
+
+    try {
+      ParseOptions(argc,argv,*s,m_pcProgName,false);
+    } catch(...) {
+      delete s;
+      throw;
+    }
+
+    return s;
+  }
+  //
+public:
+  BatchJob(class Batch &batch,int argc,char **argv,const char *progname,ULONG columns)
+    : m_Batch(batch), m_iArgc(argc), m_ppcArgv(argv), m_pcProgName(progname),
+      m_ppSession(NULL), m_ulWorkers(ThreadPool::ThreadCountOf()), m_ulColumns(columns)
+  {
+    ULONG i;
+
+    m_ppSession = new struct Session *[m_ulWorkers];
+    for(i = 0;i < m_ulWorkers;i++) {
+      m_ppSession[i] = NULL;
+    }
+  }
+  //
+  virtual ~BatchJob(void)
+  {
+    ULONG i;
+
+    for(i = 0;i < m_ulWorkers;i++) {
+      delete m_ppSession[i];
+    }
+    delete[] m_ppSession;
+  }
+  //
+  // Compare the given pair.
+  virtual void Run(ULONG slice,ULONG worker);
+};
+///
+
+/// BatchJob::Run
+// Compare the given pair and report the results.
+void BatchJob::Run(ULONG slice,ULONG worker)
+{
+  struct Session *s;
+  class ImageLayout *org    = NULL;
+  class ImageLayout *orgimg = NULL;
+  class ImageLayout *dstimg = NULL;
+  const char *dst           = m_Batch.DistortedOf(slice);
+  const char *error         = NULL;
+  double *values            = NULL;
+  ULONG count               = 0;
+  char msg[256];
+
+  assert(worker < m_ulWorkers);
+
+  try {
+    if (m_ppSession[worker] == NULL)
+      m_ppSession[worker] = CreateSession();
+    s = m_ppSession[worker];
+    //
+    // The images of the previous pair may have been at the same
+    // addresses, so the statistics cannot tell.
+    s->m_Stats.Invalidate();
+    s->m_Spectrum.Invalidate();
+    s->m_Spec1   = s->m_OptSpec1;
+    s->m_Spec2   = s->m_OptSpec2;
+    s->m_SpecOut = s->m_OptSpecOut;
+    values       = new double[m_ulColumns + 1];
+    //
+    // The original is shared with other pairs. Filters need a copy
+    // of their own as they may modify the data, otherwise a new
+    // layout suffices as crop and restrict modify that.
+    org = m_Batch.AcquireOriginal(slice,s->m_Spec1);
+    if (s->m_bFilters) {
+      orgimg = ImageLayout::CopyImage(org);
+    } else {
+      orgimg = new ImageLayout(*org);
+    }
+    if (!strcmp(dst,"-")) {
+      // The clone is cropped if the original is.
       dstimg = ImageLayout::CloneLayout(orgimg);
+      s->m_Spec2.Cropped = s->m_Spec1.Cropped;
     } else {
-      dstimg = ImageLayout::LoadImage(dst,spec2);
+      dstimg = ImageLayout::LoadImage(dst,s->m_Spec2);
+    }
+    if (s->m_bRestore) {
+      s->m_pOrgCopy = new ImageLayout(*orgimg);
+      s->m_pDstCopy = new ImageLayout(*dstimg);
     }
-    // Make copies of the images.
-    orgcpy   = new ImageLayout(*orgimg);
-    dstcpy   = new ImageLayout(*dstimg);
     //
-    specout.MergeSpecs(spec1,spec2);
+    s->m_SpecOut.MergeSpecs(s->m_Spec1,s->m_Spec2);
     //
+    RunAgenda(*s,orgimg,dstimg,values,count);
+  } catch(const char *e) {
+    // The message may live in a meter that is gone when reporting.
+    size_t len;
+    strncpy(msg,e,sizeof(msg) - 1);
+    msg[sizeof(msg) - 1] = 0;
+    len = strlen(msg);
+    while(len > 0 && (msg[len - 1] == '\n' || msg[len - 1] == '\r'))
+      msg[--len] = 0;
+    error = msg;
+  } catch(const std::bad_alloc &) {
+    error = "out of memory";
+  } catch(...) {
+    error = "caught unknown exception";
+  }
+
+  if ((s = m_ppSession[worker])) {
+    delete s->m_pOrgCopy;
+    delete s->m_pDstCopy;
+    s->m_pOrgCopy = NULL;
+    s->m_pDstCopy = NULL;
+  }
+  delete orgimg;
+  delete dstimg;
+  m_Batch.ReleaseOriginal(slice);
+
+  try {
+    m_Batch.Report(slice,values,count,error);
+  } catch(...) {
+    delete[] values;
+    throw;
+  }
+  delete[] values;
+  //
+  // Meters that keep state are created anew for the next pair.
+  if (s && !s->m_bReusable) {
+    delete s;
+    m_ppSession[worker] = NULL;
+  }
+}
+///
+
+/// RunBatch
+// Compare all pairs of the batch list, using the options in argc and
+// argv for each of them, and write the results.
+void RunBatch(class Batch &batch,struct Session &session,int argc,char **argv,const char *progname)
+{
+  const char **names = NULL;
+  ULONG columns      = 0;
+  class Meter *m;
 
+  for(m = session.m_pAgenda;m;m = m->NextOf()) {
+    if (m->NameOf())
+      columns++;
+  }
+
+  names   = new const char *[columns + 1];
+  columns = 0;
+  for(m = session.m_pAgenda;m;m = m->NextOf()) {
+    if (m->NameOf())
+      names[columns++] = m->NameOf();
+  }
+
+  try {
+    class BatchJob job(batch,argc,argv,progname,columns);
     //
-    // Now perform the measurements on all images.
-    double val = 0.0;
-    for(m = agenda;m;m = m->NextOf()) {
-      const char *name = m->NameOf();
-
-      if (name) {
-	// A real measurement. Compare the image dimensions.
-	// Compare the images, at least the dimensions and the precisions must be
-	// equal.
-	orgimg->TestIfCompatible(dstimg);
+    batch.WriteHeader(names,columns);
+    ThreadPool::Run(&job,batch.PairsOf());
+    batch.WriteFooter();
+  } catch(...) {
+    delete[] names;
+    throw;
+  }
+  delete[] names;
+}
+///
+
+/// main
+int main(int argc,char **argv)
+{
+  struct Session *session = NULL;
+  class Batch *batch = NULL;
+  const char *org = NULL;
+  const char *dst = NULL;
+  const char *name = argv[0];
+  class ImageLayout *orgimg = NULL;
+  class ImageLayout *dstimg = NULL;
+  char **options = argv;
+  int    count   = argc;
+  int    rc      = 0;
+
+  try {
+    session = new struct Session;
+    if (!ParseOptions(argc,argv,*session,name)) {
+      delete session;
+      return 0;
+    }
+    if (session->m_pcBatch) {
+      if (argc != 1) {
+	Usage(name);
+	throw "--batch takes the image pairs from the list, no further arguments are allowed";
       }
-      
-      val = m->Measure(orgimg,dstimg,val);
-      if (name) {
-	if (brief) {
-	  printf("%g\n",val);
+      if (session->m_ulStripe)
+	throw "--stream cannot be combined with --batch";
+      batch = new class Batch(session->m_pcBatch,session->m_Format);
+      RunBatch(*batch,*session,count - argc + 1,options,name);
+      if (batch->FailedOf())
+	rc = 10;
+    } else {
+      if (argc == 3) {
+	org = argv[1];
+	dst = argv[2];
+      } else {
+	Usage(name);
+	throw "requires exactly two mandatory arguments, original and distorted image";
+      }
+      assert(org && dst);
+      if (Sequence::isSequence(org,dst)) {
+	RunSequence(*session,org,dst,count - argc + 1,options,name);
+      } else if (session->m_ulStripe) {
+	RunStripes(*session,org,dst);
+      } else {
+	orgimg = ImageLayout::LoadImage(org,session->m_Spec1);
+	if (!strcmp(dst,"-")) { 
+	  // The clone is cropped if the original is.
+	  dstimg = ImageLayout::CloneLayout(orgimg);
+	  session->m_Spec2.Cropped = session->m_Spec1.Cropped;
 	} else {
-	  printf("%s:\t%g\n",name,val);
+	  dstimg = ImageLayout::LoadImage(dst,session->m_Spec2);
+	}
+	// Make copies of the images if --restore needs them. They
+	// share the planes, so only the layout is copied.
+	if (session->m_bRestore) {
+	  session->m_pOrgCopy = new ImageLayout(*orgimg);
+	  session->m_pDstCopy = new ImageLayout(*dstimg);
 	}
+	//
+	session->m_SpecOut.MergeSpecs(session->m_Spec1,session->m_Spec2);
+	//
+	// Now perform the measurements on all images.
+	ULONG results = 0;
+	RunAgenda(*session,orgimg,dstimg,NULL,results);
       }
     }
   } catch(const char *error) {
@@ -1756,19 +2449,22 @@ int main(int argc,char **argv)
     rc = 20;
   }
 
-  if (orgcpy)
-    delete orgcpy;
-  if (dstcpy)
-    delete dstcpy;
+  if (session) {
+    delete session->m_pOrgCopy;
+    delete session->m_pDstCopy;
+    session->m_pOrgCopy = NULL;
+    session->m_pDstCopy = NULL;
+  }
   if (orgimg) 
     delete orgimg;
   if (dstimg)
     delete dstimg;
 
-  while((m = agenda)) {
-    agenda = m->NextOf();
-    delete m;
-  }
+  delete batch;
+  delete session;
+
+  ThreadPool::Shutdown();
+  FFT::ReleasePlans();
 
   return rc;
 }
@@ -0,0 +1,232 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software) for Accusoft	        **
+** All Rights Reserved							**
+**************************************************************************
+
+This source file is part of difftest_ng, a universal image measuring
+and conversion framework.
+
+    difftest_ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    difftest_ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with difftest_ng.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+/*
+ * Sequence mode
+ *
+ * $Id: sequence.cpp,v 1.1 2022/09/12 10:31:44 thor Exp $
+ *
+ * This class reads the frames of two raw image sequences pair by
+ * pair, reading the next pair ahead in a background thread while
+ * the current one is measured.
+ */
+
+/// Includes
+#include "cmd/sequence.hpp"
+#include "std/stdlib.hpp"
+#include "std/string.hpp"
+#include "std/ctype.hpp"
+#include "std/assert.hpp"
+#include "img/imglayout.hpp"
+///
+
+/// Sequence::Sequence
+// Select the frames to compare from the file names.
+Sequence::Sequence(const char *org,const char *dst,
+		   const struct ImgSpecs &spec1,const struct ImgSpecs &spec2)
+  : m_ulFrames(0), m_ulNext(0)
+{
+  m_Original.m_pcName   = NULL;
+  m_Original.m_pImage   = NULL;
+  m_Distorted.m_pcName  = NULL;
+  m_Distorted.m_pImage  = NULL;
+  m_Original.m_Specs    = spec1;
+  m_Distorted.m_Specs   = spec2;
+
+  try {
+    ParseName(m_Original,org);
+    if (strcmp(dst,"-"))
+      ParseName(m_Distorted,dst);
+  } catch(...) {
+    delete[] m_Original.m_pcName;
+    delete[] m_Distorted.m_pcName;
+    throw;
+  }
+}
+///
+
+/// Sequence::~Sequence
+Sequence::~Sequence(void)
+{
+  // The reader may still fill in the images.
+  try {
+    m_Reader.Wait();
+  } catch(...) {
+  }
+
+  delete m_Original.m_pImage;
+  delete m_Distorted.m_pImage;
+  delete[] m_Original.m_pcName;
+  delete[] m_Distorted.m_pcName;
+}
+///
+
+/// Sequence::isSequence
+// Return true if one of the file names carries a frame range.
+bool Sequence::isSequence(const char *org,const char *dst)
+{
+  return strstr(org,"#frames=") || strstr(dst,"#frames=");
+}
+///
+
+/// Sequence::ParseName
+// Split the frame range off the file name.
+void Sequence::ParseName(struct Source &src,const char *name)
+{
+  const char *range = strstr(name,"#frames=");
+  size_t len        = (range)?(size_t(range - name)):(strlen(name));
+  char *end;
+
+  src.m_ulFirst     = 0;
+  src.m_ulLast      = 0;
+  src.m_bOpen       = false;
+  src.m_bRange      = false;
+  src.m_ulAvailable = 0;
+  //
+  src.m_pcName      = new char[len + 1];
+  memcpy(src.m_pcName,name,len);
+  src.m_pcName[len] = 0;
+  //
+  if (range == NULL)
+    return;
+  //
+  range += strlen("#frames=");
+  if (!isdigit(*range))
+    throw "invalid frame range, use '#frames=first-last' behind the file name";
+  src.m_ulFirst = strtoul(range,&end,10);
+  src.m_ulLast  = src.m_ulFirst;
+  if (*end == '-') {
+    range = end + 1;
+    if (*range == 0) {
+      src.m_bOpen = true;
+    } else {
+      if (!isdigit(*range))
+	throw "invalid frame range, use '#frames=first-last' behind the file name";
+      src.m_ulLast = strtoul(range,&end,10);
+    }
+  }
+  if (!src.m_bOpen && *end != 0)
+    throw "invalid frame range, use '#frames=first-last' behind the file name";
+  if (src.m_ulLast < src.m_ulFirst)
+    throw "invalid frame range, the last frame must not be smaller than the first";
+  //
+  src.m_bRange = true;
+}
+///
+
+/// Sequence::Start
+// Read the first pair and start reading the next one.
+void Sequence::Start(void)
+{
+  struct Source *src[2] = {&m_Original,&m_Distorted};
+  bool closed           = false;
+  int i;
+  //
+  // An image without a frame range takes the frames of the other.
+  if (!m_Original.m_bRange) {
+    m_Original.m_ulFirst  = m_Distorted.m_ulFirst;
+    m_Original.m_ulLast   = m_Distorted.m_ulLast;
+    m_Original.m_bOpen    = m_Distorted.m_bOpen;
+  } else if (m_Distorted.m_pcName && !m_Distorted.m_bRange) {
+    m_Distorted.m_ulFirst = m_Original.m_ulFirst;
+    m_Distorted.m_ulLast  = m_Original.m_ulLast;
+    m_Distorted.m_bOpen   = m_Original.m_bOpen;
+  }
+  //
+  // Read the first pair, which also tells how many frames the files
+  // hold.
+  m_ulNext = 0;
+  Run(0,0);
+  //
+  // Closed ranges must be of equal length, open ranges end at the
+  // end of their file or the end of the closed range, whichever
+  // comes first.
+  m_ulFrames = 0;
+  for(i = 0;i < 2;i++) {
+    if (src[i]->m_pcName && !src[i]->m_bOpen) {
+      ULONG frames = src[i]->m_ulLast - src[i]->m_ulFirst + 1;
+      if (closed && frames != m_ulFrames)
+	throw "the frame ranges of the original and the distorted image must be of equal length";
+      m_ulFrames = frames;
+      closed     = true;
+    }
+  }
+  for(i = 0;i < 2;i++) {
+    if (src[i]->m_pcName && src[i]->m_bOpen) {
+      ULONG frames = src[i]->m_ulAvailable - src[i]->m_ulFirst;
+      if (src[i]->m_ulAvailable == 0)
+	throw "the number of frames in the file is unknown, the last frame must be given";
+      if (!closed && (m_ulFrames == 0 || frames < m_ulFrames))
+	m_ulFrames = frames;
+    }
+  }
+  assert(m_ulFrames > 0);
+}
+///
+
+/// Sequence::NextFrame
+// Deliver the next pair of frames and start reading the one after.
+bool Sequence::NextFrame(class ImageLayout *&org,class ImageLayout *&dst,
+			 struct ImgSpecs &spec1,struct ImgSpecs &spec2)
+{
+  if (m_ulNext >= m_ulFrames)
+    return false;
+  //
+  m_Reader.Wait();
+  //
+  org   = m_Original.m_pImage;
+  dst   = m_Distorted.m_pImage;
+  spec1 = m_Original.m_Loaded;
+  spec2 = m_Distorted.m_Loaded;
+  m_Original.m_pImage  = NULL;
+  m_Distorted.m_pImage = NULL;
+  //
+  if (++m_ulNext < m_ulFrames)
+    m_Reader.Start(this);
+
+  return true;
+}
+///
+
+/// Sequence::Run
+// Read the pair m_ulNext. This runs in the background thread, except
+// for the first pair.
+void Sequence::Run(ULONG,ULONG)
+{
+  assert(m_Original.m_pImage == NULL && m_Distorted.m_pImage == NULL);
+
+  m_Original.m_Loaded  = m_Original.m_Specs;
+  m_Original.m_pImage  = ImageLayout::LoadFrame(m_Original.m_pcName,m_Original.m_Loaded,
+						m_Original.m_ulFirst + m_ulNext,
+						m_Original.m_ulAvailable);
+  m_Distorted.m_Loaded = m_Distorted.m_Specs;
+  if (m_Distorted.m_pcName) {
+    m_Distorted.m_pImage = ImageLayout::LoadFrame(m_Distorted.m_pcName,m_Distorted.m_Loaded,
+						  m_Distorted.m_ulFirst + m_ulNext,
+						  m_Distorted.m_ulAvailable);
+  } else {
+    // The clone is cropped if the original is.
+    m_Distorted.m_pImage = ImageLayout::CloneLayout(m_Original.m_pImage);
+    m_Distorted.m_Loaded.Cropped = m_Original.m_Loaded.Cropped;
+  }
+}
+///
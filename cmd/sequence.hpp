@@ -0,0 +1,140 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software) for Accusoft	        **
+** All Rights Reserved							**
+**************************************************************************
+
+This source file is part of difftest_ng, a universal image measuring
+and conversion framework.
+
+    difftest_ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    difftest_ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with difftest_ng.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+/*
+ * Sequence mode
+ *
+ * $Id: sequence.hpp,v 1.1 2022/09/12 10:31:44 thor Exp $
+ *
+ * This class reads the frames of two raw image sequences pair by
+ * pair, reading the next pair ahead in a background thread while
+ * the current one is measured.
+ */
+
+#ifndef CMD_SEQUENCE_HPP
+#define CMD_SEQUENCE_HPP
+
+/// Includes
+#include "interface/types.hpp"
+#include "img/imgspecs.hpp"
+#include "tools/threadpool.hpp"
+///
+
+/// Forwards
+class ImageLayout;
+///
+
+/// class Sequence
+// This class reads the frames of two raw image sequences pair by
+// pair. The frames are selected by a '#frames=first-last' suffix of
+// the file names, where last may be omitted to read up to the end
+// of the file, and '-last' may be omitted to select a single frame.
+// An image without the suffix takes the frames of the other one.
+// While the caller measures a pair, the next one is read by a
+// background thread, hence at most two frames of each sequence are
+// in memory.
+class Sequence : public Job {
+  //
+  // An image sequence.
+  struct Source {
+    //
+    // The file name without the frame range, NULL for a blank image.
+    char              *m_pcName;
+    //
+    // The first and last frame, inclusive. If the last frame is not
+    // given, m_bOpen is set.
+    ULONG              m_ulFirst;
+    ULONG              m_ulLast;
+    bool               m_bOpen;
+    //
+    // Set if the name carries a frame range.
+    bool               m_bRange;
+    //
+    // The number of frames in the file, zero if unknown.
+    ULONG              m_ulAvailable;
+    //
+    // The specifications to load the frames with.
+    struct ImgSpecs    m_Specs;
+    //
+    // The frame read ahead and its specifications after loading.
+    class ImageLayout *m_pImage;
+    struct ImgSpecs    m_Loaded;
+  }                    m_Original,m_Distorted;
+  //
+  // Number of frame pairs to compare.
+  ULONG                m_ulFrames;
+  //
+  // The index of the pair read ahead, counting from zero.
+  ULONG                m_ulNext;
+  //
+  // The thread reading ahead.
+  class Thread         m_Reader;
+  //
+  // Not copyable.
+  Sequence(const class Sequence &);
+  class Sequence &operator=(const class Sequence &);
+  //
+  // Split the frame range off the file name.
+  static void ParseName(struct Source &src,const char *name);
+  //
+public:
+  //
+  // Select the frames to compare from the file names. If the
+  // distorted name is "-", blank images are compared against.
+  Sequence(const char *org,const char *dst,
+	   const struct ImgSpecs &spec1,const struct ImgSpecs &spec2);
+  //
+  ~Sequence(void);
+  //
+  // Return true if one of the file names carries a frame range.
+  static bool isSequence(const char *org,const char *dst);
+  //
+  // Read the first pair and start reading the next one. Throws if
+  // the frame ranges do not match.
+  void Start(void);
+  //
+  // Return the number of frame pairs to compare. Only valid after
+  // Start().
+  ULONG FramesOf(void) const
+  {
+    return m_ulFrames;
+  }
+  //
+  // Return the frame index of the original of the given pair.
+  ULONG FrameOf(ULONG pair) const
+  {
+    return m_Original.m_ulFirst + pair;
+  }
+  //
+  // Deliver the next pair of frames and their specifications, and
+  // start reading the one after it. The caller takes the images over.
+  // Returns false if all pairs are delivered.
+  bool NextFrame(class ImageLayout *&org,class ImageLayout *&dst,
+		 struct ImgSpecs &spec1,struct ImgSpecs &spec2);
+  //
+  // Read the pair m_ulNext.
+  virtual void Run(ULONG slice,ULONG worker);
+};
+///
+
+///
+#endif
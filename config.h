@@ -54,6 +54,10 @@ and conversion framework.
 # define USE_EXR
 #endif
 //
+#if defined(HAVE_PTHREAD_H) && defined(HAVE_PTHREAD_CREATE) && defined(HAVE_PTHREAD_MUTEX_INIT)
+# define USE_PTHREADS
+#endif
+//
 //
 // Pull additional settings in?
 #ifdef ADDON_FILE
@@ -74,6 +74,18 @@ public:
   {
     return NULL;
   }
+  //
+  // Keeps nothing from one measurement to the next.
+  virtual bool isReusable(void) const
+  {
+    return true;
+  }
+  //
+  // Only looks at the result of the previous meter.
+  virtual bool isStreamable(void) const
+  {
+    return true;
+  }
 };
 ///
 
@@ -30,6 +30,7 @@ and conversion framework.
 
 /// Includes
 #include "img/imglayout.hpp"
+#include "img/imgspecs.hpp"
 #include "diff/crop.hpp"
 ///
 
@@ -48,3 +49,40 @@ double Crop::Measure(class ImageLayout *src,class ImageLayout *dst,double in)
 }
 ///
 
+/// Crop::PushDown
+// Hand the cropping window to the loaders of the images this crops.
+// The original alone is not cropped by its loader, as a distorted
+// image cloned from it must remain complete.
+void Crop::PushDown(struct ImgSpecs &srcspecs,struct ImgSpecs &dstspecs) const
+{
+  if (m_Mode == CropBoth) {
+    srcspecs.Cropped = ImgSpecs::No;
+    srcspecs.CropX1  = m_ulX1;
+    srcspecs.CropY1  = m_ulY1;
+    srcspecs.CropX2  = m_ulX2;
+    srcspecs.CropY2  = m_ulY2;
+  }
+  if (m_Mode == CropBoth || m_Mode == CropDst) {
+    dstspecs.Cropped = ImgSpecs::No;
+    dstspecs.CropX1  = m_ulX1;
+    dstspecs.CropY1  = m_ulY1;
+    dstspecs.CropX2  = m_ulX2;
+    dstspecs.CropY2  = m_ulY2;
+  }
+}
+///
+
+/// Crop::CropLoaded
+// Crop the images as Measure() does, except those whose loaders read
+// the window alone already.
+void Crop::CropLoaded(class ImageLayout *src,const struct ImgSpecs &srcspecs,
+		      class ImageLayout *dst,const struct ImgSpecs &dstspecs) const
+{
+  if ((m_Mode == CropBoth || m_Mode == CropSrc) && srcspecs.Cropped != ImgSpecs::Yes) {
+    src->Crop(m_ulX1,m_ulY1,m_ulX2,m_ulY2);
+  }
+  if ((m_Mode == CropBoth || m_Mode == CropDst) && dstspecs.Cropped != ImgSpecs::Yes) {
+    dst->Crop(m_ulX1,m_ulY1,m_ulX2,m_ulY2);
+  }
+}
+///
@@ -36,6 +36,10 @@ and conversion framework.
 #include "img/imglayout.hpp"
 ///
 
+/// Forwards
+struct ImgSpecs;
+///
+
 /// class Crop
 // This class extracts rectangulare image regions
 class Crop : public Meter {
@@ -75,10 +79,25 @@ public:
   //
   virtual double Measure(class ImageLayout *src,class ImageLayout *dst,double in);
   //
+  // Hand the cropping window to the loaders of the images this crops,
+  // such that they may read the window alone.
+  void PushDown(struct ImgSpecs &srcspecs,struct ImgSpecs &dstspecs) const;
+  //
+  // Crop the images as Measure() does, except those whose loaders read
+  // the window alone already.
+  void CropLoaded(class ImageLayout *src,const struct ImgSpecs &srcspecs,
+		  class ImageLayout *dst,const struct ImgSpecs &dstspecs) const;
+  //
   virtual const char *NameOf(void) const
   {
     return NULL;
   }
+  //
+  // Keeps nothing from one measurement to the next.
+  virtual bool isReusable(void) const
+  {
+    return true;
+  }
 };
 ///
 
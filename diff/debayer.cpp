@@ -33,6 +33,7 @@ and conversion framework.
 #include "diff/debayer.hpp"
 #include "std/string.hpp"
 #include "std/math.hpp"
+#include "tools/threadpool.hpp"
 ///
 
 /// Debayer::~Debayer
@@ -94,17 +95,21 @@ static DOUBLE ciepow(DOUBLE x)
 ///
 
 /// Debayer::ADHKernel
-// The actual implementation of the ADH algorithm
+// The actual implementation of the ADH algorithm, run on the tile
+// x0,y0 to x1,y1 (exclusive) of the image. The intermediate planes
+// cover the tile plus a border of Halo pixels, cut at the image edges,
+// and are carved from the scratch memory of the calling worker.
+// Positions outside of the image are mirrored back into it exactly
+// as for a full-frame run, such that tiles do not depend on each other.
+// The result is bit-identical to the full-frame run only if the
+// compiler keeps the evaluation order of the floating point
+// expressions. With -ffast-math, as in the default optimizer
+// settings, it may differ within rounding.
 template<typename T>
-void Debayer::ADHKernel(const T *src,
-			FLOAT *horr,FLOAT *verr,
-			FLOAT *horg,FLOAT *verg,
-			FLOAT *horb,FLOAT *verb,
-			FLOAT *horl ,FLOAT *verl,
-			FLOAT *horca,FLOAT *verca,
-			FLOAT *horcb,FLOAT *vercb,
+void Debayer::ADHKernel(const T *src,FLOAT *scratch,
 			LONG bytesperpixel,LONG bytesperrow,
-			T *rp,T *gp,T *bp,FLOAT min,FLOAT max)
+			T *rp,T *gp,T *bp,FLOAT min,FLOAT max,
+			LONG x0,LONG y0,LONG x1,LONG y1)
 {
   LONG x,y,dy,dx;
   LONG w  = this->m_ulWidth;
@@ -117,121 +122,104 @@ void Debayer::ADHKernel(const T *src,
   LONG ky = this->m_lky;
   LONG bx = this->m_lbx;
   LONG by = this->m_lby;
+  //
+  // The region covered by the intermediate planes, and the region
+  // the color interpolations and the CIELab conversion are required
+  // in, which is the tile plus the reach of the homogeneity map.
+  LONG ox = (x0 > Halo)?(x0 - Halo):(0);
+  LONG oy = (y0 > Halo)?(y0 - Halo):(0);
+  LONG ex = (x1 + Halo < w)?(x1 + Halo):(w);
+  LONG ey = (y1 + Halo < h)?(y1 + Halo):(h);
+  LONG lx = (x0 > Halo - 1)?(x0 - Halo + 1):(0);
+  LONG ly = (y0 > Halo - 1)?(y0 - Halo + 1):(0);
+  LONG mx = (x1 + Halo - 1 < w)?(x1 + Halo - 1):(w);
+  LONG my = (y1 + Halo - 1 < h)?(y1 + Halo - 1):(h);
+  LONG sw = ex - ox;
+  LONG ss = sw * (ey - oy);
+  FLOAT *horr  = scratch;
+  FLOAT *verr  = horr  + ss;
+  FLOAT *horg  = verr  + ss;
+  FLOAT *verg  = horg  + ss;
+  FLOAT *horb  = verg  + ss;
+  FLOAT *verb  = horb  + ss;
+  FLOAT *horl  = verb  + ss;
+  FLOAT *verl  = horl  + ss;
+  FLOAT *horca = verl  + ss;
+  FLOAT *verca = horca + ss;
+  FLOAT *horcb = verca + ss;
+  FLOAT *vercb = horcb + ss;
+  //
+  // Index of the image position x,y, within the image, in the planes.
+#define IDX(x,y) (((x) - ox) + sw * ((y) - oy))
 
   /*
   ** dcraw includes an additional affine scaling step here: it subtracts
   ** the black level (e.g. 512 for the FHG images) and scales the components
   ** by a component dependent value, (e.g. {12.009511,4.15093756,5.36335036} for the FHG images})
   */
-  for(y = 0;y < h;y += 2) {
-    for(x = 0;x < w;x += 2) {
+  for(y = oy;y < ey;y++) {
+    for(x = ox;x < ex;x++) {
+      LONG px = x & 1;
+      LONG py = y & 1;
       // Step 1: Fill in the green pixels we have in the horizontal and vertical kernel.
-      if (x + gx < w && y + gy < h) {
-	horg[(x + gx) + w * (y + gy)] = AT(x + gx,y + gy);
-	verg[(x + gx) + w * (y + gy)] = AT(x + gx,y + gy);
-      }
-      if (x + kx < w && y + ky < h) {
-	horg[(x + kx) + w * (y + ky)] = AT(x + kx,y + ky);
-	verg[(x + kx) + w * (y + ky)] = AT(x + kx,y + ky);
-      }
-      //
-      // Filter green horizontally and vertically.
-      if (x + gx < w && y + ky < h) {
-	horg[(x + gx) + w * (y + ky)] = ((AT(x + gx - 1, y + ky) + AT(x + gx,y + ky) + AT(x + gx + 1,y + ky)) * 2.0 - AT(x + gx - 2, y + ky) - AT(x + gx + 2, y + ky)) / 4.0;
-	verg[(x + gx) + w * (y + ky)] = ((AT(x + gx, y + ky - 1) + AT(x + gx,y + ky) + AT(x + gx,y + ky + 1)) * 2.0 - AT(x + gx, y + ky - 2) - AT(x + gx, y + ky + 2)) / 4.0;
-	//dcraw also clamps the interpolated values between the two real values
-      }
-      //
-      // Same for the alternative position.
-      if (x + kx < w && y + gy < h) {
-	horg[(x + kx) + w * (y + gy)] = ((AT(x + kx - 1, y + gy) + AT(x + kx,y + gy) + AT(x + kx + 1,y + gy)) * 2.0 - AT(x + kx - 2, y + gy) - AT(x + kx + 2, y + gy)) / 4.0;
-	verg[(x + kx) + w * (y + gy)] = ((AT(x + kx, y + gy - 1) + AT(x + kx,y + gy) + AT(x + kx,y + gy + 1)) * 2.0 - AT(x + kx, y + gy - 2) - AT(x + kx, y + gy + 2)) / 4.0;
+      if ((px == gx && py == gy) || (px == kx && py == ky)) {
+	horg[IDX(x,y)] = AT(x,y);
+	verg[IDX(x,y)] = AT(x,y);
+      } else {
+	// Filter green horizontally and vertically.
+	horg[IDX(x,y)] = ((AT(x - 1, y) + AT(x,y) + AT(x + 1,y)) * 2.0 - AT(x - 2, y) - AT(x + 2, y)) / 4.0;
+	verg[IDX(x,y)] = ((AT(x, y - 1) + AT(x,y) + AT(x,y + 1)) * 2.0 - AT(x, y - 2) - AT(x, y + 2)) / 4.0;
 	//dcraw also clamps the interpolated values between the two real values
       }
     }
   }
   //
   // Now compute red and blue.
-  for(y = 0;y < h;y += 2) {
-    for(x = 0;x < w;x += 2) {
-      LONG ax,ay;
-      //
-      // Interpolate red at red sample positions
-      if (x + rx < w && y + ry < h) {
-	horr[(x + rx) + w * (y + ry)] = AT(x + rx, y + ry);
-	verr[(x + rx) + w * (y + ry)] = AT(x + rx, y + ry);
-      }
-      //
-      // Horizontal and vertical interpolation of red at rx ^ 1,ry, which is a green pixel.
-      ax = rx ^ 1;
-      if (x + ax < w && y + ry < h) {
-	FLOAT nbs   = AT(x + ax - 1,y + ry) + AT(x + ax + 1,y + ry); // neighbouring red pixels.
-	FLOAT ghor  = horg[clip(x + ax - 1,w) + w * (y + ry)] + horg[clip(x + ax + 1,w) + w * (y + ry)]; // interpolated green pixels left and right
-	FLOAT gver  = verg[clip(x + ax - 1,w) + w * (y + ry)] + verg[clip(x + ax + 1,w) + w * (y + ry)];
-	horr[(x + ax) + w * (y + ry)] = horg[(x + ax) + w * (y + ry)] - ghor / 2 + nbs / 2;
-	verr[(x + ax) + w * (y + ry)] = verg[(x + ax) + w * (y + ry)] - gver / 2 + nbs / 2;
-      }
+  for(y = ly;y < my;y++) {
+    for(x = lx;x < mx;x++) {
+      LONG px = x & 1;
+      LONG py = y & 1;
+      int c;
       //
-      ay = ry ^ 1;
-      if (x + rx < w && y + ay < h) {
-	FLOAT nbs   = AT(x + rx,y + ay - 1) + AT(x + rx,y + ay + 1); // interpolated from the pixels top and bottom.
-	FLOAT ghor  = horg[x + rx + w * clip(y + ay - 1,h)] + horg[x + rx + w * clip(y + ay + 1,h)];
-	FLOAT gver  = verg[x + rx + w * clip(y + ay - 1,h)] + verg[x + rx + w * clip(y + ay + 1,h)];
-	horr[(x + rx) + w * (y + ay)] = horg[(x + rx) + w * (y + ay)] - ghor / 2 + nbs / 2;
-	verr[(x + rx) + w * (y + ay)] = verg[(x + rx) + w * (y + ay)] - gver / 2 + nbs / 2;
-      }
-      //
-      // Then diagonal.
-      if (x + ax < w && y + ay < h) {
-	FLOAT nbs   = AT(x + ax - 1,y + ay - 1) + AT(x + ax + 1,y + ay - 1) + AT(x + ax - 1,y + ay + 1) + AT(x + ax + 1,y + ay + 1); // the four surrounding red pixels.
-	FLOAT ghor  = horg[clip(x + ax - 1,w) + w * clip(y + ay - 1,h)] + horg[clip(x + ax + 1,w) + w * clip(y + ay - 1,h)] +
-	  horg[clip(x + ax - 1,w) + w * clip(y + ay + 1,h)] + horg[clip(x + ax + 1,w) + w * clip(y + ay + 1,h)];
-	FLOAT gver  = verg[clip(x + ax - 1,w) + w * clip(y + ay - 1,h)] + verg[clip(x + ax + 1,w) + w * clip(y + ay - 1,h)] +
-	  verg[clip(x + ax - 1,w) + w * clip(y + ay + 1,h)] + verg[clip(x + ax + 1,w) + w * clip(y + ay + 1,h)];
-	horr[(x + ax) + w * (y + ay)] = horg[(x + ax) + w * (y + ay)] - ghor / 4 + nbs / 4;
-	verr[(x + ax) + w * (y + ay)] = verg[(x + ax) + w * (y + ay)] - gver / 4 + nbs / 4;
-      }
-      //
-      // Interpolate blue at blue sample positions
-      if (x + bx < w && y + by < h) {
-	horb[(x + bx) + w * (y + by)] = AT(x + bx, y + by);
-	verb[(x + bx) + w * (y + by)] = AT(x + bx, y + by);
-      }
-      //
-      // Horizontal and vertical interpolation of blue at bx ^ 1,by, which is a green pixel.
-      ax = bx ^ 1;
-      if (x + ax < w && y + by < h) {
-	FLOAT nbs   = AT(x + ax - 1,y + by) + AT(x + ax + 1,y + by); // neighbouring red pixels.
-	FLOAT ghor  = horg[clip(x + ax - 1,w) + w * (y + by)] + horg[clip(x + ax + 1,w) + w * (y + by)]; // interpolated green pixels left and right
-	FLOAT gver  = verg[clip(x + ax - 1,w) + w * (y + by)] + verg[clip(x + ax + 1,w) + w * (y + by)];
-	horb[(x + ax) + w * (y + by)] = horg[(x + ax) + w * (y + by)] - ghor / 2 + nbs / 2;
-	verb[(x + ax) + w * (y + by)] = verg[(x + ax) + w * (y + by)] - gver / 2 + nbs / 2;
-      }
-      //
-      ay = by ^ 1;
-      if (x + bx < w && y + ay < h) {
-	FLOAT nbs   = AT(x + bx,y + ay - 1) + AT(x + bx,y + ay + 1); // interpolated from the pixels top and bottom.
-	FLOAT ghor  = horg[x + bx + w * clip(y + ay - 1,h)] + horg[x + bx + w * clip(y + ay + 1,h)];
-	FLOAT gver  = verg[x + bx + w * clip(y + ay - 1,h)] + verg[x + bx + w * clip(y + ay + 1,h)];
-	horb[(x + bx) + w * (y + ay)] = horg[(x + bx) + w * (y + ay)] - ghor / 2 + nbs / 2;
-	verb[(x + bx) + w * (y + ay)] = verg[(x + bx) + w * (y + ay)] - gver / 2 + nbs / 2;
-      }
-      //
-      // Then diagonal.
-      if (x + ax < w && y + ay < h) {
-	FLOAT nbs   = AT(x + ax - 1,y + ay - 1) + AT(x + ax + 1,y + ay - 1) + AT(x + ax - 1,y + ay + 1) + AT(x + ax + 1,y + ay + 1); // the four surrounding red pixels.
-	FLOAT ghor  = horg[clip(x + ax - 1,w) + w * clip(y + ay - 1,h)] + horg[clip(x + ax + 1,w) + w * clip(y + ay - 1,h)] +
-	  horg[clip(x + ax - 1,w) + w * clip(y + ay + 1,h)] + horg[clip(x + ax + 1,w) + w * clip(y + ay + 1,h)];
-	FLOAT gver  = verg[clip(x + ax - 1,w) + w * clip(y + ay - 1,h)] + verg[clip(x + ax + 1,w) + w * clip(y + ay - 1,h)] +
-	  verg[clip(x + ax - 1,w) + w * clip(y + ay + 1,h)] + verg[clip(x + ax + 1,w) + w * clip(y + ay + 1,h)];
-	horb[(x + ax) + w * (y + ay)] = horg[(x + ax) + w * (y + ay)] - ghor / 4 + nbs / 4;
-	verb[(x + ax) + w * (y + ay)] = verg[(x + ax) + w * (y + ay)] - gver / 4 + nbs / 4;
+      for(c = 0;c < 2;c++) {
+	LONG   cx  = (c)?(bx):(rx);
+	LONG   cy  = (c)?(by):(ry);
+	FLOAT *hor = (c)?(horb):(horr);
+	FLOAT *ver = (c)?(verb):(verr);
+	//
+	if (px == cx && py == cy) {
+	  // Interpolate red or blue at red or blue sample positions
+	  hor[IDX(x,y)] = AT(x, y);
+	  ver[IDX(x,y)] = AT(x, y);
+	} else if (py == cy) {
+	  // Horizontal and vertical interpolation at cx ^ 1,cy, which is a green pixel.
+	  FLOAT nbs   = AT(x - 1,y) + AT(x + 1,y); // neighbouring red or blue pixels.
+	  FLOAT ghor  = horg[IDX(clip(x - 1,w),y)] + horg[IDX(clip(x + 1,w),y)]; // interpolated green pixels left and right
+	  FLOAT gver  = verg[IDX(clip(x - 1,w),y)] + verg[IDX(clip(x + 1,w),y)];
+	  hor[IDX(x,y)] = horg[IDX(x,y)] - ghor / 2 + nbs / 2;
+	  ver[IDX(x,y)] = verg[IDX(x,y)] - gver / 2 + nbs / 2;
+	} else if (px == cx) {
+	  FLOAT nbs   = AT(x,y - 1) + AT(x,y + 1); // interpolated from the pixels top and bottom.
+	  FLOAT ghor  = horg[IDX(x,clip(y - 1,h))] + horg[IDX(x,clip(y + 1,h))];
+	  FLOAT gver  = verg[IDX(x,clip(y - 1,h))] + verg[IDX(x,clip(y + 1,h))];
+	  hor[IDX(x,y)] = horg[IDX(x,y)] - ghor / 2 + nbs / 2;
+	  ver[IDX(x,y)] = verg[IDX(x,y)] - gver / 2 + nbs / 2;
+	} else {
+	  // Then diagonal.
+	  FLOAT nbs   = AT(x - 1,y - 1) + AT(x + 1,y - 1) + AT(x - 1,y + 1) + AT(x + 1,y + 1); // the four surrounding pixels.
+	  FLOAT ghor  = horg[IDX(clip(x - 1,w),clip(y - 1,h))] + horg[IDX(clip(x + 1,w),clip(y - 1,h))] +
+	    horg[IDX(clip(x - 1,w),clip(y + 1,h))] + horg[IDX(clip(x + 1,w),clip(y + 1,h))];
+	  FLOAT gver  = verg[IDX(clip(x - 1,w),clip(y - 1,h))] + verg[IDX(clip(x + 1,w),clip(y - 1,h))] +
+	    verg[IDX(clip(x - 1,w),clip(y + 1,h))] + verg[IDX(clip(x + 1,w),clip(y + 1,h))];
+	  hor[IDX(x,y)] = horg[IDX(x,y)] - ghor / 4 + nbs / 4;
+	  ver[IDX(x,y)] = verg[IDX(x,y)] - gver / 4 + nbs / 4;
+	}
       }
     }
   }
   
-  for(y = 0;y < h;y++) {
-    for(x = 0;x < w;x++) {
+  for(y = ly;y < my;y++) {
+    for(x = lx;x < mx;x++) {
       // Now horizontal and vertical interpolations are known. Convert from RGB to LAB.
       // This depends of course on the camera primaries, but for simplicity, we use the
       // same conversion matrix as in the original work.
@@ -248,19 +236,20 @@ void Debayer::ADHKernel(const T *src,
       // (this makes little sense as xyz coordinates are always positive)
       // and then adds an offset of (0.5,0.5,0.5)
       {
-	FLOAT xh = ciepow((0.386275 * horr[x + w * y] + 0.334884 * horg[x + w * y] + 0.168971 * horb[x + w * y])/(0.95047 * max));
-	FLOAT yh = ciepow((0.199173 * horr[x + w * y] + 0.703457 * horg[x + w * y] + 0.066264 * horb[x + w * y])/max);
-	FLOAT zh = ciepow((0.018107 * horr[x + w * y] + 0.118130 * horg[x + w * y] + 0.949690 * horb[x + w * y])/(1.08833 * max));
-	FLOAT xv = ciepow((0.386275 * verr[x + w * y] + 0.334884 * verg[x + w * y] + 0.168971 * verb[x + w * y])/(0.95047 * max));
-	FLOAT yv = ciepow((0.199173 * verr[x + w * y] + 0.703457 * verg[x + w * y] + 0.066264 * verb[x + w * y])/max);
-	FLOAT zv = ciepow((0.018107 * verr[x + w * y] + 0.118130 * verg[x + w * y] + 0.949690 * verb[x + w * y])/(1.08883 * max));
+	LONG  i  = IDX(x,y);
+	FLOAT xh = ciepow((0.386275 * horr[i] + 0.334884 * horg[i] + 0.168971 * horb[i])/(0.95047 * max));
+	FLOAT yh = ciepow((0.199173 * horr[i] + 0.703457 * horg[i] + 0.066264 * horb[i])/max);
+	FLOAT zh = ciepow((0.018107 * horr[i] + 0.118130 * horg[i] + 0.949690 * horb[i])/(1.08833 * max));
+	FLOAT xv = ciepow((0.386275 * verr[i] + 0.334884 * verg[i] + 0.168971 * verb[i])/(0.95047 * max));
+	FLOAT yv = ciepow((0.199173 * verr[i] + 0.703457 * verg[i] + 0.066264 * verb[i])/max);
+	FLOAT zv = ciepow((0.018107 * verr[i] + 0.118130 * verg[i] + 0.949690 * verb[i])/(1.08883 * max));
 	// Convert from xyz to CIElab. dcraw includes an additional scaling factor of 64 here.
-	horl[x + w * y]  = 116 * yh - 16; // L horizontal
-	verl[x + w * y]  = 116 * yv - 16; // L vertical
-	horca[x + w * y] = 500 * (xh - yh);
-	verca[x + w * y] = 500 * (xv - yv);
-	horcb[x + w * y] = 200 * (yh - zh);
-	vercb[x + w * y] = 200 * (yv - zv);
+	horl[i]  = 116 * yh - 16; // L horizontal
+	verl[i]  = 116 * yv - 16; // L vertical
+	horca[i] = 500 * (xh - yh);
+	verca[i] = 500 * (xv - yv);
+	horcb[i] = 200 * (yh - zh);
+	vercb[i] = 200 * (yv - zv);
       }
     }
   }
@@ -268,36 +257,33 @@ void Debayer::ADHKernel(const T *src,
   //
   // Build homogenuity map and select the winning direction.
   // Quite like the dcraw implementation, there is no median filter.
-  for(y = 0;y < h;y++) {
-    for(x = 0;x < w;x++) {
+  for(y = y0;y < y1;y++) {
+    for(x = x0;x < x1;x++) {
       int homhor = 0;
       int homver = 0;
       for(dy = y - 1; dy <= y + 1;dy++) {
 	for (dx = x - 1; dx <= x + 1;dx++) {
-	  FLOAT ldiffhorn = ABS(horl[clip(dx,w) + w * clip(dy,h)] - horl[clip(dx,w) + w * clip(dy - 1,h)]);
-	  FLOAT ldiffvern = ABS(verl[clip(dx,w) + w * clip(dy,h)] - verl[clip(dx,w) + w * clip(dy - 1,h)]);
-	  FLOAT ldiffhors = ABS(horl[clip(dx,w) + w * clip(dy,h)] - horl[clip(dx,w) + w * clip(dy + 1,h)]);
-	  FLOAT ldiffvers = ABS(verl[clip(dx,w) + w * clip(dy,h)] - verl[clip(dx,w) + w * clip(dy + 1,h)]);
-	  FLOAT ldiffhorw = ABS(horl[clip(dx,w) + w * clip(dy,h)] - horl[clip(dx - 1,w) + w * clip(dy,h)]);
-	  FLOAT ldiffverw = ABS(verl[clip(dx,w) + w * clip(dy,h)] - verl[clip(dx - 1,w) + w * clip(dy,h)]);
-	  FLOAT ldiffhore = ABS(horl[clip(dx,w) + w * clip(dy,h)] - horl[clip(dx + 1,w) + w * clip(dy,h)]);
-	  FLOAT ldiffvere = ABS(verl[clip(dx,w) + w * clip(dy,h)] - verl[clip(dx + 1,w) + w * clip(dy,h)]);
-	  FLOAT cdiffhorn = SQR(horca[clip(dx,w) + w * clip(dy,h)] - horca[clip(dx,w) + w * clip(dy - 1,h)]) +
-	    SQR(horcb[clip(dx,w) + w * clip(dy,h)] - horcb[clip(dx,w) + w * clip(dy - 1,h)]);
-	  FLOAT cdiffvern = SQR(verca[clip(dx,w) + w * clip(dy,h)] - verca[clip(dx,w) + w * clip(dy - 1,h)]) +
-	    SQR(vercb[clip(dx,w) + w * clip(dy,h)] - vercb[clip(dx,w) + w * clip(dy - 1,h)]);
-	  FLOAT cdiffhors = SQR(horca[clip(dx,w) + w * clip(dy,h)] - horca[clip(dx,w) + w * clip(dy + 1,h)]) +
-	    SQR(horcb[clip(dx,w) + w * clip(dy,h)] - horcb[clip(dx,w) + w * clip(dy + 1,h)]);
-	  FLOAT cdiffvers = SQR(verca[clip(dx,w) + w * clip(dy,h)] - verca[clip(dx,w) + w * clip(dy + 1,h)]) +
-	    SQR(vercb[clip(dx,w) + w * clip(dy,h)] - vercb[clip(dx,h) + w * clip(dy + 1,h)]);
-	  FLOAT cdiffhorw = SQR(horca[clip(dx,w) + w * clip(dy,h)] - horca[clip(dx - 1,w) + w * clip(dy,h)]) +
-	    SQR(horcb[clip(dx,w) + w * clip(dy,h)] - horcb[clip(dx - 1,w) + w * clip(dy,h)]);
-	  FLOAT cdiffverw = SQR(verca[clip(dx,w) + w * clip(dy,h)] - verca[clip(dx - 1,w) + w * clip(dy,h)]) +
-	    SQR(vercb[clip(dx,w) + w * clip(dy,h)] - vercb[clip(dx - 1,w) + w * clip(dy,h)]);
-	  FLOAT cdiffhore = SQR(horca[clip(dx,w) + w * clip(dy,h)] - horca[clip(dx + 1,w) + w * clip(dy,h)]) +
-	    SQR(horcb[clip(dx,w) + w * clip(dy,h)] - horcb[clip(dx + 1,w) + w * clip(dy,h)]);
-	  FLOAT cdiffvere = SQR(verca[clip(dx,w) + w * clip(dy,h)] - verca[clip(dx + 1,w) + w * clip(dy,h)]) +
-	    SQR(vercb[clip(dx,w) + w * clip(dy,h)] - vercb[clip(dx + 1,w) + w * clip(dy,h)]);
+	  LONG  c         = IDX(clip(dx,w),clip(dy,h));
+	  LONG  n         = IDX(clip(dx,w),clip(dy - 1,h));
+	  LONG  s         = IDX(clip(dx,w),clip(dy + 1,h));
+	  LONG  o         = IDX(clip(dx - 1,w),clip(dy,h));
+	  LONG  e         = IDX(clip(dx + 1,w),clip(dy,h));
+	  FLOAT ldiffhorn = ABS(horl[c] - horl[n]);
+	  FLOAT ldiffvern = ABS(verl[c] - verl[n]);
+	  FLOAT ldiffhors = ABS(horl[c] - horl[s]);
+	  FLOAT ldiffvers = ABS(verl[c] - verl[s]);
+	  FLOAT ldiffhorw = ABS(horl[c] - horl[o]);
+	  FLOAT ldiffverw = ABS(verl[c] - verl[o]);
+	  FLOAT ldiffhore = ABS(horl[c] - horl[e]);
+	  FLOAT ldiffvere = ABS(verl[c] - verl[e]);
+	  FLOAT cdiffhorn = SQR(horca[c] - horca[n]) + SQR(horcb[c] - horcb[n]);
+	  FLOAT cdiffvern = SQR(verca[c] - verca[n]) + SQR(vercb[c] - vercb[n]);
+	  FLOAT cdiffhors = SQR(horca[c] - horca[s]) + SQR(horcb[c] - horcb[s]);
+	  FLOAT cdiffvers = SQR(verca[c] - verca[s]) + SQR(vercb[c] - vercb[s]);
+	  FLOAT cdiffhorw = SQR(horca[c] - horca[o]) + SQR(horcb[c] - horcb[o]);
+	  FLOAT cdiffverw = SQR(verca[c] - verca[o]) + SQR(vercb[c] - vercb[o]);
+	  FLOAT cdiffhore = SQR(horca[c] - horca[e]) + SQR(horcb[c] - horcb[e]);
+	  FLOAT cdiffvere = SQR(verca[c] - verca[e]) + SQR(vercb[c] - vercb[e]);
 	  FLOAT leps      = MIN(MAX(ldiffhorw,ldiffhore),MAX(ldiffvern,ldiffvers));
 	  FLOAT ceps      = MIN(MAX(cdiffhorw,cdiffhore),MAX(cdiffvern,cdiffvers));
 	  homhor         += (ldiffhorn <= leps && cdiffhorn <= ceps) + (ldiffhors <= leps && cdiffhors <= ceps) +
@@ -307,22 +293,23 @@ void Debayer::ADHKernel(const T *src,
 	}
       }
       FLOAT r,g,b;
+      LONG  i = IDX(x,y);
       /*
       ** the dcraw version averages over a 3x3 neighbourhood, this algorithm
       ** only checks a single value
       */
       if (homhor > homver) {
-	r = horr[x + y * w];
-	g = horg[x + y * w];
-	b = horb[x + y * w];
+	r = horr[i];
+	g = horg[i];
+	b = horb[i];
       } else if (homhor < homver) {
-	r = verr[x + y * w];
-	g = verg[x + y * w];
-	b = verb[x + y * w];
+	r = verr[i];
+	g = verg[i];
+	b = verb[i];
       } else {
-	r = (horr[x + y * w] + verr[x + y * w]) / 2;
-	g = (horg[x + y * w] + verg[x + y * w]) / 2;
-	b = (horb[x + y * w] + verb[x + y * w]) / 2;
+	r = (horr[i] + verr[i]) / 2;
+	g = (horg[i] + verg[i]) / 2;
+	b = (horb[i] + verb[i]) / 2;
       }
       if (r < min) r = min;
       if (r > max) r = max;
@@ -336,6 +323,92 @@ void Debayer::ADHKernel(const T *src,
       bp[x + y * w] = b;
     }
   }
+#undef IDX
+}
+///
+
+/// class ADHJob
+// The job running the ADH kernel on the tiles of the image, one
+// tile per slice.
+template<typename T>
+class ADHJob : public Job {
+  //
+  // The debayer filter running the kernel.
+  class Debayer *m_pParent;
+  //
+  // The source data.
+  const T       *m_pSource;
+  LONG           m_lBytesPerPixel;
+  LONG           m_lBytesPerRow;
+  //
+  // The target components.
+  T             *m_pRed;
+  T             *m_pGreen;
+  T             *m_pBlue;
+  //
+  // The clamping range.
+  FLOAT          m_fMin;
+  FLOAT          m_fMax;
+  //
+  // The scratch memory of the workers, and its size per worker.
+  FLOAT         *m_pfScratch;
+  ULONG          m_ulScratchSize;
+  //
+  // Number of tiles in horizontal direction.
+  ULONG          m_ulTilesX;
+  //
+public:
+  ADHJob(class Debayer *parent,const T *src,LONG bytesperpixel,LONG bytesperrow,
+	 T *rp,T *gp,T *bp,FLOAT min,FLOAT max,
+	 FLOAT *scratch,ULONG scratchsize,ULONG tilesx)
+    : m_pParent(parent), m_pSource(src), m_lBytesPerPixel(bytesperpixel), m_lBytesPerRow(bytesperrow),
+      m_pRed(rp), m_pGreen(gp), m_pBlue(bp), m_fMin(min), m_fMax(max),
+      m_pfScratch(scratch), m_ulScratchSize(scratchsize), m_ulTilesX(tilesx)
+  { }
+  //
+  virtual void Run(ULONG slice,ULONG worker)
+  {
+    LONG x0 = (slice % m_ulTilesX) * Debayer::TileSize;
+    LONG y0 = (slice / m_ulTilesX) * Debayer::TileSize;
+    LONG x1 = x0 + Debayer::TileSize;
+    LONG y1 = y0 + Debayer::TileSize;
+
+    if (x1 > LONG(m_pParent->m_ulWidth))
+      x1 = m_pParent->m_ulWidth;
+    if (y1 > LONG(m_pParent->m_ulHeight))
+      y1 = m_pParent->m_ulHeight;
+    
+    m_pParent->ADHKernel<T>(m_pSource,m_pfScratch + worker * m_ulScratchSize,
+			    m_lBytesPerPixel,m_lBytesPerRow,
+			    m_pRed,m_pGreen,m_pBlue,m_fMin,m_fMax,x0,y0,x1,y1);
+  }
+};
+///
+
+/// Debayer::ADHTiles
+// Run the ADH kernel on all tiles of the image, in parallel.
+template<typename T>
+void Debayer::ADHTiles(const T *src,LONG bytesperpixel,LONG bytesperrow,
+		       T *rp,T *gp,T *bp,FLOAT min,FLOAT max)
+{
+  ULONG tilesx  = (m_ulWidth  + TileSize - 1) / TileSize;
+  ULONG tilesy  = (m_ulHeight + TileSize - 1) / TileSize;
+  ULONG workers = ThreadPool::ThreadCountOf();
+  ULONG size    = (TileSize + 2 * Halo) * (TileSize + 2 * Halo) * 12;
+  FLOAT *scratch;
+
+  if (tilesx == 0 || tilesy == 0)
+    return;
+
+  scratch = new FLOAT[size * workers];
+  try {
+    class ADHJob<T> job(this,src,bytesperpixel,bytesperrow,rp,gp,bp,min,max,scratch,size,tilesx);
+    ThreadPool::Run(&job,tilesx * tilesy);
+  } catch(...) {
+    delete[] scratch;
+    throw;
+  }
+  delete[] scratch;
 }
 ///
 
@@ -550,12 +623,6 @@ void Debayer::CreateImageData(UBYTE **&data,class ImageLayout *src)
 // "Adapaptive Homogeneity directed demosaicing algorithm"
 void Debayer::ADHInterpolate(UBYTE **&dest,class ImageLayout *src)
 {
-  FLOAT *horr = NULL,*verr = NULL;
-  FLOAT *horg = NULL,*verg = NULL;
-  FLOAT *horb = NULL,*verb = NULL;
-  FLOAT *horl  = NULL,*verl  = NULL;
-  FLOAT *horca = NULL,*verca = NULL;
-  FLOAT *horcb = NULL,*vercb = NULL;
   //
   // Delete the old data
   delete[] m_pComponent;
@@ -565,117 +632,56 @@ void Debayer::ADHInterpolate(UBYTE **&dest,class ImageLayout *src)
   if (src->DepthOf() != 1)
     throw "Source image to be de-mosaiked must have only one component";
 
-  try {
-    ULONG size = src->WidthOf() * src->HeightOf();
-
-    horr  = new FLOAT[size];
-    verr  = new FLOAT[size];
-    horg  = new FLOAT[size];
-    verg  = new FLOAT[size];
-    horb  = new FLOAT[size];
-    verb  = new FLOAT[size];
-    horl  = new FLOAT[size];
-    verl  = new FLOAT[size];
-    horca = new FLOAT[size];
-    verca = new FLOAT[size];
-    horcb = new FLOAT[size];
-    vercb = new FLOAT[size];
-    
-    CreateImageData(dest,src);
+  CreateImageData(dest,src);
     
-    if (src->isFloat(0)) {
-      if (src->isSigned(0))
-	throw "the ADH algorithm is not defined for signed pixel values";
-      switch(src->BitsOf(0)) {
+  if (src->isFloat(0)) {
+    if (src->isSigned(0))
+      throw "the ADH algorithm is not defined for signed pixel values";
+    switch(src->BitsOf(0)) {
+    case 16:
+    case 32:
+      ADHTiles<FLOAT>((FLOAT *)(src->DataOf(0)),src->BytesPerPixel(0),src->BytesPerRow(0),
+		      (FLOAT *)dest[0],(FLOAT *)dest[1],(FLOAT *)dest[2],-HUGE_VAL,HUGE_VAL);
+      break;
+    case 64:
+      ADHTiles<DOUBLE>((DOUBLE *)(src->DataOf(0)),src->BytesPerPixel(0),src->BytesPerRow(0),
+		       (DOUBLE *)dest[0],(DOUBLE *)dest[1],(DOUBLE *)dest[2],-HUGE_VAL,HUGE_VAL);
+      break;
+    default:
+      throw "unsupported source pixel type";
+      break;
+    }
+  } else {
+    if (src->isSigned(0)) {
+      throw "the ADH algorithm is not defined for signed pixel values";
+    } else {
+      FLOAT min = 0;
+      FLOAT max = +(UQUAD(1) << (src->BitsOf(0))) - 1;
+      switch((src->BitsOf(0) + 7) & -8) {
+      case 8:
+	ADHTiles<UBYTE>((UBYTE *)(src->DataOf(0)),src->BytesPerPixel(0),src->BytesPerRow(0),
+			(UBYTE *)dest[0],(UBYTE *)dest[1],(UBYTE *)dest[2],min,max);
+	break;
       case 16:
+	ADHTiles<UWORD>((UWORD *)(src->DataOf(0)),src->BytesPerPixel(0),src->BytesPerRow(0),
+			(UWORD *)dest[0],(UWORD *)dest[1],(UWORD *)dest[2],min,max);
+	break;
       case 32:
-	ADHKernel<FLOAT>((FLOAT *)(src->DataOf(0)),
-			 horr,verr,horg,verg,horb,verb,
-			 horl,verl,horca,verca,horcb,vercb,
-			 src->BytesPerPixel(0),src->BytesPerRow(0),
-			 (FLOAT *)dest[0],(FLOAT *)dest[1],(FLOAT *)dest[2],-HUGE_VAL,HUGE_VAL);
+	ADHTiles<ULONG>((ULONG *)(src->DataOf(0)),src->BytesPerPixel(0),src->BytesPerRow(0),
+			(ULONG *)dest[0],(ULONG *)dest[1],(ULONG *)dest[2],min,max);
 	break;
       case 64:
-	ADHKernel<DOUBLE>((DOUBLE *)(src->DataOf(0)),
-			  horr,verr,horg,verg,horb,verb,
-			  horl,verl,horca,verca,horcb,vercb,
-			  src->BytesPerPixel(0),src->BytesPerRow(0),
-			  (DOUBLE *)dest[0],(DOUBLE *)dest[1],(DOUBLE *)dest[2],-HUGE_VAL,HUGE_VAL);
-      break;
+	ADHTiles<UQUAD>((UQUAD *)(src->DataOf(0)),src->BytesPerPixel(0),src->BytesPerRow(0),
+			(UQUAD *)dest[0],(UQUAD *)dest[1],(UQUAD *)dest[2],min,max);
+	break;
       default:
 	throw "unsupported source pixel type";
 	break;
       }
-    } else {
-      if (src->isSigned(0)) {
-	throw "the ADH algorithm is not defined for signed pixel values";
-      } else {
-	FLOAT min = 0;
-	FLOAT max = +(UQUAD(1) << (src->BitsOf(0))) - 1;
-	switch((src->BitsOf(0) + 7) & -8) {
-	case 8:
-	  ADHKernel<UBYTE>((UBYTE *)(src->DataOf(0)),
-			   horr,verr,horg,verg,horb,verb,
-			   horl,verl,horca,verca,horcb,vercb,
-			   src->BytesPerPixel(0),src->BytesPerRow(0),
-			   (UBYTE *)dest[0],(UBYTE *)dest[1],(UBYTE *)dest[2],min,max);
-	  break;
-	case 16:
-	  ADHKernel<UWORD>((UWORD *)(src->DataOf(0)),
-			   horr,verr,horg,verg,horb,verb,
-			   horl,verl,horca,verca,horcb,vercb,
-			   src->BytesPerPixel(0),src->BytesPerRow(0),
-			   (UWORD *)dest[0],(UWORD *)dest[1],(UWORD *)dest[2],min,max);
-	  break;
-	case 32:
-	  ADHKernel<ULONG>((ULONG *)(src->DataOf(0)),
-			   horr,verr,horg,verg,horb,verb,
-			   horl,verl,horca,verca,horcb,vercb,
-			   src->BytesPerPixel(0),src->BytesPerRow(0),
-			   (ULONG *)dest[0],(ULONG *)dest[1],(ULONG *)dest[2],min,max);
-	  break;
-	case 64:
-	  ADHKernel<UQUAD>((UQUAD *)(src->DataOf(0)),
-			   horr,verr,horg,verg,horb,verb,
-			   horl,verl,horca,verca,horcb,vercb,
-			   src->BytesPerPixel(0),src->BytesPerRow(0),
-			   (UQUAD *)dest[0],(UQUAD *)dest[1],(UQUAD *)dest[2],min,max);
-	  break;
-	default:
-	  throw "unsupported source pixel type";
-	  break;
-	}
-      }
     }
-    //
-    Swap(*src);
-    delete[] horr;
-    delete[] verr;
-    delete[] horg;
-    delete[] verg;
-    delete[] horb;
-    delete[] verb;
-    delete[] horl;
-    delete[] verl;
-    delete[] horca;
-    delete[] verca;
-    delete[] horcb;
-    delete[] vercb;
-  } catch(...) {
-    delete[] horr;
-    delete[] verr;
-    delete[] horg;
-    delete[] verg;
-    delete[] horb;
-    delete[] verb;
-    delete[] horl;
-    delete[] verl;
-    delete[] horca;
-    delete[] verca;
-    delete[] horcb;
-    delete[] vercb;
-    throw;
   }
+  //
+  Swap(*src);
 }
 ///
 
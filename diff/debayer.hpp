@@ -89,18 +89,30 @@ private:
   void BilinearKernel(const T *src,LONG bytesperpixel,LONG bytesperrow,
 		      T *r,T *g,T *b,S min,S max);
   //
-  // Run the ADH kernel. This requires additional arrays of the size of
-  // the full image.
+  // The tile size and the border around each tile the ADH kernel
+  // requires. The twelve intermediate planes of a tile should fit
+  // into the second level cache.
+  enum {
+    TileSize = 128,
+    Halo     = 3
+  };
+  //
+  // Run the ADH kernel on the tile x0,y0 to x1,y1 (exclusive), using
+  // the given scratch memory for the intermediate planes of the tile.
   template<typename T>
-  void ADHKernel(const T *src,
-		 FLOAT *horr,FLOAT *verr,
-		 FLOAT *horg,FLOAT *verg,
-		 FLOAT *horb,FLOAT *verb,
-		 FLOAT *horl ,FLOAT *verl,
-		 FLOAT *horca,FLOAT *verca,
-		 FLOAT *horcb,FLOAT *vercb,
+  void ADHKernel(const T *src,FLOAT *scratch,
 		 LONG bytesperpixel,LONG bytesperrow,
-		 T *rp,T *gp,T *bp,FLOAT min,FLOAT max);
+		 T *rp,T *gp,T *bp,FLOAT min,FLOAT max,
+		 LONG x0,LONG y0,LONG x1,LONG y1);
+  //
+  // Run the ADH kernel on all tiles of the image, in parallel.
+  template<typename T>
+  void ADHTiles(const T *src,LONG bytesperpixel,LONG bytesperrow,
+		T *rp,T *gp,T *bp,FLOAT min,FLOAT max);
+  //
+  // The job running the tiles.
+  template<typename T>
+  friend class ADHJob;
   //
   // Bilinear interpolation.
   void BilinearInterpolate(UBYTE **&dest,class ImageLayout *src);
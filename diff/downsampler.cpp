@@ -88,40 +88,14 @@ void Downsampler::BoxFilter(const S *org,ULONG obytesperpixel,ULONG obytesperrow
 }
 ///
 
-/// Downsampler::~Downsampler
-Downsampler::~Downsampler(void)
-{
-  ReleaseComponents(m_ppucSource);
-  ReleaseComponents(m_ppucDestination);
-}
-///
-
-/// Downsampler::ReleaseComponents
-void Downsampler::ReleaseComponents(UBYTE **p)
-{
-  int i;
-
-  if (p) {
-    for(i = 0;i < m_usAllocated;i++) {
-      if (p[i])
-        delete[] p[i];
-    }
-    delete[] p;
-    p = NULL;
-  }
-}
-///
-
-
 /// Downsampler::Downsample
-void Downsampler::Downsample(UBYTE **&data,class ImageLayout *src)
+void Downsampler::Downsample(class ImageLayout *src)
 {
   UWORD i;
-  // Delete the old image components. Does not release the
-  // memory we hold.
+  // Delete the old image components. This releases the
+  // planes only they refer to.
   delete[] m_pComponent;
   m_pComponent  = NULL;
-  ReleaseComponents(data);
   //
   if (m_bChromaOnly) {
     m_ulWidth     = src->WidthOf();
@@ -155,19 +129,6 @@ void Downsampler::Downsample(UBYTE **&data,class ImageLayout *src)
     }
   }
   //
-  data = new UBYTE *[m_usDepth];
-  memset(data,0,sizeof(UBYTE *) * m_usDepth);
-  m_usAllocated = m_usDepth;
-  //
-  for(i = 0;i < m_usDepth;i++) {
-    UBYTE bps = ImageLayout::SuggestBPP(m_pComponent[i].m_ucBits,m_pComponent[i].m_bFloat);
-    //
-    data[i]                           = new UBYTE[m_pComponent[i].m_ulWidth * m_pComponent[i].m_ulHeight * bps];
-    m_pComponent[i].m_ulBytesPerPixel = bps;
-    m_pComponent[i].m_ulBytesPerRow   = bps * m_pComponent[i].m_ulWidth;
-    m_pComponent[i].m_pPtr            = data[i];
-  }
-  //
   for(i = 0;i < m_usDepth;i++) {
     UBYTE sx,sy;
     //
@@ -179,6 +140,13 @@ void Downsampler::Downsample(UBYTE **&data,class ImageLayout *src)
       sy = 1;
     }
     //
+    // Components that are not resampled share the plane of the source.
+    if (sx == 1 && sy == 1) {
+      SharePlane(i,src,i);
+      continue;
+    }
+    AllocatePlane(i);
+    //
     if (isSigned(i)) {
       if (BitsOf(i) <= 8) {
 	BoxFilter<BYTE>((BYTE *)src->DataOf(i),src->BytesPerPixel(i),src->BytesPerRow(i),
@@ -254,11 +222,25 @@ void Downsampler::Downsample(UBYTE **&data,class ImageLayout *src)
 }
 ///
 
+/// Downsampler::Subsample
+// Subsample a single image in place.
+void Downsampler::Subsample(class ImageLayout *img)
+{
+  Downsample(img);
+  //
+  // Only the image refers to the planes now.
+  ReleaseComponents();
+}
+///
+
 /// Downsampler::Measure
 double Downsampler::Measure(class ImageLayout *src,class ImageLayout *dest,double in)
 {
-  Downsample(m_ppucSource,src);
-  Downsample(m_ppucDestination,dest);
+  Downsample(src);
+  Downsample(dest);
+  //
+  // Only the images refer to the planes now.
+  ReleaseComponents();
 
   return in;
 }
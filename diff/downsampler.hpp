@@ -43,13 +43,6 @@ struct ImgSpecs;
 /// class Downsampler
 // This class downsamples images in the spatial domain by a simple box filter.
 class Downsampler : public Meter, private ImageLayout {
-  //
-  // The component memory itself.
-  UBYTE     **m_ppucSource;
-  UBYTE     **m_ppucDestination;
-  //
-  // Number of allocated components
-  UWORD       m_usAllocated;
   //
   // Scaling coordinates.
   UBYTE       m_ucScaleX,m_ucScaleY;
@@ -57,11 +50,8 @@ class Downsampler : public Meter, private ImageLayout {
   // Set if only the chroma component is subsampled.
   bool        m_bChromaOnly;
   //
-  // Release the temporary buffer.
-  void ReleaseComponents(UBYTE **p);
-  //
   // Perform the actual downsampling.
-  void Downsample(UBYTE **&data,class ImageLayout *src);
+  void Downsample(class ImageLayout *src);
   //
   template<typename S>
   void BoxFilter(const S *org,ULONG obytesperpixel,ULONG obytesperrow,
@@ -73,11 +63,31 @@ class Downsampler : public Meter, private ImageLayout {
   //
 public:
   Downsampler(UBYTE sx,UBYTE sy,bool chromaonly)
-    : m_ppucSource(NULL),m_ppucDestination(NULL), m_usAllocated(0),
-      m_ucScaleX(sx), m_ucScaleY(sy), m_bChromaOnly(chromaonly)
+    : m_ucScaleX(sx), m_ucScaleY(sy), m_bChromaOnly(chromaonly)
   { }
   //
-  virtual ~Downsampler(void);
+  virtual ~Downsampler(void)
+  { }
+  //
+  // Return the subsampling factors.
+  UBYTE ScaleXOf(void) const
+  {
+    return m_ucScaleX;
+  }
+  //
+  UBYTE ScaleYOf(void) const
+  {
+    return m_ucScaleY;
+  }
+  //
+  // Return whether only the chroma components are subsampled.
+  bool isChromaOnly(void) const
+  {
+    return m_bChromaOnly;
+  }
+  //
+  // Subsample a single image in place.
+  void Subsample(class ImageLayout *img);
   //
   virtual double Measure(class ImageLayout *src,class ImageLayout *dst,double in);
   //
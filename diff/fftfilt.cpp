@@ -31,39 +31,14 @@ and conversion framework.
 
 /// Includes
 #include "diff/fftfilt.hpp"
+#include "diff/spectrum.hpp"
 #include "tools/fft.hpp"
 #include "std/math.hpp"
 #include "std/string.hpp"
-#ifdef USE_GSL
+#include "std/assert.hpp"
 #include "img/imglayout.hpp"
 ///
 
-/// FFTFilt::CopyToFFT
-template<typename T>
-void FFTFilt::CopyToFFT(T *org,ULONG obytesperpixel,ULONG obytesperrow,
-			T *dst,ULONG dbytesperpixel,ULONG dbytesperrow,
-			double *target,ULONG stride,ULONG w,ULONG h)
-{
-  ULONG x,y;
-
-  for(y = 0;y < h;y++) {
-    T *orgrow      = org;
-    T *dstrow      = dst;
-    double *trgrow = target + y * stride;
-    for(x = 0;x < w;x++) {
-      trgrow[0]   = *orgrow - *dstrow; // real part
-      trgrow[1]   = 0.0; // imaginary part.
-      //
-      orgrow      = (T *)((const UBYTE *)(orgrow) + obytesperpixel);
-      dstrow      = (T *)((const UBYTE *)(dstrow) + dbytesperpixel);
-      trgrow     += 2;
-    }
-    org = (T *)((const UBYTE *)(org) + obytesperrow);
-    dst = (T *)((const UBYTE *)(dst) + dbytesperrow);
-  }
-}
-///
-
 /// FFTFilt::CopyFromFFT
 template<typename T>
 void FFTFilt::CopyFromFFT(double *src,ULONG stride,ULONG w,ULONG h,
@@ -76,7 +51,7 @@ void FFTFilt::CopyFromFFT(double *src,ULONG stride,ULONG w,ULONG h,
     T *dstrow      = dst;
     double *srcrow = src;
     for(x = 0;x < w;x++) {
-      double v = srcrow[0] * scale + shift; // The imaginary part should be zero. Or close to zero...
+      double v = *srcrow * scale + shift;
       if (v < min) {
 	*dstrow = min;
       } else if (v > max) {
@@ -85,7 +60,7 @@ void FFTFilt::CopyFromFFT(double *src,ULONG stride,ULONG w,ULONG h,
 	*dstrow = T(v);
       }
       dstrow      = (T *)((UBYTE *)(dstrow) + dbytesperpixel);
-      srcrow     += 2;
+      srcrow++;
     }
     dst = (T *)((UBYTE *)(dst) + dbytesperrow);
     src += stride;
@@ -180,7 +155,7 @@ void FFTFilt::FindMinMax(double *fft,ULONG stride,ULONG w,ULONG h,double &min,do
 
   for(y = 0;y < h;y++) {
     for(x = 0;x < w;x++) {
-      double v = fft[y * stride + (x << 1) + 0]; // only the real part.
+      double v = fft[y * stride + x];
       if (v < min)
 	min = v;
       if (v > max)
@@ -197,6 +172,8 @@ double FFTFilt::Measure(class ImageLayout *src,class ImageLayout *dst,double in)
   double vmin = HUGE_VAL;
   double vmax = -vmin;
   
+  assert(m_pSpectrum);
+
   src->TestIfCompatible(dst);
 
   CreateComponents(*src);
@@ -226,57 +203,9 @@ double FFTFilt::Measure(class ImageLayout *src,class ImageLayout *dst,double in)
     m_pComponent[comp].m_pPtr            = mem;
     m_ppFFT[comp] = fft                  = new class FFT(w,h,false);
     //
-    if (src->isSigned(comp)) {
-      if (src->BitsOf(comp) <= 8) {
-	CopyToFFT<const BYTE>((const BYTE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			      (const BYTE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			      fft->DataOf(),fft->ModuloOf(),w,h);
-      } else if (!src->isFloat(comp) && src->BitsOf(comp) <= 16) {
-	CopyToFFT<const WORD>((const WORD *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			      (const WORD *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			      fft->DataOf(),fft->ModuloOf(),w,h);
-      } else if (!src->isFloat(comp) && src->BitsOf(comp) <= 32) {
-	CopyToFFT<const LONG>((const LONG *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			      (const LONG *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			      fft->DataOf(),fft->ModuloOf(),w,h);
-      } else if (src->BitsOf(comp) <= 32 && src->isFloat(comp)) {
-	CopyToFFT<const FLOAT>((const FLOAT *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			      (const FLOAT *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			      fft->DataOf(),fft->ModuloOf(),w,h);
-      } else if (src->BitsOf(comp) == 64 && src->isFloat(comp)) {
-	CopyToFFT<const DOUBLE>((const DOUBLE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				(const DOUBLE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			       fft->DataOf(),fft->ModuloOf(),w,h);	
-      } else {
-	throw "unsupported data type";
-      }
-    } else {
-      if (src->BitsOf(comp) <= 8) {
-	CopyToFFT<const UBYTE>((const UBYTE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			       (const UBYTE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			       fft->DataOf(),fft->ModuloOf(),w,h);
-      } else if (!src->isFloat(comp) && src->BitsOf(comp) <= 16) {
-	CopyToFFT<const UWORD>((const UWORD *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			       (const UWORD *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			       fft->DataOf(),fft->ModuloOf(),w,h);
-      } else if (!src->isFloat(comp) && src->BitsOf(comp) <= 32) {
-	CopyToFFT<const ULONG>((const ULONG *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			       (const ULONG *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			       fft->DataOf(),fft->ModuloOf(),w,h);
-      } else if (src->BitsOf(comp) <= 32 && src->isFloat(comp)) {
-	CopyToFFT<const FLOAT>((const FLOAT *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			       (const FLOAT *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			       fft->DataOf(),fft->ModuloOf(),w,h);
-      } else if (src->BitsOf(comp) == 64 && src->isFloat(comp)) {
-	CopyToFFT<const DOUBLE>((const DOUBLE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				(const DOUBLE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				fft->DataOf(),fft->ModuloOf(),w,h);	      
-      } else {
-	throw "unsupported data type";
-      }
-    }
-    // Run the transformation.
-    fft->ForwardsFFT();
+    // Start from the shared transformation, the filter modifies it.
+    memcpy(fft->DataOf(),m_pSpectrum->TransformOf(src,dst,comp,false)->DataOf(),
+	   sizeof(double) * fft->ModuloOf() * h);
     //
     // Apply the filter
     delete[] m_pdFilter;
@@ -302,11 +231,16 @@ double FFTFilt::Measure(class ImageLayout *src,class ImageLayout *dst,double in)
     //
     //NormalizeFilter(m_pdFilter,w,w,h);
     //
-    // Now apply the filter.
+    // Now apply the filter. Only half of the spectrum is available, hence
+    // apply the symmetric part of the filter. This is what remains of the
+    // filter when taking the real part of the output.
     for(y = 0;y < h;y++) {
-      for(x = 0;x < w;x++) {
-	fft->DataOf()[y * fft->ModuloOf() + (x << 1) + 0] *= m_pdFilter[y * w + x];
-	fft->DataOf()[y * fft->ModuloOf() + (x << 1) + 1] *= m_pdFilter[y * w + x];
+      ULONG ym = (y > 0)?(h - y):(0);
+      for(x = 0;x < fft->SpectrumWidthOf();x++) {
+	ULONG xm = (x > 0)?(w - x):(0);
+	double g = 0.5 * (m_pdFilter[y * w + x] + m_pdFilter[ym * w + xm]);
+	fft->DataOf()[y * fft->ModuloOf() + (x << 1) + 0] *= g;
+	fft->DataOf()[y * fft->ModuloOf() + (x << 1) + 1] *= g;
       }
     }
     //
@@ -393,5 +327,3 @@ double FFTFilt::Measure(class ImageLayout *src,class ImageLayout *dst,double in)
   return in;
 }
 ///
-
-#endif
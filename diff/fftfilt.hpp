@@ -35,11 +35,11 @@ and conversion framework.
 /// Includes
 #include "diff/meter.hpp"
 #include "img/imglayout.hpp"
-#ifdef USE_GSL
 ///
 
 /// Forwards
 class FFT;
+class Spectrum;
 ///
 
 /// class FFTFilt
@@ -53,6 +53,10 @@ class FFTFilt : public Meter, private ImageLayout {
   // The component memory itself.
   UBYTE     **m_ppucImage;
   //
+  // The transformations of the difference image, shared by all
+  // spectral meters.
+  class Spectrum *m_pSpectrum;
+  //
   // The FFTs used here.
   class FFT **m_ppFFT;
   //
@@ -69,11 +73,6 @@ class FFTFilt : public Meter, private ImageLayout {
   ULONG       m_ulCombX,m_ulCombY;
   //
   template<typename T>
-  void CopyToFFT(T *org       ,ULONG obytesperpixel,ULONG obytesperrow,
-		 T *dst       ,ULONG dbytesperpixel,ULONG dbytesperrow,
-		 double *trg  ,ULONG stide,ULONG w,ULONG h);
-  //
-  template<typename T>
   void CopyFromFFT(double *src,ULONG stride,ULONG w,ULONG h,
 		   T *dst,ULONG dbytesperpixel,ULONG dbytesperrow,
 		   double min,double max,double scale,double shift);
@@ -93,7 +92,7 @@ public:
   // Construct the difference image. Takes a file name.
   FFTFilt(const char *filename,ULONG xc,ULONG yc,ULONG radius,bool normalize,
 	  ULONG combx,ULONG comby)
-    : m_pTargetFile(filename), m_ppucImage(NULL), m_ppFFT(NULL), 
+    : m_pTargetFile(filename), m_ppucImage(NULL), m_pSpectrum(NULL), m_ppFFT(NULL), 
       m_ulXC(xc), m_ulYC(yc), m_ulRadius(radius), m_pdFilter(NULL), m_bNormalize(normalize),
       m_ulCombX(combx), m_ulCombY(comby)
   {
@@ -101,15 +100,25 @@ public:
   //
   virtual ~FFTFilt(void);
   //
+  virtual void AttachSpectrum(class Spectrum *spectrum)
+  {
+    m_pSpectrum = spectrum;
+  }
+  //
   virtual double Measure(class ImageLayout *src,class ImageLayout *dst,double in);
   //
   virtual const char *NameOf(void) const
   {
     return NULL;
   }
+  //
+  // The filtered image is saved, the images are not modified.
+  virtual bool isReadOnly(void) const
+  {
+    return true;
+  }
 };
 ///
 
 ///
 #endif
-#endif
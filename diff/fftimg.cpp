@@ -31,36 +31,11 @@ and conversion framework.
 
 /// Includes
 #include "diff/fftimg.hpp"
+#include "diff/spectrum.hpp"
 #include "tools/fft.hpp"
 #include "std/math.hpp"
 #include "std/string.hpp"
-#ifdef USE_GSL
-///
-
-/// FFTImg::CopyToFFT
-template<typename T>
-void FFTImg::CopyToFFT(T *org,ULONG obytesperpixel,ULONG obytesperrow,
-		       T *dst,ULONG dbytesperpixel,ULONG dbytesperrow,
-		       double *target,ULONG stride,ULONG w,ULONG h)
-{
-  ULONG x,y;
-
-  for(y = 0;y < h;y++) {
-    T *orgrow      = org;
-    T *dstrow      = dst;
-    double *trgrow = target + y * stride;
-    for(x = 0;x < w;x++) {
-      trgrow[0]   = *orgrow - *dstrow; // real part
-      trgrow[1]   = 0.0; // imaginary part.
-      //
-      orgrow      = (T *)((const UBYTE *)(orgrow) + obytesperpixel);
-      dstrow      = (T *)((const UBYTE *)(dstrow) + dbytesperpixel);
-      trgrow     += 2;
-    }
-    org = (T *)((const UBYTE *)(org) + obytesperrow);
-    dst = (T *)((const UBYTE *)(dst) + dbytesperrow);
-  }
-}
+#include "std/assert.hpp"
 ///
 
 /// FFTImg::~FFTImg
@@ -76,14 +51,7 @@ FFTImg::~FFTImg(void)
     delete[] m_ppucImage;
   }
 
-  if (m_ppFFT) {
-    for(i = 0;i < m_usDepth;i++) {
-      if (m_ppFFT[i])
-        delete m_ppFFT[i];
-    }
-    delete[] m_ppFFT;
-  }
-
+  delete[] m_ppFFT;
 }
 ///
 
@@ -93,17 +61,19 @@ double FFTImg::Measure(class ImageLayout *src,class ImageLayout *dst,double in)
   UWORD comp;
   double max = 0.0;
 
+  assert(m_pSpectrum);
+
   CreateComponents(*src);
   m_ppucImage = new UBYTE *[src->DepthOf()];
   memset(m_ppucImage,0,sizeof(UBYTE *) * src->DepthOf());
-  m_ppFFT     = new class FFT *[src->DepthOf()];
+  m_ppFFT     = new const class FFT *[src->DepthOf()];
   memset(m_ppFFT,0,sizeof(class FFT *) * src->DepthOf());
 
   for(comp = 0;comp < src->DepthOf();comp++) {
     ULONG  w    = src->WidthOf(comp);
     ULONG  h    = src->HeightOf(comp);
     UBYTE *mem  = new UBYTE[w * h];
-    class FFT *fft;
+    const class FFT *fft;
     ULONG  x,y;
     //
     m_ppucImage[comp]                    = mem;
@@ -114,65 +84,14 @@ double FFTImg::Measure(class ImageLayout *src,class ImageLayout *dst,double in)
     m_pComponent[comp].m_ulBytesPerPixel = 1;
     m_pComponent[comp].m_ulBytesPerRow   = w;
     m_pComponent[comp].m_pPtr            = mem;
-    m_ppFFT[comp] = fft                  = new class FFT(w,h,m_bWindow);
-    //
-    if (src->isSigned(comp)) {
-      if (src->BitsOf(comp) <= 8) {
-	CopyToFFT<const BYTE>((const BYTE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			      (const BYTE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			      fft->DataOf(),fft->ModuloOf(),w,h);
-      } else if (!src->isFloat(comp) && src->BitsOf(comp) <= 16) {
-	CopyToFFT<const WORD>((const WORD *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			      (const WORD *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			      fft->DataOf(),fft->ModuloOf(),w,h);
-      } else if (!src->isFloat(comp) && src->BitsOf(comp) <= 32) {
-	CopyToFFT<const LONG>((const LONG *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			      (const LONG *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			      fft->DataOf(),fft->ModuloOf(),w,h);
-      } else if (src->BitsOf(comp) <= 32 && src->isFloat(comp)) {
-	CopyToFFT<const FLOAT>((const FLOAT *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			       (const FLOAT *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			       fft->DataOf(),fft->ModuloOf(),w,h);
-      } else if (src->BitsOf(comp) == 64 && src->isFloat(comp)) {
-	CopyToFFT<const DOUBLE>((const DOUBLE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				(const DOUBLE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				fft->DataOf(),fft->ModuloOf(),w,h);
-      } else {
-	throw "unsupported data type";
-      }
-    } else {
-      if (src->BitsOf(comp) <= 8) {
-	CopyToFFT<const UBYTE>((const UBYTE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			       (const UBYTE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			       fft->DataOf(),fft->ModuloOf(),w,h);
-      } else if (!src->isFloat(comp) && src->BitsOf(comp) <= 16) {
-	CopyToFFT<const UWORD>((const UWORD *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			       (const UWORD *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			       fft->DataOf(),fft->ModuloOf(),w,h);
-      } else if (!src->isFloat(comp) && src->BitsOf(comp) <= 32) {
-	CopyToFFT<const ULONG>((const ULONG *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			       (const ULONG *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			       fft->DataOf(),fft->ModuloOf(),w,h);
-      } else if (src->BitsOf(comp) <= 32 && src->isFloat(comp)) {
-	CopyToFFT<const FLOAT>((const FLOAT *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			       (const FLOAT *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			       fft->DataOf(),fft->ModuloOf(),w,h);
-      } else if (src->BitsOf(comp) == 64 && src->isFloat(comp)) {
-	CopyToFFT<const DOUBLE>((const DOUBLE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				(const DOUBLE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				fft->DataOf(),fft->ModuloOf(),w,h);
-      } else {
-	throw "unsupported data type";
-      }
-    }
-    // Run the transformation.
-    fft->ForwardsFFT();
+    m_ppFFT[comp] = fft                  = m_pSpectrum->TransformOf(src,dst,comp,m_bWindow);
     //
     // Normalize the components.
     for(y = 0;y < h;y++) {
-      const double *data = fft->DataOf() + y * fft->ModuloOf();
-      for(x = 0;x < w;x++,data += 2) {
-	double v = sqrt(data[0] * data[0] + data[1] * data[1]);
+      for(x = 0;x < w;x++) {
+	double re,im,v;
+	fft->CoefficientOf(x,y,re,im);
+	v = sqrt(re * re + im * im);
 	if (v > max && x != 0 && y != 0)
 	  max = v;
       }
@@ -184,20 +103,21 @@ double FFTImg::Measure(class ImageLayout *src,class ImageLayout *dst,double in)
     max = 1.0;
   //
   for(comp = 0;comp < src->DepthOf();comp++) {
-    class FFT *fft = m_ppFFT[comp];
+    const class FFT *fft = m_ppFFT[comp];
     UBYTE *mem     = m_ppucImage[comp];
     ULONG  w       = src->WidthOf(comp);
     ULONG  h       = src->HeightOf(comp);
     ULONG x,y;
     //
-    // Now fill in the target 
+    // Now fill in the target, with the DC component moved to the center.
+    // This also works for odd dimensions.
     for(y = 0;y < h;y++) {
-      const double *data = fft->DataOf() + y * fft->ModuloOf();
-      UBYTE *out         = mem + ((y < (h >> 1))?(y + (h >> 1)):(y - (h >> 1))) * w;
-      out               += w >> 1;
-      for(x = 0;x < w;x++,data += 2) {
-	double v = sqrt(data[0] * data[0] + data[1] * data[1]) * 255 / max;
+      UBYTE *out         = mem + ((y + (h >> 1)) % h) * w;
+      for(x = 0;x < w;x++) {
+	double re,im,v;
 	UBYTE dt;
+	fft->CoefficientOf(x,y,re,im);
+	v = sqrt(re * re + im * im) * 255 / max;
 	if (v < 0.0) {
 	  dt = 0;
 	} else if (v > 255.0) {
@@ -205,9 +125,7 @@ double FFTImg::Measure(class ImageLayout *src,class ImageLayout *dst,double in)
 	} else {
 	  dt = UBYTE(v);
 	}
-	if (x == (w >> 1))
-	  out -= w;
-	*out++ = dt;
+	out[(x + (w >> 1)) % w] = dt;
       }
     }
   }
@@ -217,5 +135,3 @@ double FFTImg::Measure(class ImageLayout *src,class ImageLayout *dst,double in)
   return in;
 }
 ///
-
-#endif
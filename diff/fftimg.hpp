@@ -35,11 +35,11 @@ and conversion framework.
 /// Includes
 #include "diff/meter.hpp"
 #include "img/imglayout.hpp"
-#ifdef USE_GSL
 ///
 
 /// Forwards
 class FFT;
+class Spectrum;
 ///
 
 /// class FFTImg
@@ -53,36 +53,45 @@ class FFTImg : public Meter, private ImageLayout {
   // The component memory itself.
   UBYTE     **m_ppucImage;
   //
-  // The FFTs used here.
-  class FFT **m_ppFFT;
+  // The transformations of the difference image, shared by all
+  // spectral meters.
+  class Spectrum   *m_pSpectrum;
+  //
+  // The FFTs used here, one per component.
+  const class FFT **m_ppFFT;
   //
   // The window-flag for the FFT.
   bool        m_bWindow;
   //
-  template<typename T>
-  void CopyToFFT(T *org       ,ULONG obytesperpixel,ULONG obytesperrow,
-		 T *dst       ,ULONG dbytesperpixel,ULONG dbytesperrow,
-		 double *trg  ,ULONG stide,ULONG w,ULONG h);
-  //
 public:
   //
   // Construct the difference image. Takes a file name.
   FFTImg(const char *filename,bool window)
-    : m_pTargetFile(filename), m_ppucImage(NULL), m_ppFFT(NULL), m_bWindow(window)
+    : m_pTargetFile(filename), m_ppucImage(NULL), m_pSpectrum(NULL), m_ppFFT(NULL), m_bWindow(window)
   {
   }
   //
   virtual ~FFTImg(void);
   //
+  virtual void AttachSpectrum(class Spectrum *spectrum)
+  {
+    m_pSpectrum = spectrum;
+  }
+  //
   virtual double Measure(class ImageLayout *src,class ImageLayout *dst,double in);
   //
   virtual const char *NameOf(void) const
   {
     return NULL;
   }
+  //
+  // The transformation is saved, the images are not modified.
+  virtual bool isReadOnly(void) const
+  {
+    return true;
+  }
 };
 ///
 
 ///
 #endif
-#endif
@@ -42,18 +42,9 @@ void FromGrey::GreyToRGB(class ImageLayout *src)
   CreateComponents(src->WidthOf(),src->HeightOf(),3);
 
   //
-  // Now copy the attributes over.
+  // All three components share the plane of the grey component.
   for(i = 0;i < 3;i++) {
-    m_pComponent[i].m_ulWidth         = src->WidthOf(0);
-    m_pComponent[i].m_ulHeight        = src->HeightOf(0);
-    m_pComponent[i].m_ucBits          = src->BitsOf(0);
-    m_pComponent[i].m_bSigned         = src->isSigned(0);
-    m_pComponent[i].m_bFloat          = src->isFloat(0);
-    m_pComponent[i].m_ucSubX          = src->SubXOf(0);
-    m_pComponent[i].m_ucSubY          = src->SubYOf(0);
-    m_pComponent[i].m_ulBytesPerPixel = src->BytesPerPixel(0);
-    m_pComponent[i].m_ulBytesPerRow   = src->BytesPerRow(0);
-    m_pComponent[i].m_pPtr            = src->DataOf(0);
+    SharePlane(i,src,0);
   }
 }
 ///
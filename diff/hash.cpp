@@ -0,0 +1,463 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software) for Accusoft	        **
+** All Rights Reserved							**
+**************************************************************************
+
+This source file is part of difftest_ng, a universal image measuring
+and conversion framework.
+
+    difftest_ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    difftest_ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with difftest_ng.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/*
+**
+** $Id: hash.cpp,v 1.1 2022/09/26 08:40:52 thor Exp $
+**
+** This class computes a hash of the decoded samples of both images
+** and writes it to a file or to stdout.
+*/
+
+/// Includes
+#include "diff/hash.hpp"
+#include "img/imglayout.hpp"
+#include "tools/threadpool.hpp"
+#include "std/stdio.hpp"
+#include "std/string.hpp"
+#include "std/errno.hpp"
+#include "std/assert.hpp"
+///
+
+/// Primes
+// The multipliers of the hash function, those of xxHash64.
+static const UQUAD Prime1 = (UQUAD(0x9e3779b1UL) << 32) | 0x85ebca87UL;
+static const UQUAD Prime2 = (UQUAD(0xc2b2ae3dUL) << 32) | 0x27d4eb4fUL;
+static const UQUAD Prime3 = (UQUAD(0x165667b1UL) << 32) | 0x9e3779f9UL;
+static const UQUAD Prime4 = (UQUAD(0x85ebca77UL) << 32) | 0xc2b2ae63UL;
+static const UQUAD Prime5 = (UQUAD(0x27d4eb2fUL) << 32) | 0x165667c5UL;
+///
+
+/// PutWord
+// Store a 64 bit word in little endian byte order.
+static void PutWord(UBYTE *p,UQUAD v)
+{
+  int i;
+
+  for(i = 0;i < 8;i++) {
+    p[i] = UBYTE(v);
+    v  >>= 8;
+  }
+}
+///
+
+/// class HashStream
+// The hash function over a stream of bytes. The bytes are consumed
+// in stripes of 32 bytes by four accumulators as in xxHash64. The
+// accumulators are merged twice, in different ways, to form the two
+// halves of the 128 bit result.
+class HashStream {
+  //
+  // The accumulators.
+  UQUAD m_uqAcc[4];
+  //
+  // The seed, and the number of bytes consumed so far.
+  UQUAD m_uqSeed;
+  UQUAD m_uqTotal;
+  //
+  // Bytes that do not yet fill a stripe.
+  UBYTE m_ucBuffer[32];
+  ULONG m_ulFill;
+  //
+  static UQUAD Rotate(UQUAD x,int r)
+  {
+    return (x << r) | (x >> (64 - r));
+  }
+  //
+  // Read a little endian 64 bit word.
+  static UQUAD WordOf(const UBYTE *p)
+  {
+#ifdef WORDS_BIGENDIAN
+    UQUAD v = 0;
+    int i;
+    for(i = 7;i >= 0;i--)
+      v = (v << 8) | p[i];
+    return v;
+#else
+    UQUAD v;
+    memcpy(&v,p,sizeof(v));
+    return v;
+#endif
+  }
+  //
+  static UQUAD Round(UQUAD acc,UQUAD in)
+  {
+    acc += in * Prime2;
+    acc  = Rotate(acc,31);
+    return acc * Prime1;
+  }
+  //
+  static UQUAD Merge(UQUAD h,UQUAD acc)
+  {
+    h ^= Round(0,acc);
+    return h * Prime1 + Prime4;
+  }
+  //
+  static UQUAD Avalanche(UQUAD h)
+  {
+    h ^= h >> 33;
+    h *= Prime2;
+    h ^= h >> 29;
+    h *= Prime3;
+    h ^= h >> 32;
+    return h;
+  }
+  //
+  // Run a stripe of 32 bytes through the accumulators.
+  void Stripe(const UBYTE *p)
+  {
+    m_uqAcc[0] = Round(m_uqAcc[0],WordOf(p));
+    m_uqAcc[1] = Round(m_uqAcc[1],WordOf(p + 8));
+    m_uqAcc[2] = Round(m_uqAcc[2],WordOf(p + 16));
+    m_uqAcc[3] = Round(m_uqAcc[3],WordOf(p + 24));
+  }
+  //
+public:
+  HashStream(UQUAD seed)
+    : m_uqSeed(seed), m_uqTotal(0), m_ulFill(0)
+  {
+    m_uqAcc[0] = seed + Prime1 + Prime2;
+    m_uqAcc[1] = seed + Prime2;
+    m_uqAcc[2] = seed;
+    m_uqAcc[3] = seed - Prime1;
+  }
+  //
+  // Add bytes to the stream.
+  void Update(const UBYTE *data,size_t size)
+  {
+    m_uqTotal += size;
+    //
+    if (m_ulFill) {
+      size_t bytes = sizeof(m_ucBuffer) - m_ulFill;
+      if (bytes > size)
+	bytes = size;
+      memcpy(m_ucBuffer + m_ulFill,data,bytes);
+      m_ulFill += bytes;
+      data     += bytes;
+      size     -= bytes;
+      if (m_ulFill < sizeof(m_ucBuffer))
+	return;
+      Stripe(m_ucBuffer);
+      m_ulFill  = 0;
+    }
+    //
+    while(size >= sizeof(m_ucBuffer)) {
+      Stripe(data);
+      data += sizeof(m_ucBuffer);
+      size -= sizeof(m_ucBuffer);
+    }
+    //
+    memcpy(m_ucBuffer,data,size);
+    m_ulFill = size;
+  }
+  //
+  // Compute the hash of all bytes added.
+  void Finish(struct Hash::Digest &digest)
+  {
+    UQUAD h,g;
+    ULONG i;
+    //
+    if (m_uqTotal >= sizeof(m_ucBuffer)) {
+      h = Rotate(m_uqAcc[0],1) + Rotate(m_uqAcc[1],7) + Rotate(m_uqAcc[2],12) + Rotate(m_uqAcc[3],18);
+      h = Merge(h,m_uqAcc[0]);
+      h = Merge(h,m_uqAcc[1]);
+      h = Merge(h,m_uqAcc[2]);
+      h = Merge(h,m_uqAcc[3]);
+      g = Rotate(m_uqAcc[0],5) + Rotate(m_uqAcc[1],17) + Rotate(m_uqAcc[2],29) + Rotate(m_uqAcc[3],43);
+      g = Merge(g,m_uqAcc[3]);
+      g = Merge(g,m_uqAcc[2]);
+      g = Merge(g,m_uqAcc[1]);
+      g = Merge(g,m_uqAcc[0]);
+    } else {
+      h = m_uqSeed + Prime5;
+      g = Rotate(m_uqSeed,32) + Prime3;
+    }
+    h += m_uqTotal;
+    g += m_uqTotal * Prime4;
+    //
+    // The remaining bytes are padded with zeros, the total byte count
+    // makes this unambiguous.
+    memset(m_ucBuffer + m_ulFill,0,sizeof(m_ucBuffer) - m_ulFill);
+    for(i = 0;i < m_ulFill;i += 8) {
+      UQUAD k = WordOf(m_ucBuffer + i);
+      h ^= Round(0,k);
+      h  = Rotate(h,27) * Prime1 + Prime4;
+      g ^= Round(0,k ^ Prime5);
+      g  = Rotate(g,31) * Prime2 + Prime3;
+    }
+    //
+    digest.m_uqLow  = Avalanche(h);
+    digest.m_uqHigh = Avalanche(g ^ digest.m_uqLow);
+  }
+};
+///
+
+/// SampleSizeOf
+// Return the size of the samples of the component, or zero if the
+// type is not supported. The types are classified as in
+// Statistics::KernelOf.
+static ULONG SampleSizeOf(const class ImageLayout *img,UWORD comp)
+{
+  if (img->BitsOf(comp) <= 8)
+    return sizeof(UBYTE);
+  if (!img->isFloat(comp) && img->BitsOf(comp) <= 16)
+    return sizeof(UWORD);
+  if (img->BitsOf(comp) <= 32)
+    return sizeof(ULONG);
+  if (img->BitsOf(comp) == 64 && img->isFloat(comp))
+    return sizeof(UQUAD);
+  return 0;
+}
+///
+
+/// GatherRow
+// Copy a row of samples into the buffer, without gaps and in little
+// endian byte order.
+template<typename T>
+static void GatherRow(const UBYTE *row,ULONG bytesperpixel,ULONG w,UBYTE *buffer)
+{
+  ULONG x;
+#ifdef WORDS_BIGENDIAN
+  size_t i;
+
+  for(x = 0;x < w;x++) {
+    T v = *(const T *)row;
+    for(i = 0;i < sizeof(T);i++) {
+      *buffer++ = UBYTE(v);
+      v = T(v >> 8);
+    }
+    row += bytesperpixel;
+  }
+#else
+  T *out = (T *)buffer;
+
+  for(x = 0;x < w;x++) {
+    out[x] = *(const T *)row;
+    row   += bytesperpixel;
+  }
+#endif
+}
+///
+
+/// class HashJob
+// The job hashing the bands of all components of an image in
+// parallel. Each slice is one band of BandHeight rows of one
+// component.
+class HashJob : public Job {
+  //
+  // The image.
+  const class ImageLayout *m_pImage;
+  //
+  // The seed.
+  UQUAD                    m_uqSeed;
+  //
+  // Number of components, and the index of the first band of each
+  // component. The last entry is the total band count.
+  UWORD                    m_usDepth;
+  ULONG                   *m_pulFirstBand;
+  //
+  // The hashes of all bands.
+  struct Hash::Digest     *m_pBands;
+  //
+  // A row buffer per worker, for rows that are not stored without
+  // gaps in little endian byte order.
+  UBYTE                  **m_ppucBuffer;
+  ULONG                    m_ulWorkers;
+  //
+public:
+  HashJob(const class ImageLayout *img,UQUAD seed)
+    : m_pImage(img), m_uqSeed(seed), m_usDepth(img->DepthOf()),
+      m_pulFirstBand(NULL), m_pBands(NULL), m_ppucBuffer(NULL),
+      m_ulWorkers(ThreadPool::ThreadCountOf())
+  {
+    size_t row = 0;
+    UWORD comp;
+    ULONG i;
+    //
+    m_pulFirstBand    = new ULONG[m_usDepth + 1];
+    m_pulFirstBand[0] = 0;
+    for(comp = 0;comp < m_usDepth;comp++) {
+      ULONG size = SampleSizeOf(img,comp);
+      //
+      if (size == 0)
+	throw "unsupported data type";
+      if (size * img->WidthOf(comp) > row)
+	row = size * img->WidthOf(comp);
+      m_pulFirstBand[comp + 1] = m_pulFirstBand[comp] +
+	(img->HeightOf(comp) + Hash::BandHeight - 1) / Hash::BandHeight;
+    }
+    //
+    m_pBands     = new struct Hash::Digest[m_pulFirstBand[m_usDepth]];
+    m_ppucBuffer = new UBYTE *[m_ulWorkers];
+    for(i = 0;i < m_ulWorkers;i++)
+      m_ppucBuffer[i] = NULL;
+    for(i = 0;i < m_ulWorkers;i++)
+      m_ppucBuffer[i] = new UBYTE[row + 1];
+  }
+  //
+  virtual ~HashJob(void)
+  {
+    ULONG i;
+    //
+    if (m_ppucBuffer) {
+      for(i = 0;i < m_ulWorkers;i++)
+	delete[] m_ppucBuffer[i];
+      delete[] m_ppucBuffer;
+    }
+    delete[] m_pBands;
+    delete[] m_pulFirstBand;
+  }
+  //
+  // Return the number of slices of the job.
+  ULONG SlicesOf(void) const
+  {
+    return m_pulFirstBand[m_usDepth];
+  }
+  //
+  // Return the hash of the given band.
+  const struct Hash::Digest &BandOf(ULONG band) const
+  {
+    return m_pBands[band];
+  }
+  //
+  // Hash one band of one component.
+  virtual void Run(ULONG slice,ULONG worker)
+  {
+    class HashStream stream(m_uqSeed);
+    UWORD comp = 0;
+    ULONG size,bpp,bpr,w,y,y1;
+    const UBYTE *row;
+    //
+    assert(worker < m_ulWorkers);
+    //
+    while(slice >= m_pulFirstBand[comp + 1])
+      comp++;
+    //
+    size = SampleSizeOf(m_pImage,comp);
+    bpp  = m_pImage->BytesPerPixel(comp);
+    bpr  = m_pImage->BytesPerRow(comp);
+    w    = m_pImage->WidthOf(comp);
+    y    = (slice - m_pulFirstBand[comp]) * Hash::BandHeight;
+    y1   = y + Hash::BandHeight;
+    if (y1 > m_pImage->HeightOf(comp))
+      y1 = m_pImage->HeightOf(comp);
+    row  = (const UBYTE *)m_pImage->DataOf(comp) + size_t(y) * bpr;
+    //
+    for(;y < y1;y++) {
+#ifndef WORDS_BIGENDIAN
+      if (bpp == size) {
+	stream.Update(row,size_t(w) * size);
+	row += bpr;
+	continue;
+      }
+#endif
+      switch(size) {
+      case sizeof(UBYTE):
+	GatherRow<UBYTE>(row,bpp,w,m_ppucBuffer[worker]);
+	break;
+      case sizeof(UWORD):
+	GatherRow<UWORD>(row,bpp,w,m_ppucBuffer[worker]);
+	break;
+      case sizeof(ULONG):
+	GatherRow<ULONG>(row,bpp,w,m_ppucBuffer[worker]);
+	break;
+      default:
+	GatherRow<UQUAD>(row,bpp,w,m_ppucBuffer[worker]);
+	break;
+      }
+      stream.Update(m_ppucBuffer[worker],size_t(w) * size);
+      row += bpr;
+    }
+    //
+    stream.Finish(m_pBands[slice]);
+  }
+};
+///
+
+/// Hash::HashImage
+// Compute the hash of the samples of an image. The bands are hashed
+// in parallel, then the layout of the components and the hashes of
+// the bands are hashed in order.
+void Hash::HashImage(const class ImageLayout *img,UQUAD seed,struct Digest &digest)
+{
+  class HashJob job(img,seed);
+  class HashStream stream(seed);
+  UBYTE word[16];
+  UWORD comp;
+  ULONG i;
+
+  ThreadPool::Run(&job,job.SlicesOf());
+
+  PutWord(word,img->DepthOf());
+  stream.Update(word,8);
+  for(comp = 0;comp < img->DepthOf();comp++) {
+    UQUAD flags = (img->isSigned(comp)?1:0) | (img->isFloat(comp)?2:0);
+    //
+    PutWord(word,(UQUAD(img->WidthOf(comp)) << 32) | img->HeightOf(comp));
+    PutWord(word + 8,(UQUAD(img->BitsOf(comp)) << 32) | (flags << 16) |
+	    (img->SubXOf(comp) << 8) | img->SubYOf(comp));
+    stream.Update(word,16);
+  }
+  for(i = 0;i < job.SlicesOf();i++) {
+    PutWord(word,job.BandOf(i).m_uqLow);
+    PutWord(word + 8,job.BandOf(i).m_uqHigh);
+    stream.Update(word,16);
+  }
+
+  stream.Finish(digest);
+}
+///
+
+/// Hash::Measure
+// Hash both images, and write the hashes as hex numbers, the hash of
+// the original first.
+double Hash::Measure(class ImageLayout *src,class ImageLayout *dst,double in)
+{
+  struct Digest org,dist;
+  FILE *out = stdout;
+
+  HashImage(src,m_uqSeed,org);
+  HashImage(dst,m_uqSeed,dist);
+
+  if (strcmp(m_pcTargetFile,"-")) {
+    out = fopen(m_pcTargetFile,"w");
+    if (out == NULL) {
+      ImageLayout::PostError("unable to open the hash output file %s: %s\n",m_pcTargetFile,strerror(errno));
+      return in; // code should never go here.
+    }
+  } else {
+    printf("Hash:\t");
+  }
+
+  fprintf(out,"%08lx%08lx%08lx%08lx\t%08lx%08lx%08lx%08lx\n",
+	  (unsigned long)(org.m_uqHigh >> 32),(unsigned long)(org.m_uqHigh & MAX_ULONG),
+	  (unsigned long)(org.m_uqLow >> 32),(unsigned long)(org.m_uqLow & MAX_ULONG),
+	  (unsigned long)(dist.m_uqHigh >> 32),(unsigned long)(dist.m_uqHigh & MAX_ULONG),
+	  (unsigned long)(dist.m_uqLow >> 32),(unsigned long)(dist.m_uqLow & MAX_ULONG));
+
+  if (out != stdout)
+    fclose(out);
+
+  return in;
+}
+///
@@ -0,0 +1,105 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software) for Accusoft	        **
+** All Rights Reserved							**
+**************************************************************************
+
+This source file is part of difftest_ng, a universal image measuring
+and conversion framework.
+
+    difftest_ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    difftest_ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with difftest_ng.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/*
+**
+** $Id: hash.hpp,v 1.1 2022/09/26 08:40:52 thor Exp $
+**
+** This class computes a hash of the decoded samples of both images
+** and writes it to a file or to stdout.
+*/
+
+#ifndef DIFF_HASH_HPP
+#define DIFF_HASH_HPP
+
+/// Includes
+#include "interface/types.hpp"
+#include "diff/meter.hpp"
+///
+
+/// Forwards
+class ImageLayout;
+///
+
+/// class Hash
+// This class computes a 128 bit hash of the decoded samples of both
+// images and writes it to a file or to stdout. The hash depends on
+// the dimensions, the sample types and the sample values of the
+// components, but not on the file format, the memory layout or the
+// byte order of the machine. Each component is cut into bands of
+// BandHeight rows that are hashed in parallel, the hashes of the
+// bands are then hashed in order.
+class Hash : public Meter {
+public:
+  //
+  // A 128 bit hash value.
+  struct Digest {
+    UQUAD m_uqLow;
+    UQUAD m_uqHigh;
+  };
+  //
+  // The number of rows hashed by one slice of the parallel job. This
+  // is part of the definition of the hash value.
+  enum {
+    BandHeight = 64
+  };
+  //
+private:
+  //
+  // The file name the hashes are written to, or "-" for stdout.
+  const char *m_pcTargetFile;
+  //
+  // The seed of the hash function.
+  UQUAD       m_uqSeed;
+  //
+public:
+  Hash(const char *filename,UQUAD seed = 0)
+    : m_pcTargetFile(filename), m_uqSeed(seed)
+  { }
+  //
+  // Compute the hash of the samples of an image.
+  static void HashImage(const class ImageLayout *img,UQUAD seed,struct Digest &digest);
+  //
+  virtual double Measure(class ImageLayout *src,class ImageLayout *dst,double in);
+  //
+  virtual const char *NameOf(void) const
+  {
+    return NULL;
+  }
+  //
+  // Keeps nothing from one measurement to the next.
+  virtual bool isReusable(void) const
+  {
+    return true;
+  }
+  //
+  // The hashes are written, the images are not modified.
+  virtual bool isReadOnly(void) const
+  {
+    return true;
+  }
+};
+///
+
+///
+#endif
@@ -31,41 +31,26 @@ and conversion framework.
 
 /// Includes
 #include "diff/histogram.hpp"
+#include "diff/statistics.hpp"
 #include "img/imglayout.hpp"
 #include "std/assert.hpp"
 #include "std/errno.hpp"
 #include "std/string.hpp"
 ///
 
-/// Histogram::Measure
-template<typename T>
-void Histogram::Measure(T *org       ,ULONG obytesperpixel,ULONG obytesperrow,
-			T *dst       ,ULONG dbytesperpixel,ULONG dbytesperrow,
-			ULONG w      ,ULONG h,ULONG *hist  ,LONG offset)
+/// Histogram::~Histogram
+Histogram::~Histogram(void)
 {
-  ULONG x,y;
-  
-   for(y = 0;y < h;y++) {
-    T *orgrow     = org;
-    T *dstrow     = dst;
-    for(x = 0;x < w;x++) {
-      LONG diff = LONG(*orgrow) - LONG(*dstrow) + offset;
-      assert(diff >= 0);
-      hist[diff]++;
-      //
-      orgrow      = (T *)((const UBYTE *)(orgrow) + obytesperpixel);
-      dstrow      = (T *)((const UBYTE *)(dstrow) + dbytesperpixel);
-    }
-    org = (T *)((const UBYTE *)(org) + obytesperrow);
-    dst = (T *)((const UBYTE *)(dst) + dbytesperrow);
-   }
+  delete[] m_pulHist;
 }
 ///
 
-/// Histogram::~Histogram
-Histogram::~Histogram(void)
+/// Histogram::AttachStatistics
+// Register the difference histogram.
+void Histogram::AttachStatistics(class Statistics *stats)
 {
-  delete[] m_pulHist;
+  stats->Require(Statistics::Histogram);
+  m_pStatistics = stats;
 }
 ///
 
@@ -81,6 +66,7 @@ double Histogram::Measure(class ImageLayout *src,class ImageLayout *dst,double i
   src->TestIfCompatible(dst);
   
   assert(m_pulHist == NULL);
+  assert(m_pStatistics);
 
   for(comp = 0;comp < src->DepthOf();comp++) {
     UBYTE bits = src->BitsOf(comp);
@@ -100,33 +86,12 @@ double Histogram::Measure(class ImageLayout *src,class ImageLayout *dst,double i
   memset(m_pulHist,0,sizeof(ULONG) * size);
 
   for(comp = 0;comp < src->DepthOf();comp++) {
-    ULONG w = src->WidthOf(comp);
-    ULONG h = src->HeightOf(comp);
-    
-    if (src->isSigned(comp)) {
-      if (src->BitsOf(comp) <= 8) {
-	Measure<const BYTE>((const BYTE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			    (const BYTE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			    w,h,m_pulHist,offset);
-      } else if (src->BitsOf(comp) <= 16) {
-	Measure<const WORD>((const WORD *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			    (const WORD *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			    w,h,m_pulHist,offset);
-      } else {
-        throw "unsupported data type";
-      }
-    } else {
-      if (src->BitsOf(comp) <= 8) {
-	Measure<const UBYTE>((const UBYTE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			     (const UBYTE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			     w,h,m_pulHist,offset);
-      } else if (src->BitsOf(comp) <= 16) {
-	Measure<const UWORD>((const UWORD *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			     (const UWORD *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			     w,h,m_pulHist,offset);
-      } else {
-        throw "unsupported data type";
-      }
+    const struct Statistics::Result &res = m_pStatistics->ResultOf(src,dst,comp);
+    ULONG *hist = m_pulHist + offset - res.m_lHistogramOffset;
+    //
+    assert(res.m_pulHistogram);
+    for(i = 0;i < res.m_ulHistogramSize;i++) {
+      hist[i] += res.m_pulHistogram[i];
     }
   }
 
@@ -50,24 +50,20 @@ class Histogram : public Meter {
   // The histogram array.
   ULONG      *m_pulHist;
   //
-  // Measure the difference histogram, place results into the given array
-  // after adding the given offset to the difference.
-  template<typename T>
-  static void Measure(T *org       ,ULONG obytesperpixel,ULONG obytesperrow,
-		      T *dst       ,ULONG dbytesperpixel,ULONG dbytesperrow,
-		      ULONG w      ,ULONG h,ULONG *hist  ,LONG offset);
+  // The statistics collector the histogram is taken from.
+  class Statistics *m_pStatistics;
   //
 public:
   //
   // Construct the histogram. Takes a file name.
   Histogram(const char *filename)
-    : m_pcTargetFile(filename), m_lThres(-1), m_pulHist(NULL)
+    : m_pcTargetFile(filename), m_lThres(-1), m_pulHist(NULL), m_pStatistics(NULL)
   {
   }
   //
   // Construct the histogram for measuring pixel difference ratios.
   Histogram(LONG thres)
-    : m_pcTargetFile(NULL), m_lThres(thres), m_pulHist(NULL)
+    : m_pcTargetFile(NULL), m_lThres(thres), m_pulHist(NULL), m_pStatistics(NULL)
   {
   }
   //
@@ -75,6 +71,14 @@ public:
   //
   virtual double Measure(class ImageLayout *src,class ImageLayout *dst,double in);
   //
+  virtual void AttachStatistics(class Statistics *stats);
+  //
+  // Only requires the point-wise statistics.
+  virtual bool isStreamable(void) const
+  {
+    return true;
+  }
+  //
   virtual const char *NameOf(void) const
   {
     if (!m_pcTargetFile)
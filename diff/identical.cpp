@@ -0,0 +1,54 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software) for Accusoft	        **
+** All Rights Reserved							**
+**************************************************************************
+
+This source file is part of difftest_ng, a universal image measuring
+and conversion framework.
+
+    difftest_ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    difftest_ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with difftest_ng.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/*
+**
+** $Id: identical.cpp,v 1.1 2022/09/24 09:31:17 thor Exp $
+**
+** This class checks whether the two images are identical, bit by
+** bit.
+*/
+
+/// Includes
+#include "diff/identical.hpp"
+#include "diff/statistics.hpp"
+#include "img/imglayout.hpp"
+#include "std/assert.hpp"
+///
+
+/// Identical::AttachStatistics
+// Keep the statistics collector, nothing needs to be collected.
+void Identical::AttachStatistics(class Statistics *stats)
+{
+  m_pStatistics = stats;
+}
+///
+
+/// Identical::Measure
+double Identical::Measure(class ImageLayout *src,class ImageLayout *dst,double)
+{
+  assert(m_pStatistics);
+
+  return (m_pStatistics->isIdentical(src,dst))?(1.0):(0.0);
+}
+///
@@ -0,0 +1,77 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software) for Accusoft	        **
+** All Rights Reserved							**
+**************************************************************************
+
+This source file is part of difftest_ng, a universal image measuring
+and conversion framework.
+
+    difftest_ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    difftest_ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with difftest_ng.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/*
+**
+** $Id: identical.hpp,v 1.1 2022/09/24 09:31:17 thor Exp $
+**
+** This class checks whether the two images are identical, bit by
+** bit.
+*/
+
+#ifndef DIFF_IDENTICAL_HPP
+#define DIFF_IDENTICAL_HPP
+
+/// Includes
+#include "diff/meter.hpp"
+///
+
+/// Forwards
+class ImageLayout;
+class Statistics;
+///
+
+/// class Identical
+// Returns one if the images have the same layout and hold the same
+// samples, zero otherwise. The comparison stops at the first
+// difference and is shared with the statistics, which skip their
+// pass over identical images.
+class Identical : public Meter {
+  //
+  // The statistics collector that probes the images.
+  class Statistics *m_pStatistics;
+  //
+public:
+  Identical(void)
+    : m_pStatistics(NULL)
+  { }
+  //
+  virtual double Measure(class ImageLayout *src,class ImageLayout *dst,double in);
+  //
+  virtual void AttachStatistics(class Statistics *stats);
+  //
+  virtual const char *NameOf(void) const
+  {
+    return "Identical";
+  }
+  //
+  // Keeps nothing from one measurement to the next.
+  virtual bool isReusable(void) const
+  {
+    return true;
+  }
+};
+///
+
+///
+#endif
@@ -35,13 +35,64 @@ and conversion framework.
 #include "std/math.hpp"
 ///
 
+/// Statics
+// Compute the transfer functions by the math library.
+bool Mapping::m_bExactTransfer = false;
+///
+
+
+/// Mapping::CodeOf
+// Look up the code of a floating point sample in the buckets. Returns
+// false if the sample has to be converted by computation.
+bool Mapping::CodeOf(const struct FloatBucket *buckets,const void *sample,ULONG &code)
+{
+  ULONG bits;
+
+  memcpy(&bits,sample,sizeof(bits));
+  //
+  // Negative samples, infinities and NaNs are not covered.
+  if (bits < 0x7f800000UL) {
+    const struct FloatBucket *b = buckets + (bits >> BucketShift);
+    if (b->m_lCode >= 0) {
+      code = b->m_lCode + ((bits >= b->m_ulThreshold)?1:0);
+      return true;
+    }
+  }
+  return false;
+}
+///
+
+/// Mapping::LookupTable
+// Convert samples by looking them up in a table indexed by the sample
+// value.
+template<typename S,typename T>
+void Mapping::LookupTable(const S *org ,ULONG obytesperpixel,ULONG obytesperrow,
+			  T *dst       ,ULONG dbytesperpixel,ULONG dbytesperrow,
+			  ULONG w, ULONG h, const T *table)
+{
+  ULONG x,y;
+  
+  for(y = 0;y < h;y++) {
+    const S *orgrow = org;
+    T *dstrow       = dst;
+    for(x = 0;x < w;x++) {
+      *dstrow = table[*orgrow];
+      orgrow  = (const S *)((const UBYTE *)(orgrow) + obytesperpixel);
+      dstrow  = (T *)((UBYTE *)(dstrow) + dbytesperpixel);
+    }
+    org = (const S *)((const UBYTE *)(org) + obytesperrow);
+    dst = (T *)((UBYTE *)(dst) + dbytesperrow);
+  }
+}
+///
 
 /// Mapping::ToGamma
 // Convert to int using a gamma mapping.
 template<typename S,typename T>
 void Mapping::ToGamma(const S *org ,ULONG obytesperpixel,ULONG obytesperrow,
 		      T *dst       ,ULONG dbytesperpixel,ULONG dbytesperrow,
-		      ULONG w, ULONG h, double scale, double limF, double gamma)
+		      ULONG w, ULONG h, double scale, double limF, double gamma,
+		      const struct FloatBucket *buckets)
 {
   ULONG x,y;
   double invgamma = 1.0 / gamma;
@@ -50,17 +101,22 @@ void Mapping::ToGamma(const S *org ,ULONG obytesperpixel,ULONG obytesperrow,
     const S *orgrow = org;
     T *dstrow       = dst;
     for(x = 0;x < w;x++) {
-      double v    = *orgrow;
-      if (v < 0.0 || isnan(v)) {
-	v = 0.0;
-      } else if (isinf(v)) {
-	v = scale;
+      ULONG code;
+      if (buckets && CodeOf(buckets,orgrow,code)) {
+	*dstrow = T(code);
       } else {
-	v = scale * pow(v / limF,invgamma);
-	if (v > scale)
+	double v    = *orgrow;
+	if (v < 0.0 || isnan(v)) {
+	  v = 0.0;
+	} else if (isinf(v)) {
 	  v = scale;
+	} else {
+	  v = scale * pow(v / limF,invgamma);
+	  if (v > scale)
+	    v = scale;
+	}
+	*dstrow = T(v + 0.5);
       }
-      *dstrow = T(v + 0.5);
       orgrow  = (const S *)((const UBYTE *)(orgrow) + obytesperpixel);
       dstrow  = (T *)((UBYTE *)(dstrow) + dbytesperpixel);
     }
@@ -210,6 +266,24 @@ void Mapping::ToHalfLog(const FLOAT *org ,ULONG obytesperpixel,ULONG obytesperro
       } else if (v == 0.0) {
 	exponent = 0;
 	mantissa = 0;
+      } else if (!m_bExactTransfer && !isnan(v)) {
+	// Truncate the mantissa of the sample directly, which gives the
+	// same result as the computation below.
+	ULONG bits;
+	memcpy(&bits,orgrow,sizeof(bits));
+	exponent = int((bits >> 23) & 0xff) - 127 + 15;
+	if (exponent >= 31) {
+	  exponent = 31;
+	  mantissa = 0;
+	} else if (exponent <= -11) {
+	  exponent = 0;
+	  mantissa = 0;
+	} else if (exponent <= 0) {
+	  mantissa = ((bits & 0x7fffffUL) | 0x800000UL) >> (14 - exponent);
+	  exponent = 0;
+	} else {
+	  mantissa = (bits & 0x7fffffUL) >> 13;
+	}
       } else {
 	double man = 2.0 * frexp(v,&exponent); // must be between 1.0 and 2.0, not 0.5 and 1.
 	// Add the exponent bias.
@@ -398,7 +472,7 @@ void Mapping::FromPQ(const T *org ,ULONG obytesperpixel,ULONG obytesperrow,
 template<typename T>
 void Mapping::ToPQ(const FLOAT *org ,ULONG obytesperpixel,ULONG obytesperrow,
 		   T *dst           ,ULONG dbytesperpixel,ULONG dbytesperrow,
-		   ULONG w, ULONG h, double scale)
+		   ULONG w, ULONG h, double scale, const struct FloatBucket *buckets)
 {
   ULONG x,y;
   const double m1 = 2610.0 / 4096.0 * 0.25;
@@ -412,11 +486,16 @@ void Mapping::ToPQ(const FLOAT *org ,ULONG obytesperpixel,ULONG obytesperrow,
     const FLOAT *orgrow = org;
     T *dstrow           = dst;
     for(x = 0;x < w;x++) {
-      double l = (*orgrow >= 0.0)?(*orgrow / lmax):(0.0); // luminance (hopefully in nits)
-      double n = pow((c2*pow(l,m1) + c1)/(c3*pow(l,m1) + 1.0),m2);
-      if (n > 1.0)
-	n = 1.0;
-      *dstrow  = T(n * scale);
+      ULONG code;
+      if (buckets && CodeOf(buckets,orgrow,code)) {
+	*dstrow  = T(code);
+      } else {
+	double l = (*orgrow >= 0.0)?(*orgrow / lmax):(0.0); // luminance (hopefully in nits)
+	double n = pow((c2*pow(l,m1) + c1)/(c3*pow(l,m1) + 1.0),m2);
+	if (n > 1.0)
+	  n = 1.0;
+	*dstrow  = T(n * scale);
+      }
       orgrow  = (const FLOAT *)((const UBYTE *)(orgrow) + obytesperpixel);
       dstrow  = (T *)((UBYTE *)(dstrow) + dbytesperpixel);
     }
@@ -461,7 +540,7 @@ void Mapping::FromHLG(const T *org ,ULONG obytesperpixel,ULONG obytesperrow,
 template<typename T>
 void Mapping::ToHLG(const FLOAT *org ,ULONG obytesperpixel,ULONG obytesperrow,
 		    T *dst           ,ULONG dbytesperpixel,ULONG dbytesperrow,
-		    ULONG w, ULONG h, double scale)
+		    ULONG w, ULONG h, double scale, const struct FloatBucket *buckets)
 {
   ULONG x,y;
   const double a = 0.17883277, b = 0.28466892, c = 0.55991073;
@@ -473,16 +552,21 @@ void Mapping::ToHLG(const FLOAT *org ,ULONG obytesperpixel,ULONG obytesperrow,
     const FLOAT *orgrow = org;
     T *dstrow           = dst;
     for(x = 0;x < w;x++) {
-      double l = (*orgrow >= 0.0)?(*orgrow / lmax):(0.0); // luminance (hopefully in nits)
-      double n;
-      if (l < t) {
-	n = r * sqrt(l);
+      ULONG code;
+      if (buckets && CodeOf(buckets,orgrow,code)) {
+	*dstrow  = T(code);
       } else {
-	n = a * log(12.0 * l - b) + c;
+	double l = (*orgrow >= 0.0)?(*orgrow / lmax):(0.0); // luminance (hopefully in nits)
+	double n;
+	if (l < t) {
+	  n = r * sqrt(l);
+	} else {
+	  n = a * log(12.0 * l - b) + c;
+	}
+	if (n > 1.0)
+	  n = 1.0;
+	*dstrow  = T(n * scale);
       }
-      if (n > 1.0)
-	n = 1.0;
-      *dstrow  = T(n * scale);
       orgrow  = (const FLOAT *)((const UBYTE *)(orgrow) + obytesperpixel);
       dstrow  = (T *)((UBYTE *)(dstrow) + dbytesperpixel);
     }
@@ -506,6 +590,8 @@ Mapping::~Mapping(void)
 
   delete m_pDest;
   delete[] m_PU_Lut;
+  delete[] m_pucTable;
+  delete[] m_pBuckets;
 }
 ///
 
@@ -693,6 +779,458 @@ double Mapping::ComputeLimF(const FLOAT *r,ULONG rbytesperpixel,ULONG rbytesperr
 }
 ///
 
+/// Mapping::ConvertSamples
+// Convert the samples of the given component of the source from org to
+// trg, where lim is the limit of the gamma mapping.
+void Mapping::ConvertSamples(class ImageLayout *src,UWORD comp,
+			     const UBYTE *org,ULONG obytesperpixel,ULONG obytesperrow,
+			     UBYTE *trg,ULONG dbytesperpixel,ULONG dbytesperrow,
+			     ULONG w,ULONG h,double lim,const struct FloatBucket *buckets)
+{
+  switch(m_Type) {
+  case GammaToe:
+    if (m_bInverse) {
+      if (src->BitsOf(comp) <= 8) {
+	InvToeGamma<UBYTE,UBYTE>((const UBYTE *)org,obytesperpixel,obytesperrow,
+				 (UBYTE *)trg,dbytesperpixel,dbytesperrow,
+				 w,h,1.0 + m_dToeOffset,m_dToeOffset,m_dToeSlope,m_dToeThreshold,m_dGamma,0.0,(1UL << src->BitsOf(comp)) - 1);
+      } else if (src->BitsOf(comp) <= 8) {
+	InvToeGamma<UWORD,UWORD>((const UWORD *)org,obytesperpixel,obytesperrow,
+				 (UWORD *)trg,dbytesperpixel,dbytesperrow,
+				 w,h,1.0 + m_dToeOffset,m_dToeOffset,m_dToeSlope,m_dToeThreshold,m_dGamma,0.0,(1UL << src->BitsOf(comp)) - 1);
+      } else if (src->BitsOf(comp) <= 16) {
+	InvToeGamma<ULONG,ULONG>((const ULONG *)org,obytesperpixel,obytesperrow,
+				 (ULONG *)trg,dbytesperpixel,dbytesperrow,
+				 w,h,1.0 + m_dToeOffset,m_dToeOffset,m_dToeSlope,m_dToeThreshold,m_dGamma,0.0,(1UL << src->BitsOf(comp)) - 1);
+      } else throw "unsupported source bit depth, must be between 1 and 32 bits per pixel";
+    } else {
+      if (src->BitsOf(comp) <= 8) {
+	ToToeGamma<UBYTE,UBYTE>((const UBYTE *)org,obytesperpixel,obytesperrow,
+				 (UBYTE *)trg,dbytesperpixel,dbytesperrow,
+				 w,h,1.0 + m_dToeOffset,m_dToeOffset,m_dToeSlope,m_dToeThreshold,m_dGamma,0.0,(1UL << src->BitsOf(comp)) - 1);
+      } else if (src->BitsOf(comp) <= 8) {
+	ToToeGamma<UWORD,UWORD>((const UWORD *)org,obytesperpixel,obytesperrow,
+				 (UWORD *)trg,dbytesperpixel,dbytesperrow,
+				 w,h,1.0 + m_dToeOffset,m_dToeOffset,m_dToeSlope,m_dToeThreshold,m_dGamma,0.0,(1UL << src->BitsOf(comp)) - 1);
+      } else if (src->BitsOf(comp) <= 16) {
+	ToToeGamma<ULONG,ULONG>((const ULONG *)org,obytesperpixel,obytesperrow,
+				(ULONG *)trg,dbytesperpixel,dbytesperrow,
+				w,h,1.0 + m_dToeOffset,m_dToeOffset,m_dToeSlope,m_dToeThreshold,m_dGamma,0.0,(1UL << src->BitsOf(comp)) - 1);
+      } else throw "unsupported source bit depth, must be between 1 and 32 bits per pixel";
+    }
+    break;
+  case Gamma:
+    if (m_bInverse) {
+      if (src->isFloat(comp)) {
+	if (src->BitsOf(comp) <= 32) {
+	  InvGamma<FLOAT,FLOAT>((const FLOAT *)org,obytesperpixel,obytesperrow,
+				(FLOAT *)trg,dbytesperpixel,dbytesperrow,
+				w,h,1.0,1.0,m_dGamma);
+	} else throw "unsupported source bit depth, must be 16 or 32 bits per pixel";
+      } else {
+	if (src->BitsOf(comp) <= 8) {
+	  InvGamma<UBYTE,FLOAT>((const UBYTE *)org,obytesperpixel,obytesperrow,
+				(FLOAT *)trg,dbytesperpixel,dbytesperrow,
+				w,h,(1UL << src->BitsOf(comp)) - 1,1.0,m_dGamma);
+	} else if (src->BitsOf(comp) <= 16) {
+	  InvGamma<UWORD,FLOAT>((const UWORD *)org,obytesperpixel,obytesperrow,
+				(FLOAT *)trg,dbytesperpixel,dbytesperrow,
+				w,h,(1UL << src->BitsOf(comp)) - 1,1.0,m_dGamma);
+	} else if (src->BitsOf(comp) <= 32) {
+	  InvGamma<ULONG,FLOAT>((const ULONG *)org,obytesperpixel,obytesperrow,
+				(FLOAT *)trg,dbytesperpixel,dbytesperrow,
+				w,h,(1UL << src->BitsOf(comp)) - 1,1.0,m_dGamma);
+	} else throw "unsupported source bit depth, must be between 1 and 32 bits per pixel";
+      }
+    } else {
+      if (src->isFloat(comp)) {
+	if (m_ucTargetDepth <= 8) {
+	  ToGamma<FLOAT,UBYTE>((const FLOAT *)org,obytesperpixel,obytesperrow,
+			       (UBYTE *)trg,dbytesperpixel,dbytesperrow,
+			       w,h,(1UL << m_ucTargetDepth) - 1,lim,m_dGamma,buckets);
+	} else if (m_ucTargetDepth <= 16) {
+	  ToGamma<FLOAT,UWORD>((const FLOAT *)org,obytesperpixel,obytesperrow,
+			       (UWORD *)trg,dbytesperpixel,dbytesperrow,
+			       w,h,(1UL << m_ucTargetDepth) - 1,lim,m_dGamma,buckets);
+	} else if (m_ucTargetDepth <= 32) {	  
+	  ToGamma<FLOAT,ULONG>((const FLOAT *)org,obytesperpixel,obytesperrow,
+			       (ULONG *)trg,dbytesperpixel,dbytesperrow,
+			       w,h,(1UL << m_ucTargetDepth) - 1,lim,m_dGamma,buckets);
+	} else throw "unsupported target bit depth, must be between 1 and 32 bits per pixel";
+      } else if (src->BitsOf(comp) <= 8) {
+	if (m_ucTargetDepth <= 8) {
+	  ToGamma<UBYTE,UBYTE>((const UBYTE *)org,obytesperpixel,obytesperrow,
+			       (UBYTE *)trg,dbytesperpixel,dbytesperrow,
+			       w,h,(1UL << m_ucTargetDepth) - 1,lim,m_dGamma,buckets);
+	} else if (m_ucTargetDepth <= 16) {
+	  ToGamma<UBYTE,UWORD>((const UBYTE *)org,obytesperpixel,obytesperrow,
+			       (UWORD *)trg,dbytesperpixel,dbytesperrow,
+			       w,h,(1UL << m_ucTargetDepth) - 1,lim,m_dGamma,buckets);
+	} else if (m_ucTargetDepth <= 32) {	  
+	  ToGamma<UBYTE,ULONG>((const UBYTE *)org,obytesperpixel,obytesperrow,
+			       (ULONG *)trg,dbytesperpixel,dbytesperrow,
+			       w,h,(1UL << m_ucTargetDepth) - 1,lim,m_dGamma,buckets);
+	} else throw "unsupported target bit depth, must be between 1 and 32 bits per pixel";
+      } else if (src->BitsOf(comp) <= 16) {
+	if (m_ucTargetDepth <= 8) {
+	  ToGamma<UWORD,UBYTE>((const UWORD *)org,obytesperpixel,obytesperrow,
+			       (UBYTE *)trg,dbytesperpixel,dbytesperrow,
+			       w,h,(1UL << m_ucTargetDepth) - 1,lim,m_dGamma,buckets);
+	} else if (m_ucTargetDepth <= 16) {
+	  ToGamma<UWORD,UWORD>((const UWORD *)org,obytesperpixel,obytesperrow,
+			       (UWORD *)trg,dbytesperpixel,dbytesperrow,
+			       w,h,(1UL << m_ucTargetDepth) - 1,lim,m_dGamma,buckets);
+	} else if (m_ucTargetDepth <= 32) {	  
+	  ToGamma<UWORD,ULONG>((const UWORD *)org,obytesperpixel,obytesperrow,
+			       (ULONG *)trg,dbytesperpixel,dbytesperrow,
+			       w,h,(1UL << m_ucTargetDepth) - 1,lim,m_dGamma,buckets);
+	} else throw "unsupported target bit depth, must be between 1 and 32 bits per pixel";
+      } else if (src->BitsOf(comp) <= 32) {
+	if (m_ucTargetDepth <= 8) {
+	  ToGamma<ULONG,UBYTE>((const ULONG *)org,obytesperpixel,obytesperrow,
+			       (UBYTE *)trg,dbytesperpixel,dbytesperrow,
+			       w,h,(1UL << m_ucTargetDepth) - 1,lim,m_dGamma,buckets);
+	} else if (m_ucTargetDepth <= 16) {
+	  ToGamma<ULONG,UWORD>((const ULONG *)org,obytesperpixel,obytesperrow,
+			       (UWORD *)trg,dbytesperpixel,dbytesperrow,
+			       w,h,(1UL << m_ucTargetDepth) - 1,lim,m_dGamma,buckets);
+	} else if (m_ucTargetDepth <= 32) {	  
+	  ToGamma<ULONG,ULONG>((const ULONG *)org,obytesperpixel,obytesperrow,
+			       (ULONG *)trg,dbytesperpixel,dbytesperrow,
+			       w,h,(1UL << m_ucTargetDepth) - 1,lim,m_dGamma,buckets);
+	} else throw "unsupported target bit depth, must be between 1 and 32 bits per pixel";
+      }
+    }
+    break;
+  case HalfLog:
+    if (m_bInverse) {
+      if (src->BitsOf(comp) != 16 || src->isSigned(comp))
+	throw "source data must be 16 bit unsigned integer";
+      ToHalfExp((const UWORD *)org,obytesperpixel,obytesperrow,
+		(FLOAT *)trg,dbytesperpixel,dbytesperrow,
+		w,h);
+    } else {
+      if (m_ucTargetDepth != 16)
+	throw "this tool converts data to 16 bit unsigned integer";
+      ToHalfLog((const FLOAT *)org,obytesperpixel,obytesperrow,
+		(UWORD *)trg,dbytesperpixel,dbytesperrow,
+		w,h);
+    }
+    break;
+  case Log:
+    ToLog((const FLOAT *)org,obytesperpixel,obytesperrow,
+	  (FLOAT *)trg,dbytesperpixel,dbytesperrow,
+	  w,h);
+    break;
+  case PU2:
+    ToPU2((const FLOAT *)org,obytesperpixel,obytesperrow,
+	  (FLOAT *)trg,dbytesperpixel,dbytesperrow,
+	  w,h);
+    break;
+  case PQ: // Inverse PQ, i.e. from PQ to luminances.
+    if (m_bInverse) {
+      if (src->BitsOf(comp) <= 8) {
+	FromPQ<UBYTE>((const UBYTE *)org,obytesperpixel,obytesperrow,
+		      (FLOAT *)trg,dbytesperpixel,dbytesperrow,
+		      w,h,(1UL << src->BitsOf(comp)) - 1);
+      } else if (src->BitsOf(comp) <= 16) {
+	FromPQ<UWORD>((const UWORD *)org,obytesperpixel,obytesperrow,
+		      (FLOAT *)trg,dbytesperpixel,dbytesperrow,
+		      w,h,(1UL << src->BitsOf(comp)) - 1);
+      } else if (src->BitsOf(comp) <= 32) {
+	FromPQ<ULONG>((const ULONG *)org,obytesperpixel,obytesperrow,
+		      (FLOAT *)trg,dbytesperpixel,dbytesperrow,
+		      w,h,(1UL << src->BitsOf(comp)) - 1);
+      }
+    } else {
+      if (m_ucTargetDepth <= 8) {
+	ToPQ<UBYTE>((const FLOAT *)org,obytesperpixel,obytesperrow,
+		    (UBYTE *)trg,dbytesperpixel,dbytesperrow,
+		    w,h,(1UL << m_ucTargetDepth) - 1,buckets);
+      } else if (m_ucTargetDepth <= 16) {
+	ToPQ<UWORD>((const FLOAT *)org,obytesperpixel,obytesperrow,
+		     (UWORD *)trg,dbytesperpixel,dbytesperrow,
+		    w,h,(1UL << m_ucTargetDepth) - 1,buckets);
+      } else if (m_ucTargetDepth <= 32) {
+	ToPQ<ULONG>((const FLOAT *)org,obytesperpixel,obytesperrow,
+		    (ULONG *)trg,dbytesperpixel,dbytesperrow,
+		    w,h,(1UL << m_ucTargetDepth) - 1,buckets);
+      }
+    }
+    break;
+  case HLG: // Inverse HLG, i.e. from HLG to luminances.
+    if (m_bInverse) {
+      if (src->BitsOf(comp) <= 8) {
+	FromHLG<UBYTE>((const UBYTE *)org,obytesperpixel,obytesperrow,
+		       (FLOAT *)trg,dbytesperpixel,dbytesperrow,
+		       w,h,(1UL << src->BitsOf(comp)) - 1);
+      } else if (src->BitsOf(comp) <= 16) {
+	FromHLG<UWORD>((const UWORD *)org,obytesperpixel,obytesperrow,
+		       (FLOAT *)trg,dbytesperpixel,dbytesperrow,
+		       w,h,(1UL << src->BitsOf(comp)) - 1);
+      } else if (src->BitsOf(comp) <= 32) {
+	FromHLG<ULONG>((const ULONG *)org,obytesperpixel,obytesperrow,
+		       (FLOAT *)trg,dbytesperpixel,dbytesperrow,
+		       w,h,(1UL << src->BitsOf(comp)) - 1);
+      }
+    } else {
+      if (m_ucTargetDepth <= 8) {
+	ToHLG<UBYTE>((const FLOAT *)org,obytesperpixel,obytesperrow,
+		     (UBYTE *)trg,dbytesperpixel,dbytesperrow,
+		     w,h,(1UL << m_ucTargetDepth) - 1,buckets);
+      } else if (m_ucTargetDepth <= 16) {
+	 ToHLG<UWORD>((const FLOAT *)org,obytesperpixel,obytesperrow,
+		      (UWORD *)trg,dbytesperpixel,dbytesperrow,
+		      w,h,(1UL << m_ucTargetDepth) - 1,buckets);
+      } else if (m_ucTargetDepth <= 32) {
+	ToHLG<ULONG>((const FLOAT *)org,obytesperpixel,obytesperrow,
+		     (ULONG *)trg,dbytesperpixel,dbytesperrow,
+		     w,h,(1UL << m_ucTargetDepth) - 1,buckets);
+      }
+    }
+    break;
+  default:
+    throw "unsupported conversion requested";
+    break;
+  }
+}
+///
+
+/// Mapping::TableSizeOf
+// Return the number of entries of the table that can replace the
+// conversion of the given component, or zero if there is none.
+ULONG Mapping::TableSizeOf(class ImageLayout *src,UWORD comp) const
+{
+  if (m_bExactTransfer)
+    return 0;
+  //
+  // Tables are only possible for integer samples, and the conversions
+  // validate their input before.
+  if (src->isFloat(comp) || src->isSigned(comp))
+    return 0;
+  //
+  if (src->BitsOf(comp) <= 8)
+    return 1UL << 8;
+  //
+  // The toe region conversion reads 32 bit samples above eight bits.
+  if (src->BitsOf(comp) <= 16 && m_Type != GammaToe)
+    return 1UL << 16;
+  //
+  return 0;
+}
+///
+
+/// Mapping::CreateTable
+// Create the table for the given component by converting all values
+// a sample can take.
+void Mapping::CreateTable(class ImageLayout *src,class ImageLayout *dst,UWORD comp,ULONG entries,double lim)
+{
+  ULONG tbytes = dst->BytesPerPixel(comp);
+  ULONG sbytes = (src->BitsOf(comp) <= 8)?(sizeof(UBYTE)):(sizeof(UWORD));
+  UBYTE *ramp;
+  ULONG i;
+
+  delete[] m_pucTable;
+  m_pucTable    = NULL;
+  m_pucTable    = new UBYTE[entries * (tbytes + sbytes)];
+  m_ucTableBits = src->BitsOf(comp);
+  //
+  // The sample values follow the table.
+  ramp          = m_pucTable + entries * tbytes;
+  for(i = 0;i < entries;i++) {
+    if (sbytes == sizeof(UBYTE)) {
+      ramp[i] = UBYTE(i);
+    } else {
+      ((UWORD *)ramp)[i] = UWORD(i);
+    }
+  }
+  //
+  ConvertSamples(src,comp,ramp,sbytes,entries * sbytes,
+		 m_pucTable,tbytes,entries * tbytes,
+		 entries,1,lim,NULL);
+}
+///
+
+/// Mapping::ApplyTable
+// Convert a component by looking up the samples in the table.
+void Mapping::ApplyTable(class ImageLayout *src,class ImageLayout *dst,UWORD comp)
+{
+  const UBYTE *org = (const UBYTE *)src->DataOf(comp);
+  UBYTE *trg       = (UBYTE *)dst->DataOf(comp);
+  ULONG w          = src->WidthOf(comp);
+  ULONG h          = src->HeightOf(comp);
+  
+  if (src->BitsOf(comp) <= 8) {
+    switch(dst->BytesPerPixel(comp)) {
+    case 1:
+      LookupTable<UBYTE,UBYTE>(org,src->BytesPerPixel(comp),src->BytesPerRow(comp),
+			       trg,dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
+			       w,h,m_pucTable);
+      break;
+    case 2:
+      LookupTable<UBYTE,UWORD>(org,src->BytesPerPixel(comp),src->BytesPerRow(comp),
+			       (UWORD *)trg,dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
+			       w,h,(const UWORD *)m_pucTable);
+      break;
+    case 4: // Floating point targets are copied as bit patterns.
+      LookupTable<UBYTE,ULONG>(org,src->BytesPerPixel(comp),src->BytesPerRow(comp),
+			       (ULONG *)trg,dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
+			       w,h,(const ULONG *)m_pucTable);
+      break;
+    default:
+      throw "unsupported target sample size";
+    }
+  } else {
+    switch(dst->BytesPerPixel(comp)) {
+    case 1:
+      LookupTable<UWORD,UBYTE>((const UWORD *)org,src->BytesPerPixel(comp),src->BytesPerRow(comp),
+			       trg,dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
+			       w,h,m_pucTable);
+      break;
+    case 2:
+      LookupTable<UWORD,UWORD>((const UWORD *)org,src->BytesPerPixel(comp),src->BytesPerRow(comp),
+			       (UWORD *)trg,dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
+			       w,h,(const UWORD *)m_pucTable);
+      break;
+    case 4:
+      LookupTable<UWORD,ULONG>((const UWORD *)org,src->BytesPerPixel(comp),src->BytesPerRow(comp),
+			       (ULONG *)trg,dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
+			       w,h,(const ULONG *)m_pucTable);
+      break;
+    default:
+      throw "unsupported target sample size";
+    }
+  }
+}
+///
+
+/// Mapping::UseBuckets
+// Check whether the conversion of the given component can use the
+// buckets of floating point samples.
+bool Mapping::UseBuckets(class ImageLayout *src,UWORD comp) const
+{
+  if (m_bExactTransfer || m_bInverse || !src->isFloat(comp))
+    return false;
+  //
+  if (m_Type != Gamma && m_Type != PQ && m_Type != HLG)
+    return false;
+  //
+  // With more bits, too few buckets map to at most two codes.
+  if (m_ucTargetDepth > 12)
+    return false;
+  //
+  // Creating the buckets converts about two samples per bucket, which
+  // only pays off for large images.
+  return UQUAD(src->WidthOf(comp)) * src->HeightOf(comp) >= BucketCount;
+}
+///
+
+/// Mapping::CreateBuckets
+// Create the buckets of floating point samples for the given component
+// by converting the first and last sample of each bucket. As the
+// conversions are monotonic, a bucket whose samples map to two adjacent
+// codes is split at the first sample of the upper code, which is found
+// by bisection.
+void Mapping::CreateBuckets(class ImageLayout *src,class ImageLayout *dst,UWORD comp,double lim)
+{
+  struct FloatBucket *buckets = NULL;
+  FLOAT *samples = NULL;
+  UBYTE *codes   = NULL;
+  ULONG *lo      = NULL;
+  ULONG *hi      = NULL;
+  ULONG *pending = NULL;
+  ULONG dbytes   = dst->BytesPerPixel(comp);
+  ULONG i,count;
+
+  assert(dbytes == 1 || dbytes == 2);
+
+  try {
+    buckets = new struct FloatBucket[BucketCount];
+    samples = new FLOAT[2 * BucketCount];
+    codes   = new UBYTE[2 * BucketCount * dbytes];
+    lo      = new ULONG[BucketCount];
+    hi      = new ULONG[BucketCount];
+    pending = new ULONG[BucketCount];
+    //
+    // Convert the first and the last sample of all buckets at once.
+    for(i = 0;i < BucketCount;i++) {
+      lo[i] = i << BucketShift;
+      hi[i] = ((i + 1) << BucketShift) - 1;
+      memcpy(samples + i,lo + i,sizeof(FLOAT));
+      memcpy(samples + i + BucketCount,hi + i,sizeof(FLOAT));
+    }
+    ConvertSamples(src,comp,(const UBYTE *)samples,sizeof(FLOAT),2 * BucketCount * sizeof(FLOAT),
+		   codes,dbytes,2 * BucketCount * dbytes,2 * BucketCount,1,lim,NULL);
+    //
+    count = 0;
+    for(i = 0;i < BucketCount;i++) {
+      ULONG c0 = (dbytes == 1)?(codes[i]):(((UWORD *)codes)[i]);
+      ULONG c1 = (dbytes == 1)?(codes[i + BucketCount]):(((UWORD *)codes)[i + BucketCount]);
+      if (c1 == c0) {
+	buckets[i].m_lCode       = c0;
+	buckets[i].m_ulThreshold = MAX_ULONG;
+      } else if (c1 == c0 + 1) {
+	buckets[i].m_lCode       = c0;
+	pending[count++]            = i;
+      } else {
+	buckets[i].m_lCode       = -1;
+      }
+    }
+    //
+    // Bisect the open buckets, all at once, until the first sample of
+    // the upper code is found. A code other than the two the bucket
+    // maps to means that the conversion is not monotonic here.
+    while(count) {
+      ULONG n;
+      for(n = 0;n < count;n++) {
+	ULONG b   = pending[n];
+	ULONG mid = lo[b] + ((hi[b] - lo[b]) >> 1);
+	memcpy(samples + n,&mid,sizeof(FLOAT));
+      }
+      ConvertSamples(src,comp,(const UBYTE *)samples,sizeof(FLOAT),count * sizeof(FLOAT),
+		     codes,dbytes,count * dbytes,count,1,lim,NULL);
+      //
+      for(i = 0,n = 0;n < count;n++) {
+	ULONG b   = pending[n];
+	ULONG mid = lo[b] + ((hi[b] - lo[b]) >> 1);
+	ULONG c   = (dbytes == 1)?(codes[n]):(((UWORD *)codes)[n]);
+	if (c == ULONG(buckets[b].m_lCode)) {
+	  lo[b] = mid;
+	} else if (c == ULONG(buckets[b].m_lCode) + 1) {
+	  hi[b] = mid;
+	} else {
+	  buckets[b].m_lCode = -1;
+	  continue;
+	}
+	if (hi[b] - lo[b] > 1) {
+	  pending[i++] = b;
+	} else {
+	  buckets[b].m_ulThreshold = hi[b];
+	}
+      }
+      count = i;
+    }
+  } catch(...) {
+    delete[] buckets;
+    delete[] samples;
+    delete[] codes;
+    delete[] lo;
+    delete[] hi;
+    delete[] pending;
+    throw;
+  }
+  
+  delete[] samples;
+  delete[] codes;
+  delete[] lo;
+  delete[] hi;
+  delete[] pending;
+  
+  delete[] m_pBuckets;
+  m_pBuckets = buckets;
+}
+///
+
 /// Mapping::ApplyMap
 // Apply a map from the source image to the target image that must be
 // already initialized.
@@ -703,6 +1241,7 @@ void Mapping::ApplyMap(class ImageLayout *src,class ImageLayout *dst)
   double gam,ts = 1.0;
   double offset = 0.0;
   double thres  = 0.0;
+  ULONG entries;
   //
   // Need to compute the 95% percentile?
   if (m_Type == Gamma && m_bInverse == false) {
@@ -730,6 +1269,12 @@ void Mapping::ApplyMap(class ImageLayout *src,class ImageLayout *dst)
     }
   }
   //
+  // The buckets of a gamma map depend on the limit found above.
+  if (m_Type == Gamma) {
+    delete[] m_pBuckets;
+    m_pBuckets = NULL;
+  }
+  //
   assert(src->DepthOf() == dst->DepthOf());
   //
   if (m_Type == PU2)
@@ -762,6 +1307,8 @@ void Mapping::ApplyMap(class ImageLayout *src,class ImageLayout *dst)
       }
       offset = thres * (m_dGamma - 1.0);
     } else throw "invalid toe slope value specified";
+    m_dToeOffset    = offset;
+    m_dToeThreshold = thres;
   }
   // 
   //
@@ -811,212 +1358,22 @@ void Mapping::ApplyMap(class ImageLayout *src,class ImageLayout *dst)
       }
     } 
     //
-    //
-    switch(m_Type) {
-    case GammaToe:
-      if (m_bInverse) {
-	if (src->BitsOf(comp) <= 8) {
-	  InvToeGamma<UBYTE,UBYTE>((const UBYTE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				   (UBYTE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				   w,h,1.0 + offset,offset,ts,thres,m_dGamma,0.0,(1UL << src->BitsOf(comp)) - 1);
-	} else if (src->BitsOf(comp) <= 8) {
-	  InvToeGamma<UWORD,UWORD>((const UWORD *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				   (UWORD *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				   w,h,1.0 + offset,offset,ts,thres,m_dGamma,0.0,(1UL << src->BitsOf(comp)) - 1);
-	} else if (src->BitsOf(comp) <= 16) {
-	  InvToeGamma<ULONG,ULONG>((const ULONG *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				   (ULONG *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				   w,h,1.0 + offset,offset,ts,thres,m_dGamma,0.0,(1UL << src->BitsOf(comp)) - 1);
-	} else throw "unsupported source bit depth, must be between 1 and 32 bits per pixel";
-      } else {
-	if (src->BitsOf(comp) <= 8) {
-	  ToToeGamma<UBYTE,UBYTE>((const UBYTE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				   (UBYTE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				   w,h,1.0 + offset,offset,ts,thres,m_dGamma,0.0,(1UL << src->BitsOf(comp)) - 1);
-	} else if (src->BitsOf(comp) <= 8) {
-	  ToToeGamma<UWORD,UWORD>((const UWORD *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				   (UWORD *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				   w,h,1.0 + offset,offset,ts,thres,m_dGamma,0.0,(1UL << src->BitsOf(comp)) - 1);
-	} else if (src->BitsOf(comp) <= 16) {
-	  ToToeGamma<ULONG,ULONG>((const ULONG *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				  (ULONG *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				  w,h,1.0 + offset,offset,ts,thres,m_dGamma,0.0,(1UL << src->BitsOf(comp)) - 1);
-	} else throw "unsupported source bit depth, must be between 1 and 32 bits per pixel";
-      }
-      break;
-    case Gamma:
-      if (m_bInverse) {
-	if (src->isFloat(comp)) {
-	  if (src->BitsOf(comp) <= 32) {
-	    InvGamma<FLOAT,FLOAT>((const FLOAT *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				  (FLOAT *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				  w,h,1.0,1.0,m_dGamma);
-	  } else throw "unsupported source bit depth, must be 16 or 32 bits per pixel";
-	} else {
-	  if (src->BitsOf(comp) <= 8) {
-	    InvGamma<UBYTE,FLOAT>((const UBYTE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				  (FLOAT *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				  w,h,(1UL << src->BitsOf(comp)) - 1,1.0,m_dGamma);
-	  } else if (src->BitsOf(comp) <= 16) {
-	    InvGamma<UWORD,FLOAT>((const UWORD *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				  (FLOAT *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				  w,h,(1UL << src->BitsOf(comp)) - 1,1.0,m_dGamma);
-	  } else if (src->BitsOf(comp) <= 32) {
-	    InvGamma<ULONG,FLOAT>((const ULONG *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				  (FLOAT *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				  w,h,(1UL << src->BitsOf(comp)) - 1,1.0,m_dGamma);
-	  } else throw "unsupported source bit depth, must be between 1 and 32 bits per pixel";
-	}
-      } else {
-	if (src->isFloat(comp)) {
-	  if (m_ucTargetDepth <= 8) {
-	    ToGamma<FLOAT,UBYTE>((const FLOAT *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				 (UBYTE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				 w,h,(1UL << m_ucTargetDepth) - 1,lim,m_dGamma);
-	  } else if (m_ucTargetDepth <= 16) {
-	    ToGamma<FLOAT,UWORD>((const FLOAT *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				 (UWORD *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				 w,h,(1UL << m_ucTargetDepth) - 1,lim,m_dGamma);
-	  } else if (m_ucTargetDepth <= 32) {	  
-	    ToGamma<FLOAT,ULONG>((const FLOAT *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				 (ULONG *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				 w,h,(1UL << m_ucTargetDepth) - 1,lim,m_dGamma);
-	  } else throw "unsupported target bit depth, must be between 1 and 32 bits per pixel";
-	} else if (src->BitsOf(comp) <= 8) {
-	  if (m_ucTargetDepth <= 8) {
-	    ToGamma<UBYTE,UBYTE>((const UBYTE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				 (UBYTE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				 w,h,(1UL << m_ucTargetDepth) - 1,lim,m_dGamma);
-	  } else if (m_ucTargetDepth <= 16) {
-	    ToGamma<UBYTE,UWORD>((const UBYTE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				 (UWORD *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				 w,h,(1UL << m_ucTargetDepth) - 1,lim,m_dGamma);
-	  } else if (m_ucTargetDepth <= 32) {	  
-	    ToGamma<UBYTE,ULONG>((const UBYTE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				 (ULONG *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				 w,h,(1UL << m_ucTargetDepth) - 1,lim,m_dGamma);
-	  } else throw "unsupported target bit depth, must be between 1 and 32 bits per pixel";
-	} else if (src->BitsOf(comp) <= 16) {
-	  if (m_ucTargetDepth <= 8) {
-	    ToGamma<UWORD,UBYTE>((const UWORD *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				 (UBYTE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				 w,h,(1UL << m_ucTargetDepth) - 1,lim,m_dGamma);
-	  } else if (m_ucTargetDepth <= 16) {
-	    ToGamma<UWORD,UWORD>((const UWORD *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				 (UWORD *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				 w,h,(1UL << m_ucTargetDepth) - 1,lim,m_dGamma);
-	  } else if (m_ucTargetDepth <= 32) {	  
-	    ToGamma<UWORD,ULONG>((const UWORD *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				 (ULONG *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				 w,h,(1UL << m_ucTargetDepth) - 1,lim,m_dGamma);
-	  } else throw "unsupported target bit depth, must be between 1 and 32 bits per pixel";
-	} else if (src->BitsOf(comp) <= 32) {
-	  if (m_ucTargetDepth <= 8) {
-	    ToGamma<ULONG,UBYTE>((const ULONG *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				 (UBYTE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				 w,h,(1UL << m_ucTargetDepth) - 1,lim,m_dGamma);
-	  } else if (m_ucTargetDepth <= 16) {
-	    ToGamma<ULONG,UWORD>((const ULONG *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				 (UWORD *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				 w,h,(1UL << m_ucTargetDepth) - 1,lim,m_dGamma);
-	  } else if (m_ucTargetDepth <= 32) {	  
-	    ToGamma<ULONG,ULONG>((const ULONG *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				 (ULONG *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				 w,h,(1UL << m_ucTargetDepth) - 1,lim,m_dGamma);
-	  } else throw "unsupported target bit depth, must be between 1 and 32 bits per pixel";
-	}
-      }
-      break;
-    case HalfLog:
-      if (m_bInverse) {
-	if (src->BitsOf(comp) != 16 || src->isSigned(comp))
-	  throw "source data must be 16 bit unsigned integer";
-	ToHalfExp((const UWORD *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-		  (FLOAT *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-		  w,h);
-      } else {
-	if (m_ucTargetDepth != 16)
-	  throw "this tool converts data to 16 bit unsigned integer";
-	ToHalfLog((const FLOAT *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-		  (UWORD *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-		  w,h);
-      }
-      break;
-    case Log:
-      ToLog((const FLOAT *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-	    (FLOAT *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-	    w,h);
-      break;
-    case PU2:
-      ToPU2((const FLOAT *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-	    (FLOAT *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-	    w,h);
-      break;
-    case PQ: // Inverse PQ, i.e. from PQ to luminances.
-      if (m_bInverse) {
-	if (src->BitsOf(comp) <= 8) {
-	  FromPQ<UBYTE>((const UBYTE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			(FLOAT *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			w,h,(1UL << src->BitsOf(comp)) - 1);
-	} else if (src->BitsOf(comp) <= 16) {
-	  FromPQ<UWORD>((const UWORD *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			(FLOAT *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			w,h,(1UL << src->BitsOf(comp)) - 1);
-	} else if (src->BitsOf(comp) <= 32) {
-	  FromPQ<ULONG>((const ULONG *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			(FLOAT *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			w,h,(1UL << src->BitsOf(comp)) - 1);
-	}
-      } else {
-	if (m_ucTargetDepth <= 8) {
-	  ToPQ<UBYTE>((const FLOAT *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-		      (UBYTE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-		      w,h,(1UL << m_ucTargetDepth) - 1);
-	} else if (m_ucTargetDepth <= 16) {
-	  ToPQ<UWORD>((const FLOAT *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-		       (UWORD *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-		      w,h,(1UL << m_ucTargetDepth) - 1);
-	} else if (m_ucTargetDepth <= 32) {
-	  ToPQ<ULONG>((const FLOAT *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-		      (ULONG *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-		      w,h,(1UL << m_ucTargetDepth) - 1);
-	}
-      }
-      break;
-    case HLG: // Inverse HLG, i.e. from HLG to luminances.
-      if (m_bInverse) {
-	if (src->BitsOf(comp) <= 8) {
-	  FromHLG<UBYTE>((const UBYTE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			 (FLOAT *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			 w,h,(1UL << src->BitsOf(comp)) - 1);
-	} else if (src->BitsOf(comp) <= 16) {
-	  FromHLG<UWORD>((const UWORD *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			 (FLOAT *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			 w,h,(1UL << src->BitsOf(comp)) - 1);
-	} else if (src->BitsOf(comp) <= 32) {
-	  FromHLG<ULONG>((const ULONG *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			 (FLOAT *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			 w,h,(1UL << src->BitsOf(comp)) - 1);
-	}
-      } else {
-	if (m_ucTargetDepth <= 8) {
-	  ToHLG<UBYTE>((const FLOAT *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-		       (UBYTE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-		       w,h,(1UL << m_ucTargetDepth) - 1);
-	} else if (m_ucTargetDepth <= 16) {
-	   ToHLG<UWORD>((const FLOAT *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			(UWORD *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			w,h,(1UL << m_ucTargetDepth) - 1);
-	} else if (m_ucTargetDepth <= 32) {
-	  ToHLG<ULONG>((const FLOAT *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-		       (ULONG *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-		       w,h,(1UL << m_ucTargetDepth) - 1);
-	}
-      }
-      break;
-    default:
-      throw "unsupported conversion requested";
-      break;
+    // Integer samples are looked up in a table of all sample values if
+    // the component is large enough to amortize it, floating point
+    // samples in their buckets.
+    entries = TableSizeOf(src,comp);
+    if (entries && UQUAD(w) * h >= entries) {
+      if (m_pucTable == NULL || m_ucTableBits != src->BitsOf(comp))
+	CreateTable(src,dst,comp,entries,lim);
+      ApplyTable(src,dst,comp);
+    } else {
+      bool buckets = UseBuckets(src,comp);
+      if (buckets && m_pBuckets == NULL)
+	CreateBuckets(src,dst,comp,lim);
+      ConvertSamples(src,comp,
+		     (const UBYTE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
+		     (UBYTE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
+		     w,h,lim,buckets?m_pBuckets:NULL);
     }
   }
 }
@@ -57,6 +57,22 @@ public:
   };
   //
 private:
+  // Floating point samples are grouped into buckets of samples that agree
+  // in the sign, the exponent and the leading mantissa bits. The buckets
+  // cover all finite non-negative samples.
+  enum {
+    BucketShift = 13,                     // mantissa bits not used to select the bucket
+    BucketCount = 0x7f800000UL >> BucketShift
+  };
+  //
+  // The code all samples of a bucket convert to, or the code of its first
+  // sample and the first sample that converts to the next code. Samples
+  // are compared as bit patterns.
+  struct FloatBucket {
+    ULONG m_ulThreshold; // MAX_ULONG if there is only one code
+    LONG  m_lCode;       // negative if samples have to be converted one by one
+  };
+  //
   // The file name under which the difference image shall be saved.
   const char    *m_pTargetFile;
   //
@@ -69,6 +85,16 @@ private:
   // The lookup table for the perceptual uniform map.
   double        *m_PU_Lut;
   //
+  // The table of the conversion of integer samples, indexed by the sample
+  // value, followed by the sample values it was created from.
+  UBYTE         *m_pucTable;
+  //
+  // The bit depth of the source the table was created for.
+  UBYTE          m_ucTableBits;
+  //
+  // The buckets for the conversion of floating point samples to integers.
+  struct FloatBucket *m_pBuckets;
+  //
   // The mapping type to use.
   MappingType    m_Type;
   //
@@ -78,6 +104,10 @@ private:
   // For the toe-region input: The slope of the toe region.
   double         m_dToeSlope;
   //
+  // The offset and the threshold of the toe region.
+  double         m_dToeOffset;
+  double         m_dToeThreshold;
+  //
   // The desired output bitdepth. Only if ToInt is given,
   // zero if no scaling is considered.
   UBYTE          m_ucTargetDepth;
@@ -88,6 +118,9 @@ private:
   // Apply as a filter, do not save an output image.
   bool           m_bFilter;
   //
+  // If set, transfer functions are always computed by the math library.
+  static bool    m_bExactTransfer;
+  //
   // Output specifications of the destination file.
   const struct ImgSpecs &m_TargetSpecs;
   //
@@ -98,7 +131,8 @@ private:
   template<typename S,typename T>
   void ToGamma(const S *org ,ULONG obytesperpixel,ULONG obytesperrow,
 	       T *dst       ,ULONG dbytesperpixel,ULONG dbytesperrow,
-	       ULONG w, ULONG h, double scale, double limF, double gamma);
+	       ULONG w, ULONG h, double scale, double limF, double gamma,
+	       const struct FloatBucket *buckets);
   //
   // apply the inverse map.
   template<typename S,typename T>
@@ -158,7 +192,7 @@ private:
   template<typename T>
   void ToPQ(const FLOAT *org ,ULONG obytesperpixel,ULONG obytesperrow,
 	    T *dst           ,ULONG dbytesperpixel,ULONG dbytesperrow,
-	    ULONG w, ULONG h, double scale);
+	    ULONG w, ULONG h, double scale, const struct FloatBucket *buckets);
   //
   // Apply a mapping from PQ values to luminances, this is the forwards PQ map.
   template<typename T>
@@ -170,7 +204,7 @@ private:
   template<typename T>
   void ToHLG(const FLOAT *org ,ULONG obytesperpixel,ULONG obytesperrow,
 	     T *dst           ,ULONG dbytesperpixel,ULONG dbytesperrow,
-	     ULONG w, ULONG h, double scale);
+	     ULONG w, ULONG h, double scale, const struct FloatBucket *buckets);
   //
   // Apply a mapping from HLG to luminances
   template<typename T>
@@ -178,6 +212,44 @@ private:
 	       FLOAT *dst   ,ULONG dbytesperpixel,ULONG dbytesperrow,
 	       ULONG w, ULONG h, double scale);
   //
+  // Look up the code of a floating point sample in the buckets. Returns
+  // false if the sample has to be converted by computation.
+  static bool CodeOf(const struct FloatBucket *buckets,const void *sample,ULONG &code);
+  //
+  // Convert samples by looking them up in a table indexed by the sample
+  // value.
+  template<typename S,typename T>
+  static void LookupTable(const S *org ,ULONG obytesperpixel,ULONG obytesperrow,
+			  T *dst       ,ULONG dbytesperpixel,ULONG dbytesperrow,
+			  ULONG w, ULONG h, const T *table);
+  //
+  // Convert the samples of the given component of the source from org to
+  // trg, where lim is the limit of the gamma mapping, and buckets the
+  // buckets of floating point samples, if any.
+  void ConvertSamples(class ImageLayout *src,UWORD comp,
+		      const UBYTE *org,ULONG obytesperpixel,ULONG obytesperrow,
+		      UBYTE *trg,ULONG dbytesperpixel,ULONG dbytesperrow,
+		      ULONG w,ULONG h,double lim,const struct FloatBucket *buckets);
+  //
+  // Return the number of entries of the table that can replace the
+  // conversion of the given component, or zero if there is none.
+  ULONG TableSizeOf(class ImageLayout *src,UWORD comp) const;
+  //
+  // Create the table for the given component by converting all values
+  // a sample can take.
+  void CreateTable(class ImageLayout *src,class ImageLayout *dst,UWORD comp,ULONG entries,double lim);
+  //
+  // Convert a component by looking up the samples in the table.
+  void ApplyTable(class ImageLayout *src,class ImageLayout *dst,UWORD comp);
+  //
+  // Check whether the conversion of the given component can use the
+  // buckets of floating point samples.
+  bool UseBuckets(class ImageLayout *src,UWORD comp) const;
+  //
+  // Create the buckets of floating point samples for the given component
+  // by converting the first and last sample of each bucket.
+  void CreateBuckets(class ImageLayout *src,class ImageLayout *dst,UWORD comp,double lim);
+  //
   // Apply a map from the source image to the target image that must be
   // already initialized.
   void ApplyMap(class ImageLayout *src,class ImageLayout *dst);
@@ -191,9 +263,17 @@ public:
   Mapping(const char *filename,MappingType type,double gamma,bool inverse,UBYTE targetdepth,
 	  bool filter,const struct ImgSpecs &specs,double slope = 0.0)
     : m_pTargetFile(filename), m_ppucImage(NULL), m_pDest(NULL), m_PU_Lut(NULL),
-      m_Type(type), m_dGamma(gamma), m_dToeSlope(slope), m_ucTargetDepth(targetdepth), 
-      m_bInverse(inverse), m_bFilter(filter), m_TargetSpecs(specs)
+      m_pucTable(NULL), m_ucTableBits(0), m_pBuckets(NULL),
+      m_Type(type), m_dGamma(gamma), m_dToeSlope(slope), m_dToeOffset(0.0), m_dToeThreshold(0.0),
+      m_ucTargetDepth(targetdepth), m_bInverse(inverse), m_bFilter(filter), m_TargetSpecs(specs)
+  {
+  }
+  //
+  // Compute the transfer functions by the math library instead of
+  // looking them up in tables, for validation.
+  static void SetExactTransfer(bool exact)
   {
+    m_bExactTransfer = exact;
   }
   //
   virtual ~Mapping(void);
@@ -31,53 +31,18 @@ and conversion framework.
 
 /// Includes
 #include "diff/maxfreq.hpp"
+#include "diff/spectrum.hpp"
 #include "tools/fft.hpp"
 #include "std/math.hpp"
 #include "std/string.hpp"
-#ifdef USE_GSL
-///
-
-/// MaxFreq::CopyToFFT
-template<typename T>
-void MaxFreq::CopyToFFT(T *org,ULONG obytesperpixel,ULONG obytesperrow,
-			T *dst,ULONG dbytesperpixel,ULONG dbytesperrow,
-			double *target,ULONG stride,ULONG w,ULONG h)
-{
-  ULONG x,y;
-
-  for(y = 0;y < h;y++) {
-    T *orgrow      = org;
-    T *dstrow      = dst;
-    double *trgrow = target + y * stride;
-    for(x = 0;x < w;x++) {
-      trgrow[0]   = *orgrow - *dstrow; // real part
-      trgrow[1]   = 0.0; // imaginary part.
-      //
-      orgrow      = (T *)((const UBYTE *)(orgrow) + obytesperpixel);
-      dstrow      = (T *)((const UBYTE *)(dstrow) + dbytesperpixel);
-      trgrow     += 2;
-    }
-    org = (T *)((const UBYTE *)(org) + obytesperrow);
-    dst = (T *)((const UBYTE *)(dst) + dbytesperrow);
-  }
-}
+#include "std/assert.hpp"
 ///
 
 /// MaxFreq::~MaxFreq
 MaxFreq::~MaxFreq(void)
 {
-  int i;
-
   delete[] m_pdAbs;
-  
-  if (m_ppFFT) {
-    for(i = 0;i < m_usDepth;i++) {
-      if (m_ppFFT[i])
-        delete m_ppFFT[i];
-    }
-    delete[] m_ppFFT;
-  }
-
+  delete[] m_ppFFT;
 }
 ///
 
@@ -92,8 +57,10 @@ double MaxFreq::Measure(class ImageLayout *src,class ImageLayout *dst,double)
   ULONG  xm[16];
   ULONG  ym[16];
 
+  assert(m_pSpectrum);
+
   m_usDepth  = src->DepthOf();
-  m_ppFFT    = new FFT *[m_usDepth];
+  m_ppFFT    = new const FFT *[m_usDepth];
   memset(m_ppFFT,0,sizeof(class FFT *) * m_usDepth);
 
   memset(fmax,0,sizeof(fmax));
@@ -103,66 +70,13 @@ double MaxFreq::Measure(class ImageLayout *src,class ImageLayout *dst,double)
   for(comp = 0;comp < m_usDepth;comp++) {
     ULONG  w    = src->WidthOf(comp);
     ULONG  h    = src->HeightOf(comp);
-    class FFT *fft;
     //
-    m_ppFFT[comp] = fft = new class FFT(w,h,true);
+    m_ppFFT[comp] = m_pSpectrum->TransformOf(src,dst,comp,true);
     //
     if (w > maxw)
       maxw = w;
     if (h > maxh)
       maxh = h;
-    //
-    if (src->isSigned(comp)) {
-      if (src->BitsOf(comp) <= 8) {
-	CopyToFFT<const BYTE>((const BYTE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			      (const BYTE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			      fft->DataOf(),fft->ModuloOf(),w,h);
-      } else if (!src->isFloat(comp) && src->BitsOf(comp) <= 16) {
-	CopyToFFT<const WORD>((const WORD *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			      (const WORD *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			      fft->DataOf(),fft->ModuloOf(),w,h);
-      } else if (!src->isFloat(comp) && src->BitsOf(comp) <= 32) {
-	CopyToFFT<const LONG>((const LONG *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			      (const LONG *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			      fft->DataOf(),fft->ModuloOf(),w,h);
-      } else if (src->BitsOf(comp) <= 32 && src->isFloat(comp)) {
-	CopyToFFT<const FLOAT>((const FLOAT *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			       (const FLOAT *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			       fft->DataOf(),fft->ModuloOf(),w,h);
-      } else if (src->BitsOf(comp) == 64 && src->isFloat(comp)) {
-	CopyToFFT<const DOUBLE>((const DOUBLE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			       (const DOUBLE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				fft->DataOf(),fft->ModuloOf(),w,h);
-      } else {
-	throw "unsupported data type";
-      }
-    } else {
-      if (src->BitsOf(comp) <= 8) {
-	CopyToFFT<const UBYTE>((const UBYTE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			       (const UBYTE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			       fft->DataOf(),fft->ModuloOf(),w,h);
-      } else if (!src->isFloat(comp) && src->BitsOf(comp) <= 16) {
-	CopyToFFT<const UWORD>((const UWORD *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			       (const UWORD *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			       fft->DataOf(),fft->ModuloOf(),w,h);
-      } else if (!src->isFloat(comp) && src->BitsOf(comp) <= 32) {
-	CopyToFFT<const ULONG>((const ULONG *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			       (const ULONG *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			       fft->DataOf(),fft->ModuloOf(),w,h);
-      } else if (src->BitsOf(comp) <= 32 && src->isFloat(comp)) {
-	CopyToFFT<const FLOAT>((const FLOAT *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			       (const FLOAT *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			       fft->DataOf(),fft->ModuloOf(),w,h);
-      } else if (src->BitsOf(comp) == 64 && src->isFloat(comp)) {
-	CopyToFFT<const DOUBLE>((const DOUBLE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				(const DOUBLE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				fft->DataOf(),fft->ModuloOf(),w,h);
-      } else {
-	throw "unsupported data type";
-      }
-    }
-    // Run the transformation.
-    fft->ForwardsFFT();
   }
 
   // Due to symmetry, only 1/4 needs to be investiaged.
@@ -175,10 +89,10 @@ double MaxFreq::Measure(class ImageLayout *src,class ImageLayout *dst,double)
     for(x = 0;x < maxw;x++) {
       double f = 0.0;
       for(comp = 0;comp < m_usDepth;comp++) {
-	class FFT *fft = m_ppFFT[comp];
+	const class FFT *fft = m_ppFFT[comp];
 	if (x < fft->WidthOf() && y < fft->HeightOf()) {
-	  double re = fft->DataOf()[y * fft->ModuloOf() + (x << 1) + 0];
-	  double im = fft->DataOf()[y * fft->ModuloOf() + (x << 1) + 1];
+	  double re,im;
+	  fft->CoefficientOf(x,y,re,im);
 	  f        += re * re + im * im;
 	}
       }
@@ -265,5 +179,3 @@ double MaxFreq::Measure(class ImageLayout *src,class ImageLayout *dst,double)
   return 0.0;
 }
 ///
-
-#endif
@@ -35,11 +35,11 @@ and conversion framework.
 /// Includes
 #include "diff/meter.hpp"
 #include "img/imglayout.hpp"
-#ifdef USE_GSL
 ///
 
 /// Forwards
 class FFT;
+class Spectrum;
 ///
 
 /// class MaxFreq
@@ -47,8 +47,12 @@ class FFT;
 // with the same number of components as the original.
 class MaxFreq : public Meter {
   //
-  // The FFTs used here.
-  class FFT **m_ppFFT;
+  // The transformations of the difference image, shared by all
+  // spectral meters.
+  class Spectrum   *m_pSpectrum;
+  //
+  // The FFTs used here, one per component.
+  const class FFT **m_ppFFT;
   //
   // Number of FFT components.
   UWORD       m_usDepth;
@@ -59,11 +63,6 @@ class MaxFreq : public Meter {
   // The type of measurement.
   int         m_Type;
   //
-  template<typename T>
-  void CopyToFFT(T *org       ,ULONG obytesperpixel,ULONG obytesperrow,
-		 T *dst       ,ULONG dbytesperpixel,ULONG dbytesperrow,
-		 double *trg  ,ULONG stide,ULONG w,ULONG h);
-  //
 public:
   //
   // What should be measured.
@@ -77,12 +76,17 @@ public:
   //
   // Construct the difference image. Takes a file name.
   MaxFreq(Type t)
-    : m_ppFFT(NULL), m_usDepth(0), m_pdAbs(NULL), m_Type(t)
+    : m_pSpectrum(NULL), m_ppFFT(NULL), m_usDepth(0), m_pdAbs(NULL), m_Type(t)
   {
   }
   //
   virtual ~MaxFreq(void);
   //
+  virtual void AttachSpectrum(class Spectrum *spectrum)
+  {
+    m_pSpectrum = spectrum;
+  }
+  //
   virtual double Measure(class ImageLayout *src,class ImageLayout *dst,double in);
   //
   virtual const char *NameOf(void) const
@@ -106,4 +110,3 @@ public:
 
 ///
 #endif
-#endif
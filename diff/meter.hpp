@@ -37,6 +37,9 @@ and conversion framework.
 
 /// Forwards
 class ImageLayout;
+class Statistics;
+class Spectrum;
+class Downsampler;
 ///
 
 /// class Meter
@@ -74,6 +77,53 @@ public:
   // Return the name of this class.
   virtual const char *NameOf(void) const = 0;
   //
+  // Attach the statistics collector shared by all meters on the
+  // agenda. Meters that compute point-wise statistics register
+  // their requirements here and read their results from it.
+  virtual void AttachStatistics(class Statistics *)
+  {
+  }
+  //
+  // Attach the fourier transformations of the difference image
+  // shared by all spectral meters on the agenda.
+  virtual void AttachSpectrum(class Spectrum *)
+  {
+  }
+  //
+  // Return whether the meter can be run again on another image pair,
+  // as in batch mode. Meters that keep the images or buffers they
+  // created in a measurement around cannot.
+  virtual bool isReusable(void) const
+  {
+    return false;
+  }
+  //
+  // Return whether the meter gets along with the point-wise statistics
+  // alone, and can thus run on images that are delivered in stripes and
+  // are never complete in memory.
+  virtual bool isStreamable(void) const
+  {
+    return false;
+  }
+  //
+  // Return whether a meter without a result leaves the images alone,
+  // e.g. because it only writes a file, such that everything derived
+  // from the images remains valid. Streamable meters never modify
+  // the images.
+  virtual bool isReadOnly(void) const
+  {
+    return isStreamable();
+  }
+  //
+  // Offer the subsampling of the chroma components that directly
+  // follows this meter on the agenda. A meter that takes it over
+  // runs it as part of its own work and deletes it. Returns false
+  // if the subsampling has to run on its own.
+  virtual bool FuseSubsampling(class Downsampler *)
+  {
+    return false;
+  }
+  //
 };
 ///
 
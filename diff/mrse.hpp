@@ -38,6 +38,7 @@ and conversion framework.
 
 /// Forwards
 class ImageLayout;
+class Statistics;
 ///
 
 /// class MRSE
@@ -46,11 +47,9 @@ class MRSE : public Meter {
   // PSNR measurement type
   int m_Type;
   //
-  // Templated implementations
-  template<typename T>
-  double Compute(T *org,ULONG obytesperpixel,ULONG obytesperrow,
-		 T *dst,ULONG dbytesperpixel,ULONG dbytesperrow,
-		 ULONG w,ULONG h);
+  // The statistics collector the errors are taken from.
+  class Statistics *m_pStatistics;
+  //
 public:
   //
   // Several options: Mean MRSE, minimum MRSE, and with YCbCr weights (yuck!)
@@ -63,15 +62,29 @@ public:
   };
   //
   MRSE(Type t)
-    : m_Type(t)
+    : m_Type(t), m_pStatistics(NULL)
   { }
   //
   virtual double Measure(class ImageLayout *src,class ImageLayout *dst,double in);
   //
+  virtual void AttachStatistics(class Statistics *stats);
+  //
   virtual const char *NameOf(void) const
   {
     return "MRSE";
   }
+  //
+  // Keeps nothing from one measurement to the next.
+  virtual bool isReusable(void) const
+  {
+    return true;
+  }
+  //
+  // Only requires the point-wise statistics.
+  virtual bool isStreamable(void) const
+  {
+    return true;
+  }
 };
 ///
 
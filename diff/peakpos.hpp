@@ -37,6 +37,7 @@ and conversion framework.
 
 /// Forwards
 class ImageLayout;
+class Statistics;
 ///
 
 /// class PeakPos
@@ -51,11 +52,9 @@ class PeakPos : public Meter {
   // PRE measurement type
   int m_Type;
   //
-  // Templated implementations
-  template<typename T>
-  Pixel PeakError(T *org,ULONG obytesperpixel,ULONG obytesperrow,
-		  T *dst,ULONG dbytesperpixel,ULONG dbytesperrow,
-		  ULONG w,ULONG h);
+  // The statistics collector the errors are taken from.
+  class Statistics *m_pStatistics;
+  //
 public:
   //
   // Several options: X and Y position.
@@ -65,15 +64,29 @@ public:
   };
   //
   PeakPos(Type t)
-    : m_Type(t)
+    : m_Type(t), m_pStatistics(NULL)
   { }
   //
   virtual double Measure(class ImageLayout *src,class ImageLayout *dst,double in);
   //
+  virtual void AttachStatistics(class Statistics *stats);
+  //
   virtual const char *NameOf(void) const
   {
     return "PeakPosition";
   }
+  //
+  // Keeps nothing from one measurement to the next.
+  virtual bool isReusable(void) const
+  {
+    return true;
+  }
+  //
+  // Only requires the point-wise statistics.
+  virtual bool isStreamable(void) const
+  {
+    return true;
+  }
 };
 ///
 
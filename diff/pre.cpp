@@ -30,36 +30,18 @@ and conversion framework.
 
 /// Includes
 #include "diff/pre.hpp"
+#include "diff/statistics.hpp"
 #include "img/imglayout.hpp"
 #include "std/math.hpp"
+#include "std/assert.hpp"
 ///
 
-/// PRE::PeakError
-template<typename T>
-double PRE::PeakError(T *org,ULONG obytesperpixel,ULONG obytesperrow,
-		      T *dst,ULONG dbytesperpixel,ULONG dbytesperrow,
-		      ULONG w,ULONG h)
+/// PRE::AttachStatistics
+// Register the statistics the peak error is computed from.
+void PRE::AttachStatistics(class Statistics *stats)
 {
-  double error = 0.0;
-  ULONG x,y;
-
-  for(y = 0;y < h;y++) {
-    T *orgrow = org;
-    T *dstrow = dst;
-    for(x = 0;x < w;x++) {
-      double diff = *orgrow - *dstrow;
-      diff        = fabs(diff);
-      if (diff > error)
-	error     = diff;
-      //
-      orgrow      = (T *)((const UBYTE *)(orgrow) + obytesperpixel);
-      dstrow      = (T *)((const UBYTE *)(dstrow) + dbytesperpixel);
-    }
-    org = (T *)((const UBYTE *)(org) + obytesperrow);
-    dst = (T *)((const UBYTE *)(dst) + dbytesperrow);
-  }
-
-  return error;
+  stats->Require(Statistics::Peak);
+  m_pStatistics = stats;
 }
 ///
 
@@ -69,62 +51,13 @@ double PRE::Measure(class ImageLayout *src,class ImageLayout *dst,double)
   double error = 0.0;
   UWORD comp;
 
+  assert(m_pStatistics);
+
   for(comp = 0;comp < src->DepthOf();comp++) {
-    double peak = 0.0;
-    ULONG  w    = src->WidthOf(comp);
-    ULONG  h    = src->HeightOf(comp);
+    const struct Statistics::Result &res = m_pStatistics->ResultOf(src,dst,comp);
+    double peak = res.m_dPeak;
     double prc  = src->isFloat(comp)?(1.0):(double(UQUAD(1) << src->BitsOf(comp)) - 1.0);
     //
-    if (src->isSigned(comp)) {
-      if (src->BitsOf(comp) <= 8) {
-	peak = PeakError<const BYTE>((const BYTE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				     (const BYTE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				     w,h);
-      } else if (!src->isFloat(comp) && src->BitsOf(comp) <= 16) {
-	peak = PeakError<const WORD>((const WORD *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				     (const WORD *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				     w,h);
-       } else if (!src->isFloat(comp) && src->BitsOf(comp) <= 32) {
-	peak = PeakError<const LONG>((const LONG *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				     (const LONG *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				     w,h);
-      } else if (src->BitsOf(comp) <= 32 && src->isFloat(comp)) {
-	peak = PeakError<const FLOAT>((const FLOAT *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				      (const FLOAT *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				      w,h);
-      } else if (src->BitsOf(comp) == 64 && src->isFloat(comp)) {
-	peak = PeakError<const DOUBLE>((const DOUBLE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				       (const DOUBLE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				       w,h);
-      } else {
-	throw "unsupported data type";
-      }
-    } else {
-      if (src->BitsOf(comp) <= 8) {
-	peak = PeakError<const UBYTE>((const UBYTE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				      (const UBYTE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				      w,h);
-      } else if (!src->isFloat(comp) && src->BitsOf(comp) <= 16) {
-	peak = PeakError<const UWORD>((const UWORD *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				      (const UWORD *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				      w,h);
-      } else if (!src->isFloat(comp) && src->BitsOf(comp) <= 32) {
-	peak = PeakError<const ULONG>((const ULONG *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				      (const ULONG *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				      w,h);
-      } else if (src->BitsOf(comp) <= 32 && src->isFloat(comp)) {
-	peak = PeakError<const FLOAT>((const FLOAT *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				      (const FLOAT *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				      w,h);
-      } else if (src->BitsOf(comp) == 64 && src->isFloat(comp)) {
-	peak = PeakError<const DOUBLE>((const DOUBLE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				       (const DOUBLE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				       w,h);
-      } else {
-	throw "unsupported data type";
-      }
-    }
-    //
     peak /= prc;
     //
     switch(m_Type) {
@@ -31,40 +31,22 @@ and conversion framework.
 
 /// Includes
 #include "diff/psnr.hpp"
+#include "diff/statistics.hpp"
 #include "img/imglayout.hpp"
 #include "std/math.hpp"
+#include "std/assert.hpp"
 ///
 
-/// PSNR::MSE
-template<typename T>
-double PSNR::MSE(T *org,ULONG obytesperpixel,ULONG obytesperrow,
-		 T *dst,ULONG dbytesperpixel,ULONG dbytesperrow,
-		 ULONG w,ULONG h,double &max,double &energy)
+/// PSNR::AttachStatistics
+// Register the sums the PSNR is computed from.
+void PSNR::AttachStatistics(class Statistics *stats)
 {
-  double error = 0.0;
-  ULONG x,y;
-
-  for(y = 0;y < h;y++) {
-    T *orgrow = org;
-    T *dstrow = dst;
-    for(x = 0;x < w;x++) {
-      double diff = *orgrow - *dstrow;
-      double orq  = *orgrow * *orgrow;
-      //double dsq  = *dstrow * *dstrow;
-      error      += diff * diff;
-      //energy     += (orq + dsq) * 0.5;
-      energy     += orq;
-      if (orq > max) max = orq;
-      // if (dsq > max) max = dsq;
-      //
-      orgrow      = (T *)((const UBYTE *)(orgrow) + obytesperpixel);
-      dstrow      = (T *)((const UBYTE *)(dstrow) + dbytesperpixel);
-    }
-    org = (T *)((const UBYTE *)(org) + obytesperrow);
-    dst = (T *)((const UBYTE *)(dst) + dbytesperrow);
+  if (m_bSNR) {
+    stats->Require(Statistics::SquareError | Statistics::Energy);
+  } else {
+    stats->Require(Statistics::SquareError);
   }
-
-  return error;
+  m_pStatistics = stats;
 }
 ///
 
@@ -77,67 +59,23 @@ double PSNR::Measure(class ImageLayout *src,class ImageLayout *dst,double)
   UWORD comp,d  = src->DepthOf();
   int type      = m_Type;
 
+  assert(m_pStatistics);
+
   if (d != 3 && type != Min && type != Mean && type != RootMean) {
     fprintf(stderr,"the selected PSNR measurement is only available for three component images, reverting to minpsnr\n");
     type = Min;
   }
 
   for(comp = 0;comp < d;comp++) {
-    double mse = 0.0;
-    double erg = 0.0;
+    const struct Statistics::Result &res = m_pStatistics->ResultOf(src,dst,comp);
+    double mse = res.m_dSquareError;
+    double erg = res.m_dEnergy;
     ULONG  w   = src->WidthOf(comp);
     ULONG  h   = src->HeightOf(comp);
     double prc = (src->isFloat(comp))?(1.0):(double(UQUAD(1) << src->BitsOf(comp)) - 1.0);
     //
-    if (src->isSigned(comp)) {
-      if (src->BitsOf(comp) <= 8) {
-	mse = MSE<const BYTE>((const BYTE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			      (const BYTE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			      w,h,max,erg);
-      } else if (!src->isFloat(comp) && src->BitsOf(comp) <= 16) {
-	mse = MSE<const WORD>((const WORD *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			      (const WORD *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			      w,h,max,erg);
-      } else if (!src->isFloat(comp) && src->BitsOf(comp) <= 32) {
-	mse = MSE<const LONG>((const LONG *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			      (const LONG *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			      w,h,max,erg);
-      } else if (src->BitsOf(comp) <= 32 && src->isFloat(comp)) {
-	mse = MSE<const FLOAT>((const FLOAT *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			       (const FLOAT *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			       w,h,max,erg);
-      } else if (src->BitsOf(comp) == 64 && src->isFloat(comp)) {
-	mse = MSE<const DOUBLE>((const DOUBLE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				(const DOUBLE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				w,h,max,erg);
-      } else {
-	throw "unsupported data type";
-      }
-    } else {
-      if (src->BitsOf(comp) <= 8) {
-	mse = MSE<const UBYTE>((const UBYTE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			       (const UBYTE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			       w,h,max,erg);
-      } else if (!src->isFloat(comp) && src->BitsOf(comp) <= 16) {
-	mse = MSE<const UWORD>((const UWORD *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			       (const UWORD *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			       w,h,max,erg);
-      } else if (!src->isFloat(comp) && src->BitsOf(comp) <= 32) {
-	mse = MSE<const ULONG>((const ULONG *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			       (const ULONG *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			       w,h,max,erg);
-      } else if (src->BitsOf(comp) <= 32 && src->isFloat(comp)) {
-	mse = MSE<const FLOAT>((const FLOAT *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			       (const FLOAT *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			       w,h,max,erg);
-      } else if (src->BitsOf(comp) == 64 && src->isFloat(comp)) {
-	mse = MSE<const DOUBLE>((const DOUBLE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				(const DOUBLE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				w,h,max,erg);
-      } else {
-	throw "unsupported data type";
-      }
-    }
+    if (res.m_dMaxSquare > max)
+      max = res.m_dMaxSquare;
     //
     if (m_bSNR || m_bLinear) {
       mse /= (w * h);
@@ -38,6 +38,7 @@ and conversion framework.
 
 /// Forwards
 class ImageLayout;
+class Statistics;
 ///
 
 /// class PSNR
@@ -55,11 +56,9 @@ class PSNR : public Meter {
   // Instead of taking the max in the SNR computation, compute the energy of the source.
   bool m_bScaleToEnergy;
   //
-  // Templated implementations
-  template<typename T>
-  double MSE(T *org,ULONG obytesperpixel,ULONG obytesperrow,
-	     T *dst,ULONG dbytesperpixel,ULONG dbytesperrow,
-	     ULONG w,ULONG h,double &max,double &energy);
+  // The statistics collector the errors are taken from.
+  class Statistics *m_pStatistics;
+  //
 public:
   //
   // Several options: Mean PSNR, minimum PSNR, and with YCbCr weights (yuck!)
@@ -73,11 +72,13 @@ public:
   };
   //
   PSNR(Type t,bool linear = false,bool snr = false,bool fromenergy = false)
-    : m_Type(t), m_bLinear(linear), m_bSNR(snr), m_bScaleToEnergy(fromenergy)
+    : m_Type(t), m_bLinear(linear), m_bSNR(snr), m_bScaleToEnergy(fromenergy), m_pStatistics(NULL)
   { }
   //
   virtual double Measure(class ImageLayout *src,class ImageLayout *dst,double in);
   //
+  virtual void AttachStatistics(class Statistics *stats);
+  //
   virtual const char *NameOf(void) const
   {
     if (m_bLinear) {
@@ -89,6 +90,18 @@ public:
       return "SNR";
     return "PSNR";
   }
+  //
+  // Keeps nothing from one measurement to the next.
+  virtual bool isReusable(void) const
+  {
+    return true;
+  }
+  //
+  // Only requires the point-wise statistics.
+  virtual bool isStreamable(void) const
+  {
+    return true;
+  }
 };
 ///
 
@@ -56,6 +56,12 @@ public:
   {
     return NULL;
   }
+  //
+  // Keeps nothing from one measurement to the next.
+  virtual bool isReusable(void) const
+  {
+    return true;
+  }
 };
 ///
 
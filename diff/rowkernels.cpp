@@ -0,0 +1,1047 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software) for Accusoft	        **
+** All Rights Reserved							**
+**************************************************************************
+
+This source file is part of difftest_ng, a universal image measuring
+and conversion framework.
+
+    difftest_ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    difftest_ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with difftest_ng.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/*
+**
+** $Id: rowkernels.cpp,v 1.1 2022/09/06 10:02:37 thor Exp $
+**
+** Vectorized kernels that collect the moments of the differences
+** of a single row of samples, for the sample types and layouts that
+** are common enough to deserve them. The instruction set is picked
+** at run time.
+*/
+
+/// Includes
+#include "diff/rowkernels.hpp"
+#include "std/math.hpp"
+///
+
+/// Defines
+// The vector kernels are built with per-function target attributes,
+// so that the rest of the program does not depend on the instruction
+// set of the machine it runs on.
+#if (defined(__x86_64__) || defined(__i386__)) && \
+  ((defined(__GNUC__) && __GNUC__ >= 6) || defined(__clang__))
+# define HAVE_X86_KERNELS
+# include <immintrin.h>
+# if defined(__GNUC__) && !defined(__clang__)
+// GCC reports the undefined register contents its AVX-512 headers
+// start from as uninitialized.
+#  pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+# endif
+# define TARGET_SSE2   __attribute__((target("sse2")))
+# define TARGET_AVX2   __attribute__((target("avx2")))
+# define TARGET_AVX512 __attribute__((target("avx512f,avx512bw")))
+#endif
+///
+
+/// Clear
+// Reset the moments of a row.
+static void Clear(struct RowKernels::Moments &m)
+{
+  m.m_dSquareError = 0.0;
+  m.m_dAbsError    = 0.0;
+  m.m_dDrift       = 0.0;
+  m.m_dMinDiff     = HUGE_VAL;
+  m.m_dMaxDiff     = -HUGE_VAL;
+}
+///
+
+/// ScalarMoments
+// Add the moments of count samples, step samples apart, to m. This
+// is the kernel if no vector instructions are available, and covers
+// the ends of the rows the vector kernels leave over.
+template<typename T>
+static void ScalarMoments(const T *org,const T *dst,ULONG count,ULONG step,struct RowKernels::Moments &m)
+{
+  double sqerr  = 0.0;
+  double abserr = 0.0;
+  double drift  = 0.0;
+
+  while(count) {
+    double diff = double(*org) - double(*dst);
+    //
+    sqerr  += diff * diff;
+    abserr += fabs(diff);
+    drift  += diff;
+    if (diff < m.m_dMinDiff)
+      m.m_dMinDiff = diff;
+    if (diff > m.m_dMaxDiff)
+      m.m_dMaxDiff = diff;
+    //
+    org += step;
+    dst += step;
+    count--;
+  }
+  m.m_dSquareError += sqerr;
+  m.m_dAbsError    += abserr;
+  m.m_dDrift       += drift;
+}
+///
+
+/// ScalarDense
+// The scalar kernel for samples stored without gaps.
+template<typename T>
+static void ScalarDense(const T *org,const T *dst,ULONG w,struct RowKernels::Moments &m)
+{
+  Clear(m);
+  ScalarMoments(org,dst,w,1,m);
+}
+///
+
+/// ScalarInterleaved
+// The scalar kernel for three interleaved components.
+template<typename T>
+static void ScalarInterleaved(const T *org,const T *dst,ULONG w,struct RowKernels::Moments *m)
+{
+  int c;
+
+  for(c = 0;c < 3;c++) {
+    Clear(m[c]);
+    ScalarMoments(org + c,dst + c,w,3,m[c]);
+  }
+}
+///
+
+/// ScalarTransform
+// Transform pixels by a fixed point matrix in 64 bit arithmetic, see
+// RowKernels::Transform. This works for all bit depths, and covers the
+// ends of the rows the vector kernel leaves over.
+static void ScalarTransform(LONG *c0,LONG *c1,LONG *c2,const QUAD *matrix,LONG limit,ULONG w)
+{
+  const UQUAD mask  = (UQUAD(1) << RowKernels::FractionBits) - 1;
+  const UQUAD guard = UQUAD(1) << (RowKernels::FractionBits - 12);
+
+  while(w) {
+    QUAD v[3];
+    int i;
+    //
+    for(i = 0;i < 3;i++)
+      v[i] = *c0 * matrix[4*i] + *c1 * matrix[4*i+1] + *c2 * matrix[4*i+2] + matrix[4*i+3];
+    //
+    if (((UQUAD(v[0]) + guard) & mask) < 2 * guard ||
+	((UQUAD(v[1]) + guard) & mask) < 2 * guard ||
+	((UQUAD(v[2]) + guard) & mask) < 2 * guard) {
+      *c0 = -1;
+    } else {
+      for(i = 0;i < 3;i++) {
+	if (v[i] < 0) {
+	  v[i] = 0;
+	} else {
+	  v[i] >>= RowKernels::FractionBits;
+	  if (v[i] > limit)
+	    v[i] = limit;
+	}
+      }
+      *c0 = LONG(v[0]);
+      *c1 = LONG(v[1]);
+      *c2 = LONG(v[2]);
+    }
+    c0++,c1++,c2++;
+    w--;
+  }
+}
+///
+
+#ifdef HAVE_X86_KERNELS
+/// Masks
+// Selection masks for three interleaved components: Starting at
+// offset (3 - r) % 3, element p is set if p % 3 == r. The AVX-512
+// kernels use mask registers built from the same pattern instead.
+static const UBYTE ByteMask[36] = {
+  0xff,0,0,0xff,0,0,0xff,0,0,0xff,0,0,0xff,0,0,0xff,0,0,
+  0xff,0,0,0xff,0,0,0xff,0,0,0xff,0,0,0xff,0,0,0xff,0,0
+};
+static const UWORD WordMask[21] = {
+  0xffff,0,0,0xffff,0,0,0xffff,0,0,0xffff,0,0,0xffff,0,0,0xffff,0,0,
+  0xffff,0,0
+};
+#define PERIOD3_MASK 0x9249249249249249ULL
+///
+
+/// ResidueOf
+// Element p of vector k of a group of three vectors of n elements
+// each belongs to component c if p % 3 is the returned value.
+static int ResidueOf(int c,int k,int n)
+{
+  int r = (c - k * n) % 3;
+
+  return (r < 0)?(r + 3):(r);
+}
+///
+
+/// IntegerMoments
+// Fill in the moments from the lanes of the integer kernels.
+static void IntegerMoments(struct RowKernels::Moments &m,int lanes,
+			   const UQUAD *sqerr,const UQUAD *abserr,const UQUAD *org,const UQUAD *dst,
+			   LONG min,LONG max)
+{
+  UQUAD sq = 0,ab = 0,so = 0,sd = 0;
+  int i;
+
+  for(i = 0;i < lanes;i++) {
+    sq += sqerr[i];
+    ab += abserr[i];
+    so += org[i];
+    sd += dst[i];
+  }
+  m.m_dSquareError = double(sq);
+  m.m_dAbsError    = double(ab);
+  m.m_dDrift       = double(QUAD(so) - QUAD(sd));
+  m.m_dMinDiff     = min;
+  m.m_dMaxDiff     = max;
+}
+///
+
+/// MinOf
+// The smallest of n integers.
+template<typename T>
+static LONG MinOf(const T *v,int n)
+{
+  LONG min = v[0];
+  int i;
+
+  for(i = 1;i < n;i++) {
+    if (v[i] < min)
+      min = v[i];
+  }
+  return min;
+}
+///
+
+/// MaxOf
+// The largest of n integers.
+template<typename T>
+static LONG MaxOf(const T *v,int n)
+{
+  LONG max = v[0];
+  int i;
+
+  for(i = 1;i < n;i++) {
+    if (v[i] > max)
+      max = v[i];
+  }
+  return max;
+}
+///
+
+/// struct SSE2Bytes
+// The SSE2 kernel for 8 bit samples. The differences are widened to
+// 16 bits, the squares are summed in 32 bits and flushed into 64 bit
+// sums before they can overflow.
+struct SSE2Bytes {
+  typedef UBYTE   Sample;
+  typedef __m128i Vector;
+  typedef __m128i Mask;
+  enum {
+    Lanes = 16,
+    Flush = 8192 // each 32 bit lane grows by at most 4*255^2 per step
+  };
+  __m128i m_Square;
+  __m128i m_SquareSum;
+  __m128i m_Abs;
+  __m128i m_Org;
+  __m128i m_Dst;
+  __m128i m_Min;
+  __m128i m_Max;
+  ULONG   m_ulSteps;
+  //
+  TARGET_SSE2 void Init(void)
+  {
+    m_Square    = _mm_setzero_si128();
+    m_SquareSum = _mm_setzero_si128();
+    m_Abs       = _mm_setzero_si128();
+    m_Org       = _mm_setzero_si128();
+    m_Dst       = _mm_setzero_si128();
+    m_Min       = _mm_set1_epi16(0x7fff);
+    m_Max       = _mm_set1_epi16(-0x8000);
+    m_ulSteps   = 0;
+  }
+  //
+  TARGET_SSE2 static __m128i Load(const UBYTE *p)
+  {
+    return _mm_loadu_si128((const __m128i *)p);
+  }
+  //
+  TARGET_SSE2 static __m128i MaskOf(int r)
+  {
+    return _mm_loadu_si128((const __m128i *)(ByteMask + (3 - r) % 3));
+  }
+  //
+  TARGET_SSE2 static __m128i Select(__m128i v0,__m128i v1,__m128i v2,const __m128i *m)
+  {
+    return _mm_or_si128(_mm_or_si128(_mm_and_si128(v0,m[0]),_mm_and_si128(v1,m[1])),
+			_mm_and_si128(v2,m[2]));
+  }
+  //
+  TARGET_SSE2 void FlushSquares(void)
+  {
+    __m128i zero = _mm_setzero_si128();
+    //
+    m_SquareSum = _mm_add_epi64(m_SquareSum,_mm_add_epi64(_mm_unpacklo_epi32(m_Square,zero),
+							  _mm_unpackhi_epi32(m_Square,zero)));
+    m_Square    = zero;
+    m_ulSteps   = 0;
+  }
+  //
+  TARGET_SSE2 void Step(__m128i a,__m128i b)
+  {
+    __m128i zero = _mm_setzero_si128();
+    __m128i ad   = _mm_or_si128(_mm_subs_epu8(a,b),_mm_subs_epu8(b,a));
+    __m128i dlo  = _mm_sub_epi16(_mm_unpacklo_epi8(a,zero),_mm_unpacklo_epi8(b,zero));
+    __m128i dhi  = _mm_sub_epi16(_mm_unpackhi_epi8(a,zero),_mm_unpackhi_epi8(b,zero));
+    //
+    m_Abs    = _mm_add_epi64(m_Abs,_mm_sad_epu8(ad,zero));
+    m_Org    = _mm_add_epi64(m_Org,_mm_sad_epu8(a,zero));
+    m_Dst    = _mm_add_epi64(m_Dst,_mm_sad_epu8(b,zero));
+    m_Min    = _mm_min_epi16(m_Min,_mm_min_epi16(dlo,dhi));
+    m_Max    = _mm_max_epi16(m_Max,_mm_max_epi16(dlo,dhi));
+    m_Square = _mm_add_epi32(m_Square,_mm_add_epi32(_mm_madd_epi16(dlo,dlo),_mm_madd_epi16(dhi,dhi)));
+    if (++m_ulSteps >= Flush)
+      FlushSquares();
+  }
+  //
+  TARGET_SSE2 void Finish(struct RowKernels::Moments &m)
+  {
+    UQUAD sq[2],ab[2],so[2],sd[2];
+    WORD min[8],max[8];
+    //
+    FlushSquares();
+    _mm_storeu_si128((__m128i *)sq,m_SquareSum);
+    _mm_storeu_si128((__m128i *)ab,m_Abs);
+    _mm_storeu_si128((__m128i *)so,m_Org);
+    _mm_storeu_si128((__m128i *)sd,m_Dst);
+    _mm_storeu_si128((__m128i *)min,m_Min);
+    _mm_storeu_si128((__m128i *)max,m_Max);
+    IntegerMoments(m,2,sq,ab,so,sd,MinOf(min,8),MaxOf(max,8));
+  }
+};
+///
+
+/// struct SSE2Words
+// The SSE2 kernel for 16 bit samples. The absolute differences fit
+// into 16 bits, their squares are formed in 64 bits. Sums of 16 bit
+// values are formed with SAD on the low and high bytes separately.
+struct SSE2Words {
+  typedef UWORD   Sample;
+  typedef __m128i Vector;
+  typedef __m128i Mask;
+  enum {
+    Lanes = 8
+  };
+  __m128i m_Square;
+  __m128i m_Abs;
+  __m128i m_Org;
+  __m128i m_Dst;
+  __m128i m_Min;
+  __m128i m_Max;
+  //
+  TARGET_SSE2 void Init(void)
+  {
+    m_Square = _mm_setzero_si128();
+    m_Abs    = _mm_setzero_si128();
+    m_Org    = _mm_setzero_si128();
+    m_Dst    = _mm_setzero_si128();
+    m_Min    = _mm_set1_epi32(0x7fffffff);
+    m_Max    = _mm_set1_epi32(-0x7fffffff - 1);
+  }
+  //
+  TARGET_SSE2 static __m128i Load(const UWORD *p)
+  {
+    return _mm_loadu_si128((const __m128i *)p);
+  }
+  //
+  TARGET_SSE2 static __m128i MaskOf(int r)
+  {
+    return _mm_loadu_si128((const __m128i *)(WordMask + (3 - r) % 3));
+  }
+  //
+  TARGET_SSE2 static __m128i Select(__m128i v0,__m128i v1,__m128i v2,const __m128i *m)
+  {
+    return _mm_or_si128(_mm_or_si128(_mm_and_si128(v0,m[0]),_mm_and_si128(v1,m[1])),
+			_mm_and_si128(v2,m[2]));
+  }
+  //
+  // Sum the 16 bit lanes into two 64 bit lanes.
+  TARGET_SSE2 static __m128i Sum(__m128i v)
+  {
+    __m128i zero = _mm_setzero_si128();
+    //
+    return _mm_add_epi64(_mm_sad_epu8(_mm_and_si128(v,_mm_set1_epi16(0xff)),zero),
+			 _mm_slli_epi64(_mm_sad_epu8(_mm_srli_epi16(v,8),zero),8));
+  }
+  //
+  // Sum the squares of the 32 bit lanes into two 64 bit lanes.
+  TARGET_SSE2 static __m128i Squares(__m128i v)
+  {
+    __m128i odd = _mm_srli_epi64(v,32);
+    //
+    return _mm_add_epi64(_mm_mul_epu32(v,v),_mm_mul_epu32(odd,odd));
+  }
+  //
+  // Signed 32 bit minimum and maximum, not available before SSE4.1.
+  TARGET_SSE2 static __m128i Min(__m128i a,__m128i b)
+  {
+    __m128i gt = _mm_cmpgt_epi32(a,b);
+    //
+    return _mm_or_si128(_mm_and_si128(gt,b),_mm_andnot_si128(gt,a));
+  }
+  //
+  TARGET_SSE2 static __m128i Max(__m128i a,__m128i b)
+  {
+    __m128i gt = _mm_cmpgt_epi32(a,b);
+    //
+    return _mm_or_si128(_mm_and_si128(gt,a),_mm_andnot_si128(gt,b));
+  }
+  //
+  TARGET_SSE2 void Step(__m128i a,__m128i b)
+  {
+    __m128i zero = _mm_setzero_si128();
+    __m128i ad   = _mm_or_si128(_mm_subs_epu16(a,b),_mm_subs_epu16(b,a));
+    __m128i dlo  = _mm_sub_epi32(_mm_unpacklo_epi16(a,zero),_mm_unpacklo_epi16(b,zero));
+    __m128i dhi  = _mm_sub_epi32(_mm_unpackhi_epi16(a,zero),_mm_unpackhi_epi16(b,zero));
+    //
+    m_Square = _mm_add_epi64(m_Square,_mm_add_epi64(Squares(_mm_unpacklo_epi16(ad,zero)),
+						     Squares(_mm_unpackhi_epi16(ad,zero))));
+    m_Abs    = _mm_add_epi64(m_Abs,Sum(ad));
+    m_Org    = _mm_add_epi64(m_Org,Sum(a));
+    m_Dst    = _mm_add_epi64(m_Dst,Sum(b));
+    m_Min    = Min(m_Min,Min(dlo,dhi));
+    m_Max    = Max(m_Max,Max(dlo,dhi));
+  }
+  //
+  TARGET_SSE2 void Finish(struct RowKernels::Moments &m)
+  {
+    UQUAD sq[2],ab[2],so[2],sd[2];
+    LONG min[4],max[4];
+    //
+    _mm_storeu_si128((__m128i *)sq,m_Square);
+    _mm_storeu_si128((__m128i *)ab,m_Abs);
+    _mm_storeu_si128((__m128i *)so,m_Org);
+    _mm_storeu_si128((__m128i *)sd,m_Dst);
+    _mm_storeu_si128((__m128i *)min,m_Min);
+    _mm_storeu_si128((__m128i *)max,m_Max);
+    IntegerMoments(m,2,sq,ab,so,sd,MinOf(min,4),MaxOf(max,4));
+  }
+};
+///
+
+/// struct AVX2Bytes
+// The AVX2 kernel for 8 bit samples, see SSE2Bytes.
+struct AVX2Bytes {
+  typedef UBYTE   Sample;
+  typedef __m256i Vector;
+  typedef __m256i Mask;
+  enum {
+    Lanes = 32,
+    Flush = 8192 // each 32 bit lane grows by at most 4*255^2 per step
+  };
+  __m256i m_Square;
+  __m256i m_SquareSum;
+  __m256i m_Abs;
+  __m256i m_Org;
+  __m256i m_Dst;
+  __m256i m_Min;
+  __m256i m_Max;
+  ULONG   m_ulSteps;
+  //
+  TARGET_AVX2 void Init(void)
+  {
+    m_Square    = _mm256_setzero_si256();
+    m_SquareSum = _mm256_setzero_si256();
+    m_Abs       = _mm256_setzero_si256();
+    m_Org       = _mm256_setzero_si256();
+    m_Dst       = _mm256_setzero_si256();
+    m_Min       = _mm256_set1_epi16(0x7fff);
+    m_Max       = _mm256_set1_epi16(-0x8000);
+    m_ulSteps   = 0;
+  }
+  //
+  TARGET_AVX2 static __m256i Load(const UBYTE *p)
+  {
+    return _mm256_loadu_si256((const __m256i *)p);
+  }
+  //
+  TARGET_AVX2 static __m256i MaskOf(int r)
+  {
+    return _mm256_loadu_si256((const __m256i *)(ByteMask + (3 - r) % 3));
+  }
+  //
+  TARGET_AVX2 static __m256i Select(__m256i v0,__m256i v1,__m256i v2,const __m256i *m)
+  {
+    return _mm256_or_si256(_mm256_or_si256(_mm256_and_si256(v0,m[0]),_mm256_and_si256(v1,m[1])),
+			   _mm256_and_si256(v2,m[2]));
+  }
+  //
+  TARGET_AVX2 void FlushSquares(void)
+  {
+    __m256i zero = _mm256_setzero_si256();
+    //
+    m_SquareSum = _mm256_add_epi64(m_SquareSum,_mm256_add_epi64(_mm256_unpacklo_epi32(m_Square,zero),
+								 _mm256_unpackhi_epi32(m_Square,zero)));
+    m_Square    = zero;
+    m_ulSteps   = 0;
+  }
+  //
+  TARGET_AVX2 void Step(__m256i a,__m256i b)
+  {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i ad   = _mm256_or_si256(_mm256_subs_epu8(a,b),_mm256_subs_epu8(b,a));
+    __m256i dlo  = _mm256_sub_epi16(_mm256_unpacklo_epi8(a,zero),_mm256_unpacklo_epi8(b,zero));
+    __m256i dhi  = _mm256_sub_epi16(_mm256_unpackhi_epi8(a,zero),_mm256_unpackhi_epi8(b,zero));
+    //
+    m_Abs    = _mm256_add_epi64(m_Abs,_mm256_sad_epu8(ad,zero));
+    m_Org    = _mm256_add_epi64(m_Org,_mm256_sad_epu8(a,zero));
+    m_Dst    = _mm256_add_epi64(m_Dst,_mm256_sad_epu8(b,zero));
+    m_Min    = _mm256_min_epi16(m_Min,_mm256_min_epi16(dlo,dhi));
+    m_Max    = _mm256_max_epi16(m_Max,_mm256_max_epi16(dlo,dhi));
+    m_Square = _mm256_add_epi32(m_Square,_mm256_add_epi32(_mm256_madd_epi16(dlo,dlo),
+							  _mm256_madd_epi16(dhi,dhi)));
+    if (++m_ulSteps >= Flush)
+      FlushSquares();
+  }
+  //
+  TARGET_AVX2 void Finish(struct RowKernels::Moments &m)
+  {
+    UQUAD sq[4],ab[4],so[4],sd[4];
+    WORD min[16],max[16];
+    //
+    FlushSquares();
+    _mm256_storeu_si256((__m256i *)sq,m_SquareSum);
+    _mm256_storeu_si256((__m256i *)ab,m_Abs);
+    _mm256_storeu_si256((__m256i *)so,m_Org);
+    _mm256_storeu_si256((__m256i *)sd,m_Dst);
+    _mm256_storeu_si256((__m256i *)min,m_Min);
+    _mm256_storeu_si256((__m256i *)max,m_Max);
+    IntegerMoments(m,4,sq,ab,so,sd,MinOf(min,16),MaxOf(max,16));
+  }
+};
+///
+
+/// struct AVX2Words
+// The AVX2 kernel for 16 bit samples, see SSE2Words.
+struct AVX2Words {
+  typedef UWORD   Sample;
+  typedef __m256i Vector;
+  typedef __m256i Mask;
+  enum {
+    Lanes = 16
+  };
+  __m256i m_Square;
+  __m256i m_Abs;
+  __m256i m_Org;
+  __m256i m_Dst;
+  __m256i m_Min;
+  __m256i m_Max;
+  //
+  TARGET_AVX2 void Init(void)
+  {
+    m_Square = _mm256_setzero_si256();
+    m_Abs    = _mm256_setzero_si256();
+    m_Org    = _mm256_setzero_si256();
+    m_Dst    = _mm256_setzero_si256();
+    m_Min    = _mm256_set1_epi32(0x7fffffff);
+    m_Max    = _mm256_set1_epi32(-0x7fffffff - 1);
+  }
+  //
+  TARGET_AVX2 static __m256i Load(const UWORD *p)
+  {
+    return _mm256_loadu_si256((const __m256i *)p);
+  }
+  //
+  TARGET_AVX2 static __m256i MaskOf(int r)
+  {
+    return _mm256_loadu_si256((const __m256i *)(WordMask + (3 - r) % 3));
+  }
+  //
+  TARGET_AVX2 static __m256i Select(__m256i v0,__m256i v1,__m256i v2,const __m256i *m)
+  {
+    return _mm256_or_si256(_mm256_or_si256(_mm256_and_si256(v0,m[0]),_mm256_and_si256(v1,m[1])),
+			   _mm256_and_si256(v2,m[2]));
+  }
+  //
+  TARGET_AVX2 static __m256i Sum(__m256i v)
+  {
+    __m256i zero = _mm256_setzero_si256();
+    //
+    return _mm256_add_epi64(_mm256_sad_epu8(_mm256_and_si256(v,_mm256_set1_epi16(0xff)),zero),
+			    _mm256_slli_epi64(_mm256_sad_epu8(_mm256_srli_epi16(v,8),zero),8));
+  }
+  //
+  TARGET_AVX2 static __m256i Squares(__m256i v)
+  {
+    __m256i odd = _mm256_srli_epi64(v,32);
+    //
+    return _mm256_add_epi64(_mm256_mul_epu32(v,v),_mm256_mul_epu32(odd,odd));
+  }
+  //
+  TARGET_AVX2 void Step(__m256i a,__m256i b)
+  {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i ad   = _mm256_or_si256(_mm256_subs_epu16(a,b),_mm256_subs_epu16(b,a));
+    __m256i dlo  = _mm256_sub_epi32(_mm256_unpacklo_epi16(a,zero),_mm256_unpacklo_epi16(b,zero));
+    __m256i dhi  = _mm256_sub_epi32(_mm256_unpackhi_epi16(a,zero),_mm256_unpackhi_epi16(b,zero));
+    //
+    m_Square = _mm256_add_epi64(m_Square,_mm256_add_epi64(Squares(_mm256_unpacklo_epi16(ad,zero)),
+							   Squares(_mm256_unpackhi_epi16(ad,zero))));
+    m_Abs    = _mm256_add_epi64(m_Abs,Sum(ad));
+    m_Org    = _mm256_add_epi64(m_Org,Sum(a));
+    m_Dst    = _mm256_add_epi64(m_Dst,Sum(b));
+    m_Min    = _mm256_min_epi32(m_Min,_mm256_min_epi32(dlo,dhi));
+    m_Max    = _mm256_max_epi32(m_Max,_mm256_max_epi32(dlo,dhi));
+  }
+  //
+  TARGET_AVX2 void Finish(struct RowKernels::Moments &m)
+  {
+    UQUAD sq[4],ab[4],so[4],sd[4];
+    LONG min[8],max[8];
+    //
+    _mm256_storeu_si256((__m256i *)sq,m_Square);
+    _mm256_storeu_si256((__m256i *)ab,m_Abs);
+    _mm256_storeu_si256((__m256i *)so,m_Org);
+    _mm256_storeu_si256((__m256i *)sd,m_Dst);
+    _mm256_storeu_si256((__m256i *)min,m_Min);
+    _mm256_storeu_si256((__m256i *)max,m_Max);
+    IntegerMoments(m,4,sq,ab,so,sd,MinOf(min,8),MaxOf(max,8));
+  }
+};
+///
+
+/// struct AVX512Bytes
+// The AVX-512 kernel for 8 bit samples, see SSE2Bytes. Interleaved
+// components are selected with mask registers.
+struct AVX512Bytes {
+  typedef UBYTE    Sample;
+  typedef __m512i  Vector;
+  typedef __mmask64 Mask;
+  enum {
+    Lanes = 64,
+    Flush = 8192 // each 32 bit lane grows by at most 4*255^2 per step
+  };
+  __m512i m_Square;
+  __m512i m_SquareSum;
+  __m512i m_Abs;
+  __m512i m_Org;
+  __m512i m_Dst;
+  __m512i m_Min;
+  __m512i m_Max;
+  ULONG   m_ulSteps;
+  //
+  TARGET_AVX512 void Init(void)
+  {
+    m_Square    = _mm512_setzero_si512();
+    m_SquareSum = _mm512_setzero_si512();
+    m_Abs       = _mm512_setzero_si512();
+    m_Org       = _mm512_setzero_si512();
+    m_Dst       = _mm512_setzero_si512();
+    m_Min       = _mm512_set1_epi16(0x7fff);
+    m_Max       = _mm512_set1_epi16(-0x8000);
+    m_ulSteps   = 0;
+  }
+  //
+  TARGET_AVX512 static __m512i Load(const UBYTE *p)
+  {
+    return _mm512_loadu_si512((const void *)p);
+  }
+  //
+  TARGET_AVX512 static __mmask64 MaskOf(int r)
+  {
+    return __mmask64(PERIOD3_MASK << r);
+  }
+  //
+  TARGET_AVX512 static __m512i Select(__m512i v0,__m512i v1,__m512i v2,const __mmask64 *m)
+  {
+    return _mm512_mask_blend_epi8(m[2],_mm512_mask_blend_epi8(m[1],v0,v1),v2);
+  }
+  //
+  TARGET_AVX512 void FlushSquares(void)
+  {
+    __m512i zero = _mm512_setzero_si512();
+    //
+    m_SquareSum = _mm512_add_epi64(m_SquareSum,_mm512_add_epi64(_mm512_unpacklo_epi32(m_Square,zero),
+								 _mm512_unpackhi_epi32(m_Square,zero)));
+    m_Square    = zero;
+    m_ulSteps   = 0;
+  }
+  //
+  TARGET_AVX512 void Step(__m512i a,__m512i b)
+  {
+    __m512i zero = _mm512_setzero_si512();
+    __m512i ad   = _mm512_or_si512(_mm512_subs_epu8(a,b),_mm512_subs_epu8(b,a));
+    __m512i dlo  = _mm512_sub_epi16(_mm512_unpacklo_epi8(a,zero),_mm512_unpacklo_epi8(b,zero));
+    __m512i dhi  = _mm512_sub_epi16(_mm512_unpackhi_epi8(a,zero),_mm512_unpackhi_epi8(b,zero));
+    //
+    m_Abs    = _mm512_add_epi64(m_Abs,_mm512_sad_epu8(ad,zero));
+    m_Org    = _mm512_add_epi64(m_Org,_mm512_sad_epu8(a,zero));
+    m_Dst    = _mm512_add_epi64(m_Dst,_mm512_sad_epu8(b,zero));
+    m_Min    = _mm512_min_epi16(m_Min,_mm512_min_epi16(dlo,dhi));
+    m_Max    = _mm512_max_epi16(m_Max,_mm512_max_epi16(dlo,dhi));
+    m_Square = _mm512_add_epi32(m_Square,_mm512_add_epi32(_mm512_madd_epi16(dlo,dlo),
+							  _mm512_madd_epi16(dhi,dhi)));
+    if (++m_ulSteps >= Flush)
+      FlushSquares();
+  }
+  //
+  TARGET_AVX512 void Finish(struct RowKernels::Moments &m)
+  {
+    UQUAD sq[8],ab[8],so[8],sd[8];
+    WORD min[32],max[32];
+    //
+    FlushSquares();
+    _mm512_storeu_si512((void *)sq,m_SquareSum);
+    _mm512_storeu_si512((void *)ab,m_Abs);
+    _mm512_storeu_si512((void *)so,m_Org);
+    _mm512_storeu_si512((void *)sd,m_Dst);
+    _mm512_storeu_si512((void *)min,m_Min);
+    _mm512_storeu_si512((void *)max,m_Max);
+    IntegerMoments(m,8,sq,ab,so,sd,MinOf(min,32),MaxOf(max,32));
+  }
+};
+///
+
+/// struct AVX512Words
+// The AVX-512 kernel for 16 bit samples, see SSE2Words.
+struct AVX512Words {
+  typedef UWORD     Sample;
+  typedef __m512i   Vector;
+  typedef __mmask32 Mask;
+  enum {
+    Lanes = 32
+  };
+  __m512i m_Square;
+  __m512i m_Abs;
+  __m512i m_Org;
+  __m512i m_Dst;
+  __m512i m_Min;
+  __m512i m_Max;
+  //
+  TARGET_AVX512 void Init(void)
+  {
+    m_Square = _mm512_setzero_si512();
+    m_Abs    = _mm512_setzero_si512();
+    m_Org    = _mm512_setzero_si512();
+    m_Dst    = _mm512_setzero_si512();
+    m_Min    = _mm512_set1_epi32(0x7fffffff);
+    m_Max    = _mm512_set1_epi32(-0x7fffffff - 1);
+  }
+  //
+  TARGET_AVX512 static __m512i Load(const UWORD *p)
+  {
+    return _mm512_loadu_si512((const void *)p);
+  }
+  //
+  TARGET_AVX512 static __mmask32 MaskOf(int r)
+  {
+    return __mmask32(PERIOD3_MASK << r);
+  }
+  //
+  TARGET_AVX512 static __m512i Select(__m512i v0,__m512i v1,__m512i v2,const __mmask32 *m)
+  {
+    return _mm512_mask_blend_epi16(m[2],_mm512_mask_blend_epi16(m[1],v0,v1),v2);
+  }
+  //
+  TARGET_AVX512 static __m512i Sum(__m512i v)
+  {
+    __m512i zero = _mm512_setzero_si512();
+    //
+    return _mm512_add_epi64(_mm512_sad_epu8(_mm512_and_si512(v,_mm512_set1_epi16(0xff)),zero),
+			    _mm512_slli_epi64(_mm512_sad_epu8(_mm512_srli_epi16(v,8),zero),8));
+  }
+  //
+  TARGET_AVX512 static __m512i Squares(__m512i v)
+  {
+    __m512i odd = _mm512_srli_epi64(v,32);
+    //
+    return _mm512_add_epi64(_mm512_mul_epu32(v,v),_mm512_mul_epu32(odd,odd));
+  }
+  //
+  TARGET_AVX512 void Step(__m512i a,__m512i b)
+  {
+    __m512i zero = _mm512_setzero_si512();
+    __m512i ad   = _mm512_or_si512(_mm512_subs_epu16(a,b),_mm512_subs_epu16(b,a));
+    __m512i dlo  = _mm512_sub_epi32(_mm512_unpacklo_epi16(a,zero),_mm512_unpacklo_epi16(b,zero));
+    __m512i dhi  = _mm512_sub_epi32(_mm512_unpackhi_epi16(a,zero),_mm512_unpackhi_epi16(b,zero));
+    //
+    m_Square = _mm512_add_epi64(m_Square,_mm512_add_epi64(Squares(_mm512_unpacklo_epi16(ad,zero)),
+							   Squares(_mm512_unpackhi_epi16(ad,zero))));
+    m_Abs    = _mm512_add_epi64(m_Abs,Sum(ad));
+    m_Org    = _mm512_add_epi64(m_Org,Sum(a));
+    m_Dst    = _mm512_add_epi64(m_Dst,Sum(b));
+    m_Min    = _mm512_min_epi32(m_Min,_mm512_min_epi32(dlo,dhi));
+    m_Max    = _mm512_max_epi32(m_Max,_mm512_max_epi32(dlo,dhi));
+  }
+  //
+  TARGET_AVX512 void Finish(struct RowKernels::Moments &m)
+  {
+    UQUAD sq[8],ab[8],so[8],sd[8];
+    LONG min[16],max[16];
+    //
+    _mm512_storeu_si512((void *)sq,m_Square);
+    _mm512_storeu_si512((void *)ab,m_Abs);
+    _mm512_storeu_si512((void *)so,m_Org);
+    _mm512_storeu_si512((void *)sd,m_Dst);
+    _mm512_storeu_si512((void *)min,m_Min);
+    _mm512_storeu_si512((void *)max,m_Max);
+    IntegerMoments(m,8,sq,ab,so,sd,MinOf(min,16),MaxOf(max,16));
+  }
+};
+///
+
+/// TransformAVX2
+// Transform pixels by a fixed point matrix, eight at a time. This
+// requires samples of at most twelve bits. The coefficients are split
+// into their upper bits and their lower 16 bits, such that both sums
+// of products fit into 32 bits, and then recombined exactly. The
+// results are thus the same as those of the scalar code.
+TARGET_AVX2 static void TransformAVX2(LONG *c0,LONG *c1,LONG *c2,const QUAD *matrix,LONG limit,ULONG w)
+{
+  __m256i hi[12],lo[12];
+  __m256i low   = _mm256_set1_epi32(0xffff);
+  __m256i guard = _mm256_set1_epi32(1L << (RowKernels::FractionBits - 12));
+  __m256i lim   = _mm256_set1_epi32(limit);
+  __m256i zero  = _mm256_setzero_si256();
+  ULONG x = 0;
+  int i;
+
+  for(i = 0;i < 12;i++) {
+    hi[i] = _mm256_set1_epi32(LONG(matrix[i] >> 16));
+    lo[i] = _mm256_set1_epi32(LONG(matrix[i] & 0xffff));
+  }
+
+  for(;x + 8 <= w;x += 8) {
+    __m256i v0   = _mm256_loadu_si256((const __m256i *)(c0 + x));
+    __m256i v1   = _mm256_loadu_si256((const __m256i *)(c1 + x));
+    __m256i v2   = _mm256_loadu_si256((const __m256i *)(c2 + x));
+    __m256i near = zero;
+    __m256i out[3];
+    //
+    for(i = 0;i < 3;i++) {
+      const int k = 4 * i;
+      __m256i h   = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(hi[k],v0),_mm256_mullo_epi32(hi[k+1],v1)),
+				     _mm256_add_epi32(_mm256_mullo_epi32(hi[k+2],v2),hi[k+3]));
+      __m256i l   = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(lo[k],v0),_mm256_mullo_epi32(lo[k+1],v1)),
+				     _mm256_add_epi32(_mm256_mullo_epi32(lo[k+2],v2),lo[k+3]));
+      __m256i frac;
+      //
+      // Carry the lower sum into the upper, the result is h * 2^16 +
+      // (l & 0xffff), with the integer part in the upper 16 bits of h.
+      h    = _mm256_add_epi32(h,_mm256_srli_epi32(l,16));
+      frac = _mm256_or_si256(_mm256_slli_epi32(h,16),_mm256_and_si256(l,low));
+      near = _mm256_or_si256(near,
+			     _mm256_cmpeq_epi32(_mm256_srli_epi32(_mm256_add_epi32(frac,guard),
+								  RowKernels::FractionBits - 11),zero));
+      out[i] = _mm256_min_epi32(_mm256_max_epi32(_mm256_srai_epi32(h,16),zero),lim);
+    }
+    _mm256_storeu_si256((__m256i *)(c0 + x),_mm256_or_si256(out[0],near));
+    _mm256_storeu_si256((__m256i *)(c1 + x),out[1]);
+    _mm256_storeu_si256((__m256i *)(c2 + x),out[2]);
+  }
+  ScalarTransform(c0 + x,c1 + x,c2 + x,matrix,limit,w - x);
+}
+///
+
+/// Drivers
+// Run a kernel over a row of samples stored without gaps, or over a
+// row of three interleaved components. Each instruction set needs its
+// own copy such that the kernel methods can be inlined. Whatever does
+// not fill a complete vector is left to the scalar code.
+#define DEFINE_DRIVERS(level,target)						\
+template<class K>								\
+target static void Dense##level(const typename K::Sample *org,const typename K::Sample *dst, \
+				ULONG w,struct RowKernels::Moments &m)		\
+{										\
+  ULONG x = 0;									\
+										\
+  Clear(m);									\
+  if (w >= ULONG(K::Lanes)) {							\
+    K k;									\
+    k.Init();									\
+    for(;x + K::Lanes <= w;x += K::Lanes) {					\
+      k.Step(K::Load(org + x),K::Load(dst + x));				\
+    }										\
+    k.Finish(m);								\
+  }										\
+  ScalarMoments(org + x,dst + x,w - x,1,m);					\
+}										\
+										\
+template<class K>								\
+target static void Interleaved##level(const typename K::Sample *org,const typename K::Sample *dst, \
+				      ULONG w,struct RowKernels::Moments *m)	\
+{										\
+  ULONG x = 0;									\
+  int c,i;									\
+										\
+  for(c = 0;c < 3;c++)								\
+    Clear(m[c]);								\
+  if (w >= ULONG(K::Lanes)) {							\
+    K k[3];									\
+    typename K::Mask mask[3][3];						\
+    for(c = 0;c < 3;c++) {							\
+      k[c].Init();								\
+      for(i = 0;i < 3;i++)							\
+	mask[c][i] = K::MaskOf(ResidueOf(c,i,K::Lanes));			\
+    }										\
+    for(;x + K::Lanes <= w;x += K::Lanes) {					\
+      const typename K::Sample *o = org + 3 * x;				\
+      const typename K::Sample *d = dst + 3 * x;				\
+      typename K::Vector o0 = K::Load(o);					\
+      typename K::Vector o1 = K::Load(o + K::Lanes);				\
+      typename K::Vector o2 = K::Load(o + 2 * K::Lanes);			\
+      typename K::Vector d0 = K::Load(d);					\
+      typename K::Vector d1 = K::Load(d + K::Lanes);				\
+      typename K::Vector d2 = K::Load(d + 2 * K::Lanes);			\
+      for(c = 0;c < 3;c++) {							\
+	k[c].Step(K::Select(o0,o1,o2,mask[c]),K::Select(d0,d1,d2,mask[c]));	\
+      }										\
+    }										\
+    for(c = 0;c < 3;c++)							\
+      k[c].Finish(m[c]);							\
+  }										\
+  for(c = 0;c < 3;c++)								\
+    ScalarMoments(org + 3 * x + c,dst + 3 * x + c,w - x,3,m[c]);		\
+}
+
+DEFINE_DRIVERS(SSE2,TARGET_SSE2)
+DEFINE_DRIVERS(AVX2,TARGET_AVX2)
+DEFINE_DRIVERS(AVX512,TARGET_AVX512)
+#undef DEFINE_DRIVERS
+///
+#endif
+
+/// struct Dispatch
+// The kernels selected for this machine.
+struct Dispatch {
+  RowKernels::Level m_Level;
+  void (*m_pDenseBytes)(const UBYTE *,const UBYTE *,ULONG,struct RowKernels::Moments &);
+  void (*m_pDenseWords)(const UWORD *,const UWORD *,ULONG,struct RowKernels::Moments &);
+  void (*m_pInterleavedBytes)(const UBYTE *,const UBYTE *,ULONG,struct RowKernels::Moments *);
+  void (*m_pInterleavedWords)(const UWORD *,const UWORD *,ULONG,struct RowKernels::Moments *);
+  void (*m_pTransform)(LONG *,LONG *,LONG *,const QUAD *,LONG,ULONG);
+};
+///
+
+/// Resolve
+// Pick the kernels for the instruction sets this machine supports.
+static struct Dispatch Resolve(void)
+{
+  struct Dispatch d;
+
+  d.m_Level               = RowKernels::Scalar;
+  d.m_pDenseBytes         = &ScalarDense<UBYTE>;
+  d.m_pDenseWords         = &ScalarDense<UWORD>;
+  d.m_pInterleavedBytes   = &ScalarInterleaved<UBYTE>;
+  d.m_pInterleavedWords   = &ScalarInterleaved<UWORD>;
+  d.m_pTransform          = &ScalarTransform;
+
+#ifdef HAVE_X86_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+    d.m_Level               = RowKernels::AVX512;
+    d.m_pDenseBytes         = &DenseAVX512<AVX512Bytes>;
+    d.m_pDenseWords         = &DenseAVX512<AVX512Words>;
+    d.m_pInterleavedBytes   = &InterleavedAVX512<AVX512Bytes>;
+    d.m_pInterleavedWords   = &InterleavedAVX512<AVX512Words>;
+    d.m_pTransform          = &TransformAVX2;
+  } else if (__builtin_cpu_supports("avx2")) {
+    d.m_Level               = RowKernels::AVX2;
+    d.m_pDenseBytes         = &DenseAVX2<AVX2Bytes>;
+    d.m_pDenseWords         = &DenseAVX2<AVX2Words>;
+    d.m_pInterleavedBytes   = &InterleavedAVX2<AVX2Bytes>;
+    d.m_pInterleavedWords   = &InterleavedAVX2<AVX2Words>;
+    d.m_pTransform          = &TransformAVX2;
+  } else if (__builtin_cpu_supports("sse2")) {
+    d.m_Level               = RowKernels::SSE2;
+    d.m_pDenseBytes         = &DenseSSE2<SSE2Bytes>;
+    d.m_pDenseWords         = &DenseSSE2<SSE2Words>;
+    d.m_pInterleavedBytes   = &InterleavedSSE2<SSE2Bytes>;
+    d.m_pInterleavedWords   = &InterleavedSSE2<SSE2Words>;
+  }
+#endif
+
+  return d;
+}
+///
+
+/// DispatchOf
+// Return the kernels for this machine, resolved on first use.
+static const struct Dispatch &DispatchOf(void)
+{
+  static const struct Dispatch dispatch = Resolve();
+
+  return dispatch;
+}
+///
+
+/// RowKernels::LevelOf
+// Return the instruction set the kernels use on this machine.
+RowKernels::Level RowKernels::LevelOf(void)
+{
+  return DispatchOf().m_Level;
+}
+///
+
+/// RowKernels::Dense
+// Collect the moments of w samples stored without gaps.
+void RowKernels::Dense(const UBYTE *org,const UBYTE *dst,ULONG w,struct Moments &m)
+{
+  DispatchOf().m_pDenseBytes(org,dst,w,m);
+}
+///
+
+/// RowKernels::Dense
+// Collect the moments of w samples stored without gaps.
+void RowKernels::Dense(const UWORD *org,const UWORD *dst,ULONG w,struct Moments &m)
+{
+  DispatchOf().m_pDenseWords(org,dst,w,m);
+}
+///
+
+/// RowKernels::Interleaved
+// Collect the moments of w pixels of three interleaved components.
+void RowKernels::Interleaved(const UBYTE *org,const UBYTE *dst,ULONG w,struct Moments *m)
+{
+  DispatchOf().m_pInterleavedBytes(org,dst,w,m);
+}
+///
+
+/// RowKernels::Interleaved
+// Collect the moments of w pixels of three interleaved components.
+void RowKernels::Interleaved(const UWORD *org,const UWORD *dst,ULONG w,struct Moments *m)
+{
+  DispatchOf().m_pInterleavedWords(org,dst,w,m);
+}
+///
+
+/// RowKernels::Transform
+// Transform w pixels of three components by a fixed point matrix.
+void RowKernels::Transform(LONG *c0,LONG *c1,LONG *c2,const QUAD *matrix,LONG limit,UBYTE bits,ULONG w)
+{
+  // The vector kernels compute in 32 bits, which only suffices for
+  // twelve bit samples.
+  if (bits > 12) {
+    ScalarTransform(c0,c1,c2,matrix,limit,w);
+  } else {
+    DispatchOf().m_pTransform(c0,c1,c2,matrix,limit,w);
+  }
+}
+///
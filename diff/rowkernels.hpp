@@ -0,0 +1,101 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software) for Accusoft	        **
+** All Rights Reserved							**
+**************************************************************************
+
+This source file is part of difftest_ng, a universal image measuring
+and conversion framework.
+
+    difftest_ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    difftest_ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with difftest_ng.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/*
+**
+** $Id: rowkernels.hpp,v 1.1 2022/09/06 10:02:37 thor Exp $
+**
+** Vectorized kernels that collect the moments of the differences
+** of a single row of samples, for the sample types and layouts that
+** are common enough to deserve them. The instruction set is picked
+** at run time.
+*/
+
+#ifndef DIFF_ROWKERNELS_HPP
+#define DIFF_ROWKERNELS_HPP
+
+/// Includes
+#include "interface/types.hpp"
+///
+
+/// class RowKernels
+// Vectorized kernels that collect the moments of the differences
+// of a single row of samples, for the sample types and layouts that
+// are common enough to deserve them. The instruction set is picked
+// at run time. Only integer samples are covered, floating point sums
+// would depend on the number of lanes of the instruction set.
+class RowKernels {
+public:
+  //
+  // The moments of the differences org - dst of a row.
+  struct Moments {
+    //
+    // Sum of squared, absolute and signed differences. These are
+    // exact, hence independent of the instruction set.
+    double m_dSquareError;
+    double m_dAbsError;
+    double m_dDrift;
+    //
+    // Minimum and maximum signed difference.
+    double m_dMinDiff;
+    double m_dMaxDiff;
+  };
+  //
+  // The instruction sets kernels exist for.
+  enum Level {
+    Scalar,  // no vector kernels, plain C++
+    SSE2,
+    AVX2,
+    AVX512   // AVX-512F and AVX-512BW
+  };
+  //
+  // The number of fractional bits of the matrices of Transform().
+  enum {
+    FractionBits = 32
+  };
+  //
+  // Return the instruction set the kernels use on this machine.
+  static Level LevelOf(void);
+  //
+  // Collect the moments of w samples stored without gaps.
+  static void Dense(const UBYTE *org,const UBYTE *dst,ULONG w,struct Moments &m);
+  static void Dense(const UWORD *org,const UWORD *dst,ULONG w,struct Moments &m);
+  //
+  // Collect the moments of w pixels of three interleaved components,
+  // one set of moments per component.
+  static void Interleaved(const UBYTE *org,const UBYTE *dst,ULONG w,struct Moments *m);
+  static void Interleaved(const UWORD *org,const UWORD *dst,ULONG w,struct Moments *m);
+  //
+  // Transform w pixels of three components of the given bit depth,
+  // at most 16, stored without gaps, by a fixed point matrix. Each of
+  // its three rows holds the coefficients of c0, c1 and c2 and an
+  // offset. The results are truncated, clipped to 0..limit and stored
+  // back into c0, c1 and c2. Pixels of which one result is closer than
+  // 2^-12 to an integer are marked by -1 in c0 instead, the caller has
+  // to compute them with a more precise method.
+  static void Transform(LONG *c0,LONG *c1,LONG *c2,const QUAD *matrix,LONG limit,UBYTE bits,ULONG w);
+};
+///
+
+///
+#endif
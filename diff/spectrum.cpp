@@ -0,0 +1,238 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software) for Accusoft	        **
+** All Rights Reserved							**
+**************************************************************************
+
+This source file is part of difftest_ng, a universal image measuring
+and conversion framework.
+
+    difftest_ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    difftest_ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with difftest_ng.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/*
+**
+** $Id: spectrum.cpp,v 1.1 2022/09/09 09:41:23 thor Exp $
+**
+** This class keeps the fourier transformations of the difference
+** between two images the spectral meters need, and keeps them until
+** the images change.
+*/
+
+/// Includes
+#include "diff/spectrum.hpp"
+#include "img/imglayout.hpp"
+#include "tools/fft.hpp"
+#include "std/string.hpp"
+#include "std/assert.hpp"
+///
+
+/// Spectrum::CopyToFFT
+// Copy the difference between the images into the input of
+// the transformation.
+template<typename T>
+void Spectrum::CopyToFFT(T *org,ULONG obytesperpixel,ULONG obytesperrow,
+			 T *dst,ULONG dbytesperpixel,ULONG dbytesperrow,
+			 double *target,ULONG stride,ULONG w,ULONG h)
+{
+  ULONG x,y;
+
+  for(y = 0;y < h;y++) {
+    T *orgrow      = org;
+    T *dstrow      = dst;
+    double *trgrow = target + y * stride;
+    for(x = 0;x < w;x++) {
+      *trgrow     = *orgrow - *dstrow; // the input is real.
+      //
+      orgrow      = (T *)((const UBYTE *)(orgrow) + obytesperpixel);
+      dstrow      = (T *)((const UBYTE *)(dstrow) + dbytesperpixel);
+      trgrow++;
+    }
+    org = (T *)((const UBYTE *)(org) + obytesperrow);
+    dst = (T *)((const UBYTE *)(dst) + dbytesperrow);
+  }
+}
+///
+
+/// Spectrum::Transform
+// Fill in the difference of the given component and run the
+// transformation.
+void Spectrum::Transform(const class ImageLayout *src,const class ImageLayout *dst,UWORD comp,
+			 class FFT *fft)
+{
+  ULONG w = src->WidthOf(comp);
+  ULONG h = src->HeightOf(comp);
+
+  if (src->isSigned(comp)) {
+    if (src->BitsOf(comp) <= 8) {
+      CopyToFFT<const BYTE>((const BYTE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
+			    (const BYTE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
+			    fft->DataOf(),fft->ModuloOf(),w,h);
+    } else if (!src->isFloat(comp) && src->BitsOf(comp) <= 16) {
+      CopyToFFT<const WORD>((const WORD *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
+			    (const WORD *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
+			    fft->DataOf(),fft->ModuloOf(),w,h);
+    } else if (!src->isFloat(comp) && src->BitsOf(comp) <= 32) {
+      CopyToFFT<const LONG>((const LONG *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
+			    (const LONG *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
+			    fft->DataOf(),fft->ModuloOf(),w,h);
+    } else if (src->BitsOf(comp) <= 32 && src->isFloat(comp)) {
+      CopyToFFT<const FLOAT>((const FLOAT *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
+			     (const FLOAT *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
+			     fft->DataOf(),fft->ModuloOf(),w,h);
+    } else if (src->BitsOf(comp) == 64 && src->isFloat(comp)) {
+      CopyToFFT<const DOUBLE>((const DOUBLE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
+			      (const DOUBLE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
+			      fft->DataOf(),fft->ModuloOf(),w,h);
+    } else {
+      throw "unsupported data type";
+    }
+  } else {
+    if (src->BitsOf(comp) <= 8) {
+      CopyToFFT<const UBYTE>((const UBYTE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
+			     (const UBYTE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
+			     fft->DataOf(),fft->ModuloOf(),w,h);
+    } else if (!src->isFloat(comp) && src->BitsOf(comp) <= 16) {
+      CopyToFFT<const UWORD>((const UWORD *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
+			     (const UWORD *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
+			     fft->DataOf(),fft->ModuloOf(),w,h);
+    } else if (!src->isFloat(comp) && src->BitsOf(comp) <= 32) {
+      CopyToFFT<const ULONG>((const ULONG *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
+			     (const ULONG *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
+			     fft->DataOf(),fft->ModuloOf(),w,h);
+    } else if (src->BitsOf(comp) <= 32 && src->isFloat(comp)) {
+      CopyToFFT<const FLOAT>((const FLOAT *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
+			     (const FLOAT *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
+			     fft->DataOf(),fft->ModuloOf(),w,h);
+    } else if (src->BitsOf(comp) == 64 && src->isFloat(comp)) {
+      CopyToFFT<const DOUBLE>((const DOUBLE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
+			      (const DOUBLE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
+			      fft->DataOf(),fft->ModuloOf(),w,h);
+    } else {
+      throw "unsupported data type";
+    }
+  }
+  //
+  // Run the transformation.
+  fft->ForwardsFFT();
+}
+///
+
+/// Spectrum::Release
+// Release the transformations.
+void Spectrum::Release(void)
+{
+  int i;
+  UWORD comp;
+
+  for(i = 0;i < 2;i++) {
+    if (m_ppFFT[i]) {
+      for(comp = 0;comp < m_usDepth;comp++) {
+	delete m_ppFFT[i][comp];
+      }
+      delete[] m_ppFFT[i];
+      m_ppFFT[i] = NULL;
+    }
+  }
+  delete[] m_pKey;
+  m_pKey    = NULL;
+  m_usDepth = 0;
+  m_bValid  = false;
+  m_pOrg    = NULL;
+  m_pDst    = NULL;
+}
+///
+
+/// Spectrum::isCurrent
+// Check whether the transformations are still valid for the
+// given image pair.
+bool Spectrum::isCurrent(const class ImageLayout *org,const class ImageLayout *dst) const
+{
+  UWORD comp;
+
+  if (!m_bValid)
+    return false;
+
+  if (org != m_pOrg || dst != m_pDst || org->DepthOf() != m_usDepth)
+    return false;
+
+  for(comp = 0;comp < m_usDepth;comp++) {
+    if (m_pKey[comp].m_pOrgData != org->DataOf(comp) ||
+	m_pKey[comp].m_pDstData != dst->DataOf(comp) ||
+	m_pKey[comp].m_ulWidth  != org->WidthOf(comp) ||
+	m_pKey[comp].m_ulHeight != org->HeightOf(comp))
+      return false;
+  }
+
+  return true;
+}
+///
+
+/// Spectrum::Prepare
+// Prepare the transformations for the given image pair.
+void Spectrum::Prepare(const class ImageLayout *org,const class ImageLayout *dst)
+{
+  UWORD comp,d = org->DepthOf();
+  int i;
+  //
+  Release();
+  //
+  m_pKey = new struct Key[d];
+  for(i = 0;i < 2;i++) {
+    m_ppFFT[i] = new class FFT *[d];
+    memset(m_ppFFT[i],0,sizeof(class FFT *) * d);
+  }
+  m_usDepth = d;
+  //
+  for(comp = 0;comp < d;comp++) {
+    m_pKey[comp].m_pOrgData = org->DataOf(comp);
+    m_pKey[comp].m_pDstData = dst->DataOf(comp);
+    m_pKey[comp].m_ulWidth  = org->WidthOf(comp);
+    m_pKey[comp].m_ulHeight = org->HeightOf(comp);
+  }
+  m_pOrg   = org;
+  m_pDst   = dst;
+  m_bValid = true;
+}
+///
+
+/// Spectrum::TransformOf
+// Return the transformation of the difference between the given
+// component of the images, with or without windowing. Compute it
+// if it is not yet available.
+const class FFT *Spectrum::TransformOf(const class ImageLayout *org,const class ImageLayout *dst,UWORD comp,
+				       bool window)
+{
+  class FFT **slot;
+
+  if (!isCurrent(org,dst))
+    Prepare(org,dst);
+
+  assert(comp < m_usDepth);
+
+  slot = m_ppFFT[window?1:0] + comp;
+  if (*slot == NULL) {
+    class FFT *fft = new class FFT(org->WidthOf(comp),org->HeightOf(comp),window);
+    try {
+      Transform(org,dst,comp,fft);
+    } catch(...) {
+      delete fft;
+      throw;
+    }
+    *slot = fft;
+  }
+
+  return *slot;
+}
+///
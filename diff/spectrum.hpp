@@ -0,0 +1,129 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software) for Accusoft	        **
+** All Rights Reserved							**
+**************************************************************************
+
+This source file is part of difftest_ng, a universal image measuring
+and conversion framework.
+
+    difftest_ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    difftest_ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with difftest_ng.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/*
+**
+** $Id: spectrum.hpp,v 1.1 2022/09/09 09:41:23 thor Exp $
+**
+** This class keeps the fourier transformations of the difference
+** between two images the spectral meters need, and keeps them until
+** the images change.
+*/
+
+#ifndef DIFF_SPECTRUM_HPP
+#define DIFF_SPECTRUM_HPP
+
+/// Includes
+#include "interface/types.hpp"
+///
+
+/// Forwards
+class ImageLayout;
+class FFT;
+///
+
+/// class Spectrum
+// This class keeps the fourier transformations of the difference
+// between two images the spectral meters need, and keeps them until
+// the images change. Transformations with and without windowing are
+// kept apart.
+class Spectrum {
+  //
+  // The transformations of each component, without and with
+  // windowing. Entries are NULL until requested.
+  class FFT              **m_ppFFT[2];
+  //
+  // Number of components the transformations are valid for.
+  UWORD                    m_usDepth;
+  //
+  // Set while the transformations are valid. Reset if the images
+  // have been modified.
+  bool                     m_bValid;
+  //
+  // The images the transformations belong to.
+  const class ImageLayout *m_pOrg;
+  const class ImageLayout *m_pDst;
+  //
+  // The data pointers and dimensions the transformations were
+  // computed on. Used to detect that the images changed underneath.
+  struct Key {
+    const void *m_pOrgData;
+    const void *m_pDstData;
+    ULONG       m_ulWidth;
+    ULONG       m_ulHeight;
+  }                       *m_pKey;
+  //
+  // Release the transformations.
+  void Release(void);
+  //
+  // Check whether the transformations are still valid for the
+  // given image pair.
+  bool isCurrent(const class ImageLayout *org,const class ImageLayout *dst) const;
+  //
+  // Prepare the transformations for the given image pair.
+  void Prepare(const class ImageLayout *org,const class ImageLayout *dst);
+  //
+  // Copy the difference between the images into the input of
+  // the transformation.
+  template<typename T>
+  static void CopyToFFT(T *org       ,ULONG obytesperpixel,ULONG obytesperrow,
+			T *dst       ,ULONG dbytesperpixel,ULONG dbytesperrow,
+			double *trg  ,ULONG stride,ULONG w,ULONG h);
+  //
+  // Fill in the difference of the given component and run the
+  // transformation.
+  static void Transform(const class ImageLayout *org,const class ImageLayout *dst,UWORD comp,
+			class FFT *fft);
+  //
+public:
+  //
+  Spectrum(void)
+    : m_usDepth(0), m_bValid(false), m_pOrg(NULL), m_pDst(NULL), m_pKey(NULL)
+  {
+    m_ppFFT[0] = NULL;
+    m_ppFFT[1] = NULL;
+  }
+  //
+  ~Spectrum(void)
+  {
+    Release();
+  }
+  //
+  // Forget the transformations because the images have been
+  // modified, e.g. by a filter.
+  void Invalidate(void)
+  {
+    m_bValid = false;
+  }
+  //
+  // Return the transformation of the difference between the given
+  // component of the images, with or without windowing. Compute it
+  // if it is not yet available. The transformation is shared with
+  // other meters and must not be modified.
+  const class FFT *TransformOf(const class ImageLayout *org,const class ImageLayout *dst,UWORD comp,
+			       bool window);
+};
+///
+
+///
+#endif
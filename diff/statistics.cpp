@@ -0,0 +1,1159 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software) for Accusoft	        **
+** All Rights Reserved							**
+**************************************************************************
+
+This source file is part of difftest_ng, a universal image measuring
+and conversion framework.
+
+    difftest_ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    difftest_ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with difftest_ng.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/*
+**
+** $Id: statistics.cpp,v 1.1 2022/09/02 08:12:44 thor Exp $
+**
+** This class collects all point-wise statistics between two images
+** the scalar meters need in a single pass over the data, and keeps
+** them until the images change.
+*/
+
+/// Includes
+#include "diff/statistics.hpp"
+#include "img/imglayout.hpp"
+#include "std/math.hpp"
+#include "std/string.hpp"
+#include "std/assert.hpp"
+#include "tools/threadpool.hpp"
+#include "diff/rowkernels.hpp"
+///
+
+/// Statistics::Accumulate
+// The templated kernel: Accumulate everything requested in one
+// pass over h rows, the first of which is row y0 of the image.
+// Sums are formed per row first and then added to the result.
+template<typename T>
+void Statistics::Accumulate(const void *orgdata,ULONG obytesperpixel,ULONG obytesperrow,
+			    const void *dstdata,ULONG dbytesperpixel,ULONG dbytesperrow,
+			    ULONG w,ULONG h,ULONG y0,ULONG flags,struct Result &res,
+			    ULONG *hist,LONG offset,double *rows,double *columns)
+{
+  T *org = (T *)orgdata;
+  T *dst = (T *)dstdata;
+  ULONG x,y;
+
+  for(y = 0;y < h;y++) {
+    double sqerr  = 0.0;
+    double abserr = 0.0;
+    double drift  = 0.0;
+    double energy = 0.0;
+    double rel    = 0.0;
+    T *orgrow     = org;
+    T *dstrow     = dst;
+    for(x = 0;x < w;x++) {
+      double vorg = *orgrow;
+      double vdst = *dstrow;
+      double diff = vorg - vdst;
+      //
+      if (flags & (SquareError | RowError | RowProfile))
+	sqerr  += diff * diff;
+      if (columns)
+	columns[x] += diff * diff;
+      if (flags & AbsError)
+	abserr += fabs(diff);
+      if (flags & Drift)
+	drift  += diff;
+      if (flags & Extrema) {
+	if (diff < res.m_dMinDiff)
+	  res.m_dMinDiff = diff;
+	if (diff > res.m_dMaxDiff)
+	  res.m_dMaxDiff = diff;
+      }
+      if (flags & Peak) {
+	double peak = fabs(diff);
+	if (peak > res.m_dPeak) {
+	  res.m_dPeak   = peak;
+	  res.m_ulPeakX = x;
+	  res.m_ulPeakY = y + y0;
+	}
+      }
+      if (flags & Energy) {
+	double orq = vorg * vorg;
+	energy += orq;
+	if (orq > res.m_dMaxSquare)
+	  res.m_dMaxSquare = orq;
+      }
+      if (flags & Range) {
+	if (vorg < res.m_dToe)
+	  res.m_dToe  = vorg;
+	if (vorg > res.m_dHead)
+	  res.m_dHead = vorg;
+      }
+      if (flags & Relative) {
+	double norm = vorg * vorg + vdst * vdst;
+	if (norm > 0.0)
+	  rel += (diff * diff) / norm;
+      }
+      if (hist) {
+	LONG d = LONG(*orgrow) - LONG(*dstrow) + offset;
+	assert(d >= 0);
+	hist[d]++;
+      }
+      //
+      orgrow      = (T *)((const UBYTE *)(orgrow) + obytesperpixel);
+      dstrow      = (T *)((const UBYTE *)(dstrow) + dbytesperpixel);
+    }
+    res.m_dSquareError += sqerr;
+    res.m_dAbsError    += abserr;
+    res.m_dDrift       += drift;
+    res.m_dEnergy      += energy;
+    res.m_dRelative    += rel;
+    if (sqerr > res.m_dMaxRowError)
+      res.m_dMaxRowError = sqerr;
+    if (rows)
+      rows[y] = sqerr;
+    org = (T *)((const UBYTE *)(org) + obytesperrow);
+    dst = (T *)((const UBYTE *)(dst) + dbytesperrow);
+  }
+}
+///
+
+/// FoldRow
+// Add the moments of a row delivered by the row kernels to the
+// result. If the row contains a new peak, it is located with the
+// same arithmetic the templated kernel uses.
+template<typename T>
+static void FoldRow(const struct RowKernels::Moments &m,const T *org,const T *dst,ULONG step,
+		    ULONG w,ULONG y,ULONG flags,struct Statistics::Result &res)
+{
+  res.m_dSquareError += m.m_dSquareError;
+  res.m_dAbsError    += m.m_dAbsError;
+  res.m_dDrift       += m.m_dDrift;
+  if (m.m_dSquareError > res.m_dMaxRowError)
+    res.m_dMaxRowError = m.m_dSquareError;
+  if (m.m_dMinDiff < res.m_dMinDiff)
+    res.m_dMinDiff = m.m_dMinDiff;
+  if (m.m_dMaxDiff > res.m_dMaxDiff)
+    res.m_dMaxDiff = m.m_dMaxDiff;
+
+  if ((flags & Statistics::Peak) && (m.m_dMaxDiff > res.m_dPeak || -m.m_dMinDiff > res.m_dPeak)) {
+    ULONG x;
+    for(x = 0;x < w;x++) {
+      double vorg = *org;
+      double vdst = *dst;
+      double peak = fabs(vorg - vdst);
+      if (peak > res.m_dPeak) {
+	res.m_dPeak   = peak;
+	res.m_ulPeakX = x;
+	res.m_ulPeakY = y;
+      }
+      org += step;
+      dst += step;
+    }
+  }
+}
+///
+
+/// AddColumns
+// Add the squared differences of a row, still in the cache from the
+// row kernels, to the column sums.
+template<typename T>
+static void AddColumns(const T *org,const T *dst,ULONG step,ULONG w,double *columns)
+{
+  ULONG x;
+
+  for(x = 0;x < w;x++) {
+    double vorg = *org;
+    double vdst = *dst;
+    double diff = vorg - vdst;
+    columns[x] += diff * diff;
+    org += step;
+    dst += step;
+  }
+}
+///
+
+/// Statistics::Dense
+// The kernel for samples stored without gaps, running the rows
+// through the row kernels.
+template<typename T>
+void Statistics::Dense(const void *orgdata,ULONG,ULONG obytesperrow,
+		       const void *dstdata,ULONG,ULONG dbytesperrow,
+		       ULONG w,ULONG h,ULONG y0,ULONG flags,struct Result &res,
+		       ULONG *,LONG,double *rows,double *columns)
+{
+  const UBYTE *org = (const UBYTE *)orgdata;
+  const UBYTE *dst = (const UBYTE *)dstdata;
+  struct RowKernels::Moments m;
+  ULONG y;
+
+  for(y = 0;y < h;y++) {
+    RowKernels::Dense((const T *)org,(const T *)dst,w,m);
+    FoldRow(m,(const T *)org,(const T *)dst,1,w,y + y0,flags,res);
+    if (rows)
+      rows[y] = m.m_dSquareError;
+    if (columns)
+      AddColumns((const T *)org,(const T *)dst,1,w,columns);
+    org += obytesperrow;
+    dst += dbytesperrow;
+  }
+}
+///
+
+/// Statistics::Interleaved
+// The kernel for three interleaved components, running the rows
+// through the row kernels.
+template<typename T>
+void Statistics::Interleaved(const void *orgdata,ULONG obytesperrow,
+			     const void *dstdata,ULONG dbytesperrow,
+			     ULONG w,ULONG h,ULONG y0,ULONG flags,struct Result **res,
+			     double **rows,double **columns)
+{
+  const UBYTE *org = (const UBYTE *)orgdata;
+  const UBYTE *dst = (const UBYTE *)dstdata;
+  struct RowKernels::Moments m[3];
+  ULONG y;
+  int c;
+
+  for(y = 0;y < h;y++) {
+    RowKernels::Interleaved((const T *)org,(const T *)dst,w,m);
+    for(c = 0;c < 3;c++) {
+      FoldRow(m[c],(const T *)org + c,(const T *)dst + c,3,w,y + y0,flags,*res[c]);
+      if (rows[c])
+	rows[c][y] = m[c].m_dSquareError;
+      if (columns[c])
+	AddColumns((const T *)org + c,(const T *)dst + c,3,w,columns[c]);
+    }
+    org += obytesperrow;
+    dst += dbytesperrow;
+  }
+}
+///
+
+/// RowSampleSizeOf
+// Return the sample size of the component if the row kernels
+// support its type, or zero. Types are classified as in
+// Statistics::KernelOf. Floating point components remain on the
+// templated kernels, which sum in the same order whatever the
+// instruction set and the requested meters.
+static ULONG RowSampleSizeOf(const class ImageLayout *img,UWORD comp)
+{
+  if (img->BitsOf(comp) <= 8)
+    return (img->isSigned(comp))?(0):(sizeof(UBYTE));
+  if (img->isFloat(comp))
+    return 0;
+  if (!img->isSigned(comp) && img->BitsOf(comp) <= 16)
+    return sizeof(UWORD);
+  return 0;
+}
+///
+
+/// Statistics::KernelOf
+// Return the kernel suitable for the given component.
+Statistics::Kernel Statistics::KernelOf(const class ImageLayout *org,const class ImageLayout *dst,UWORD comp,
+					ULONG flags)
+{
+  const class ImageLayout *img = org;
+
+  if ((flags & ~RowMoments) == 0 && RowKernels::LevelOf() != RowKernels::Scalar) {
+    ULONG size = RowSampleSizeOf(org,comp);
+    if (size && org->BytesPerPixel(comp) == size && dst->BytesPerPixel(comp) == size) {
+      switch(size) {
+      case sizeof(UBYTE):
+	return &Dense<UBYTE>;
+      case sizeof(UWORD):
+	return &Dense<UWORD>;
+      }
+    }
+  }
+
+  if (img->isSigned(comp)) {
+    if (img->BitsOf(comp) <= 8) {
+      return &Accumulate<const BYTE>;
+    } else if (!img->isFloat(comp) && img->BitsOf(comp) <= 16) {
+      return &Accumulate<const WORD>;
+    } else if (!img->isFloat(comp) && img->BitsOf(comp) <= 32) {
+      return &Accumulate<const LONG>;
+    } else if (img->BitsOf(comp) <= 32 && img->isFloat(comp)) {
+      return &Accumulate<const FLOAT>;
+    } else if (img->BitsOf(comp) == 64 && img->isFloat(comp)) {
+      return &Accumulate<const DOUBLE>;
+    }
+  } else {
+    if (img->BitsOf(comp) <= 8) {
+      return &Accumulate<const UBYTE>;
+    } else if (!img->isFloat(comp) && img->BitsOf(comp) <= 16) {
+      return &Accumulate<const UWORD>;
+    } else if (!img->isFloat(comp) && img->BitsOf(comp) <= 32) {
+      return &Accumulate<const ULONG>;
+    } else if (img->BitsOf(comp) <= 32 && img->isFloat(comp)) {
+      return &Accumulate<const FLOAT>;
+    } else if (img->BitsOf(comp) == 64 && img->isFloat(comp)) {
+      return &Accumulate<const DOUBLE>;
+    }
+  }
+  throw "unsupported data type";
+}
+///
+
+/// Statistics::GroupKernelOf
+// Return the kernel for the three interleaved components starting
+// at the given component, or NULL if they are not interleaved.
+Statistics::GroupKernel Statistics::GroupKernelOf(const class ImageLayout *org,const class ImageLayout *dst,
+						  UWORD comp,ULONG flags)
+{
+  ULONG size;
+  UWORD i;
+
+  if ((flags & ~RowMoments) || RowKernels::LevelOf() == RowKernels::Scalar)
+    return NULL;
+
+  if (comp + 3 > org->DepthOf())
+    return NULL;
+
+  size = RowSampleSizeOf(org,comp);
+  if (size == 0)
+    return NULL;
+
+  for(i = 0;i < 3;i++) {
+    if (RowSampleSizeOf(org,comp + i) != size ||
+	org->isFloat(comp + i)          != org->isFloat(comp) ||
+	org->WidthOf(comp + i)          != org->WidthOf(comp) ||
+	org->HeightOf(comp + i)         != org->HeightOf(comp) ||
+	org->BytesPerPixel(comp + i)    != 3 * size ||
+	dst->BytesPerPixel(comp + i)    != 3 * size ||
+	org->BytesPerRow(comp + i)      != org->BytesPerRow(comp) ||
+	dst->BytesPerRow(comp + i)      != dst->BytesPerRow(comp) ||
+	org->DataOf(comp + i) != (const UBYTE *)org->DataOf(comp) + i * size ||
+	dst->DataOf(comp + i) != (const UBYTE *)dst->DataOf(comp) + i * size)
+      return NULL;
+  }
+
+  switch(size) {
+  case sizeof(UBYTE):
+    return &Interleaved<UBYTE>;
+  case sizeof(UWORD):
+    return &Interleaved<UWORD>;
+  }
+  return NULL;
+}
+///
+
+/// Statistics::Reset
+// Reset a result to the neutral element.
+void Statistics::Reset(struct Result &res)
+{
+  res.m_dSquareError     = 0.0;
+  res.m_dAbsError        = 0.0;
+  res.m_dDrift           = 0.0;
+  res.m_dMinDiff         = HUGE_VAL;
+  res.m_dMaxDiff         = -HUGE_VAL;
+  res.m_dPeak            = 0.0;
+  res.m_ulPeakX          = 0;
+  res.m_ulPeakY          = 0;
+  res.m_dEnergy          = 0.0;
+  res.m_dMaxSquare       = 0.0;
+  res.m_dToe             = HUGE_VAL;
+  res.m_dHead            = -HUGE_VAL;
+  res.m_dRelative        = 0.0;
+  res.m_dMaxRowError     = 0.0;
+  res.m_pdRowError       = NULL;
+  res.m_pdColumnError    = NULL;
+  res.m_pulHistogram     = NULL;
+  res.m_ulHistogramSize  = 0;
+  res.m_lHistogramOffset = 0;
+}
+///
+
+/// Statistics::Merge
+// Combine the result of the given band into the target, which
+// is the result of the bands above it. On ties, the peak found
+// first in scan order wins.
+void Statistics::Merge(struct Result &target,const struct Result &band)
+{
+  target.m_dSquareError += band.m_dSquareError;
+  target.m_dAbsError    += band.m_dAbsError;
+  target.m_dDrift       += band.m_dDrift;
+  target.m_dEnergy      += band.m_dEnergy;
+  target.m_dRelative    += band.m_dRelative;
+  if (band.m_dMinDiff < target.m_dMinDiff)
+    target.m_dMinDiff = band.m_dMinDiff;
+  if (band.m_dMaxDiff > target.m_dMaxDiff)
+    target.m_dMaxDiff = band.m_dMaxDiff;
+  if (band.m_dPeak > target.m_dPeak) {
+    target.m_dPeak   = band.m_dPeak;
+    target.m_ulPeakX = band.m_ulPeakX;
+    target.m_ulPeakY = band.m_ulPeakY;
+  }
+  if (band.m_dMaxSquare > target.m_dMaxSquare)
+    target.m_dMaxSquare = band.m_dMaxSquare;
+  if (band.m_dToe < target.m_dToe)
+    target.m_dToe = band.m_dToe;
+  if (band.m_dHead > target.m_dHead)
+    target.m_dHead = band.m_dHead;
+  if (band.m_dMaxRowError > target.m_dMaxRowError)
+    target.m_dMaxRowError = band.m_dMaxRowError;
+}
+///
+
+/// Statistics::Reduce
+// Combine the results of the given bands pairwise, in a fixed
+// order, and merge them into the target. Destroys the bands.
+void Statistics::Reduce(struct Result *bands,ULONG count,struct Result &target)
+{
+  ULONG step,i;
+  //
+  for(step = 1;step < count;step <<= 1) {
+    for(i = 0;i + step < count;i += step << 1) {
+      Merge(bands[i],bands[i + step]);
+    }
+  }
+  //
+  if (count > 0)
+    Merge(target,bands[0]);
+}
+///
+
+/// class StatisticsJob
+// The job running the kernels in parallel. Each slice is one band
+// of BandHeight rows of one component, or of three interleaved
+// components that are collected together.
+class StatisticsJob : public Job {
+  //
+  // The images.
+  const class ImageLayout *m_pOrg;
+  const class ImageLayout *m_pDst;
+  //
+  // The row of the full image the first row of the data is, if the
+  // images are just a stripe of it.
+  ULONG                    m_ulRow;
+  //
+  // The requested statistics.
+  ULONG                    m_ulFlags;
+  //
+  // Number of components, and the index of the first band of
+  // each component. The last entry is the total band count.
+  UWORD                    m_usDepth;
+  ULONG                   *m_pulFirstBand;
+  //
+  // The index of the first slice of each component. Components
+  // collected along with the preceding one have no slices. The
+  // last entry is the total slice count.
+  ULONG                   *m_pulFirstSlice;
+  //
+  // The kernels of each component, and the kernel of the group
+  // of interleaved components starting at it, if any.
+  Statistics::Kernel      *m_pKernel;
+  Statistics::GroupKernel *m_pGroupKernel;
+  //
+  // The results of all bands.
+  struct Statistics::Result *m_pBands;
+  //
+  // The results of the complete components, holding the row sums.
+  struct Statistics::Result *m_pResult;
+  //
+  // Histograms per component and per worker, or NULL.
+  ULONG                  **m_ppulHistogram;
+  //
+  // Column sums per component and per band, or NULL. Each band
+  // adds to its own sums, such that they can be combined in a fixed
+  // order whichever worker ran the band.
+  double                 **m_ppdColumns;
+  ULONG                    m_ulWorkers;
+  //
+public:
+  StatisticsJob(const class ImageLayout *org,const class ImageLayout *dst,ULONG flags,ULONG row,
+		struct Statistics::Result *results)
+    : m_pOrg(org), m_pDst(dst), m_ulRow(row), m_ulFlags(flags), m_usDepth(org->DepthOf()),
+      m_pulFirstBand(NULL), m_pulFirstSlice(NULL), m_pKernel(NULL), m_pGroupKernel(NULL),
+      m_pBands(NULL), m_pResult(results), m_ppulHistogram(NULL), m_ppdColumns(NULL),
+      m_ulWorkers(ThreadPool::ThreadCountOf())
+  {
+    UWORD comp;
+    ULONG i;
+    //
+    m_pulFirstBand  = new ULONG[m_usDepth + 1];
+    m_pulFirstSlice = new ULONG[m_usDepth + 1];
+    m_pKernel       = new Statistics::Kernel[m_usDepth];
+    m_pGroupKernel  = new Statistics::GroupKernel[m_usDepth];
+    m_ppulHistogram = new ULONG *[m_usDepth];
+    m_ppdColumns    = new double *[m_usDepth];
+    for(comp = 0;comp < m_usDepth;comp++) {
+      m_ppulHistogram[comp] = NULL;
+      m_ppdColumns[comp]    = NULL;
+    }
+    //
+    m_pulFirstBand[0]  = 0;
+    m_pulFirstSlice[0] = 0;
+    for(comp = 0;comp < m_usDepth;comp++) {
+      ULONG h     = org->HeightOf(comp);
+      ULONG bands = (h + Statistics::BandHeight - 1) / Statistics::BandHeight;
+      m_pKernel[comp]           = Statistics::KernelOf(org,dst,comp,flags);
+      m_pGroupKernel[comp]      = NULL;
+      m_pulFirstBand[comp + 1]  = m_pulFirstBand[comp] + bands;
+      m_pulFirstSlice[comp + 1] = m_pulFirstSlice[comp] + bands;
+    }
+    //
+    // Interleaved components are collected together by the slices
+    // of the first of them.
+    for(comp = 0;comp + 3 <= m_usDepth;) {
+      m_pGroupKernel[comp] = Statistics::GroupKernelOf(org,dst,comp,flags);
+      if (m_pGroupKernel[comp]) {
+	ULONG bands = m_pulFirstBand[comp + 1] - m_pulFirstBand[comp];
+	UWORD c;
+	for(c = comp + 2;c < m_usDepth;c++)
+	  m_pulFirstSlice[c + 1] -= 2 * bands;
+	m_pulFirstSlice[comp + 2] = m_pulFirstSlice[comp + 1];
+	comp += 3;
+      } else {
+	comp++;
+      }
+    }
+    //
+    m_pBands = new struct Statistics::Result[m_pulFirstBand[m_usDepth]];
+    for(i = 0;i < m_pulFirstBand[m_usDepth];i++)
+      Statistics::Reset(m_pBands[i]);
+  }
+  //
+  ~StatisticsJob(void)
+  {
+    UWORD comp;
+    //
+    for(comp = 0;comp < m_usDepth;comp++) {
+      delete[] m_ppulHistogram[comp];
+      delete[] m_ppdColumns[comp];
+    }
+    delete[] m_ppdColumns;
+    delete[] m_ppulHistogram;
+    delete[] m_pBands;
+    delete[] m_pGroupKernel;
+    delete[] m_pKernel;
+    delete[] m_pulFirstSlice;
+    delete[] m_pulFirstBand;
+  }
+  //
+  // Number of slices of the job.
+  ULONG SlicesOf(void) const
+  {
+    return m_pulFirstSlice[m_usDepth];
+  }
+  //
+  // Allocate the per-worker histograms of the given component.
+  void CreateHistogram(UWORD comp,ULONG size)
+  {
+    assert(m_ppulHistogram[comp] == NULL);
+    m_ppulHistogram[comp] = new ULONG[size * m_ulWorkers];
+    memset(m_ppulHistogram[comp],0,sizeof(ULONG) * size * m_ulWorkers);
+  }
+  //
+  // Allocate the per-band column sums of the given component.
+  void CreateColumns(UWORD comp)
+  {
+    ULONG w     = m_pOrg->WidthOf(comp);
+    ULONG bands = m_pulFirstBand[comp + 1] - m_pulFirstBand[comp];
+    //
+    assert(m_ppdColumns[comp] == NULL);
+    m_ppdColumns[comp] = new double[w * bands];
+    memset(m_ppdColumns[comp],0,sizeof(double) * w * bands);
+  }
+  //
+  // Run a single band.
+  virtual void Run(ULONG slice,ULONG worker)
+  {
+    UWORD comp = 0;
+    ULONG band,y0,h;
+    ULONG *hist = NULL;
+    LONG offset = 0;
+    //
+    while(slice >= m_pulFirstSlice[comp + 1])
+      comp++;
+    //
+    band = slice - m_pulFirstSlice[comp];
+    y0   = band * Statistics::BandHeight;
+    h    = m_pOrg->HeightOf(comp) - y0;
+    if (h > Statistics::BandHeight)
+      h = Statistics::BandHeight;
+    //
+    if (m_pGroupKernel[comp]) {
+      struct Statistics::Result *res[3];
+      double *rows[3],*columns[3];
+      int c;
+      for(c = 0;c < 3;c++) {
+	res[c]     = m_pBands + m_pulFirstBand[comp + c] + band;
+	rows[c]    = RowsOf(comp + c,y0);
+	columns[c] = ColumnsOf(comp + c,band);
+      }
+      m_pGroupKernel[comp]((const UBYTE *)m_pOrg->DataOf(comp) + y0 * m_pOrg->BytesPerRow(comp),
+			   m_pOrg->BytesPerRow(comp),
+			   (const UBYTE *)m_pDst->DataOf(comp) + y0 * m_pDst->BytesPerRow(comp),
+			   m_pDst->BytesPerRow(comp),
+			   m_pOrg->WidthOf(comp),h,m_ulRow + y0,m_ulFlags,res,rows,columns);
+      return;
+    }
+    //
+    if (m_ppulHistogram[comp]) {
+      offset = (1L << m_pOrg->BitsOf(comp)) - 1;
+      assert(worker < m_ulWorkers);
+      hist   = m_ppulHistogram[comp] + worker * (2 * offset + 1);
+    }
+    //
+    m_pKernel[comp]((const UBYTE *)m_pOrg->DataOf(comp) + y0 * m_pOrg->BytesPerRow(comp),
+		    m_pOrg->BytesPerPixel(comp),m_pOrg->BytesPerRow(comp),
+		    (const UBYTE *)m_pDst->DataOf(comp) + y0 * m_pDst->BytesPerRow(comp),
+		    m_pDst->BytesPerPixel(comp),m_pDst->BytesPerRow(comp),
+		    m_pOrg->WidthOf(comp),h,m_ulRow + y0,m_ulFlags,m_pBands[m_pulFirstBand[comp] + band],hist,offset,
+		    RowsOf(comp,y0),ColumnsOf(comp,band));
+  }
+  //
+  // Return where the row sums of the band starting at row y0 of the
+  // data go, or NULL if they are not requested.
+  double *RowsOf(UWORD comp,ULONG y0) const
+  {
+    if (m_pResult[comp].m_pdRowError)
+      return m_pResult[comp].m_pdRowError + m_ulRow + y0;
+    return NULL;
+  }
+  //
+  // Return the column sums of the given band, or NULL if they are
+  // not requested.
+  double *ColumnsOf(UWORD comp,ULONG band) const
+  {
+    if (m_ppdColumns[comp]) {
+      assert(band < m_pulFirstBand[comp + 1] - m_pulFirstBand[comp]);
+      return m_ppdColumns[comp] + band * m_pOrg->WidthOf(comp);
+    }
+    return NULL;
+  }
+  //
+  // Add the histogram of a component, summed over the workers, to
+  // the result.
+  void AddHistogram(UWORD comp,struct Statistics::Result &res) const
+  {
+    if (m_ppulHistogram[comp]) {
+      ULONG w,i;
+      assert(res.m_pulHistogram);
+      for(w = 0;w < m_ulWorkers;w++) {
+	const ULONG *src = m_ppulHistogram[comp] + w * res.m_ulHistogramSize;
+	for(i = 0;i < res.m_ulHistogramSize;i++) {
+	  res.m_pulHistogram[i] += src[i];
+	}
+      }
+    }
+  }
+  //
+  // Combine the column sums of the bands of a component pairwise,
+  // in the same fixed order as Statistics::Reduce() combines the
+  // band results, and add them to the result. The sums thus do not
+  // depend on the number of threads, whatever the sample type.
+  // Destroys the sums of the bands.
+  void AddColumnSums(UWORD comp,struct Statistics::Result &res)
+  {
+    if (m_ppdColumns[comp]) {
+      ULONG w     = m_pOrg->WidthOf(comp);
+      ULONG count = m_pulFirstBand[comp + 1] - m_pulFirstBand[comp];
+      ULONG step,i,x;
+      assert(res.m_pdColumnError);
+      for(step = 1;step < count;step <<= 1) {
+	for(i = 0;i + step < count;i += step << 1) {
+	  double *dst       = m_ppdColumns[comp] + i * w;
+	  const double *src = m_ppdColumns[comp] + (i + step) * w;
+	  for(x = 0;x < w;x++) {
+	    dst[x] += src[x];
+	  }
+	}
+      }
+      if (count > 0) {
+	for(x = 0;x < w;x++) {
+	  res.m_pdColumnError[x] += m_ppdColumns[comp][x];
+	}
+      }
+    }
+  }
+  //
+  // Combine the bands of a component pairwise, in a fixed order,
+  // and deliver the result. The histogram is summed over the
+  // workers, the column sums over the bands.
+  void Reduce(UWORD comp,struct Statistics::Result &res)
+  {
+    Statistics::Reduce(m_pBands + m_pulFirstBand[comp],
+		       m_pulFirstBand[comp + 1] - m_pulFirstBand[comp],res);
+    AddHistogram(comp,res);
+    AddColumnSums(comp,res);
+  }
+  //
+  // Deliver the bands of a component unreduced, they are combined
+  // with those of the other stripes later. Only the histogram and
+  // the column sums are added to the result. The column sums are
+  // only combined within the stripe, the meters requiring them do
+  // not run on stripes.
+  void Deliver(UWORD comp,struct Statistics::Result *bands,struct Statistics::Result &res)
+  {
+    memcpy(bands,m_pBands + m_pulFirstBand[comp],
+	   sizeof(struct Statistics::Result) * (m_pulFirstBand[comp + 1] - m_pulFirstBand[comp]));
+    AddHistogram(comp,res);
+    AddColumnSums(comp,res);
+  }
+};
+///
+
+/// Statistics::Release
+// Release the results.
+void Statistics::Release(void)
+{
+  if (m_pResult) {
+    UWORD comp;
+    for(comp = 0;comp < m_usDepth;comp++) {
+      delete[] m_pResult[comp].m_pulHistogram;
+      delete[] m_pResult[comp].m_pdRowError;
+      delete[] m_pResult[comp].m_pdColumnError;
+    }
+  }
+  delete[] m_pResult;
+  m_pResult     = NULL;
+  delete[] m_pKey;
+  m_pKey        = NULL;
+  delete[] m_pBands;
+  m_pBands      = NULL;
+  delete[] m_pulFirstBand;
+  m_pulFirstBand= NULL;
+  m_usDepth     = 0;
+  m_ulCollected = 0;
+  m_bProbed     = false;
+  m_pOrg        = NULL;
+  m_pDst        = NULL;
+}
+///
+
+/// Statistics::isKeyed
+// Check whether the results are prepared for the given image pair.
+bool Statistics::isKeyed(const class ImageLayout *org,const class ImageLayout *dst) const
+{
+  UWORD comp;
+
+  if (m_pKey == NULL || org != m_pOrg || dst != m_pDst || org->DepthOf() != m_usDepth)
+    return false;
+
+  for(comp = 0;comp < m_usDepth;comp++) {
+    if (m_pKey[comp].m_pOrgData != org->DataOf(comp) ||
+	m_pKey[comp].m_pDstData != dst->DataOf(comp) ||
+	m_pKey[comp].m_ulWidth  != org->WidthOf(comp) ||
+	m_pKey[comp].m_ulHeight != org->HeightOf(comp))
+      return false;
+  }
+
+  return true;
+}
+///
+
+/// Statistics::isCurrent
+// Check whether the collected results are still valid for the
+// given image pair.
+bool Statistics::isCurrent(const class ImageLayout *org,const class ImageLayout *dst) const
+{
+  if (m_ulCollected == 0 || (m_ulRequirements & ~m_ulCollected))
+    return false;
+
+  return isKeyed(org,dst);
+}
+///
+
+/// Statistics::ProbeComponent
+// Check whether the samples of a single component are the same,
+// with the type given by its size. Rows without gaps are compared
+// at once.
+template<typename T>
+bool Statistics::ProbeComponent(const void *orgdata,ULONG obytesperpixel,ULONG obytesperrow,
+				const void *dstdata,ULONG dbytesperpixel,ULONG dbytesperrow,
+				ULONG w,ULONG h)
+{
+  const UBYTE *org = (const UBYTE *)orgdata;
+  const UBYTE *dst = (const UBYTE *)dstdata;
+  ULONG x,y;
+
+  for(y = 0;y < h;y++) {
+    if (obytesperpixel == sizeof(T) && dbytesperpixel == sizeof(T)) {
+      if (memcmp(org,dst,w * sizeof(T)))
+	return false;
+    } else {
+      const UBYTE *orgrow = org;
+      const UBYTE *dstrow = dst;
+      for(x = 0;x < w;x++) {
+	if (*(const T *)orgrow != *(const T *)dstrow)
+	  return false;
+	orgrow += obytesperpixel;
+	dstrow += dbytesperpixel;
+      }
+    }
+    org += obytesperrow;
+    dst += dbytesperrow;
+  }
+
+  return true;
+}
+///
+
+/// ProbeSizeOf
+// Return the size of the samples of the component as far as the
+// equality probe is concerned, or zero if the type is not supported.
+// The types are classified as in Statistics::KernelOf.
+static ULONG ProbeSizeOf(const class ImageLayout *img,UWORD comp)
+{
+  if (img->BitsOf(comp) <= 8)
+    return sizeof(UBYTE);
+  if (!img->isFloat(comp) && img->BitsOf(comp) <= 16)
+    return sizeof(UWORD);
+  if (img->BitsOf(comp) <= 32)
+    return sizeof(ULONG);
+  if (img->BitsOf(comp) == 64 && img->isFloat(comp))
+    return sizeof(UQUAD);
+  return 0;
+}
+///
+
+/// GroupOf
+// Return the number of components starting at the given one that are
+// interleaved without gaps, such that a row of pixels covers exactly
+// their samples, or one if there is no such group.
+static UWORD GroupOf(const class ImageLayout *img,UWORD comp,ULONG size)
+{
+  ULONG bpp = img->BytesPerPixel(comp);
+  UWORD n   = UWORD(bpp / size);
+  UWORD i;
+
+  if (bpp % size || n <= 1 || comp + n > img->DepthOf())
+    return 1;
+
+  for(i = 1;i < n;i++) {
+    if (ProbeSizeOf(img,comp + i)    != size ||
+	img->BytesPerPixel(comp + i) != bpp  ||
+	img->BytesPerRow(comp + i)   != img->BytesPerRow(comp) ||
+	img->WidthOf(comp + i)       != img->WidthOf(comp)     ||
+	img->HeightOf(comp + i)      != img->HeightOf(comp)    ||
+	(const UBYTE *)img->DataOf(comp + i) != (const UBYTE *)img->DataOf(comp) + i * size)
+      return 1;
+  }
+
+  return n;
+}
+///
+
+/// Statistics::Probe
+// Check whether the two images hold the same samples, bit by bit.
+// Stops at the first difference.
+bool Statistics::Probe(const class ImageLayout *org,const class ImageLayout *dst)
+{
+  UWORD comp,d = org->DepthOf();
+
+  if (dst->DepthOf() != d)
+    return false;
+
+  for(comp = 0;comp < d;comp++) {
+    if (org->WidthOf(comp) != dst->WidthOf(comp) || org->HeightOf(comp) != dst->HeightOf(comp) ||
+	org->BitsOf(comp)  != dst->BitsOf(comp)  || org->isSigned(comp)  != dst->isSigned(comp)  ||
+	org->isFloat(comp) != dst->isFloat(comp))
+      return false;
+  }
+
+  for(comp = 0;comp < d;) {
+    const void *o = org->DataOf(comp);
+    const void *t = dst->DataOf(comp);
+    ULONG w       = org->WidthOf(comp);
+    ULONG h       = org->HeightOf(comp);
+    ULONG size    = ProbeSizeOf(org,comp);
+    UWORD n;
+    bool same;
+    //
+    if (size == 0)
+      return false;
+    //
+    // Components interleaved alike in both images are compared in one
+    // go, all their samples in a row are contiguous.
+    n = GroupOf(org,comp,size);
+    if (n > 1 && GroupOf(dst,comp,size) == n) {
+      same = ProbeComponent<UBYTE>(o,1,org->BytesPerRow(comp),t,1,dst->BytesPerRow(comp),w * n * size,h);
+    } else {
+      n = 1;
+      switch(size) {
+      case sizeof(UBYTE):
+	same = ProbeComponent<UBYTE>(o,org->BytesPerPixel(comp),org->BytesPerRow(comp),
+				     t,dst->BytesPerPixel(comp),dst->BytesPerRow(comp),w,h);
+	break;
+      case sizeof(UWORD):
+	same = ProbeComponent<UWORD>(o,org->BytesPerPixel(comp),org->BytesPerRow(comp),
+				     t,dst->BytesPerPixel(comp),dst->BytesPerRow(comp),w,h);
+	break;
+      case sizeof(ULONG):
+	same = ProbeComponent<ULONG>(o,org->BytesPerPixel(comp),org->BytesPerRow(comp),
+				     t,dst->BytesPerPixel(comp),dst->BytesPerRow(comp),w,h);
+	break;
+      default:
+	same = ProbeComponent<UQUAD>(o,org->BytesPerPixel(comp),org->BytesPerRow(comp),
+				     t,dst->BytesPerPixel(comp),dst->BytesPerRow(comp),w,h);
+	break;
+      }
+    }
+    if (!same)
+      return false;
+    comp += n;
+  }
+
+  return true;
+}
+///
+
+/// Statistics::Identical
+// Fill in the results of two identical images without looking at
+// the samples: All differences are zero. Statistics of the original
+// alone cannot be filled in this way.
+void Statistics::Identical(const class ImageLayout *org)
+{
+  UWORD comp;
+
+  assert((m_ulRequirements & (Energy | Range)) == 0);
+
+  for(comp = 0;comp < m_usDepth;comp++) {
+    struct Result &res = m_pResult[comp];
+    ULONG w            = org->WidthOf(comp);
+    ULONG h            = org->HeightOf(comp);
+    //
+    if (w > 0 && h > 0) {
+      res.m_dMinDiff = 0.0;
+      res.m_dMaxDiff = 0.0;
+    }
+    if (res.m_pulHistogram)
+      res.m_pulHistogram[res.m_lHistogramOffset] = w * h;
+  }
+}
+///
+
+/// Statistics::Prepare
+// Create the results for the given image pair, and the histograms
+// if required.
+void Statistics::Prepare(const class ImageLayout *org,const class ImageLayout *dst)
+{
+  UWORD comp,d = org->DepthOf();
+  //
+  Release();
+  //
+  m_pResult = new struct Result[d];
+  m_usDepth = d;
+  for(comp = 0;comp < d;comp++)
+    Reset(m_pResult[comp]);
+  m_pKey    = new struct Key[d];
+  for(comp = 0;comp < d;comp++) {
+    struct Result &res = m_pResult[comp];
+    //
+    m_pKey[comp].m_pOrgData = org->DataOf(comp);
+    m_pKey[comp].m_pDstData = dst->DataOf(comp);
+    m_pKey[comp].m_ulWidth  = org->WidthOf(comp);
+    m_pKey[comp].m_ulHeight = org->HeightOf(comp);
+    //
+    // The histogram is only available for integer data of at most
+    // 16 bits. Meters that require it check this themselves.
+    if ((m_ulRequirements & Histogram) && !org->isFloat(comp) && org->BitsOf(comp) <= 16) {
+      res.m_lHistogramOffset = (1L << org->BitsOf(comp)) - 1;
+      res.m_ulHistogramSize  = 2 * res.m_lHistogramOffset + 1;
+      res.m_pulHistogram     = new ULONG[res.m_ulHistogramSize];
+      memset(res.m_pulHistogram,0,sizeof(ULONG) * res.m_ulHistogramSize);
+    }
+    //
+    if (m_ulRequirements & RowProfile) {
+      res.m_pdRowError = new double[org->HeightOf(comp)];
+      memset(res.m_pdRowError,0,sizeof(double) * org->HeightOf(comp));
+    }
+    if (m_ulRequirements & ColumnProfile) {
+      res.m_pdColumnError = new double[org->WidthOf(comp)];
+      memset(res.m_pdColumnError,0,sizeof(double) * org->WidthOf(comp));
+    }
+  }
+}
+///
+
+/// Statistics::Collect
+// Run the collection over all components of the given rows, the
+// first of which is row y0 of the image. The components are cut
+// into bands of a fixed height, the bands are run in parallel, and
+// their results are combined in a fixed order. If the images are
+// delivered in stripes, the bands are kept and only combined once
+// all stripes are in.
+void Statistics::Collect(const class ImageLayout *org,const class ImageLayout *dst,ULONG y0)
+{
+  class StatisticsJob job(org,dst,m_ulRequirements,y0,m_pResult);
+  UWORD comp;
+
+  for(comp = 0;comp < m_usDepth;comp++) {
+    if (m_pBands) {
+      ULONG first = m_pulFirstBand[comp] + y0 / BandHeight;
+      //
+      if (first + (org->HeightOf(comp) + BandHeight - 1) / BandHeight > m_pulFirstBand[comp + 1])
+	throw "image stripe extends beyond the end of the image";
+    }
+    if (m_pResult[comp].m_pulHistogram)
+      job.CreateHistogram(comp,m_pResult[comp].m_ulHistogramSize);
+    if (m_pResult[comp].m_pdColumnError)
+      job.CreateColumns(comp);
+  }
+
+  ThreadPool::Run(&job,job.SlicesOf());
+
+  for(comp = 0;comp < m_usDepth;comp++) {
+    if (m_pBands) {
+      job.Deliver(comp,m_pBands + m_pulFirstBand[comp] + y0 / BandHeight,m_pResult[comp]);
+    } else {
+      job.Reduce(comp,m_pResult[comp]);
+    }
+  }
+}
+///
+
+/// Statistics::ResultOf
+// Return the statistics of the given component of the image pair,
+// collect them if they are not yet available.
+const struct Statistics::Result &Statistics::ResultOf(const class ImageLayout *org,const class ImageLayout *dst,
+						      UWORD comp)
+{
+  assert(m_ulRequirements);
+
+  if (!isCurrent(org,dst)) {
+    bool probe     = (m_ulRequirements & (Energy | Range)) == 0;
+    bool identical = false;
+    UWORD c;
+    //
+    if (m_pBands)
+      throw "the statistics of images delivered in stripes are not yet complete";
+    //
+    // If nothing but the differences is required, identical integer
+    // images need not be looked at a second time. Floating point
+    // samples identical bit by bit can still differ by a NaN.
+    for(c = 0;c < org->DepthOf();c++) {
+      if (org->isFloat(c))
+	probe = false;
+    }
+    if (probe)
+      identical = isIdentical(org,dst);
+    //
+    // Collect all components at once: Whoever asks for one
+    // component will ask for all others next.
+    Prepare(org,dst);
+    if (identical) {
+      Identical(org);
+    } else {
+      Collect(org,dst,0);
+    }
+    //
+    m_pOrg        = org;
+    m_pDst        = dst;
+    m_ulCollected = m_ulRequirements;
+    m_bProbed     = probe;
+    m_bIdentical  = identical;
+  }
+
+  assert(comp < m_usDepth);
+
+  return m_pResult[comp];
+}
+///
+
+/// Statistics::isIdentical
+// Return whether the two images are identical, i.e. have the same
+// layout and hold the same samples bit by bit. The result is kept
+// until the images change.
+bool Statistics::isIdentical(const class ImageLayout *org,const class ImageLayout *dst)
+{
+  if (!m_bProbed || !isKeyed(org,dst)) {
+    bool identical;
+    //
+    if (m_pBands)
+      throw "the statistics of images delivered in stripes are not yet complete";
+    //
+    identical = Probe(org,dst);
+    if (!isKeyed(org,dst)) {
+      Prepare(org,dst);
+      m_pOrg = org;
+      m_pDst = dst;
+    }
+    m_bProbed    = true;
+    m_bIdentical = identical;
+  }
+
+  return m_bIdentical;
+}
+///
+
+/// Statistics::BeginStripes
+// Start collecting the statistics of images that are delivered in
+// stripes from top to bottom. The images given here describe the
+// full images, but need not hold any data.
+void Statistics::BeginStripes(const class ImageLayout *org,const class ImageLayout *dst)
+{
+  UWORD comp;
+  ULONG i;
+  
+  Prepare(org,dst);
+  
+  m_pulFirstBand    = new ULONG[m_usDepth + 1];
+  m_pulFirstBand[0] = 0;
+  for(comp = 0;comp < m_usDepth;comp++) {
+    if (org->HeightOf(comp) != org->HeightOf() || dst->HeightOf(comp) != dst->HeightOf())
+      throw "images with vertically subsampled components cannot be delivered in stripes";
+    m_pulFirstBand[comp + 1] = m_pulFirstBand[comp] + (org->HeightOf(comp) + BandHeight - 1) / BandHeight;
+  }
+  //
+  m_pBands = new struct Result[m_pulFirstBand[m_usDepth]];
+  for(i = 0;i < m_pulFirstBand[m_usDepth];i++)
+    Reset(m_pBands[i]);
+  //
+  m_pOrg = org;
+  m_pDst = dst;
+}
+///
+
+/// Statistics::CollectStripe
+// Collect the statistics of the next stripe, the first row of which
+// is row y0 of the image.
+void Statistics::CollectStripe(const class ImageLayout *org,const class ImageLayout *dst,ULONG y0)
+{
+  assert(m_pBands);
+
+  if (y0 % BandHeight)
+    throw "image stripes must start at a multiple of the band height";
+  if (org->DepthOf() != m_usDepth || dst->DepthOf() != m_usDepth)
+    throw "image stripes differ in their number of components";
+
+  Collect(org,dst,y0);
+}
+///
+
+/// Statistics::EndStripes
+// Combine the stripes. The results are then available for the
+// images given to BeginStripes(), exactly as if these had been
+// collected at once.
+void Statistics::EndStripes(void)
+{
+  UWORD comp;
+  
+  assert(m_pBands);
+  
+  for(comp = 0;comp < m_usDepth;comp++) {
+    Reduce(m_pBands + m_pulFirstBand[comp],m_pulFirstBand[comp + 1] - m_pulFirstBand[comp],m_pResult[comp]);
+  }
+  
+  delete[] m_pBands;
+  m_pBands       = NULL;
+  delete[] m_pulFirstBand;
+  m_pulFirstBand = NULL;
+  m_ulCollected  = m_ulRequirements;
+}
+///
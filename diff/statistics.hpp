@@ -0,0 +1,318 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software) for Accusoft	        **
+** All Rights Reserved							**
+**************************************************************************
+
+This source file is part of difftest_ng, a universal image measuring
+and conversion framework.
+
+    difftest_ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    difftest_ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with difftest_ng.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/*
+**
+** $Id: statistics.hpp,v 1.1 2022/09/02 08:12:44 thor Exp $
+**
+** This class collects all point-wise statistics between two images
+** the scalar meters need in a single pass over the data, and keeps
+** them until the images change.
+*/
+
+#ifndef DIFF_STATISTICS_HPP
+#define DIFF_STATISTICS_HPP
+
+/// Includes
+#include "interface/types.hpp"
+///
+
+/// Forwards
+class ImageLayout;
+///
+
+/// class Statistics
+// This class collects all point-wise statistics between two images
+// the scalar meters need in a single pass over the data, and keeps
+// them until the images change.
+class Statistics {
+public:
+  //
+  // The statistics that can be requested. Meters register the
+  // ones they need when they are attached to the agenda, and only
+  // these are collected.
+  enum Requirement {
+    SquareError   = 1,    // sum of squared differences
+    AbsError      = 2,    // sum of absolute differences
+    Drift         = 4,    // sum of signed differences
+    Extrema       = 8,    // minimum and maximum signed difference
+    Peak          = 16,   // maximum absolute difference and its position
+    Energy        = 32,   // energy and maximum square of the original
+    Range         = 64,   // minimum and maximum value of the original
+    Relative      = 128,  // sum of relative squared differences
+    Histogram     = 256,  // histogram of the differences, integer only
+    RowError      = 512,  // largest sum of squared differences over a row
+    RowProfile    = 1024, // sum of squared differences of each row
+    ColumnProfile = 2048  // sum of squared differences of each column
+  };
+  //
+  // The collected statistics of a single component. The sums
+  // are not normalized, and nothing is scaled to the sample
+  // range.
+  struct Result {
+    //
+    // Sum of squared, absolute and signed differences.
+    double      m_dSquareError;
+    double      m_dAbsError;
+    double      m_dDrift;
+    //
+    // Minimum and maximum signed difference.
+    double      m_dMinDiff;
+    double      m_dMaxDiff;
+    //
+    // Maximum absolute difference, and where it was found
+    // first in scan order.
+    double      m_dPeak;
+    ULONG       m_ulPeakX;
+    ULONG       m_ulPeakY;
+    //
+    // Energy of the original, and its largest square.
+    double      m_dEnergy;
+    double      m_dMaxSquare;
+    //
+    // Minimum and maximum sample value of the original.
+    double      m_dToe;
+    double      m_dHead;
+    //
+    // Sum of squared differences relative to the sum of squares.
+    double      m_dRelative;
+    //
+    // The largest sum of squared differences of a single row.
+    double      m_dMaxRowError;
+    //
+    // The sums of squared differences of each row and each column,
+    // or NULL if not requested.
+    double     *m_pdRowError;
+    double     *m_pdColumnError;
+    //
+    // The difference histogram, or NULL if not available for
+    // this component. Index zero is the difference -offset.
+    ULONG      *m_pulHistogram;
+    ULONG       m_ulHistogramSize;
+    LONG        m_lHistogramOffset;
+  };
+  //
+private:
+  //
+  // The requirements registered so far.
+  ULONG              m_ulRequirements;
+  //
+  // The requirements the current results have been collected for.
+  ULONG              m_ulCollected;
+  //
+  // Whether the images have been probed for equality, and the result.
+  bool               m_bProbed;
+  bool               m_bIdentical;
+  //
+  // The images the results belong to.
+  const class ImageLayout *m_pOrg;
+  const class ImageLayout *m_pDst;
+  //
+  // Number of components the results are valid for.
+  UWORD              m_usDepth;
+  //
+  // The per-component results.
+  struct Result     *m_pResult;
+  //
+  // The data pointers and dimensions the results were computed
+  // on. Used to detect that the images changed underneath.
+  struct Key {
+    const void *m_pOrgData;
+    const void *m_pDstData;
+    ULONG       m_ulWidth;
+    ULONG       m_ulHeight;
+  }                 *m_pKey;
+  //
+  // While the images are delivered in stripes, the results of all
+  // bands, and the index of the first band of each component. The
+  // last entry is the total band count.
+  struct Result     *m_pBands;
+  ULONG             *m_pulFirstBand;
+  //
+  // Release the results.
+  void Release(void);
+  //
+  // Check whether the results are prepared for the given image pair.
+  bool isKeyed(const class ImageLayout *org,const class ImageLayout *dst) const;
+  //
+  // Check whether the collected results are still valid for the
+  // given image pair.
+  bool isCurrent(const class ImageLayout *org,const class ImageLayout *dst) const;
+  //
+  // Check whether the two images hold the same samples, bit by bit.
+  // Stops at the first difference.
+  static bool Probe(const class ImageLayout *org,const class ImageLayout *dst);
+  //
+  // Check whether the samples of a single component are the same,
+  // with the type given by its size.
+  template<typename T>
+  static bool ProbeComponent(const void *org,ULONG obytesperpixel,ULONG obytesperrow,
+			     const void *dst,ULONG dbytesperpixel,ULONG dbytesperrow,
+			     ULONG w,ULONG h);
+  //
+  // Fill in the results of two identical images without looking at
+  // the samples.
+  void Identical(const class ImageLayout *org);
+  //
+  // The statistics the vectorized row kernels deliver. They are used
+  // if nothing else is required and the samples are stored without
+  // gaps, or as three interleaved components.
+  enum {
+    RowMoments = SquareError | AbsError | Drift | Extrema | Peak | RowError |
+                 RowProfile | ColumnProfile
+  };
+  //
+  // The type-erased kernel for a single data type. The row sums are
+  // stored into rows, starting with the first row of the band, the
+  // column sums are added to columns. Either may be NULL.
+  typedef void (*Kernel)(const void *org,ULONG obytesperpixel,ULONG obytesperrow,
+			 const void *dst,ULONG dbytesperpixel,ULONG dbytesperrow,
+			 ULONG w,ULONG h,ULONG y0,ULONG flags,struct Result &res,
+			 ULONG *hist,LONG offset,double *rows,double *columns);
+  //
+  // The type-erased kernel for three interleaved components of the
+  // same type, delivering into res[0] to res[2], and likewise into
+  // the row and column sums.
+  typedef void (*GroupKernel)(const void *org,ULONG obytesperrow,
+			      const void *dst,ULONG dbytesperrow,
+			      ULONG w,ULONG h,ULONG y0,ULONG flags,struct Result **res,
+			      double **rows,double **columns);
+  //
+  // Return the kernel suitable for the given component.
+  static Kernel KernelOf(const class ImageLayout *org,const class ImageLayout *dst,UWORD comp,ULONG flags);
+  //
+  // Return the kernel for the three interleaved components starting
+  // at the given component, or NULL if they are not interleaved.
+  static GroupKernel GroupKernelOf(const class ImageLayout *org,const class ImageLayout *dst,UWORD comp,
+				   ULONG flags);
+  //
+  // Reset a result to the neutral element.
+  static void Reset(struct Result &res);
+  //
+  // Combine the result of the given band into the target, which
+  // is the result of the bands above it.
+  static void Merge(struct Result &target,const struct Result &band);
+  //
+  // Combine the results of the given bands pairwise, in a fixed
+  // order, and merge them into the target. Destroys the bands.
+  static void Reduce(struct Result *bands,ULONG count,struct Result &target);
+  //
+  // Create the results for the given image pair, and the histograms
+  // if required.
+  void Prepare(const class ImageLayout *org,const class ImageLayout *dst);
+  //
+  // Run the collection over all components of the given rows,
+  // the first of which is row y0 of the image.
+  void Collect(const class ImageLayout *org,const class ImageLayout *dst,ULONG y0);
+  //
+  // The templated kernel: Accumulate everything requested in one
+  // pass over h rows, the first of which is row y0 of the image.
+  template<typename T>
+  static void Accumulate(const void *org,ULONG obytesperpixel,ULONG obytesperrow,
+			 const void *dst,ULONG dbytesperpixel,ULONG dbytesperrow,
+			 ULONG w,ULONG h,ULONG y0,ULONG flags,struct Result &res,
+			 ULONG *hist,LONG offset,double *rows,double *columns);
+  //
+  // The kernel for samples stored without gaps, running the rows
+  // through the row kernels.
+  template<typename T>
+  static void Dense(const void *org,ULONG obytesperpixel,ULONG obytesperrow,
+		    const void *dst,ULONG dbytesperpixel,ULONG dbytesperrow,
+		    ULONG w,ULONG h,ULONG y0,ULONG flags,struct Result &res,
+		    ULONG *hist,LONG offset,double *rows,double *columns);
+  //
+  // The kernel for three interleaved components, running the rows
+  // through the row kernels.
+  template<typename T>
+  static void Interleaved(const void *org,ULONG obytesperrow,
+			  const void *dst,ULONG dbytesperrow,
+			  ULONG w,ULONG h,ULONG y0,ULONG flags,struct Result **res,
+			  double **rows,double **columns);
+  //
+  // The job running the kernels in parallel.
+  friend class StatisticsJob;
+  //
+public:
+  //
+  // Number of rows collected by one slice of the parallel
+  // collection. This is fixed such that the order in which partial
+  // results are combined, and thus the result, does not depend on
+  // the number of threads. Stripes must start at a multiple of it.
+  enum {
+    BandHeight = 16
+  };
+  //
+  Statistics(void)
+    : m_ulRequirements(0), m_ulCollected(0), m_bProbed(false), m_bIdentical(false),
+      m_pOrg(NULL), m_pDst(NULL),
+      m_usDepth(0), m_pResult(NULL), m_pKey(NULL), m_pBands(NULL), m_pulFirstBand(NULL)
+  { }
+  //
+  ~Statistics(void)
+  {
+    Release();
+  }
+  //
+  // Register the statistics a meter will request.
+  void Require(ULONG requirements)
+  {
+    m_ulRequirements |= requirements;
+  }
+  //
+  // Forget the collected results because the images have been
+  // modified, e.g. by a filter.
+  void Invalidate(void)
+  {
+    m_ulCollected = 0;
+    m_bProbed     = false;
+  }
+  //
+  // Return the statistics of the given component of the image pair,
+  // collect them if they are not yet available.
+  const struct Result &ResultOf(const class ImageLayout *org,const class ImageLayout *dst,UWORD comp);
+  //
+  // Return whether the two images are identical, i.e. have the same
+  // layout and hold the same samples bit by bit. The result is kept
+  // until the images change. The results of identical integer images
+  // are filled in without a pass over the data.
+  bool isIdentical(const class ImageLayout *org,const class ImageLayout *dst);
+  //
+  // Start collecting the statistics of images that are delivered in
+  // stripes from top to bottom. The images given here describe the
+  // full images, but need not hold any data.
+  void BeginStripes(const class ImageLayout *org,const class ImageLayout *dst);
+  //
+  // Collect the statistics of the next stripe, the first row of which
+  // is row y0 of the image. Except for the last, the stripe heights
+  // must be multiples of the band height.
+  void CollectStripe(const class ImageLayout *org,const class ImageLayout *dst,ULONG y0);
+  //
+  // Combine the stripes. The results are then available for the
+  // images given to BeginStripes(), exactly as if these had been
+  // collected at once.
+  void EndStripes(void);
+};
+///
+
+///
+#endif
@@ -31,235 +31,107 @@ and conversion framework.
 
 /// Includes
 #include "diff/stripe.hpp"
+#include "diff/statistics.hpp"
 #include "img/imglayout.hpp"
 #include "std/math.hpp"
+#include "std/assert.hpp"
+#include "std/errno.hpp"
+#include "std/string.hpp"
 ///
 
-/// Stripe::MSE
-// Traditional non-directional MSE
-template<typename T>
-double Stripe::MSE(T *org,ULONG obytesperpixel,ULONG obytesperrow,
-		   T *dst,ULONG dbytesperpixel,ULONG dbytesperrow,
-		   ULONG w,ULONG h)
+/// Stripe::AttachStatistics
+// Register the row and column errors.
+void Stripe::AttachStatistics(class Statistics *stats)
 {
-  double error = 0.0;
-  ULONG x,y;
-
-  for(y = 0;y < h;y++) {
-    T *orgrow = org;
-    T *dstrow = dst;
-    for(x = 0;x < w;x++) {
-      double diff = *orgrow - *dstrow;
-      error      += diff * diff;
-      //
-      orgrow      = (T *)((const UBYTE *)(orgrow) + obytesperpixel);
-      dstrow      = (T *)((const UBYTE *)(dstrow) + dbytesperpixel);
-    }
-    org = (T *)((const UBYTE *)(org) + obytesperrow);
-    dst = (T *)((const UBYTE *)(dst) + dbytesperrow);
-  }
-
-  return error;
+  stats->Require(Statistics::RowError | Statistics::ColumnProfile);
+  if (m_pcProfileFile)
+    stats->Require(Statistics::RowProfile);
+  m_pStatistics = stats;
 }
 ///
 
-/// Stripe::MSE_Hor
-// l^2 in Horizontal direction, l^infinity in vertical direction
-template<typename T>
-double Stripe::MSE_Hor(T *org,ULONG obytesperpixel,ULONG obytesperrow,
-		       T *dst,ULONG dbytesperpixel,ULONG dbytesperrow,
-		       ULONG w,ULONG h)
+/// Stripe::WriteProfile
+// Write the mean square errors of all rows and columns, one per line,
+// as component, row or column, index and error.
+void Stripe::WriteProfile(class ImageLayout *src,class ImageLayout *dst) const
 {
-  double error = 0.0;
-  ULONG x,y;
-
-  for(y = 0;y < h;y++) {
-    double err = 0.0;
-    T *orgrow = org;
-    T *dstrow = dst;
-    for(x = 0;x < w;x++) {
-      double diff = *orgrow - *dstrow;
-      err        += diff * diff;
-      //
-      orgrow      = (T *)((const UBYTE *)(orgrow) + obytesperpixel);
-      dstrow      = (T *)((const UBYTE *)(dstrow) + dbytesperpixel);
+  FILE *out = stdout;
+  UWORD comp;
+  ULONG i;
+
+  if (strcmp(m_pcProfileFile,"-")) {
+    out = fopen(m_pcProfileFile,"w");
+    if (out == NULL) {
+      ImageLayout::PostError("unable to open the stripe profile output file %s: %s\n",
+			     m_pcProfileFile,strerror(errno));
+      return; // code should never go here.
     }
-    if (err > error)
-      error = err;
-    org = (T *)((const UBYTE *)(org) + obytesperrow);
-    dst = (T *)((const UBYTE *)(dst) + dbytesperrow);
   }
 
-  return error * h;
-}
-///
-
-/// Stripe::MSE_Ver
-// l^2 in vertical direction, l^infinity in horizontal direction
-template<typename T>
-double Stripe::MSE_Ver(T *org,ULONG obytesperpixel,ULONG obytesperrow,
-		       T *dst,ULONG dbytesperpixel,ULONG dbytesperrow,
-		       ULONG w,ULONG h)
-{
-  double error = 0.0;
-  ULONG x,y;
-
-  for(x = 0;x < w;x++) {
-    double err = 0.0;
-    T *orgrow = org;
-    T *dstrow = dst;
-    for(y = 0;y < h;y++) {
-      double diff = *orgrow - *dstrow;
-      err        += diff * diff;
-      //
-      orgrow      = (T *)((const UBYTE *)(orgrow) + obytesperrow);
-      dstrow      = (T *)((const UBYTE *)(dstrow) + dbytesperrow);
+  for(comp = 0;comp < src->DepthOf();comp++) {
+    const struct Statistics::Result &res = m_pStatistics->ResultOf(src,dst,comp);
+    ULONG w = src->WidthOf(comp);
+    ULONG h = src->HeightOf(comp);
+    //
+    assert(res.m_pdRowError && res.m_pdColumnError);
+    for(i = 0;i < h;i++) {
+      fprintf(out,"%d\trow\t%lu\t%g\n",comp,(unsigned long)i,res.m_pdRowError[i] / w);
+    }
+    for(i = 0;i < w;i++) {
+      fprintf(out,"%d\tcolumn\t%lu\t%g\n",comp,(unsigned long)i,res.m_pdColumnError[i] / h);
     }
-    if (err > error)
-      error = err;
-    org = (T *)((const UBYTE *)(org) + obytesperpixel);
-    dst = (T *)((const UBYTE *)(dst) + dbytesperpixel);
   }
 
-  return error * w;
+  if (out != stdout)
+    fclose(out);
 }
 ///
 
 /// Stripe::Measure
+// Compare the worst row and the worst column of each component. The
+// row and column sums are all collected by the statistics in a
+// single pass over the images in memory order.
 double Stripe::Measure(class ImageLayout *src,class ImageLayout *dst,double)
 {
   double max   = 0.0;
   UWORD comp;
 
+  assert(m_pStatistics);
+
   for(comp = 0;comp < src->DepthOf();comp++) {
+    const struct Statistics::Result &res = m_pStatistics->ResultOf(src,dst,comp);
     double mseh = 0.0;
     double msev = 0.0;
     double mse  = 0.0;
     ULONG  w   = src->WidthOf(comp);
     ULONG  h   = src->HeightOf(comp);
     double prc = (src->isFloat(comp))?(1.0):(double(UQUAD(1) << src->BitsOf(comp)) - 1.0);
+    ULONG  x;
     //
-    if (src->isSigned(comp)) {
-      if (src->BitsOf(comp) <= 8) {
-	mseh = MSE_Hor<const BYTE>((const BYTE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				   (const BYTE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				   w,h);
-	msev = MSE_Ver<const BYTE>((const BYTE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				   (const BYTE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				   w,h);
- 	mse  = MSE<const BYTE>((const BYTE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			       (const BYTE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			       w,h);
-     } else if (!src->isFloat(comp) && src->BitsOf(comp) <= 16) {
-	mseh = MSE_Hor<const WORD>((const WORD *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				   (const WORD *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				   w,h);
-	msev = MSE_Ver<const WORD>((const WORD *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				   (const WORD *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				   w,h);
-	mse  = MSE<const WORD>((const WORD *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			       (const WORD *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			       w,h);
-       } else if (!src->isFloat(comp) && src->BitsOf(comp) <= 32) {
-	mseh = MSE_Hor<const LONG>((const LONG *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				   (const LONG *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				   w,h);
-	msev = MSE_Ver<const LONG>((const LONG *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				   (const LONG *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				   w,h);
-	mse  = MSE<const LONG>((const LONG *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-			       (const LONG *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-			       w,h);
-      } else if (src->BitsOf(comp) <= 32 && src->isFloat(comp)) {
-	mseh = MSE_Hor<const FLOAT>((const FLOAT *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				    (const FLOAT *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				    w,h);
-	msev = MSE_Ver<const FLOAT>((const FLOAT *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				    (const FLOAT *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				    w,h);
-	mse  = MSE<const FLOAT>((const FLOAT *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				(const FLOAT *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				w,h);
-      } else if (src->BitsOf(comp) == 64 && src->isFloat(comp)) {
-	mseh = MSE_Hor<const DOUBLE>((const DOUBLE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				     (const DOUBLE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				     w,h);
-	msev = MSE_Ver<const DOUBLE>((const DOUBLE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				     (const DOUBLE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				     w,h);
-	mse  = MSE<const DOUBLE>((const DOUBLE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				 (const DOUBLE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				 w,h);
-      } else {
-	throw "unsupported data type";
-      }
-    } else {
-      if (src->BitsOf(comp) <= 8) {
-	mseh = MSE_Hor<const UBYTE>((const UBYTE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				    (const UBYTE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				    w,h);
-	msev = MSE_Ver<const UBYTE>((const UBYTE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				    (const UBYTE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				    w,h);
-	mse  = MSE<const UBYTE>((const UBYTE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				(const UBYTE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				w,h);
-      } else if (!src->isFloat(comp) && src->BitsOf(comp) <= 16) {
-	mseh = MSE_Hor<const UWORD>((const UWORD *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				    (const UWORD *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				    w,h);
-	msev = MSE_Ver<const UWORD>((const UWORD *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				    (const UWORD *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				    w,h);
-	mse  = MSE<const UWORD>((const UWORD *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				(const UWORD *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				w,h);
-      } else if (!src->isFloat(comp) && src->BitsOf(comp) <= 32) {
-	mseh = MSE_Hor<const ULONG>((const ULONG *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				    (const ULONG *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				    w,h);
-	msev = MSE_Ver<const ULONG>((const ULONG *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				    (const ULONG *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				    w,h);
-	mse  = MSE<const ULONG>((const ULONG *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				(const ULONG *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				w,h);
-      } else if (src->BitsOf(comp) <= 32 && src->isFloat(comp)) {
-	mseh = MSE_Hor<const FLOAT>((const FLOAT *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				    (const FLOAT *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				    w,h);
-	msev = MSE_Ver<const FLOAT>((const FLOAT *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				    (const FLOAT *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				    w,h);
-	mse  = MSE<const FLOAT>((const FLOAT *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				(const FLOAT *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				w,h);
-      } else if (src->BitsOf(comp) == 64 && src->isFloat(comp)) {
-	mseh = MSE_Hor<const DOUBLE>((const DOUBLE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				     (const DOUBLE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				     w,h);
-	msev = MSE_Ver<const DOUBLE>((const DOUBLE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				     (const DOUBLE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				     w,h);
-	mse  = MSE<const DOUBLE>((const DOUBLE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				 (const DOUBLE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				 w,h);
-      } else {
-	throw "unsupported data type";
-      }
+    // The horizontal error is l^2 along the rows and l^infinity
+    // across them, the vertical error l^2 along the columns and
+    // l^infinity across them.
+    mseh  = res.m_dMaxRowError * h;
+    assert(res.m_pdColumnError);
+    for(x = 0;x < w;x++) {
+      if (res.m_pdColumnError[x] > msev)
+	msev = res.m_pdColumnError[x];
     }
+    msev *= w;
     //
     mseh /= (w * h) * prc * prc;
     msev /= (w * h) * prc * prc;
-    mse  /= (w * h) * prc * prc;
     //
-    mse   = (mse - msev) - (mse - mseh);
+    mse   = mseh - msev;
     if (mse < 0)
       mse = -mse;
     if (mse > max)
       max = mse;
     //
   }
+
+  if (m_pcProfileFile)
+    WriteProfile(src,dst);
     
   return -10.0 * log(max) / log(10.0);
 }
@@ -38,6 +38,7 @@ and conversion framework.
 
 /// Forwards
 class ImageLayout;
+class Statistics;
 ///
 
 /// class Stripe
@@ -46,33 +47,44 @@ class Stripe : public Meter {
   // PSNR measurement type
   int m_Type;
   //
-  // Templated implementations
-  template<typename T>
-  double MSE_Hor(T *org,ULONG obytesperpixel,ULONG obytesperrow,
-		 T *dst,ULONG dbytesperpixel,ULONG dbytesperrow,
-		 ULONG w,ULONG h);
+  // The file the row and column errors are written to, "-" for
+  // stdout, or NULL.
+  const char *m_pcProfileFile;
   //
-  template<typename T>
-  double MSE_Ver(T *org,ULONG obytesperpixel,ULONG obytesperrow,
-		 T *dst,ULONG dbytesperpixel,ULONG dbytesperrow,
-		 ULONG w,ULONG h);  
+  // The statistics collector the row and column errors are taken
+  // from.
+  class Statistics *m_pStatistics;
+  //
+  // Write the mean square errors of all rows and columns.
+  void WriteProfile(class ImageLayout *src,class ImageLayout *dst) const;
   //
-  template<typename T>
-  double MSE(T *org,ULONG obytesperpixel,ULONG obytesperrow,
-	     T *dst,ULONG dbytesperpixel,ULONG dbytesperrow,
-	     ULONG w,ULONG h);
 public:
   //
   //
-  Stripe()
+  Stripe(const char *profile = NULL)
+    : m_pcProfileFile(profile), m_pStatistics(NULL)
   { }
   //
   virtual double Measure(class ImageLayout *src,class ImageLayout *dst,double in);
   //
+  virtual void AttachStatistics(class Statistics *stats);
+  //
   virtual const char *NameOf(void) const
   {
     return "Stripe-Detect";
   }
+  //
+  // Keeps nothing from one measurement to the next.
+  virtual bool isReusable(void) const
+  {
+    return true;
+  }
+  //
+  // Only requires the row and column sums of the statistics.
+  virtual bool isStreamable(void) const
+  {
+    return true;
+  }
 };
 ///
 
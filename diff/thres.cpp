@@ -30,79 +30,36 @@ and conversion framework.
 
 /// Includes
 #include "diff/thres.hpp"
+#include "diff/statistics.hpp"
 #include "img/imglayout.hpp"
 #include "std/math.hpp"
+#include "std/assert.hpp"
 ///
 
-/// Thres::PeakError
-template<typename T>
-double Thres::Error(T *org,ULONG obytesperpixel,ULONG obytesperrow,
-		    T *dst,ULONG dbytesperpixel,ULONG dbytesperrow,
-		    ULONG w,ULONG h)
+/// Thres::AttachStatistics
+// Register the statistics this threshold is computed from.
+void Thres::AttachStatistics(class Statistics *stats)
 {
-  double error;
-  ULONG x,y;
-
   switch(m_Type) {
-  case Toe:
   case Min:
-    error = HUGE_VAL;
-    break;
-  case Head:
   case Max:
-    error = -HUGE_VAL;
+    stats->Require(Statistics::Extrema);
     break;
-  default:
-    error = 0;
+  case Avg:
+    stats->Require(Statistics::AbsError);
+    break;
+  case Drift:
+    stats->Require(Statistics::Drift);
+    break;
+  case Peak:
+    stats->Require(Statistics::Peak);
+    break;
+  case Toe:
+  case Head:
+    stats->Require(Statistics::Range);
     break;
   }
-  
-  for(y = 0;y < h;y++) {
-    T *orgrow = org;
-    T *dstrow = dst;
-    for(x = 0;x < w;x++) {
-      double diff = *orgrow - *dstrow;
-      switch(m_Type) {
-      case Min:
-	if (diff < error)
-	  error = diff;
-	break;
-      case Max:
-	if (diff > error)
-	  error = diff;
-	break;
-      case Drift:
-	error += diff;
-	break;
-      case Avg:
-	error += fabs(diff);
-	break;
-      case Peak:
-	diff = fabs(diff);
-	if (diff > error)
-	  error = diff;
-	break;
-      case Toe:
-	if (*orgrow < error)
-	  error = *orgrow;
-	break;
-      case Head:
-	if (*orgrow > error)
-	  error = *orgrow;
-	break;
-      }
-      //
-      orgrow      = (T *)((const UBYTE *)(orgrow) + obytesperpixel);
-      dstrow      = (T *)((const UBYTE *)(dstrow) + dbytesperpixel);
-    }
-    org = (T *)((const UBYTE *)(org) + obytesperrow);
-    dst = (T *)((const UBYTE *)(dst) + dbytesperrow);
-  }
-
-  if (m_Type == Avg || m_Type == Drift)
-    error /= w * h;
-  
-  return error;
+  m_pStatistics = stats;
 }
 ///
 
@@ -111,6 +68,8 @@ double Thres::Measure(class ImageLayout *src,class ImageLayout *dst,double)
 {
   double error;
   UWORD comp;
+
+  assert(m_pStatistics);
   
   switch(m_Type) {
   case Toe:
@@ -127,58 +86,33 @@ double Thres::Measure(class ImageLayout *src,class ImageLayout *dst,double)
   }
   
   for(comp = 0;comp < src->DepthOf();comp++) {
+    const struct Statistics::Result &res = m_pStatistics->ResultOf(src,dst,comp);
     double peak = 0.0;
     ULONG  w    = src->WidthOf(comp);
     ULONG  h    = src->HeightOf(comp);
     //
-    if (src->isSigned(comp)) {
-      if (src->BitsOf(comp) <= 8) {
-	peak = Error<const BYTE>((const BYTE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				 (const BYTE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				 w,h);
-      } else if (!src->isFloat(comp) && src->BitsOf(comp) <= 16) {
-	peak = Error<const WORD>((const WORD *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				 (const WORD *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				 w,h);
-      } else if (!src->isFloat(comp) && src->BitsOf(comp) <= 32) {
-	peak = Error<const LONG>((const LONG *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				 (const LONG *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				 w,h);
-      } else if (src->BitsOf(comp) <= 32 && src->isFloat(comp)) {
-	peak = Error<const FLOAT>((const FLOAT *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				  (const FLOAT *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				  w,h);
-      } else if (src->BitsOf(comp) == 64 && src->isFloat(comp)) {
-	peak = Error<const DOUBLE>((const DOUBLE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				   (const DOUBLE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				   w,h);
-      } else {
-	throw "unsupported data type";
-      }
-    } else {
-      if (src->BitsOf(comp) <= 8) {
-	peak = Error<const UBYTE>((const UBYTE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				  (const UBYTE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				  w,h);
-      } else if (!src->isFloat(comp) && src->BitsOf(comp) <= 16) {
-	peak = Error<const UWORD>((const UWORD *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				  (const UWORD *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				  w,h);
-      } else if (!src->isFloat(comp) && src->BitsOf(comp) <= 32) {
-	peak = Error<const ULONG>((const ULONG *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				  (const ULONG *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				  w,h);
-      } else if (src->BitsOf(comp) <= 32 && src->isFloat(comp)) {
-	peak = Error<const FLOAT>((const FLOAT *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				  (const FLOAT *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				  w,h);
-      } else if (src->BitsOf(comp) == 64 && src->isFloat(comp)) {
-	peak = Error<const DOUBLE>((const DOUBLE *)src->DataOf(comp),src->BytesPerPixel(comp),src->BytesPerRow(comp),
-				   (const DOUBLE *)dst->DataOf(comp),dst->BytesPerPixel(comp),dst->BytesPerRow(comp),
-				   w,h);
-      } else {
-	throw "unsupported data type";
-      }
+    switch(m_Type) {
+    case Min:
+      peak = res.m_dMinDiff;
+      break;
+    case Max:
+      peak = res.m_dMaxDiff;
+      break;
+    case Avg:
+      peak = res.m_dAbsError / (w * h);
+      break;
+    case Drift:
+      peak = res.m_dDrift / (w * h);
+      break;
+    case Peak:
+      peak = res.m_dPeak;
+      break;
+    case Toe:
+      peak = res.m_dToe;
+      break;
+    case Head:
+      peak = res.m_dHead;
+      break;
     }
     //
     switch(m_Type) {
@@ -37,6 +37,7 @@ and conversion framework.
 
 /// Forwards
 class ImageLayout;
+class Statistics;
 ///
 
 /// class Thres
@@ -45,11 +46,9 @@ class Thres : public Meter {
   // Threshold measurement type
   int m_Type;
   //
-  // Templated implementations
-  template<typename T>
-  double Error(T *org,ULONG obytesperpixel,ULONG obytesperrow,
-	       T *dst,ULONG dbytesperpixel,ULONG dbytesperrow,
-	       ULONG w,ULONG h);
+  // The statistics collector the errors are taken from.
+  class Statistics *m_pStatistics;
+  //
 public:
   //
   enum Type {
@@ -63,11 +62,13 @@ public:
   };
   //
   Thres(Type t)
-    : m_Type(t)
+    : m_Type(t), m_pStatistics(NULL)
   { }
   //
   virtual double Measure(class ImageLayout *src,class ImageLayout *dst,double in);
   //
+  virtual void AttachStatistics(class Statistics *stats);
+  //
   virtual const char *NameOf(void) const
   {
     switch(m_Type) {
@@ -88,6 +89,18 @@ public:
     }
     return NULL;
   }
+  //
+  // Keeps nothing from one measurement to the next.
+  virtual bool isReusable(void) const
+  {
+    return true;
+  }
+  //
+  // Only requires the point-wise statistics.
+  virtual bool isStreamable(void) const
+  {
+    return true;
+  }
 };
 ///
 
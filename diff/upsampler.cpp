@@ -113,40 +113,14 @@ void Upsampler::BoxFilter(const S *org,ULONG obytesperpixel,ULONG obytesperrow,
 }
 ///
 
-/// Upsampler::~Upsampler
-Upsampler::~Upsampler(void)
-{
-  ReleaseComponents(m_ppucSource);
-  ReleaseComponents(m_ppucDestination);
-}
-///
-
-/// Upsampler::ReleaseComponents
-void Upsampler::ReleaseComponents(UBYTE **p)
-{
-  int i;
-
-  if (p) {
-    for(i = 0;i < m_usDepth;i++) {
-      if (p[i])
-        delete[] p[i];
-    }
-    delete[] p;
-    p = NULL;
-  }
-}
-///
-
-
 /// Upsampler::Upsample
-void Upsampler::Upsample(UBYTE **&data,class ImageLayout *src)
+void Upsampler::Upsample(class ImageLayout *src)
 {
   UWORD i;
-  // Delete the old image components. Does not release the
-  // memory we hold.
+  // Delete the old image components. This releases the
+  // planes only they refer to.
   delete[] m_pComponent;
   m_pComponent  = NULL;
-  ReleaseComponents(data);
   //
   if (m_bChromaOnly || m_bAutomatic) {
     m_ulWidth     = src->WidthOf();
@@ -185,19 +159,6 @@ void Upsampler::Upsample(UBYTE **&data,class ImageLayout *src)
     }
   }
   //
-  data = new UBYTE *[m_usDepth];
-  memset(data,0,sizeof(UBYTE *) * m_usDepth);
-  m_usAllocated = m_usDepth;
-  //
-  for(i = 0;i < m_usDepth;i++) {
-    UBYTE bps = ImageLayout::SuggestBPP(m_pComponent[i].m_ucBits,m_pComponent[i].m_bFloat);
-    //
-    data[i]                           = new UBYTE[m_pComponent[i].m_ulWidth * m_pComponent[i].m_ulHeight * bps];
-    m_pComponent[i].m_ulBytesPerPixel = bps;
-    m_pComponent[i].m_ulBytesPerRow   = bps * m_pComponent[i].m_ulWidth;
-    m_pComponent[i].m_pPtr            = data[i];
-  }
-  //
   for(i = 0;i < m_usDepth;i++) {
     UBYTE sx,sy;
     //
@@ -212,6 +173,13 @@ void Upsampler::Upsample(UBYTE **&data,class ImageLayout *src)
       sy = 1;
     }
     //
+    // Components that are not resampled share the plane of the source.
+    if (sx == 1 && sy == 1) {
+      SharePlane(i,src,i);
+      continue;
+    }
+    AllocatePlane(i);
+    //
     if (isSigned(i)) {
       if (BitsOf(i) <= 8) {
 	if (m_FilterType == Boxed) {
@@ -360,8 +328,11 @@ void Upsampler::Upsample(UBYTE **&data,class ImageLayout *src)
 /// Upsampler::Measure
 double Upsampler::Measure(class ImageLayout *src,class ImageLayout *dest,double in)
 {
-  Upsample(m_ppucSource,src);
-  Upsample(m_ppucDestination,dest);
+  Upsample(src);
+  Upsample(dest);
+  //
+  // Only the images refer to the planes now.
+  ReleaseComponents();
 
   return in;
 }
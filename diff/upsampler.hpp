@@ -52,13 +52,6 @@ public:
   };
   //
 private:
-  // The component memory itself.
-  UBYTE     **m_ppucSource;
-  UBYTE     **m_ppucDestination;
-  //
-  // Number of allocated components
-  UWORD       m_usAllocated;
-  //
   // Scaling coordinates.
   UBYTE       m_ucScaleX,m_ucScaleY;
   //
@@ -70,11 +63,8 @@ private:
   //
   FilterType  m_FilterType;
   //
-  // Release the temporary buffer.
-  void ReleaseComponents(UBYTE **p);
-  //
   // Perform the actual downsampling.
-  void Upsample(UBYTE **&data,class ImageLayout *src);
+  void Upsample(class ImageLayout *src);
   //
   template<typename S>
   void BilinearFilter(const S *org,ULONG obytesperpixel,ULONG obytesperrow,
@@ -92,12 +82,12 @@ private:
   //
 public:
   Upsampler(UBYTE sx,UBYTE sy,bool chromaonly,FilterType type,bool automatic = false)
-    : m_ppucSource(NULL),m_ppucDestination(NULL), m_usAllocated(0),
-      m_ucScaleX(sx), m_ucScaleY(sy), m_bChromaOnly(chromaonly),
+    : m_ucScaleX(sx), m_ucScaleY(sy), m_bChromaOnly(chromaonly),
       m_bAutomatic(automatic), m_FilterType(type)
   { }
   //
-  virtual ~Upsampler(void);
+  virtual ~Upsampler(void)
+  { }
   //
   virtual double Measure(class ImageLayout *src,class ImageLayout *dst,double in);
   //
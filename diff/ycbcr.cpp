@@ -32,20 +32,10 @@ and conversion framework.
 #include "diff/meter.hpp"
 #include "img/imglayout.hpp"
 #include "diff/ycbcr.hpp"
+#include "diff/downsampler.hpp"
+#include "diff/rowkernels.hpp"
 #include "std/math.hpp"
-///
-
-/// YCbCr::~YCbCr
-// Destructor, also gets rid of the image memory
-YCbCr::~YCbCr(void)
-{
-  int i;
-  
-  for(i = 0;i < 4;i++) {
-    delete[] m_ppucSrcImage[i];
-    delete[] m_ppucDstImage[i];
-  }
-}
+#include "std/string.hpp"
 ///
 
 /// YCbCr::ToDeltaGreen
@@ -275,6 +265,167 @@ void YCbCr::ToYCbCr2020(S *r,S *g,S *b,
 }
 /// 
 
+/// YCbCr::ToYCbCrPixel
+// Convert a single pixel of unsigned integer samples, r,g,b in px[0],
+// px[1] and px[2], in floating point.
+template<typename S>
+void YCbCr::ToYCbCrPixel(S *px,
+			 double yoffset,double coffset,
+			 double min,double max,
+			 double cmin,double cmax)
+{
+  switch(m_Conversion) {
+  case YCbCr_Trafo:
+    ToYCbCr<S,S>(px,px + 1,px + 2,
+		 yoffset,coffset,min,max,cmin,cmax,
+		 sizeof(S),sizeof(S),sizeof(S),3 * sizeof(S),3 * sizeof(S),3 * sizeof(S),
+		 1,1);
+    break;
+  case YCbCr709_Trafo:
+    ToYCbCr709<S,S>(px,px + 1,px + 2,
+		    yoffset,coffset,min,max,cmin,cmax,
+		    sizeof(S),sizeof(S),sizeof(S),3 * sizeof(S),3 * sizeof(S),3 * sizeof(S),
+		    1,1);
+    break;
+  case YCbCr2020_Trafo:
+    ToYCbCr2020<S,S>(px,px + 1,px + 2,
+		     yoffset,coffset,min,max,cmin,cmax,
+		     sizeof(S),sizeof(S),sizeof(S),3 * sizeof(S),3 * sizeof(S),3 * sizeof(S),
+		     1,1);
+    break;
+  default:
+    throw "unknown conversion specified";
+  }
+}
+///
+
+/// YCbCr::ToYCbCrFixed
+// Forward conversion of unsigned integer samples in fixed point, for
+// all YCbCr conversions. The chroma components are subsampled by sx
+// and sy. The matrix contains the coefficients of r,g,b and the offset
+// for y, cb and cr in this order, limit is the maximum sample value.
+// Results closer to a rounding threshold than the precision of the
+// fixed point computation are computed in floating point instead,
+// such that the results are identical to those of the conversions
+// above.
+template<typename S>
+void YCbCr::ToYCbCrFixed(const S *r,const S *g,const S *b,S *yp,S *cb,S *cr,
+			 const QUAD *matrix,ULONG limit,UBYTE bits,
+			 double yoffset,double coffset,
+			 double min,double max,
+			 double cmin,double cmax,
+			 ULONG bppr,ULONG bppg,ULONG bppb,
+			 ULONG bprr,ULONG bprg,ULONG bprb,
+			 ULONG bppy,ULONG bppcb,ULONG bppcr,
+			 ULONG bpry,ULONG bprcb,ULONG bprcr,
+			 ULONG w, ULONG h,UBYTE sx,UBYTE sy)
+{
+  ULONG cw    = (w + sx - 1) / sx;
+  ULONG *sums = new ULONG[2 * cw];
+  LONG *row   = NULL;
+  ULONG x,y,yo,ym;
+
+  try {
+    LONG *c0,*c1,*c2;
+    //
+    row = new LONG[3 * w];
+    c0  = row;
+    c1  = row + w;
+    c2  = row + 2 * w;
+    //
+    for(y = 0;y < h;y += sy) {
+      ULONG *sum;
+      S *cbrow = cb;
+      S *crrow = cr;
+      //
+      ym = y + sy;
+      if (ym > h)
+	ym = h;
+      memset(sums,0,2 * cw * sizeof(ULONG));
+      //
+      for(yo = y;yo < ym;yo++) {
+	const S *rrow = r;
+	const S *grow = g;
+	const S *brow = b;
+	S *yrow       = yp;
+	UBYTE xs      = 0;
+	//
+	// Collect the row such that the kernel finds the samples
+	// without gaps.
+	for(x = 0;x < w;x++) {
+	  c0[x] = *rrow;
+	  c1[x] = *grow;
+	  c2[x] = *brow;
+	  rrow  = (const S *)((const UBYTE *)(rrow) + bppr);
+	  grow  = (const S *)((const UBYTE *)(grow) + bppg);
+	  brow  = (const S *)((const UBYTE *)(brow) + bppb);
+	}
+	RowKernels::Transform(c0,c1,c2,matrix,limit,bits,w);
+	//
+	rrow = r;
+	grow = g;
+	brow = b;
+	sum  = sums;
+	for(x = 0;x < w;x++) {
+	  S px[3];
+	  //
+	  if (c0[x] < 0) {
+	    // Too close to the next integer, the rounding of the floating
+	    // point computation decides.
+	    px[0] = *rrow;
+	    px[1] = *grow;
+	    px[2] = *brow;
+	    ToYCbCrPixel<S>(px,yoffset,coffset,min,max,cmin,cmax);
+	  } else {
+	    px[0] = S(c0[x]);
+	    px[1] = S(c1[x]);
+	    px[2] = S(c2[x]);
+	  }
+	  //
+	  *yrow   = px[0];
+	  sum[0] += px[1];
+	  sum[1] += px[2];
+	  if (++xs >= sx) {
+	    xs   = 0;
+	    sum += 2;
+	  }
+	  //
+	  rrow  = (const S *)((const UBYTE *)(rrow) + bppr);
+	  grow  = (const S *)((const UBYTE *)(grow) + bppg);
+	  brow  = (const S *)((const UBYTE *)(brow) + bppb);
+	  yrow  = (S *)((UBYTE *)(yrow) + bppy);
+	}
+	r  = (const S *)((const UBYTE *)(r) + bprr);
+	g  = (const S *)((const UBYTE *)(g) + bprg);
+	b  = (const S *)((const UBYTE *)(b) + bprb);
+	yp = (S *)((UBYTE *)(yp) + bpry);
+      }
+      //
+      // Write the averages of the chroma samples, truncated as the
+      // downsampler does.
+      sum = sums;
+      for(x = 0;x < w;x += sx) {
+	ULONG cnt = ((x + sx > w)?(w - x):(sx)) * (ym - y);
+	*cbrow    = S(sum[0] / cnt);
+	*crrow    = S(sum[1] / cnt);
+	sum      += 2;
+	cbrow     = (S *)((UBYTE *)(cbrow) + bppcb);
+	crrow     = (S *)((UBYTE *)(crrow) + bppcr);
+      }
+      cb = (S *)((UBYTE *)(cb) + bprcb);
+      cr = (S *)((UBYTE *)(cr) + bprcr);
+    }
+  } catch(...) {
+    delete[] row;
+    delete[] sums;
+    throw;
+  }
+
+  delete[] row;
+  delete[] sums;
+}
+///
+
 /// YCbCr::FromYCbCr
 template<typename S,typename T>
 void YCbCr::FromYCbCr(S *yp,T *cb,T *cr,
@@ -824,6 +975,136 @@ void YCbCr::ToYCbCr(class ImageLayout *img)
   }
 }
 ///
+
+/// YCbCr::ToYCbCrFixed
+// Convert a single image of unsigned integer samples to YCbCr in
+// fixed point, including the subsampling of the chroma components if
+// there is one. Returns false if the image cannot be converted this
+// way.
+bool YCbCr::ToYCbCrFixed(class ImageLayout *img)
+{
+  double m[12];
+  QUAD matrix[12];
+  UBYTE bits = img->BitsOf(0);
+  UBYTE sx   = 1;
+  UBYTE sy   = 1;
+  double yoffset,coffset;
+  double ymin,ymax;
+  int i;
+
+  if (m_bMakeSigned || img->DepthOf() != 3 || bits > 16)
+    return false;
+  //
+  for(i = 0;i < 3;i++) {
+    if (img->WidthOf(i) != img->WidthOf(0) || img->HeightOf(i) != img->HeightOf(0) ||
+	img->BitsOf(i)  != bits || img->isSigned(i) || img->isFloat(i))
+      return false;
+  }
+  //
+  // The offsets and the range of the conversion to unsigned samples.
+  yoffset = 0.5;
+  coffset = 0.5 + (QUAD(1) << (bits-1));
+  ymin    = 0;
+  ymax    = (QUAD(1) << (bits))-1;
+  if (m_bBlackLevel)
+    yoffset += (QUAD(1) << bits) >> 4;
+  //
+  // Collect the coefficients the conversions above use.
+  switch(m_Conversion) {
+  case YCbCr_Trafo:
+    m[0] = 0.299;    m[1] = 0.587;    m[2]  = 0.114;    m[3]  = yoffset;
+    m[4] = -0.16875; m[5] = -0.33126; m[6]  = 0.5;      m[7]  = coffset;
+    m[8] = 0.5;      m[9] = -0.41869; m[10] = -0.08131; m[11] = coffset;
+    break;
+  case YCbCr709_Trafo:
+  case YCbCr2020_Trafo:
+    {
+      const double kb = (m_Conversion == YCbCr709_Trafo)?(0.0722):(0.0593);
+      const double kr = (m_Conversion == YCbCr709_Trafo)?(0.2126):(0.2627);
+      const double kg = 1.0 - kb - kr;
+      //
+      m[0] = kr;
+      m[1] = kg;
+      m[2] = kb;
+      m[3] = yoffset;
+      m[4] = -0.5 * kr / (1.0 - kb);
+      m[5] = -0.5 * kg / (1.0 - kb);
+      m[6] = 0.5;
+      m[7] = coffset;
+      m[8] = 0.5;
+      m[9] = -0.5 * kg / (1.0 - kr);
+      m[10]= -0.5 * kb / (1.0 - kr);
+      m[11]= coffset;
+      //
+      // The 2020 conversion derives the chroma components from luma
+      // including its offset.
+      if (m_Conversion == YCbCr2020_Trafo) {
+	m[7]  -= 0.5 * yoffset / (1.0 - kb);
+	m[11] -= 0.5 * yoffset / (1.0 - kr);
+      }
+    }
+    break;
+  default:
+    return false;
+  }
+  //
+  for(i = 0;i < 12;i++)
+    matrix[i] = QUAD(floor(m[i] * (UQUAD(1) << RowKernels::FractionBits) + 0.5));
+  //
+  if (m_pSubsampler) {
+    UWORD comp;
+    //
+    sx = m_pSubsampler->ScaleXOf();
+    sy = m_pSubsampler->ScaleYOf();
+    //
+    // Build the image with the subsampled chroma components in here,
+    // luma is converted in place.
+    CreateComponents(*img);
+    SharePlane(0,img,0);
+    for(comp = 1;comp < 3;comp++) {
+      m_pComponent[comp].m_ulWidth  = (img->WidthOf(comp)  + sx - 1) / sx;
+      m_pComponent[comp].m_ulHeight = (img->HeightOf(comp) + sy - 1) / sy;
+      m_pComponent[comp].m_ucSubX   = img->SubXOf(comp) * sx;
+      m_pComponent[comp].m_ucSubY   = img->SubYOf(comp) * sy;
+      AllocatePlane(comp);
+    }
+  }
+  //
+  {
+    class ImageLayout *trg = (m_pSubsampler)?(this):(img);
+    //
+    if (bits <= 8) {
+      ToYCbCrFixed<UBYTE>((const UBYTE *)img->DataOf(0),(const UBYTE *)img->DataOf(1),(const UBYTE *)img->DataOf(2),
+			  (UBYTE *)trg->DataOf(0),(UBYTE *)trg->DataOf(1),(UBYTE *)trg->DataOf(2),
+			  matrix,ULONG(ymax),bits,yoffset,coffset,ymin,ymax,ymin,ymax,
+			  img->BytesPerPixel(0),img->BytesPerPixel(1),img->BytesPerPixel(2),
+			  img->BytesPerRow(0)  ,img->BytesPerRow(1)  ,img->BytesPerRow(2),
+			  trg->BytesPerPixel(0),trg->BytesPerPixel(1),trg->BytesPerPixel(2),
+			  trg->BytesPerRow(0)  ,trg->BytesPerRow(1)  ,trg->BytesPerRow(2),
+			  img->WidthOf(0),img->HeightOf(0),sx,sy);
+    } else {
+      ToYCbCrFixed<UWORD>((const UWORD *)img->DataOf(0),(const UWORD *)img->DataOf(1),(const UWORD *)img->DataOf(2),
+			  (UWORD *)trg->DataOf(0),(UWORD *)trg->DataOf(1),(UWORD *)trg->DataOf(2),
+			  matrix,ULONG(ymax),bits,yoffset,coffset,ymin,ymax,ymin,ymax,
+			  img->BytesPerPixel(0),img->BytesPerPixel(1),img->BytesPerPixel(2),
+			  img->BytesPerRow(0)  ,img->BytesPerRow(1)  ,img->BytesPerRow(2),
+			  trg->BytesPerPixel(0),trg->BytesPerPixel(1),trg->BytesPerPixel(2),
+			  trg->BytesPerRow(0)  ,trg->BytesPerRow(1)  ,trg->BytesPerRow(2),
+			  img->WidthOf(0),img->HeightOf(0),sx,sy);
+    }
+  }
+  //
+  if (m_pSubsampler) {
+    Swap(*img);
+    //
+    // Only the image refers to the planes now.
+    ReleaseComponents();
+  }
+
+  return true;
+}
+///
+
 /// YCbCr::FromYbCr
 // Convert a single image from YCbCr to signed or unsigned RGB.
 void YCbCr::FromYCbCr(class ImageLayout *img)
@@ -1014,7 +1295,7 @@ void YCbCr::DispatchToRCT(const class ImageLayout *img,ULONG yoffset,ULONG coffs
 
 /// YCbCr::ToRCT
 // Convert an image with the RCT or the YCgCo transformation.
-void YCbCr::ToRCT(class ImageLayout *img,UBYTE *(&membuf)[4])
+void YCbCr::ToRCT(class ImageLayout *img)
 {
   LONG yoffset  = 0; // always zero
   LONG coffset  = 0; // the chroma component offset.
@@ -1052,8 +1333,6 @@ void YCbCr::ToRCT(class ImageLayout *img,UBYTE *(&membuf)[4])
       ULONG h     = img->HeightOf(comp);
       UBYTE bits  = img->BitsOf(comp); // input bits.
       UBYTE obits = bits;
-      UBYTE bpc;
-      UBYTE *mem;
       //
       // If this is float, then we are not supported.
       if (img->isFloat(comp))
@@ -1073,29 +1352,17 @@ void YCbCr::ToRCT(class ImageLayout *img,UBYTE *(&membuf)[4])
 	if (comp > 0)
 	  obits++;
       }
-      bpc = ImageLayout::SuggestBPP(obits,false);
-      mem = new UBYTE[w * h * bpc];
-      //
-      // Store the pointer to be able to release it later.
-      membuf[comp]                         = mem;
       m_pComponent[comp].m_ucBits          = obits;
       m_pComponent[comp].m_bSigned         = (comp > 0)?(csign):(ysign);
       m_pComponent[comp].m_bFloat          = false;
       m_pComponent[comp].m_ulWidth         = w;
       m_pComponent[comp].m_ulHeight        = h;
-      m_pComponent[comp].m_ulBytesPerPixel = bpc;
-      m_pComponent[comp].m_ulBytesPerRow   = bpc * w;
-      m_pComponent[comp].m_pPtr            = mem;
+      //
+      // The plane is released with the last image referring to it.
+      AllocatePlane(comp);
     } else {
-      // Otherwise, just copy the data over.
-      m_pComponent[comp].m_ucBits          = img->BitsOf(comp);
-      m_pComponent[comp].m_bSigned         = img->isSigned(comp);
-      m_pComponent[comp].m_bFloat          = img->isFloat(comp);
-      m_pComponent[comp].m_ulWidth         = img->WidthOf(comp);
-      m_pComponent[comp].m_ulHeight        = img->HeightOf(comp);
-      m_pComponent[comp].m_ulBytesPerPixel = img->BytesPerPixel(comp);
-      m_pComponent[comp].m_ulBytesPerRow   = img->BytesPerRow(comp);
-      m_pComponent[comp].m_pPtr            = img->DataOf(comp);
+      // Otherwise, share the data.
+      SharePlane(comp,img,comp);
     }
   }
 
@@ -1307,7 +1574,7 @@ void YCbCr::DispatchFromYCbCr(const class ImageLayout *img,double yoffset,double
 
 /// YCbCr::FromRCT
 // Convert back from RCT or YCgCo to RGB
-void YCbCr::FromRCT(class ImageLayout *img,UBYTE *(&membuf)[4])
+void YCbCr::FromRCT(class ImageLayout *img)
 {
   LONG yoffset  = 0; // always zero
   LONG coffset  = 0; // the chroma component offset.
@@ -1365,8 +1632,6 @@ void YCbCr::FromRCT(class ImageLayout *img,UBYTE *(&membuf)[4])
     if (comp < mindepth) {
       ULONG w     = img->WidthOf(comp);
       ULONG h     = img->HeightOf(comp);
-      UBYTE bpc;
-      UBYTE *mem;
       //
       // If this is float, then we are not supported.
       if (img->isFloat(comp))
@@ -1380,29 +1645,17 @@ void YCbCr::FromRCT(class ImageLayout *img,UBYTE *(&membuf)[4])
 	  throw "RCT and YCgCo require that all chroma components have the same signedness";
       }
       //
-      bpc = ImageLayout::SuggestBPP(ybits,false);
-      mem = new UBYTE[w * h * bpc];
-      //
-      // Store the pointer to be able to release it later.
-      membuf[comp]                         = mem;
       m_pComponent[comp].m_ucBits          = ybits;
       m_pComponent[comp].m_bSigned         = ysign; // signed-ness comes from the luma component.
       m_pComponent[comp].m_bFloat          = false;
       m_pComponent[comp].m_ulWidth         = w;
       m_pComponent[comp].m_ulHeight        = h;
-      m_pComponent[comp].m_ulBytesPerPixel = bpc;
-      m_pComponent[comp].m_ulBytesPerRow   = bpc * w;
-      m_pComponent[comp].m_pPtr            = mem;
+      //
+      // The plane is released with the last image referring to it.
+      AllocatePlane(comp);
     } else {
-      // Otherwise, just copy the data over.
-      m_pComponent[comp].m_ucBits          = img->BitsOf(comp);
-      m_pComponent[comp].m_bSigned         = img->isSigned(comp);
-      m_pComponent[comp].m_bFloat          = img->isFloat(comp);
-      m_pComponent[comp].m_ulWidth         = img->WidthOf(comp);
-      m_pComponent[comp].m_ulHeight        = img->HeightOf(comp);
-      m_pComponent[comp].m_ulBytesPerPixel = img->BytesPerPixel(comp);
-      m_pComponent[comp].m_ulBytesPerRow   = img->BytesPerRow(comp);
-      m_pComponent[comp].m_pPtr            = img->DataOf(comp);
+      // Otherwise, share the data.
+      SharePlane(comp,img,comp);
     }
   }
 
@@ -1456,7 +1709,7 @@ void YCbCr::FromRCT(class ImageLayout *img,UBYTE *(&membuf)[4])
 
 /// YCbCr::To422RCT
 // Convert a 422 sampled image with the 422 RCT to YCbCr.
-void YCbCr::To422RCT(class ImageLayout *img,UBYTE *(&membuf)[4])
+void YCbCr::To422RCT(class ImageLayout *img)
 {
   LONG yoffset  = 0; // always zero
   LONG coffset  = 0; // the chroma component offset.
@@ -1491,8 +1744,6 @@ void YCbCr::To422RCT(class ImageLayout *img,UBYTE *(&membuf)[4])
       ULONG h     = img->HeightOf(comp);
       UBYTE bits  = img->BitsOf(comp); // input bits.
       UBYTE obits = bits;
-      UBYTE bpc;
-      UBYTE *mem;
       //
       // If this is float, then we are not supported.
       if (img->isFloat(comp))
@@ -1507,29 +1758,17 @@ void YCbCr::To422RCT(class ImageLayout *img,UBYTE *(&membuf)[4])
       // Expand the bitdepths of all components. Otherwise, this transformation
       // would not be reversible.
       obits++;
-      bpc = ImageLayout::SuggestBPP(obits,false);
-      mem = new UBYTE[w * h * bpc];
-      //
-      // Store the pointer to be able to release it later.
-      membuf[comp]                         = mem;
       m_pComponent[comp].m_ucBits          = obits;
       m_pComponent[comp].m_bSigned         = (comp > 0)?(csign):(ysign);
       m_pComponent[comp].m_bFloat          = false;
       m_pComponent[comp].m_ulWidth         = w;
       m_pComponent[comp].m_ulHeight        = h;
-      m_pComponent[comp].m_ulBytesPerPixel = bpc;
-      m_pComponent[comp].m_ulBytesPerRow   = bpc * w;
-      m_pComponent[comp].m_pPtr            = mem;
+      //
+      // The plane is released with the last image referring to it.
+      AllocatePlane(comp);
     } else {
-      // Otherwise, just copy the data over.
-      m_pComponent[comp].m_ucBits          = img->BitsOf(comp);
-      m_pComponent[comp].m_bSigned         = img->isSigned(comp);
-      m_pComponent[comp].m_bFloat          = img->isFloat(comp);
-      m_pComponent[comp].m_ulWidth         = img->WidthOf(comp);
-      m_pComponent[comp].m_ulHeight        = img->HeightOf(comp);
-      m_pComponent[comp].m_ulBytesPerPixel = img->BytesPerPixel(comp);
-      m_pComponent[comp].m_ulBytesPerRow   = img->BytesPerRow(comp);
-      m_pComponent[comp].m_pPtr            = img->DataOf(comp);
+      // Otherwise, share the data.
+      SharePlane(comp,img,comp);
     }
   }
 
@@ -1583,7 +1822,7 @@ void YCbCr::To422RCT(class ImageLayout *img,UBYTE *(&membuf)[4])
 
 /// YCbCr::From422RCT
 // Convert a YCbCr 422 sampled image with the 422 RCT to RGB.
-void YCbCr::From422RCT(class ImageLayout *img,UBYTE *(&membuf)[4])
+void YCbCr::From422RCT(class ImageLayout *img)
 {
   LONG yoffset  = 0; // always zero
   LONG coffset  = 0; // the chroma component offset.
@@ -1636,8 +1875,6 @@ void YCbCr::From422RCT(class ImageLayout *img,UBYTE *(&membuf)[4])
     if (comp < 3) {
       ULONG w     = img->WidthOf(comp);
       ULONG h     = img->HeightOf(comp);
-      UBYTE bpc;
-      UBYTE *mem;
       //
       // If this is float, then we are not supported.
       if (img->isFloat(comp))
@@ -1649,29 +1886,17 @@ void YCbCr::From422RCT(class ImageLayout *img,UBYTE *(&membuf)[4])
       if (comp > 0 && img->isSigned(comp) != csign)
 	throw "The 422RCT requires that all chroma components have the same signedness";
       //
-      bpc = ImageLayout::SuggestBPP(ybits - 1,false);
-      mem = new UBYTE[w * h * bpc];
-      //
-      // Store the pointer to be able to release it later.
-      membuf[comp]                         = mem;
       m_pComponent[comp].m_ucBits          = ybits - 1;
       m_pComponent[comp].m_bSigned         = ysign; // signed-ness comes from the luma component.
       m_pComponent[comp].m_bFloat          = false;
       m_pComponent[comp].m_ulWidth         = w;
       m_pComponent[comp].m_ulHeight        = h;
-      m_pComponent[comp].m_ulBytesPerPixel = bpc;
-      m_pComponent[comp].m_ulBytesPerRow   = bpc * w;
-      m_pComponent[comp].m_pPtr            = mem;
+      //
+      // The plane is released with the last image referring to it.
+      AllocatePlane(comp);
     } else {
-      // Otherwise, just copy the data over.
-      m_pComponent[comp].m_ucBits          = img->BitsOf(comp);
-      m_pComponent[comp].m_bSigned         = img->isSigned(comp);
-      m_pComponent[comp].m_bFloat          = img->isFloat(comp);
-      m_pComponent[comp].m_ulWidth         = img->WidthOf(comp);
-      m_pComponent[comp].m_ulHeight        = img->HeightOf(comp);
-      m_pComponent[comp].m_ulBytesPerPixel = img->BytesPerPixel(comp);
-      m_pComponent[comp].m_ulBytesPerRow   = img->BytesPerRow(comp);
-      m_pComponent[comp].m_pPtr            = img->DataOf(comp);
+      // Otherwise, share the data.
+      SharePlane(comp,img,comp);
     }
   }
 
@@ -1768,6 +1993,33 @@ void YCbCr::DispatchFrom422RCT(const class ImageLayout *img,ULONG yoffset,ULONG
 }
 ///
 
+/// YCbCr::~YCbCr
+YCbCr::~YCbCr(void)
+{
+  delete m_pSubsampler;
+}
+///
+
+/// YCbCr::FuseSubsampling
+// Take over a subsampling of the chroma components following a
+// conversion to YCbCr.
+bool YCbCr::FuseSubsampling(class Downsampler *sub)
+{
+  if (m_bInverse || m_pSubsampler || !sub->isChromaOnly())
+    return false;
+
+  switch(m_Conversion) {
+  case YCbCr_Trafo:
+  case YCbCr709_Trafo:
+  case YCbCr2020_Trafo:
+    m_pSubsampler = sub;
+    return true;
+  default:
+    return false;
+  }
+}
+///
+
 /// YCbCr::Measure
 double YCbCr::Measure(class ImageLayout *src,class ImageLayout *dst,double in)
 {
@@ -1806,8 +2058,18 @@ double YCbCr::Measure(class ImageLayout *src,class ImageLayout *dst,double in)
       FromYCbCr(src);
       FromYCbCr(dst);
     } else {
-      ToYCbCr(src);
-      ToYCbCr(dst);
+      // Unsigned integer samples are converted in fixed point, which
+      // also subsamples the chroma components right away.
+      if (!ToYCbCrFixed(src)) {
+	ToYCbCr(src);
+	if (m_pSubsampler)
+	  m_pSubsampler->Subsample(src);
+      }
+      if (!ToYCbCrFixed(dst)) {
+	ToYCbCr(dst);
+	if (m_pSubsampler)
+	  m_pSubsampler->Subsample(dst);
+      }
     }
     break;
   case RCTD_Trafo:
@@ -1816,33 +2078,37 @@ double YCbCr::Measure(class ImageLayout *src,class ImageLayout *dst,double in)
   case RCT_Trafo:
   case YCgCo_Trafo:
     if (m_bInverse) {
-      FromRCT(src,m_ppucSrcImage);
+      FromRCT(src);
       Swap(*src);
-      FromRCT(dst,m_ppucDstImage);
+      FromRCT(dst);
       Swap(*dst);
     } else {
-      ToRCT(src,m_ppucSrcImage);
+      ToRCT(src);
       Swap(*src);
-      ToRCT(dst,m_ppucDstImage);
+      ToRCT(dst);
       Swap(*dst);
     }
     break;
   case RCT422_Trafo:
     if (m_bInverse) {
-      From422RCT(src,m_ppucSrcImage);
+      From422RCT(src);
       Swap(*src);
-      From422RCT(dst,m_ppucDstImage);
+      From422RCT(dst);
       Swap(*dst);
     } else {
-      To422RCT(src,m_ppucSrcImage);
+      To422RCT(src);
       Swap(*src);
-      To422RCT(dst,m_ppucDstImage);
+      To422RCT(dst);
       Swap(*dst);
     }
     break;
   default:
     throw "unknown conversion type specified";
   }
+  //
+  // Only the images refer to the planes now.
+  ReleaseComponents();
+  
   return in;
 }
 ///
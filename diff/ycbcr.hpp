@@ -39,6 +39,7 @@ and conversion framework.
 
 /// Forwards
 struct ImgSpecs;
+class Downsampler;
 ///
 
 /// class YCbCr
@@ -56,11 +57,6 @@ class YCbCr : public Meter, private ImageLayout {
   // is added or subtracted from the signal levels.
   bool  m_bBlackLevel;
   //
-  // The component memory itself. In case of the integer transformations,
-  // the range is expanded, hence a new image has to be created.
-  UBYTE *m_ppucSrcImage[4];
-  UBYTE *m_ppucDstImage[4];
-  //
 public:
   //
   // The conversion to run
@@ -79,6 +75,10 @@ public:
 private:
   Conversion m_Conversion;
   //
+  // The subsampling of the chroma components run along with the
+  // conversion, if any.
+  class Downsampler *m_pSubsampler;
+  //
   template<typename S>
   static void Copy(const S *src,S *dst,
 		   ULONG srcbpp,ULONG srcbpr,
@@ -152,6 +152,31 @@ private:
 			   ULONG bpra,ULONG bprd,
 			   ULONG w, ULONG h);
   //
+  // Convert a single pixel of unsigned integer samples, r,g,b in px[0],
+  // px[1] and px[2], in floating point.
+  template<typename S>
+  void ToYCbCrPixel(S *px,
+		    double yoffset,double coffset,
+		    double min,double max,
+		    double cmin,double cmax);
+  //
+  // Forward conversion of unsigned integer samples in fixed point, for
+  // all YCbCr conversions. The chroma components are subsampled by sx
+  // and sy. The matrix contains the coefficients of r,g,b and the
+  // offset for y, cb and cr in this order, limit is the maximum sample
+  // value of samples of the given bit depth.
+  template<typename S>
+  void ToYCbCrFixed(const S *r,const S *g,const S *b,S *y,S *cb,S *cr,
+		    const QUAD *matrix,ULONG limit,UBYTE bits,
+		    double yoffset,double coffset,
+		    double min,double max,
+		    double cmin,double cmax,
+		    ULONG bppr,ULONG bppg,ULONG bppb,
+		    ULONG bprr,ULONG bprg,ULONG bprb,
+		    ULONG bppy,ULONG bppcb,ULONG bppcr,
+		    ULONG bpry,ULONG bprcb,ULONG bprcr,
+		    ULONG w, ULONG h,UBYTE sx,UBYTE sy);
+  //
   // Backwards conversion.
   template<typename S,typename T>
   static void FromYCbCr(S *y,T *cb,T *cr,
@@ -218,6 +243,12 @@ private:
   // Convert a single image to YCbCr.
   void ToYCbCr(class ImageLayout *img);
   //
+  // Convert a single image of unsigned integer samples to YCbCr in
+  // fixed point, including the subsampling of the chroma components
+  // if there is one. Returns false if the image cannot be converted
+  // this way.
+  bool ToYCbCrFixed(class ImageLayout *img);
+  //
   // Convert a single image from YCbCr to RGB
   void FromYCbCr(class ImageLayout *img);
   //
@@ -253,31 +284,33 @@ private:
   // They are both range-expanding.
   //
   // Convert an image from RCT or YCgCo, creating a new image
-  void ToRCT(class ImageLayout *img,UBYTE *(&membuf)[4]);
+  void ToRCT(class ImageLayout *img);
   //
   // Convert an image from RCT or YCgCo, creating a new image
-  void FromRCT(class ImageLayout *img,UBYTE *(&membuf)[4]);
+  void FromRCT(class ImageLayout *img);
   //
   // Convert a 422 sampled image with the 422 RCT to YCbCr.
-  void To422RCT(class ImageLayout *img,UBYTE *(&membuf)[4]);
+  void To422RCT(class ImageLayout *img);
   //
   // Convert a YCbCr 422 sampled image with the 422 RCT to RGB.
-  void From422RCT(class ImageLayout *img,UBYTE *(&membuf)[4]);
+  void From422RCT(class ImageLayout *img);
   //
 public:
   //
   // Forwards or backwards conversion to and from YCbCr
   YCbCr(bool inverse,bool makesigned,bool blacklevel,Conversion conv)
-    : m_bInverse(inverse), m_bMakeSigned(makesigned), m_bBlackLevel(blacklevel), m_Conversion(conv)
-  {
-    memset(m_ppucSrcImage,0,sizeof(m_ppucSrcImage));
-    memset(m_ppucDstImage,0,sizeof(m_ppucDstImage));
-  }
+    : m_bInverse(inverse), m_bMakeSigned(makesigned), m_bBlackLevel(blacklevel), m_Conversion(conv),
+      m_pSubsampler(NULL)
+  { }
   //
   virtual ~YCbCr(void);
   //
   virtual double Measure(class ImageLayout *src,class ImageLayout *dst,double in);
   //
+  // Take over a subsampling of the chroma components following a
+  // conversion to YCbCr.
+  virtual bool FuseSubsampling(class Downsampler *sub);
+  //
   virtual const char *NameOf(void) const
   {
     return NULL;
@@ -37,6 +37,7 @@ and conversion framework.
 /// BlankImg::BlankImg
 // Create a blank image of the given dimensions.
 BlankImg::BlankImg(ULONG width,ULONG height,UWORD depth)
+  : m_pucImage(NULL)
 {
   m_ulWidth  = width;
   m_ulHeight = height;
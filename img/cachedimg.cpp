@@ -0,0 +1,514 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software) for Accusoft	        **
+** All Rights Reserved							**
+**************************************************************************
+
+This source file is part of difftest_ng, a universal image measuring
+and conversion framework.
+
+    difftest_ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    difftest_ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with difftest_ng.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/*
+**
+** This image class keeps decoded images in a cache directory, and
+** maps them from there instead of decoding the source file again.
+**
+** $Id: cachedimg.cpp,v 1.1 2022/09/21 10:12:44 thor Exp $
+**
+*/
+
+/// Includes
+#include "img/cachedimg.hpp"
+#include "tools/mappedfile.hpp"
+#include "tools/threadpool.hpp"
+#include "std/stdio.hpp"
+#include "std/string.hpp"
+#include "std/unistd.hpp"
+#if defined(HAVE_UNISTD_H) && defined(HAVE_SYS_STAT_H) && defined(_POSIX_MAPPED_FILES) && _POSIX_MAPPED_FILES > 0
+# define USE_CACHE
+# include <sys/types.h>
+# include <sys/stat.h>
+#endif
+///
+
+/// Defines
+// Planes start at multiples of this size in the cache entry.
+#define CACHE_PAGESIZE 4096
+// Identifies cache entries, and their version.
+#define CACHE_MAGIC    "DTNGIMG1"
+// The byte order marker, as found on this system.
+#define CACHE_ENDIAN   0x01020304UL
+///
+
+/// CachedImg::CacheHeader
+// The start of a cache entry. All numbers are in the byte order of
+// the system that wrote it.
+struct CachedImg::CacheHeader {
+  //
+  // Identifies the entry.
+  char   m_cMagic[8];
+  ULONG  m_ulEndian;
+  //
+  // Dimensions of the image.
+  ULONG  m_ulWidth;
+  ULONG  m_ulHeight;
+  ULONG  m_ulDepth;
+  //
+  // The key of the entry.
+  struct CacheKey m_Key;
+  //
+  // The specs the loader found.
+  DOUBLE m_dRadianceScale;
+  UBYTE  m_ucFeatures[8];
+};
+///
+
+/// CachedImg::CacheComponent
+// A component of the image. These follow the header.
+struct CachedImg::CacheComponent {
+  //
+  // Offset of the plane from the start of the entry. Samples are
+  // packed, the plane has no gaps.
+  UQUAD  m_uqOffset;
+  //
+  ULONG  m_ulWidth;
+  ULONG  m_ulHeight;
+  //
+  UBYTE  m_ucBits;
+  UBYTE  m_ucSigned;
+  UBYTE  m_ucFloat;
+  UBYTE  m_ucSubX;
+  UBYTE  m_ucSubY;
+  UBYTE  m_ucPad[3];
+};
+///
+
+/// Statics
+// The directory of the cache.
+const char *CachedImg::m_pcDirectory = NULL;
+//
+// Protects the counter of the temporary files.
+static class Mutex CacheLock;
+static ULONG       CacheCount = 0;
+///
+
+/// GetFeatures
+// Collect the features of the specs the loaders look at, or set.
+static void GetFeatures(const struct ImgSpecs &specs,UBYTE *features)
+{
+  features[0] = specs.ASCII;
+  features[1] = specs.Interleaved;
+  features[2] = specs.YUVEncoded;
+  features[3] = specs.Palettized;
+  features[4] = specs.LittleEndian;
+  features[5] = specs.AbsoluteRadiance;
+  features[6] = specs.FullRange;
+  features[7] = 0;
+}
+///
+
+/// SetFeatures
+// Install the features collected by GetFeatures in the specs.
+static void SetFeatures(struct ImgSpecs &specs,const UBYTE *features)
+{
+  specs.ASCII            = ImgSpecs::BinaryFeature(features[0]);
+  specs.Interleaved      = ImgSpecs::BinaryFeature(features[1]);
+  specs.YUVEncoded       = ImgSpecs::BinaryFeature(features[2]);
+  specs.Palettized       = ImgSpecs::BinaryFeature(features[3]);
+  specs.LittleEndian     = ImgSpecs::BinaryFeature(features[4]);
+  specs.AbsoluteRadiance = ImgSpecs::BinaryFeature(features[5]);
+  specs.FullRange        = ImgSpecs::BinaryFeature(features[6]);
+}
+///
+
+/// CachedImg::CachedImg
+CachedImg::CachedImg(void)
+  : m_pMap(NULL)
+{
+}
+///
+
+/// CachedImg::~CachedImg
+CachedImg::~CachedImg(void)
+{
+  delete m_pMap;
+}
+///
+
+/// CachedImg::SetDirectory
+// Install the directory of the cache, enabling it. Throws if the
+// directory does not exist.
+void CachedImg::SetDirectory(const char *dir)
+{
+#ifdef USE_CACHE
+  struct stat st;
+
+  if (stat(dir,&st) != 0 || !S_ISDIR(st.st_mode))
+    PostError("the cache directory %s does not exist",dir);
+
+  m_pcDirectory = dir;
+#else
+  (void)dir;
+  throw "the image cache requires files to be mapped, which is not supported on this system";
+#endif
+}
+///
+
+/// CachedImg::HashOf
+// Hash the given memory block into the given hash value.
+UQUAD CachedImg::HashOf(const UBYTE *data,size_t size,UQUAD hash)
+{
+  const UQUAD mult = (UQUAD(0x9e3779b9UL) << 32) | 0x7f4a7c15UL;
+  UQUAD v;
+
+  hash ^= UQUAD(size) * mult;
+  //
+  // Eight bytes at a time, the high bits of the product are folded
+  // back into the low ones.
+  while(size >= sizeof(v)) {
+    memcpy(&v,data,sizeof(v));
+    hash  = (hash ^ v) * mult;
+    hash ^= hash >> 32;
+    data += sizeof(v);
+    size -= sizeof(v);
+  }
+  //
+  v = 0;
+  while(size) {
+    v = (v << 8) | *data++;
+    size--;
+  }
+  hash  = (hash ^ v) * mult;
+  hash ^= hash >> 32;
+
+  return hash;
+}
+///
+
+/// CachedImg::KeyOf
+// Compute the key of the given source file loaded with the given
+// specs. Returns false if the source is not a regular file.
+bool CachedImg::KeyOf(const char *filename,const struct ImgSpecs &specs,struct CacheKey &key)
+{
+#ifdef USE_CACHE
+  class MappedFile map;
+  const char *ext = strrchr(filename,'.');
+  UBYTE features[8];
+  struct stat st;
+  FILE *file;
+  bool mapped;
+
+  if (stat(filename,&st) != 0 || !S_ISREG(st.st_mode))
+    return false;
+
+  file = fopen(filename,"rb");
+  if (file == NULL)
+    return false;
+  mapped = map.Map(file);
+  fclose(file);
+  if (!mapped)
+    return false;
+  //
+  memset(&key,0,sizeof(key));
+  key.m_uqSize     = map.SizeOf();
+  key.m_uqModified = st.st_mtime;
+  key.m_uqContents = HashOf(map.DataOf(),map.SizeOf(),0);
+  //
+  // The loaders depend on the specs and the file type.
+  GetFeatures(specs,features);
+  key.m_uqSpecs    = HashOf(features,sizeof(features),0);
+  key.m_uqSpecs    = HashOf((const UBYTE *)&specs.RadianceScale,sizeof(specs.RadianceScale),key.m_uqSpecs);
+  if (ext)
+    key.m_uqSpecs  = HashOf((const UBYTE *)ext,strlen(ext),key.m_uqSpecs);
+
+  return true;
+#else
+  (void)filename;
+  (void)specs;
+  (void)key;
+  return false;
+#endif
+}
+///
+
+/// CachedImg::CacheNameOf
+// Return the file name of the cache entry for the key. The caller
+// has to delete it.
+char *CachedImg::CacheNameOf(const struct CacheKey &key)
+{
+  UQUAD hash = HashOf((const UBYTE *)&key,sizeof(key),0);
+  char *name = new char[strlen(m_pcDirectory) + 32];
+
+  sprintf(name,"%s/%08lx%08lx.dtc",m_pcDirectory,
+	  (unsigned long)(hash >> 32),(unsigned long)(hash & MAX_ULONG));
+
+  return name;
+}
+///
+
+/// CachedImg::Map
+// Map the cache entry of the given name if it exists and holds the
+// given key, and fill in the specs the loader found. Returns false
+// if there is no valid entry.
+bool CachedImg::Map(const char *cachename,const struct CacheKey &key,struct ImgSpecs &specs)
+{
+  const struct CacheHeader *header;
+  const struct CacheComponent *comp;
+  UBYTE *base;
+  size_t size;
+  FILE *file;
+  bool mapped;
+  UWORD d;
+
+  assert(m_pMap == NULL);
+
+  file = fopen(cachename,"rb");
+  if (file == NULL)
+    return false;
+  m_pMap = new class MappedFile;
+  mapped = m_pMap->Map(file);
+  fclose(file);
+  if (!mapped)
+    return false;
+  //
+  base   = m_pMap->DataOf();
+  size   = m_pMap->SizeOf();
+  header = (const struct CacheHeader *)base;
+  if (size < sizeof(struct CacheHeader) ||
+      memcmp(header->m_cMagic,CACHE_MAGIC,sizeof(header->m_cMagic)) ||
+      header->m_ulEndian != CACHE_ENDIAN ||
+      memcmp(&header->m_Key,&key,sizeof(key)) ||
+      header->m_ulDepth == 0 || header->m_ulDepth > MAX_UWORD ||
+      (size - sizeof(struct CacheHeader)) / sizeof(struct CacheComponent) < header->m_ulDepth)
+    return false;
+  //
+  comp = (const struct CacheComponent *)(header + 1);
+  for(d = 0;d < header->m_ulDepth;d++) {
+    UQUAD bytes;
+    if (comp[d].m_ucFloat) {
+      if (comp[d].m_ucBits != 16 && comp[d].m_ucBits != 32 && comp[d].m_ucBits != 64)
+	return false;
+    } else if (comp[d].m_ucBits == 0 || comp[d].m_ucBits > 32) {
+      return false;
+    }
+    bytes = UQUAD(comp[d].m_ulWidth) * comp[d].m_ulHeight * SuggestBPP(comp[d].m_ucBits,comp[d].m_ucFloat != 0);
+    if (comp[d].m_uqOffset > size || bytes > size - comp[d].m_uqOffset)
+      return false;
+  }
+  //
+  CreateComponents(header->m_ulWidth,header->m_ulHeight,header->m_ulDepth);
+  for(d = 0;d < m_usDepth;d++) {
+    struct ComponentLayout *cl = m_pComponent + d;
+    cl->m_ucBits          = comp[d].m_ucBits;
+    cl->m_bSigned         = comp[d].m_ucSigned != 0;
+    cl->m_bFloat          = comp[d].m_ucFloat  != 0;
+    cl->m_ucSubX          = comp[d].m_ucSubX;
+    cl->m_ucSubY          = comp[d].m_ucSubY;
+    cl->m_ulWidth         = comp[d].m_ulWidth;
+    cl->m_ulHeight        = comp[d].m_ulHeight;
+    cl->m_ulBytesPerPixel = SuggestBPP(cl->m_ucBits,cl->m_bFloat);
+    cl->m_ulBytesPerRow   = cl->m_ulBytesPerPixel * cl->m_ulWidth;
+    cl->m_pPtr            = base + comp[d].m_uqOffset;
+  }
+  //
+  specs.RadianceScale = header->m_dRadianceScale;
+  SetFeatures(specs,header->m_ucFeatures);
+
+  return true;
+}
+///
+
+/// CachedImg::Store
+// Write a cache entry of the given name for the image. Returns false
+// if the entry cannot be written.
+bool CachedImg::Store(const char *cachename,const struct CacheKey &key,
+		      const class ImageLayout *img,const struct ImgSpecs &specs)
+{
+  static const UBYTE zero[CACHE_PAGESIZE] = {0};
+  struct CacheHeader header;
+  struct CacheComponent *comp = NULL;
+  UBYTE *row                  = NULL;
+  char *tmpname               = NULL;
+  FILE *file                  = NULL;
+  UWORD depth                 = img->DepthOf();
+  unsigned long pid           = 0;
+  UQUAD offset,pos;
+  ULONG count;
+  bool ok;
+  UWORD d;
+
+  memset(&header,0,sizeof(header));
+  memcpy(header.m_cMagic,CACHE_MAGIC,sizeof(header.m_cMagic));
+  header.m_ulEndian       = CACHE_ENDIAN;
+  header.m_ulWidth        = img->WidthOf();
+  header.m_ulHeight       = img->HeightOf();
+  header.m_ulDepth        = depth;
+  header.m_Key            = key;
+  header.m_dRadianceScale = specs.RadianceScale;
+  GetFeatures(specs,header.m_ucFeatures);
+  //
+  // The entry is written to a file of its own and renamed when
+  // complete, such that concurrent runs never see a partial entry.
+#ifdef HAVE_UNISTD_H
+  pid = getpid();
+#endif
+  CacheLock.Lock();
+  count = CacheCount++;
+  CacheLock.Unlock();
+
+  try {
+    comp    = new struct CacheComponent[depth];
+    memset(comp,0,sizeof(struct CacheComponent) * depth);
+    offset  = sizeof(header) + sizeof(struct CacheComponent) * depth;
+    for(d = 0;d < depth;d++) {
+      offset = (offset + CACHE_PAGESIZE - 1) & ~UQUAD(CACHE_PAGESIZE - 1);
+      comp[d].m_uqOffset = offset;
+      comp[d].m_ulWidth  = img->WidthOf(d);
+      comp[d].m_ulHeight = img->HeightOf(d);
+      comp[d].m_ucBits   = img->BitsOf(d);
+      comp[d].m_ucSigned = img->isSigned(d);
+      comp[d].m_ucFloat  = img->isFloat(d);
+      comp[d].m_ucSubX   = img->SubXOf(d);
+      comp[d].m_ucSubY   = img->SubYOf(d);
+      offset += UQUAD(img->WidthOf(d)) * img->HeightOf(d) * SuggestBPP(img->BitsOf(d),img->isFloat(d));
+    }
+    //
+    tmpname = new char[strlen(cachename) + 32];
+    sprintf(tmpname,"%s.%lu.%lu",cachename,pid,(unsigned long)count);
+    file    = fopen(tmpname,"wb");
+    if (file == NULL) {
+      delete[] comp;
+      delete[] tmpname;
+      return false;
+    }
+    //
+    ok  = fwrite(&header,sizeof(header),1,file) == 1;
+    ok  = ok && fwrite(comp,sizeof(struct CacheComponent),depth,file) == depth;
+    pos = sizeof(header) + sizeof(struct CacheComponent) * depth;
+    for(d = 0;d < depth && ok;d++) {
+      ULONG w          = img->WidthOf(d);
+      ULONG h          = img->HeightOf(d);
+      ULONG bpp        = SuggestBPP(img->BitsOf(d),img->isFloat(d));
+      ULONG sbpp       = img->BytesPerPixel(d);
+      ULONG sbpr       = img->BytesPerRow(d);
+      const UBYTE *src = (const UBYTE *)img->DataOf(d);
+      ULONG x,y;
+      //
+      while(pos < comp[d].m_uqOffset && ok) {
+	size_t pad = size_t(comp[d].m_uqOffset - pos);
+	ok   = fwrite(zero,1,pad,file) == pad;
+	pos += pad;
+      }
+      //
+      if (sbpp != bpp) {
+	delete[] row;
+	row = NULL;
+	row = new UBYTE[size_t(w) * bpp];
+      }
+      for(y = 0;y < h && ok;y++) {
+	if (sbpp == bpp) {
+	  ok = fwrite(src,bpp,w,file) == w;
+	} else {
+	  const UBYTE *s = src;
+	  UBYTE *dst     = row;
+	  for(x = 0;x < w;x++) {
+	    memcpy(dst,s,bpp);
+	    dst += bpp;
+	    s   += sbpp;
+	  }
+	  ok = fwrite(row,bpp,w,file) == w;
+	}
+	src += sbpr;
+      }
+      pos += UQUAD(w) * h * bpp;
+    }
+  } catch(...) {
+    if (file) {
+      fclose(file);
+      remove(tmpname);
+    }
+    delete[] row;
+    delete[] comp;
+    delete[] tmpname;
+    throw;
+  }
+  //
+  if (fclose(file) != 0)
+    ok = false;
+  if (ok)
+    ok = rename(tmpname,cachename) == 0;
+  if (!ok)
+    remove(tmpname);
+
+  delete[] row;
+  delete[] comp;
+  delete[] tmpname;
+
+  return ok;
+}
+///
+
+/// CachedImg::LoadCached
+// Load an image from the cache if it holds it, otherwise decode it
+// and enter it into the cache. A window to crop to is not pushed
+// down into the loader, the complete image is cached and the crop
+// is left to the caller.
+class ImageLayout *CachedImg::LoadCached(const char *filename,struct ImgSpecs &specs)
+{
+  struct CacheKey key;
+  class CachedImg *cached = NULL;
+  class ImageLayout *img  = NULL;
+  char *cachename         = NULL;
+  bool crop               = false;
+
+  assert(m_pcDirectory);
+
+  if (!KeyOf(filename,specs,key))
+    return DecodeImage(filename,specs);
+
+  try {
+    cachename = CacheNameOf(key);
+    cached    = new class CachedImg;
+    if (cached->Map(cachename,key,specs)) {
+      delete[] cachename;
+      return cached;
+    }
+    delete cached;
+    cached = NULL;
+    //
+    if (specs.Cropped == ImgSpecs::No) {
+      specs.Cropped = ImgSpecs::Unspecified;
+      crop          = true;
+    }
+    img = DecodeImage(filename,specs);
+    if (crop)
+      specs.Cropped = ImgSpecs::No;
+    //
+    // If the entry cannot be written, the image is decoded again
+    // next time, which is not an error.
+    Store(cachename,key,img,specs);
+  } catch(...) {
+    delete cached;
+    delete img;
+    delete[] cachename;
+    throw;
+  }
+
+  delete[] cachename;
+
+  return img;
+}
+///
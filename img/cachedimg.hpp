@@ -0,0 +1,119 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software) for Accusoft	        **
+** All Rights Reserved							**
+**************************************************************************
+
+This source file is part of difftest_ng, a universal image measuring
+and conversion framework.
+
+    difftest_ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    difftest_ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with difftest_ng.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/*
+**
+** This image class keeps decoded images in a cache directory, and
+** maps them from there instead of decoding the source file again.
+**
+** $Id: cachedimg.hpp,v 1.1 2022/09/21 10:12:44 thor Exp $
+**
+*/
+
+#ifndef IMG_CACHEDIMG_HPP
+#define IMG_CACHEDIMG_HPP
+
+/// Includes
+#include "interface/types.hpp"
+#include "img/imglayout.hpp"
+#include "img/imgspecs.hpp"
+///
+
+/// Forwards
+class MappedFile;
+///
+
+/// CachedImg
+// An image mapped from a cache entry. An entry holds the planes of a
+// decoded image in a flat file, each plane starting at a page
+// boundary, along with the component layout and the specs the loader
+// found. Entries are keyed by the size, the modification time and a
+// hash of the contents of the source file, and the specs it was
+// loaded with.
+class CachedImg : public ImageLayout {
+  //
+  // The key of a cache entry.
+  struct CacheKey {
+    UQUAD m_uqSize;
+    UQUAD m_uqModified;
+    UQUAD m_uqContents;
+    UQUAD m_uqSpecs;
+  };
+  //
+  // The layout of a cache entry: The header, the components, and
+  // the planes.
+  struct CacheHeader;
+  struct CacheComponent;
+  //
+  // The mapping of the cache entry.
+  class MappedFile  *m_pMap;
+  //
+  // The directory of the cache, or NULL if there is none.
+  static const char *m_pcDirectory;
+  //
+  // Hash the given memory block into the given hash value.
+  static UQUAD HashOf(const UBYTE *data,size_t size,UQUAD hash);
+  //
+  // Compute the key of the given source file loaded with the given
+  // specs. Returns false if the source is not a regular file.
+  static bool KeyOf(const char *filename,const struct ImgSpecs &specs,struct CacheKey &key);
+  //
+  // Return the file name of the cache entry for the key. The caller
+  // has to delete it.
+  static char *CacheNameOf(const struct CacheKey &key);
+  //
+  // Map the cache entry of the given name if it exists and holds the
+  // given key, and fill in the specs the loader found. Returns false
+  // if there is no valid entry.
+  bool Map(const char *cachename,const struct CacheKey &key,struct ImgSpecs &specs);
+  //
+  // Write a cache entry of the given name for the image. Returns false
+  // if the entry cannot be written.
+  static bool Store(const char *cachename,const struct CacheKey &key,
+		    const class ImageLayout *img,const struct ImgSpecs &specs);
+  //
+public:
+  CachedImg(void);
+  //
+  ~CachedImg(void);
+  //
+  // Install the directory of the cache, enabling it. Throws if the
+  // directory does not exist.
+  static void SetDirectory(const char *dir);
+  //
+  // Return the directory of the cache, or NULL if caching is disabled.
+  static const char *DirectoryOf(void)
+  {
+    return m_pcDirectory;
+  }
+  //
+  // Load an image from the cache if it holds it, otherwise decode it
+  // and enter it into the cache. A window to crop to is not pushed
+  // down into the loader, the complete image is cached and the crop
+  // is left to the caller.
+  static class ImageLayout *LoadCached(const char *filename,struct ImgSpecs &specs);
+};
+///
+
+///
+#endif
@@ -36,6 +36,7 @@ and conversion framework.
 #include "std/stdio.hpp"
 #include "std/errno.hpp"
 #include "std/stdlib.hpp"
+#include "std/string.hpp"
 #include "cmd/main.hpp"
 #include "img/imglayout.hpp"
 #include "img/imgspecs.hpp"
@@ -49,6 +50,31 @@ and conversion framework.
 #include "img/simpleraw.hpp"
 #include "img/simpledpx.hpp"
 #include "img/blankimg.hpp"
+#include "img/cachedimg.hpp"
+#ifdef USE_PTHREADS
+#include <pthread.h>
+#endif
+///
+
+/// Statics
+#ifdef USE_PTHREADS
+// Images are loaded from several threads at once in batch mode, so
+// each thread formats its error messages into a buffer of its own.
+static pthread_key_t  ErrorKey;
+static pthread_once_t ErrorOnce = PTHREAD_ONCE_INIT;
+//
+// Release the buffer of a thread when it terminates.
+static void ReleaseErrorBuffer(void *buffer)
+{
+  free(buffer);
+}
+//
+// Create the key of the per-thread buffers.
+static void CreateErrorKey(void)
+{
+  pthread_key_create(&ErrorKey,&ReleaseErrorBuffer);
+}
+#endif
 ///
 
 /// ImageLayout::ImageLayout
@@ -73,7 +99,7 @@ ImageLayout::ImageLayout(const class ImageLayout &src)
     UWORD size = m_usDepth;
     // Now copy the component layouts over, including the memory pointers.
     for(i = 0; i < size; i++) {
-      // The compiler-generated assignment operator is fine for us here.
+      // The assignment shares the planes, if any.
       m_pComponent[i] = src.m_pComponent[i];
     }
   }
@@ -101,7 +127,7 @@ class ImageLayout &ImageLayout::operator=(const class ImageLayout &src)
     struct ComponentLayout *newcomp = new struct ComponentLayout[size];
     if (src.m_pComponent) {
       for(i = 0;i < size;i++) {
-	// The default assignment is just fine.
+	// The assignment shares the planes, if any.
 	newcomp[i] = src.m_pComponent[i];
       }
     }
@@ -113,7 +139,7 @@ class ImageLayout &ImageLayout::operator=(const class ImageLayout &src)
     // No need to allocate memory, just copy it over.
     if (src.m_pComponent) {
       for(i = 0;i < size;i++) {
-	// The default assignment is just fine.
+	// The assignment shares the planes, if any.
 	m_pComponent[i] = src.m_pComponent[i];
       }
     }
@@ -130,7 +156,24 @@ class ImageLayout &ImageLayout::operator=(const class ImageLayout &src)
 // error
 void TYPE_CDECL ImageLayout::PostError(const char *fmt,...)
 {
-  char buffer[4096];
+  // The message must survive the throw, hence it cannot go onto
+  // the stack. It remains valid until the same thread posts the
+  // next error.
+#ifdef USE_PTHREADS
+  char *buffer;
+  //
+  pthread_once(&ErrorOnce,&CreateErrorKey);
+  buffer = (char *)pthread_getspecific(ErrorKey);
+  if (buffer == NULL) {
+    buffer = (char *)malloc(4096);
+    if (buffer == NULL || pthread_setspecific(ErrorKey,buffer)) {
+      free(buffer);
+      throw "out of memory reporting an image error";
+    }
+  }
+#else
+  static char buffer[4096];
+#endif
   va_list args;
   //
   va_start(args,fmt);
@@ -195,6 +238,59 @@ void ImageLayout::CreateComponents(const class ImageLayout &o)
 }
 ///
 
+/// ImageLayout::AllocatePlane
+// Allocate a reference counted plane for the given component from
+// its dimensions and sample type, and fill in the bytes per pixel
+// and row. Returns the memory of the plane.
+APTR ImageLayout::AllocatePlane(UWORD comp)
+{
+  struct ComponentLayout *cl = m_pComponent + comp;
+  UBYTE bpp                  = SuggestBPP(cl->m_ucBits,cl->m_bFloat);
+  struct PlaneBuffer *buf    = new struct PlaneBuffer;
+  //
+  buf->m_ulRefs  = 1;
+  buf->m_pucData = NULL;
+  try {
+    buf->m_pucData = new UBYTE[size_t(cl->m_ulWidth) * cl->m_ulHeight * bpp];
+  } catch(...) {
+    delete buf;
+    throw;
+  }
+  //
+  cl->ReleasePlane();
+  cl->m_pBuffer         = buf;
+  cl->m_ulBytesPerPixel = bpp;
+  cl->m_ulBytesPerRow   = bpp * cl->m_ulWidth;
+  cl->m_pPtr            = buf->m_pucData;
+  //
+  return cl->m_pPtr;
+}
+///
+
+/// ImageLayout::SharePlane
+// Let the given component share the layout and the plane of a
+// component of another image.
+void ImageLayout::SharePlane(UWORD comp,const class ImageLayout *src,UWORD srccomp)
+{
+  assert(comp < m_usDepth && srccomp < src->m_usDepth);
+  
+  m_pComponent[comp] = src->m_pComponent[srccomp];
+}
+///
+
+/// ImageLayout::ReleaseComponents
+// Drop all components, and thus the planes only they refer to.
+void ImageLayout::ReleaseComponents(void)
+{
+  delete[] m_pComponent;
+  m_pComponent  = NULL;
+  m_ulWidth     = 0;
+  m_ulHeight    = 0;
+  m_usDepth     = 0;
+  m_usAlphaDepth= 0;
+}
+///
+
 /// ImageLayout::Swap
 // Swap this image layout internals with that of the given source.
 void ImageLayout::Swap(class ImageLayout &o)
@@ -277,12 +373,52 @@ void ImageLayout::Crop(ULONG x1,ULONG y1,ULONG x2,ULONG y2)
 }
 ///
 
+/// ImageLayout::CropRowsOf
+// Check whether a loader may read only the window the specs ask to
+// crop to. The dimensions and subsampling of the image must be known.
+// If so, returns true and the first and last row of the window.
+bool ImageLayout::CropRowsOf(const struct ImgSpecs &specs,ULONG &y1,ULONG &y2) const
+{
+  UWORD i;
+
+  if (specs.Cropped != ImgSpecs::No)
+    return false;
+  //
+  // Windows that are empty or outside of the image are left to Crop()
+  // to complain about.
+  if (specs.CropX1 > specs.CropX2 || specs.CropY1 > specs.CropY2 ||
+      specs.CropX1 >= m_ulWidth   || specs.CropY1 >= m_ulHeight)
+    return false;
+  //
+  for(i = 0;i < m_usDepth;i++) {
+    if (m_pComponent[i].m_ucSubX != 1 || m_pComponent[i].m_ucSubY != 1)
+      return false;
+  }
+  //
+  y1 = specs.CropY1;
+  y2 = (specs.CropY2 < m_ulHeight)?(specs.CropY2):(m_ulHeight - 1);
+  
+  return true;
+}
+///
+
+/// ImageLayout::CropLoaded
+// Complete the crop to the window of the specs for a loader that
+// read the rows starting at row top of the image, at full width.
+void ImageLayout::CropLoaded(struct ImgSpecs &specs,ULONG top)
+{
+  assert(specs.Cropped == ImgSpecs::No && specs.CropY1 >= top);
+
+  Crop(specs.CropX1,specs.CropY1 - top,specs.CropX2,specs.CropY2 - top);
+  specs.Cropped = ImgSpecs::Yes;
+}
+///
+
 /// ImageLayout::LoadImage
 // Load an image from the specified filespec using the appropriate file type,
 // derived from the extension. Returns the proper loader.
 class ImageLayout *ImageLayout::LoadImage(const char *filename,struct ImgSpecs &specs)
 {  
-  class ImageLayout *img = NULL;
   const char *ext        = strrchr(filename,'.');
   //
   if (ext == NULL) {
@@ -311,6 +447,31 @@ class ImageLayout *ImageLayout::LoadImage(const char *filename,struct ImgSpecs &
     return NULL;
   }
   //
+  // Raw file names include the layout, they are not cached. They are
+  // not decoded either, but mapped anyhow. PGX images are decoded from
+  // side files the cache key does not cover, they are not cached
+  // either.
+  if (CachedImg::DirectoryOf() &&
+      !(!strncmp(ext,".raw",4)  || !strncmp(ext,".craw",5) ||
+	!strncmp(ext,".v210",4) || !strncmp(ext,".yuv",4)  ||
+	!strncmp(ext,".pgx",4)))
+    return CachedImg::LoadCached(filename,specs);
+  //
+  return DecodeImage(filename,specs);
+}
+///
+
+/// ImageLayout::DecodeImage
+// Load an image from the specified file using the appropriate file type,
+// derived from the extension, bypassing the cache.
+class ImageLayout *ImageLayout::DecodeImage(const char *filename,struct ImgSpecs &specs)
+{
+  class ImageLayout *img = NULL;
+  const char *ext        = strrchr(filename,'.');
+  //
+  if (ext == NULL)
+    throw "no file format extender, can't load source image";
+  //
   try {
     //
     if (!strcmp(ext,".ppm") || !strcmp(ext,".pgm") || !strcmp(ext,".pbm") || 
@@ -380,6 +541,86 @@ class ImageLayout *ImageLayout::LoadImage(const char *filename,struct ImgSpecs &
 }
 ///
 
+/// ImageLayout::LoadFrame
+// Load the given frame of a file holding a sequence of images of the
+// same format. Only raw files can hold sequences.
+class ImageLayout *ImageLayout::LoadFrame(const char *filename,struct ImgSpecs &specs,
+					  ULONG frame,ULONG &frames)
+{
+  class SimpleRaw *raw   = NULL;
+  const char *ext        = strrchr(filename,'.');
+  //
+  if (ext == NULL)
+    throw "no file format extender, can't load source image";
+  //
+  if (!(!strncmp(ext,".raw",4)  || !strncmp(ext,".craw",5) ||
+	!strncmp(ext,".v210",4) || !strncmp(ext,".yuv",4)))
+    PostError("%s cannot be read as a sequence of frames, only raw images can",filename);
+  //
+  try {
+    raw = new SimpleRaw;
+    raw->LoadFrame(filename,specs,frame);
+    frames = raw->FramesOf();
+  } catch(...) {
+    delete raw;
+    throw;
+  }
+  //
+  return raw;
+}
+///
+
+/// ImageLayout::OpenStripes
+// Open an image for reading it in stripes from top to bottom. The
+// returned layout describes the full image, but holds no data before
+// ReadStripe() is called.
+class ImageLayout *ImageLayout::OpenStripes(const char *filename,struct ImgSpecs &specs)
+{
+  class ImageLayout *img = NULL;
+  const char *ext        = strrchr(filename,'.');
+  //
+  if (ext == NULL)
+    throw "no file format extender, can't load source image";
+  //
+  try {
+    if (!strcmp(ext,".ppm") || !strcmp(ext,".pgm") || 
+	!strcmp(ext,".pnm") || !strcmp(ext,".pfm")) {
+      class SimplePpm *ppm = new SimplePpm;
+      img = ppm;
+      ppm->OpenStripes(filename,specs);
+    } else if (!strcmp(ext,".tif") || !strcmp(ext,".tiff")) {
+      class SimpleTiff *tif = new SimpleTiff;
+      img = tif;
+      tif->OpenStripes(filename,specs);
+    } else if (!strncmp(ext,".raw",4)  || !strncmp(ext,".craw",5) ||
+	       !strncmp(ext,".v210",4) || !strncmp(ext,".yuv",4)) {
+      class SimpleRaw *raw = new SimpleRaw;
+      img = raw;
+      raw->OpenStripes(filename,specs);
+    } else {
+      PostError("the file format of %s cannot be read in stripes, only pnm (pgm,ppm,pfm), tiff and raw can",
+		filename);
+    }
+  } catch(...) {
+    delete img;
+    throw;
+  }
+  //
+  return img;
+}
+///
+
+/// ImageLayout::ReadStripe
+// Read the next stripe of an image opened by OpenStripes(). Loaders
+// that can deliver stripes override this.
+ULONG ImageLayout::ReadStripe(ULONG)
+{
+  throw "this image cannot be read in stripes";
+  
+  return 0;
+}
+///
+
 /// ImageLayout::SaveImage
 // Save an image back to a file
 void ImageLayout::SaveImage(const char *filename,const struct ImgSpecs &specs)
@@ -467,6 +708,51 @@ class ImageLayout *ImageLayout::CloneLayout(const class ImageLayout *org)
 }
 ///
 
+/// ImageLayout::CopyImage
+// Create an image of the same layout holding a copy of the data of
+// the given image, such that it can be modified independently.
+class ImageLayout *ImageLayout::CopyImage(const class ImageLayout *org)
+{
+  class BlankImg *img = new BlankImg(*org);
+  UWORD d;
+
+  try {
+    img->BlankSeparate();
+    //
+    for(d = 0;d < img->DepthOf();d++) {
+      ULONG w          = img->WidthOf(d);
+      ULONG h          = img->HeightOf(d);
+      ULONG bpp        = img->BytesPerPixel(d);
+      ULONG sbpp       = org->BytesPerPixel(d);
+      ULONG sbpr       = org->BytesPerRow(d);
+      const UBYTE *src = (const UBYTE *)org->DataOf(d);
+      UBYTE *dst       = (UBYTE *)img->DataOf(d);
+      ULONG x,y;
+      //
+      for(y = 0;y < h;y++) {
+	const UBYTE *s = src;
+	if (sbpp == bpp) {
+	  memcpy(dst,s,size_t(w) * bpp);
+	  dst += size_t(w) * bpp;
+	} else {
+	  for(x = 0;x < w;x++) {
+	    memcpy(dst,s,bpp);
+	    dst += bpp;
+	    s   += sbpp;
+	  }
+	}
+	src += sbpr;
+      }
+    }
+  } catch(...) {
+    delete img;
+    throw;
+  }
+
+  return img;
+}
+///
+
 /// ImageLayout::TestIfCompatible
 // Check whether the two images are compatible in dimension and depth
 // to allow a comparison. Throw if not.
@@ -68,6 +68,19 @@ protected:
   // Number of alpha channels in here.
   UWORD              m_usAlphaDepth;
   //
+  // A reference counted image plane, allocated by filters that create
+  // new image data. All component layouts referring to the plane share
+  // it, and the last one releases it. The counter is not protected,
+  // thus planes must not be shared between threads.
+  struct PlaneBuffer {
+    //
+    // Number of component layouts referring to this plane.
+    ULONG       m_ulRefs;
+    //
+    // The memory of the plane.
+    UBYTE      *m_pucData;
+  };
+  //
   // The component array. We hold depth+1 components, one is reserved for the ROI.
   // How and where the components are organized is the matter of the implementors.
   struct ComponentLayout {
@@ -100,16 +113,63 @@ protected:
     // administrate the memory, this does the implementor.
     APTR        m_pPtr;
     //
+    // The plane the image data lives in if it is reference counted,
+    // NULL if the memory is administrated by the implementor.
+    struct PlaneBuffer *m_pBuffer;
+    //
     // Constructor.
     ComponentLayout(void)
       : m_ucBits(8), m_bSigned(false), m_bFloat(false),
 	m_ucSubX(1), m_ucSubY(1),
 	m_ulWidth(0), m_ulHeight(0),
-	m_pPtr(NULL)
+	m_pPtr(NULL), m_pBuffer(NULL)
     { }
     //
+    // Copies share the plane.
+    ComponentLayout(const struct ComponentLayout &o)
+      : m_ucBits(o.m_ucBits), m_bSigned(o.m_bSigned), m_bFloat(o.m_bFloat),
+	m_ucSubX(o.m_ucSubX), m_ucSubY(o.m_ucSubY),
+	m_ulWidth(o.m_ulWidth), m_ulHeight(o.m_ulHeight),
+	m_ulBytesPerPixel(o.m_ulBytesPerPixel), m_ulBytesPerRow(o.m_ulBytesPerRow),
+	m_pPtr(o.m_pPtr), m_pBuffer(o.m_pBuffer)
+    {
+      if (m_pBuffer)
+	m_pBuffer->m_ulRefs++;
+    }
+    //
     ~ComponentLayout(void)
-    { }
+    {
+      ReleasePlane();
+    }
+    //
+    struct ComponentLayout &operator=(const struct ComponentLayout &o)
+    {
+      if (o.m_pBuffer)
+	o.m_pBuffer->m_ulRefs++;
+      ReleasePlane();
+      m_ucBits          = o.m_ucBits;
+      m_bSigned         = o.m_bSigned;
+      m_bFloat          = o.m_bFloat;
+      m_ucSubX          = o.m_ucSubX;
+      m_ucSubY          = o.m_ucSubY;
+      m_ulWidth         = o.m_ulWidth;
+      m_ulHeight        = o.m_ulHeight;
+      m_ulBytesPerPixel = o.m_ulBytesPerPixel;
+      m_ulBytesPerRow   = o.m_ulBytesPerRow;
+      m_pPtr            = o.m_pPtr;
+      m_pBuffer         = o.m_pBuffer;
+      return *this;
+    }
+    //
+    // Drop the reference to the plane, release it if this was the last.
+    void ReleasePlane(void)
+    {
+      if (m_pBuffer && --m_pBuffer->m_ulRefs == 0) {
+	delete[] m_pBuffer->m_pucData;
+	delete m_pBuffer;
+      }
+      m_pBuffer = NULL;
+    }
   }            *m_pComponent;
   //
   // Allocate an image layout for the given width and height.
@@ -120,11 +180,36 @@ protected:
   // original.
   void CreateComponents(const class ImageLayout &img);
   //
+  // Allocate a reference counted plane for the given component from
+  // its dimensions and sample type, and fill in the bytes per pixel
+  // and row. Returns the memory of the plane.
+  APTR AllocatePlane(UWORD comp);
+  //
+  // Let the given component share the layout and the plane of a
+  // component of another image.
+  void SharePlane(UWORD comp,const class ImageLayout *src,UWORD srccomp);
+  //
+  // Drop all components, and thus the planes only they refer to.
+  void ReleaseComponents(void);
+  //
   // Compute a suitable bits per pixel value from a bitdepth. Note that
   // this is not the bpp value for this specific implementation, but
   // a helper function that returns a usable size for a given bitdepth
   static UBYTE SuggestBPP(UBYTE bits,bool isfloat);
   //
+  // Load an image from the specified file using the appropriate file type,
+  // derived from the extension, bypassing the cache.
+  static class ImageLayout *DecodeImage(const char *filename,struct ImgSpecs &specs);
+  //
+  // Check whether a loader may read only the window the specs ask to
+  // crop to. The dimensions and subsampling of the image must be known.
+  // If so, returns true and the first and last row of the window.
+  bool CropRowsOf(const struct ImgSpecs &specs,ULONG &y1,ULONG &y2) const;
+  //
+  // Complete the crop to the window of the specs for a loader that
+  // read the rows starting at row top of the image, at full width.
+  void CropLoaded(struct ImgSpecs &specs,ULONG top);
+  //
 public:
   // This can be called by subclasses to indicate an
   // error
@@ -283,10 +368,33 @@ public:
   // derived from the extension. Returns the proper loader.
   static class ImageLayout *LoadImage(const char *filename,struct ImgSpecs &specs);
   //
+  // Load the given frame of a file holding a sequence of images, and
+  // return the number of frames in the file in frames, or zero if the
+  // file does not tell. Throws if the file format cannot hold
+  // sequences.
+  static class ImageLayout *LoadFrame(const char *filename,struct ImgSpecs &specs,
+				      ULONG frame,ULONG &frames);
+  //
+  // Open an image for reading it in stripes from top to bottom. The
+  // returned layout describes the full image, but holds no data before
+  // ReadStripe() is called. Throws if the file format or the image
+  // cannot be read in stripes.
+  static class ImageLayout *OpenStripes(const char *filename,struct ImgSpecs &specs);
+  //
+  // Read the next stripe of an image opened by OpenStripes(), the given
+  // number of rows or the remaining ones. Afterwards, the layout
+  // describes just this stripe. Returns the number of rows, zero at the
+  // end of the image.
+  virtual ULONG ReadStripe(ULONG rows);
+  //
   // Clone the layout of an image and create an image of the same dimensions just
   // with no data.
   static class ImageLayout *CloneLayout(const class ImageLayout *org);
   //
+  // Create an image of the same layout holding a copy of the data of
+  // the given image, such that it can be modified independently.
+  static class ImageLayout *CopyImage(const class ImageLayout *org);
+  //
   // Save an image back to a file
   void SaveImage(const char *filename,const struct ImgSpecs &specs);
   //
@@ -70,10 +70,34 @@ struct ImgSpecs {
   //
   BinaryFeature FullRange;
   //
+  // Is the image going to be cropped right after loading? Unspecified
+  // if not, No if the loader may read the window given by the edges
+  // below alone, and Yes if it did and the image is the window.
+  BinaryFeature Cropped;
+  //
+  // The edges of the cropping window, inclusive.
+  ULONG         CropX1,CropY1,CropX2,CropY2;
+  //
+  // The compression of the output, for formats that offer a choice.
+  enum CompressionType {
+    Uncompressed,
+    LZW,
+    PackBits
+  };
+  CompressionType Compression;
+  //
+  // Shall compressed output use horizontal prediction?
+  BinaryFeature Predictor;
+  //
+  // Rows per strip of the output, zero for the default.
+  ULONG         RowsPerStrip;
+  //
   ImgSpecs(void)
     : ASCII(Unspecified), Interleaved(Unspecified), YUVEncoded(Unspecified), 
       Palettized(Unspecified), LittleEndian(Unspecified), AbsoluteRadiance(Unspecified),
-      RadianceScale(1.0), FullRange(Unspecified)
+      RadianceScale(1.0), FullRange(Unspecified), Cropped(Unspecified),
+      CropX1(0), CropY1(0), CropX2(0), CropY2(0),
+      Compression(Uncompressed), Predictor(Unspecified), RowsPerStrip(0)
   { }
   //
   // MergeSpecs: Merge this, and two other specs together. This one overrides all,
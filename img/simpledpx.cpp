@@ -33,6 +33,7 @@ and conversion framework.
 #include "img/imgspecs.hpp"
 #include "std/stdio.hpp"
 #include "tools/file.hpp"
+#include "tools/mappedfile.hpp"
 ///
 
 /// SimpleDPX::SimpleDPX
@@ -728,6 +729,246 @@ void SimpleDPX::ParseElement(FILE *file,struct ImageElement *el)
 }
 ///
 
+/// SimpleDPX::SamplePositions
+// Compute the bit positions of the samples within a 32 bit word by
+// running the state machine of ReadData() over a word. Returns the
+// number of samples per word, or zero if samples straddle words.
+UBYTE SimpleDPX::SamplePositions(const struct ImageElement *el,UBYTE *shift) const
+{
+  UBYTE bits  = el->m_ucBitDepth;
+  UBYTE k     = 0;
+  bool filled = false;
+  int bit     = 0;
+
+  for(;;) {
+    if (m_bLeftToRightScan) {
+      if (bit <= el->m_ucLSBPaddingBits) {
+	if (filled)
+	  break;
+	bit    = 32 - el->m_ucMSBPaddingBits;
+	filled = true;
+      }
+      if (bit < bits)
+	return 0;
+      shift[k++] = bit - bits;
+    } else {
+      if (bit <= el->m_ucMSBPaddingBits) {
+	if (filled)
+	  break;
+	bit    = 32 - el->m_ucLSBPaddingBits;
+	filled = true;
+      }
+      if (bit < bits)
+	return 0;
+      shift[k++] = 32 - bit;
+    }
+    bit -= bits;
+    if (el->m_ucPackElements == 1)
+      bit -= el->m_ucLSBPaddingBits + el->m_ucMSBPaddingBits;
+  }
+
+  return k;
+}
+///
+
+/// LoadDPXWord
+// Load a 32 bit word of the given endianness from memory.
+static inline ULONG LoadDPXWord(const UBYTE *p,bool littleendian)
+{
+  if (littleendian) {
+    return ULONG(p[0]) | (ULONG(p[1]) << 8) | (ULONG(p[2]) << 16) | (ULONG(p[3]) << 24);
+  } else {
+    return (ULONG(p[0]) << 24) | (ULONG(p[1]) << 16) | (ULONG(p[2]) << 8) | ULONG(p[3]);
+  }
+}
+///
+
+/// SimpleDPX::ScatterLine
+// Distribute the samples of a scan line over the rows of the
+// components. The samples of the scan pattern repeat groups times,
+// occurrence is the index of each scan element among those of its
+// channel, count the number of scan elements of the channel.
+template<typename T>
+void SimpleDPX::ScatterLine(const ULONG *samples,const struct ImageElement *el,
+			    const UBYTE *occurrence,const UBYTE *count,ULONG groups,ULONG y) const
+{
+  const struct ScanElement *sl;
+  ULONG len = 0;
+  ULONG j;
+
+  for(sl = el->m_pScanPattern;sl;sl = sl->m_pNext)
+    len++;
+
+  for(sl = el->m_pScanPattern,j = 0;sl;sl = sl->m_pNext,j++) {
+    const struct ComponentLayout *cl = sl->m_pComponent;
+    const ULONG *src = samples + j;
+    ULONG w          = cl->m_ulWidth;
+    ULONG ty         = (m_bFlipY)?(cl->m_ulHeight - 1 - y):(y);
+    ULONG step       = count[j];
+    ULONG x          = occurrence[j];
+    ULONG g;
+    T *row           = (T *)((UBYTE *)sl->m_pData + ty * cl->m_ulBytesPerRow);
+    //
+    if (m_bFlipX) {
+      for(g = 0;g < groups && x < w;g++,x += step,src += len)
+	row[w - 1 - x] = T(*src);
+    } else if (step == 1 && len == 1) {
+      for(g = 0;g < groups && x < w;g++,x++)
+	row[x] = T(src[g]);
+    } else {
+      for(g = 0;g < groups && x < w;g++,x += step,src += len)
+	row[x] = T(*src);
+    }
+  }
+}
+///
+
+/// SimpleDPX::UnpackElement
+// Parse an element without runlength coding scan line by scan line
+// from the file contents in memory. All samples of a line are
+// unpacked at once, either from fixed positions within the 32 bit
+// words, or as a bit stream if samples straddle words. Only the scan
+// lines of rows y1 to y2 of the image are unpacked. Returns false
+// if the element requires ParseElement().
+bool SimpleDPX::UnpackElement(const UBYTE *data,size_t size,struct ImageElement *el,ULONG y1,ULONG y2)
+{
+  const struct ScanElement *sl;
+  UBYTE shift[32];
+  UBYTE occurrence[8],count[8];
+  UBYTE channels[16];
+  UBYTE bits   = el->m_ucBitDepth;
+  UBYTE k;
+  ULONG len    = 0;
+  ULONG groups = 0;
+  ULONG samples,words,mask,y,i,last;
+  UQUAD linebytes;
+  ULONG *line;
+  const UBYTE *p;
+
+  if (el->m_bRLE || el->m_bFloat || m_bFlipXY || bits > 16 || bits == 0)
+    return false;
+  if (el->m_ulWidth == 0 || el->m_ulHeight == 0 || y2 >= el->m_ulHeight || y1 > y2)
+    return false;
+  //
+  // Find the number of times each channel appears in the scan
+  // pattern. All components must have the height of the element.
+  memset(channels,0,sizeof(channels));
+  for(sl = el->m_pScanPattern;sl;sl = sl->m_pNext,len++) {
+    if (len >= 8 || sl->m_pComponent->m_ulHeight != el->m_ulHeight)
+      return false;
+    occurrence[len] = channels[sl->m_usTargetChannel & 0x0f]++;
+  }
+  if (len == 0)
+    return false;
+  for(sl = el->m_pScanPattern,i = 0;sl;sl = sl->m_pNext,i++) {
+    ULONG n;
+    count[i] = channels[sl->m_usTargetChannel & 0x0f];
+    n        = (sl->m_pComponent->m_ulWidth + count[i] - 1) / count[i];
+    if (n > groups)
+      groups = n;
+  }
+  samples = groups * len;
+  //
+  // Lines start at word boundaries.
+  k = SamplePositions(el,shift);
+  if (k) {
+    words = (samples + k - 1) / k;
+  } else if (el->m_ucLSBPaddingBits == 0 && el->m_ucMSBPaddingBits == 0) {
+    words = ULONG((UQUAD(samples) * bits + 31) >> 5);
+  } else {
+    return false;
+  }
+  linebytes = (UQUAD(words) << 2) + el->m_ulEndOfLinePadding;
+  if (el->m_ulOffset > size ||
+      size - el->m_ulOffset < linebytes * (el->m_ulHeight - 1) + (UQUAD(words) << 2))
+    PostError("unexpected error while reading a DPX file %s",m_pcFileName);
+  //
+  // The scan lines of the rows to unpack.
+  if (m_bFlipY) {
+    last = el->m_ulHeight - 1 - y1;
+    y    = el->m_ulHeight - 1 - y2;
+  } else {
+    last = y2;
+    y    = y1;
+  }
+  //
+  mask = (1UL << bits) - 1;
+  line = new ULONG[samples];
+  p    = data + el->m_ulOffset + linebytes * y;
+  for(;y <= last;y++,p += linebytes) {
+    const UBYTE *w = p;
+    ULONG *dst     = line;
+    ULONG left     = samples;
+    //
+    if (k == 3) {
+      // The common case of 10 bit samples, three per word.
+      UBYTE s0 = shift[0],s1 = shift[1],s2 = shift[2];
+      for(;left >= 3;left -= 3,dst += 3,w += 4) {
+	ULONG word = LoadDPXWord(w,m_bLittleEndian);
+	dst[0]     = (word >> s0) & mask;
+	dst[1]     = (word >> s1) & mask;
+	dst[2]     = (word >> s2) & mask;
+      }
+    }
+    if (k) {
+      while(left) {
+	ULONG word = LoadDPXWord(w,m_bLittleEndian);
+	UBYTE n    = (left < k)?(UBYTE(left)):(k);
+	for(i = 0;i < n;i++)
+	  dst[i] = (word >> shift[i]) & mask;
+	dst  += n;
+	left -= n;
+	w    += 4;
+      }
+    } else if (m_bLeftToRightScan) {
+      // Bit stream, filled from the MSB.
+      UQUAD acc  = 0;
+      UBYTE have = 0;
+      for(;left;left--) {
+	if (have < bits) {
+	  acc   = (acc << 32) | LoadDPXWord(w,m_bLittleEndian);
+	  have += 32;
+	  w    += 4;
+	}
+	have  -= bits;
+	*dst++ = ULONG(acc >> have) & mask;
+      }
+    } else {
+      // Bit stream, filled from the LSB.
+      UQUAD acc  = 0;
+      UBYTE have = 0;
+      for(;left;left--) {
+	if (have < bits) {
+	  acc  |= UQUAD(LoadDPXWord(w,m_bLittleEndian)) << have;
+	  have += 32;
+	  w    += 4;
+	}
+	*dst++ = ULONG(acc) & mask;
+	acc  >>= bits;
+	have  -= bits;
+      }
+    }
+    //
+    if (el->m_bSigned) {
+      ULONG sign = 1UL << (bits - 1);
+      for(i = 0;i < samples;i++) {
+	if (line[i] & sign)
+	  line[i] |= ULONG(-1) << bits;
+      }
+    }
+    //
+    if (bits <= 8) {
+      ScatterLine<UBYTE>(line,el,occurrence,count,groups,y);
+    } else {
+      ScatterLine<UWORD>(line,el,occurrence,count,groups,y);
+    }
+  }
+  delete[] line;
+
+  return true;
+}
+///
+
 /// SimpleDPX::LoadImage
 // Load an image from a level 1 file descriptor, keep it within
 // the internals of this class. The accessor methods below
@@ -736,13 +977,31 @@ void SimpleDPX::LoadImage(const char *name,struct ImgSpecs &specs)
 {
   UWORD i;
   File input(name,"rb");
+  class MappedFile map;
+  bool mapped,crop;
+  ULONG y1,y2;
   
   m_pcFileName = name;
 
   ParseHeader(input,specs);
+  //
+  // Elements without runlength coding are unpacked from memory
+  // if possible. If the image is cropped right away, only the rows
+  // of the window are unpacked then, and the memory of the other
+  // rows is never touched.
+  mapped = map.Map(input);
+  crop   = mapped && CropRowsOf(specs,y1,y2);
+  if (!crop) {
+    y1 = 0;
+    y2 = m_ulHeight - 1;
+  }
   for(i = 0;i < m_usElements;i++) {
-    ParseElement(input,m_Elements + i);
+    if (!(mapped && UnpackElement(map.DataOf(),map.SizeOf(),m_Elements + i,y1,y2)))
+      ParseElement(input,m_Elements + i);
   }
+  //
+  if (crop)
+    CropLoaded(specs,0);
 }
 ///
 
@@ -211,8 +211,8 @@ class SimpleDPX : public ImageLayout {
     //
     // X and Y position for scanning. Element #15 is reserved for alpha.
     // This is for internal housekeeping.
-    ULONG m_ulX[15];
-    ULONG m_ulY[15];
+    ULONG m_ulX[16];
+    ULONG m_ulY[16];
     //
     // Default constructor of an element: delete at least the pointer.
     ImageElement(void)
@@ -397,6 +397,23 @@ class SimpleDPX : public ImageLayout {
   // data container.
   void ParseElement(FILE *file,struct ImageElement *el);
   //
+  // Compute the bit positions of the samples within a 32 bit word
+  // by running the state machine of ReadData() over a word. Returns
+  // the number of samples per word, or zero if samples straddle words.
+  UBYTE SamplePositions(const struct ImageElement *el,UBYTE *shift) const;
+  //
+  // Parse an element without runlength coding scan line by scan line
+  // from the file contents in memory, unpacking all samples of a line
+  // at once. Only rows y1 to y2 of the image are unpacked, the others
+  // are left alone. Returns false if the element requires ParseElement().
+  bool UnpackElement(const UBYTE *data,size_t size,struct ImageElement *el,ULONG y1,ULONG y2);
+  //
+  // Distribute the samples of a scan line over the rows of the
+  // components, for samples stored as T.
+  template<typename T>
+  void ScatterLine(const ULONG *samples,const struct ImageElement *el,
+		   const UBYTE *occurrence,const UBYTE *count,ULONG groups,ULONG y) const;
+  //
   // Write out the target data to the components.
   void WriteElement(FILE *out,struct ImageElement *el);
   //
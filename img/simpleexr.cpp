@@ -28,13 +28,19 @@ and conversion framework.
 
 /// Includes
 #include "std/stdlib.hpp"
+#include "std/string.hpp"
+#include "std/stddef.hpp"
 #include "tools/file.hpp"
 #include "simpleexr.hpp"
 #include "imgspecs.hpp"
+#include "tools/threadpool.hpp"
 #ifdef USE_EXR
 #include <ImfInputFile.h>
 #include <ImfRgbaFile.h>
 #include <ImfArray.h>
+#include <ImfChannelList.h>
+#include <ImfFrameBuffer.h>
+#include <ImfThreading.h>
 #include <ImathBox.h>
 #include <half.h>
 #include <Iex.h>
@@ -47,7 +53,6 @@ using namespace Imath;
 /// SimpleEXR::SimpleEXR
 // Default constructor.
 SimpleEXR::SimpleEXR(void)
-  : m_pfImage(NULL)
 {
 }
 ///
@@ -55,16 +60,38 @@ SimpleEXR::SimpleEXR(void)
 /// SimpleEXR::SimpleEXR
 // Copy constructor, reference a PPM image.
 SimpleEXR::SimpleEXR(const class ImageLayout &org)
-  : ImageLayout(org), m_pfImage(NULL)
+  : ImageLayout(org)
 {
 }
 ///
 
 /// SimpleEXR::~SimpleEXR
-// Dispose the object, delete the image
+// Dispose the object. The planes are owned by the components.
 SimpleEXR::~SimpleEXR(void)
 {
-  delete[] m_pfImage;
+}
+///
+
+/// SimpleEXR::ChannelRank
+// Return the position a channel of the given name takes in the
+// component list. The color channels come first and in their usual
+// order such that RGB files keep their layout, everything else
+// (AOVs, depth, ...) follows in the order of the channel list.
+// Layer prefixes are ignored.
+int SimpleEXR::ChannelRank(const char *name)
+{
+  static const char *order[] = {"R","G","B","Y","RY","BY","A",NULL};
+  const char *dot            = strrchr(name,'.');
+  int i;
+
+  if (dot)
+    name = dot + 1;
+
+  for(i = 0;order[i];i++) {
+    if (!strcmp(name,order[i]))
+      return i;
+  }
+  return i;
 }
 ///
 
@@ -74,12 +101,28 @@ SimpleEXR::~SimpleEXR(void)
 void SimpleEXR::LoadImage(const char *basename,struct ImgSpecs &specs)
 { 
   try {
-    ::FLOAT *data;
+    ULONG threads = ::ThreadPool::ThreadCountOf();
+    UWORD comp,colors;
+    ULONG y1,y2;
+    bool crop;
+    int rank;
+    //
     if (m_pComponent) {
       PostError("Image is already loaded.\n");
     }
     //
-    RgbaInputFile in(basename);
+    // Let the library decode lines and tiles in parallel. The calling
+    // thread works as well, thus no workers are needed for one thread.
+    if (threads <= 1)
+      threads = 0;
+    if (globalThreadCount() != int(threads))
+      setGlobalThreadCount(threads);
+    //
+    // This reads scan line and tiled files alike, and the first part
+    // of a multi-part file.
+    InputFile in(basename);
+    const ChannelList &channels = in.header().channels();
+    ChannelList::ConstIterator it;
     double scale           = 1.0;
     if( hasWhiteLuminance( in.header() ) ) {
       scale = whiteLuminance( in.header() );
@@ -94,41 +137,122 @@ void SimpleEXR::LoadImage(const char *basename,struct ImgSpecs &specs)
     Box2i dw   = in.dataWindow();
     m_ulWidth  = dw.max.x - dw.min.x + 1;
     m_ulHeight = dw.max.y - dw.min.y + 1;
-    m_usDepth  = 3;
+    m_usDepth  = 0;
+    for(it = channels.begin();it != channels.end();++it) {
+      m_usDepth++;
+    }
+    if (m_usDepth == 0) {
+      PostError("%s does not contain any channels.\n",basename);
+    }
     //
     specs.ASCII      = ImgSpecs::No;
     specs.Palettized = ImgSpecs::No;
     specs.YUVEncoded = ImgSpecs::No;
     //
-    Array2D <Rgba> pixels (m_ulHeight, m_ulWidth);
-    in.setFrameBuffer(&pixels[0][0] - dw.min.y * m_ulWidth - dw.min.x, 1, m_ulWidth);
-    in.readPixels (dw.min.y, dw.max.y);
-    //
-    // Now build the component array.
     CreateComponents(m_ulWidth,m_ulHeight,m_usDepth);
     //
-    assert(m_pfImage == NULL);
-    //
-    // Compute the bit depth from the precision
-    data = m_pfImage  = new ::FLOAT[m_ulWidth * m_ulHeight * m_usDepth];
+    // If the image is cropped right away, only the rows of the window
+    // are decoded, at full width. This requires all channels to be
+    // sampled at full resolution.
+    crop = CropRowsOf(specs,y1,y2);
+    for(it = channels.begin();it != channels.end();++it) {
+      if (it.channel().xSampling != 1 || it.channel().ySampling != 1)
+	crop = false;
+    }
+    if (!crop) {
+      y1 = 0;
+      y2 = m_ulHeight - 1;
+    }
     //
-    // Ok, now fill out the components.
-    for(UWORD i = 0; i < m_usDepth; i++) {
-      m_pComponent[i].m_ucBits          = 32;
-      m_pComponent[i].m_ulBytesPerPixel = m_usDepth * 4; // Notice the "per byte" indicator!
-      m_pComponent[i].m_ulBytesPerRow   = m_usDepth * 4 * m_ulWidth;
-      m_pComponent[i].m_pPtr            = m_pfImage + i;
-      m_pComponent[i].m_bFloat          = true;
-      m_pComponent[i].m_bSigned         = true;
+    // Assign the channels to components in the order of their rank, and
+    // create a slice for each that lets the library decode directly into
+    // the plane. Half floats are kept as float, as everywhere else.
+    FrameBuffer fb;
+    comp   = 0;
+    colors = 0;
+    for(rank = 0;rank <= ChannelRank("");rank++) {
+      for(it = channels.begin();it != channels.end();++it) {
+	const Channel &ch = it.channel();
+	struct ComponentLayout *cl;
+	PixelType type;
+	char *base;
+	//
+	if (ChannelRank(it.name()) != rank)
+	  continue;
+	if (ch.xSampling < 1 || ch.xSampling > 255 || ch.ySampling < 1 || ch.ySampling > 255) {
+	  PostError("unsupported subsampling of channel %s in %s.\n",it.name(),basename);
+	}
+	//
+	cl             = m_pComponent + comp;
+	cl->m_ucSubX   = ch.xSampling;
+	cl->m_ucSubY   = ch.ySampling;
+	cl->m_ulWidth  = (m_ulWidth  + ch.xSampling - 1) / ch.xSampling;
+	cl->m_ulHeight = (crop)?(y2 - y1 + 1):((m_ulHeight + ch.ySampling - 1) / ch.ySampling);
+	switch(ch.type) {
+	case Imf::HALF:
+	  cl->m_ucBits  = 16;
+	  cl->m_bFloat  = true;
+	  cl->m_bSigned = true;
+	  type          = Imf::FLOAT;
+	  break;
+	case Imf::FLOAT:
+	  cl->m_ucBits  = 32;
+	  cl->m_bFloat  = true;
+	  cl->m_bSigned = true;
+	  type          = Imf::FLOAT;
+	  break;
+	case Imf::UINT:
+	  cl->m_ucBits  = 32;
+	  cl->m_bFloat  = false;
+	  cl->m_bSigned = false;
+	  type          = Imf::UINT;
+	  break;
+	default:
+	  PostError("unsupported sample type of channel %s in %s.\n",it.name(),basename);
+	  return;
+	}
+	AllocatePlane(comp);
+	//
+	// The library addresses sample (x,y) at
+	// base + (x / xSampling) * xStride + (y / ySampling) * yStride
+	// in absolute coordinates.
+	base = (char *)(cl->m_pPtr)
+	  - (dw.min.x / ch.xSampling) * ptrdiff_t(cl->m_ulBytesPerPixel)
+	  - ((dw.min.y + LONG(y1)) / ch.ySampling) * ptrdiff_t(cl->m_ulBytesPerRow);
+	fb.insert(it.name(),Slice(type,base,cl->m_ulBytesPerPixel,cl->m_ulBytesPerRow,
+				  ch.xSampling,ch.ySampling,0.0));
+	//
+	// R,G,B and Y come first, these are subject to the luminance.
+	if (rank <= ChannelRank("Y") && cl->m_bFloat)
+	  colors = comp + 1;
+	comp++;
+      }
     }
-    for (ULONG y = 0; y < m_ulHeight; ++y) {
-      for (ULONG x = 0; x < m_ulWidth; ++x) {
-	Rgba &pixel = pixels[y][x];
-	*data++     = pixel.r * scale;
-	*data++     = pixel.g * scale;
-	*data++     = pixel.b * scale;
+    assert(comp == m_usDepth);
+    //
+    in.setFrameBuffer(fb);
+    in.readPixels(dw.min.y + y1,dw.min.y + y2);
+    //
+    // Scale the color channels to absolute radiance if requested.
+    if (scale != 1.0) {
+      for(comp = 0;comp < colors;comp++) {
+	struct ComponentLayout *cl = m_pComponent + comp;
+	::FLOAT *row               = (::FLOAT *)(cl->m_pPtr);
+	ULONG x,y;
+	//
+	for(y = 0;y < cl->m_ulHeight;y++) {
+	  for(x = 0;x < cl->m_ulWidth;x++) {
+	    row[x] *= scale;
+	  }
+	  row = (::FLOAT *)((UBYTE *)(row) + cl->m_ulBytesPerRow);
+	}
       }
     }
+    //
+    if (crop) {
+      m_ulHeight = y2 - y1 + 1;
+      CropLoaded(specs,y1);
+    }
   } catch(const Iex::BaseExc &ex) {
     static char e[256];
     strncpy(e,ex.what(),255);
@@ -43,8 +43,9 @@ struct ImgSpecs;
 #ifdef USE_EXR
 class SimpleEXR : public ImageLayout {
   //
-  // This is the image raw data
-  FLOAT *m_pfImage;
+  // Return the position of the channel of the given name in the
+  // component list.
+  static int ChannelRank(const char *name);
   //
 public:
   //
@@ -28,7 +28,9 @@ and conversion framework.
 
 /// Includes
 #include "std/stdlib.hpp"
+#include "std/string.hpp"
 #include "tools/file.hpp"
+#include "tools/mappedfile.hpp"
 #include "simpleppm.hpp"
 #include "imgspecs.hpp"
 ///
@@ -36,7 +38,8 @@ and conversion framework.
 /// SimplePpm::SimplePpm
 // Default constructor.
 SimplePpm::SimplePpm(void)
-  : m_pucImage(NULL), m_pusImage(NULL), m_pfImage(NULL)
+  : m_pucImage(NULL), m_pusImage(NULL), m_pfImage(NULL), m_pMap(NULL),
+    m_pStream(NULL), m_ulBufferRows(0)
 {
 }
 ///
@@ -44,7 +47,8 @@ SimplePpm::SimplePpm(void)
 /// SimplePpm::SimplePpm
 // Copy constructor, reference a PPM image.
 SimplePpm::SimplePpm(const class ImageLayout &org)
-  : ImageLayout(org), m_pucImage(NULL), m_pusImage(NULL), m_pfImage(NULL)
+  : ImageLayout(org), m_pucImage(NULL), m_pusImage(NULL), m_pfImage(NULL), m_pMap(NULL),
+    m_pStream(NULL), m_ulBufferRows(0)
 {
 }
 ///
@@ -56,6 +60,9 @@ SimplePpm::~SimplePpm(void)
   delete[] m_pucImage;
   delete[] m_pusImage;
   delete[] m_pfImage;
+  delete m_pMap;
+  if (m_pStream)
+    fclose(m_pStream);
 }
 ///
 
@@ -176,29 +183,99 @@ void SimplePpm::SkipComment(void)
 }
 ///
 
-/// SimplePpm::LoadImage
-// Load an image from an already open (binary) PPM or PGM file
-// Throw in case the file should be invalid.
-void SimplePpm::LoadImage(const char *basename,struct ImgSpecs &specs)
-{ 
-  LONG data;
+/// SimplePpm::MapSamples
+// Try to use the binary samples directly from a mapping of the file,
+// starting at the current position. Samples that are not in the byte
+// order of the machine, floating point samples that require scaling
+// and samples that are not aligned are converted in place, on private
+// copies of the pages. Only the samples of rows y1 to y2 are
+// converted, in each plane if the components are stored one after
+// another as in PFS. Returns NULL if the file cannot be mapped, the
+// samples must be read then.
+APTR SimplePpm::MapSamples(UBYTE bits,bool flt,bool pfs,bool bigendian,double scale,ULONG y1,ULONG y2)
+{
+  size_t bytes = (flt)?(sizeof(FLOAT)):((bits > 8)?(sizeof(UWORD)):(sizeof(UBYTE)));
+  size_t count = size_t(m_ulWidth) * m_ulHeight * m_usDepth;
+  size_t row   = size_t(m_ulWidth) * ((pfs)?(1):(m_usDepth));
+  UWORD planes = (pfs)?(m_usDepth):(1);
+  long offset  = ftell(m_pFile);
   UWORD i;
-  LONG precision;
-  ULONG x,y;
-  UBYTE bits;
-  double scale = 1.0;
-  bool raw; // raw or ASCII?  
-  bool flt = false; // pfm or ppm?
-  bool pfs = false; // pfs or pfm?
-  bool bigendian = true; // default is bigendian.
-  File file(basename,"rb");
-  //
-  //
-  if (m_pComponent) {
-    PostError("Image is already loaded.\n");
+#ifdef WORDS_BIGENDIAN
+  bool native  = bigendian;
+#else
+  bool native  = !bigendian;
+#endif
+  UBYTE *src,*dst;
+
+  if (offset < 0)
+    return NULL;
+
+  m_pMap = new class MappedFile;
+  if (!m_pMap->Map(m_pFile) || m_pMap->SizeOf() < size_t(offset) ||
+      (m_pMap->SizeOf() - offset) / bytes < count) {
+    // Truncated files are left to the regular reader to complain about.
+    delete m_pMap;
+    m_pMap = NULL;
+    return NULL;
   }
   //
-  m_pFile = file;
+  // The header does not necessarily end at a multiple of the sample
+  // size, then the samples move down to the next aligned position.
+  src = m_pMap->DataOf() + offset;
+  dst = src - offset % bytes;
+
+  for(i = 0;i < planes;i++) {
+    size_t first = (size_t(i) * m_ulHeight + y1) * row * bytes;
+    ConvertSamples(src + first,dst + first,(y2 - y1 + 1) * row,bytes,native,scale);
+  }
+
+  return dst;
+}
+///
+
+/// SimplePpm::ConvertSamples
+// Move binary samples of the given size from src to dst, which may
+// be identical or lie below src, and bring them into the byte order
+// of the machine. Floating point samples are scaled.
+void SimplePpm::ConvertSamples(const UBYTE *src,UBYTE *dst,size_t count,size_t bytes,bool native,double scale)
+{
+  size_t i;
+
+  if (bytes == sizeof(UWORD) && (!native || src != dst)) {
+    for(i = 0;i < count;i++) {
+      UWORD v;
+      memcpy(&v,src + i * sizeof(UWORD),sizeof(UWORD));
+      if (!native)
+	v = UWORD((v >> 8) | (v << 8));
+      memcpy(dst + i * sizeof(UWORD),&v,sizeof(UWORD));
+    }
+  } else if (bytes == sizeof(FLOAT) && (!native || src != dst || scale != 1.0)) {
+    for(i = 0;i < count;i++) {
+      union {
+	ULONG ul;
+	FLOAT f;
+      } u;
+      memcpy(&u.ul,src + i * sizeof(FLOAT),sizeof(FLOAT));
+      if (!native)
+	u.ul = (u.ul >> 24) | ((u.ul >> 8) & 0xff00) | ((u.ul << 8) & 0xff0000) | (u.ul << 24);
+      if (scale != 1.0)
+	u.f = scale * u.f;
+      memcpy(dst + i * sizeof(FLOAT),&u.ul,sizeof(FLOAT));
+    }
+  }
+}
+///
+
+/// SimplePpm::ReadHeader
+// Read the header of the file up to the first sample, and build the
+// component array from it. Returns whether the samples are binary,
+// floating point, in PFS format or big endian, their bit depth and
+// the scale to apply to floating point samples.
+void SimplePpm::ReadHeader(struct ImgSpecs &specs,bool &raw,bool &flt,bool &pfs,bool &bigendian,
+			   UBYTE &bits,double &scale)
+{
+  LONG data;
+  LONG precision;
   //
   // Read the header of the file. This must be P6 for a
   // color image, and P5 for a grey-scale image. We currently
@@ -367,9 +444,83 @@ void SimplePpm::LoadImage(const char *basename,struct ImgSpecs &specs)
     }
   }
   //
+  if (!pfs) {
+    // Skip a single whitespace character.
+    data = Get();
+    // Check for MS-Dos line separator \r\n
+    if (data == '\r') {
+      data = Get();
+      if (data != '\n') {
+	// no MS-Dos separator, MacOs separator! Iek!
+	LastUnDo();
+	data = '\r';
+      }
+    }
+    //
+    // A new line must be found here.
+    if (data != ' ' && data != '\n' && data != '\r' && data != '\t') {
+      PostError("Malformed PPM stream.\n");
+    }
+  }
+  //
+  if (flt) {
+    //
+    // Check what to do about the scale.
+    if (specs.AbsoluteRadiance != ImgSpecs::Yes) {
+      // Here keep the scale in the specs, write it out later.
+      specs.RadianceScale = scale;
+      scale = 1.0;
+    }
+  }
+}
+///
+
+/// SimplePpm::LoadImage
+// Load an image from an already open (binary) PPM or PGM file
+// Throw in case the file should be invalid.
+void SimplePpm::LoadImage(const char *basename,struct ImgSpecs &specs)
+{ 
+  LONG data;
+  UWORD i;
+  ULONG x,y;
+  UBYTE bits;
+  double scale = 1.0;
+  bool raw; // raw or ASCII?  
+  bool flt = false; // pfm or ppm?
+  bool pfs = false; // pfs or pfm?
+  bool bigendian = true; // default is bigendian.
+  APTR mapped = NULL; // the samples if used from the file
+  bool crop = false; // read the crop window only?
+  ULONG y1,y2;
+  File file(basename,"rb");
+  //
+  //
+  if (m_pComponent) {
+    PostError("Image is already loaded.\n");
+  }
+  //
+  m_pFile = file;
+  //
+  ReadHeader(specs,raw,flt,pfs,bigendian,bits,scale);
+  //
+  // Binary samples are used directly from the file if possible. If
+  // the image is cropped right away, only the rows of the window
+  // are touched then.
+  if (raw && bits > 1) {
+    crop = CropRowsOf(specs,y1,y2);
+    if (!crop) {
+      y1 = 0;
+      y2 = m_ulHeight - 1;
+    }
+    mapped = MapSamples(bits,flt,pfs,bigendian,scale,y1,y2);
+    crop   = crop && mapped;
+  }
+  //
   // The next step depends on whether we are UBYTE or UWORD.
   if (bits == 32) {
-    m_pfImage  = new FLOAT[m_ulWidth * m_ulHeight * m_usDepth];
+    FLOAT *image = (FLOAT *)mapped;
+    if (image == NULL)
+      image = m_pfImage = new FLOAT[m_ulWidth * m_ulHeight * m_usDepth];
     //
     // Ok, now fill out the components. PFM is interleaved, PFS is separate.
     if (pfs) { 
@@ -377,7 +528,7 @@ void SimplePpm::LoadImage(const char *basename,struct ImgSpecs &specs)
 	m_pComponent[i].m_ucBits          = bits;
 	m_pComponent[i].m_ulBytesPerPixel = 4; 
 	m_pComponent[i].m_ulBytesPerRow   = 4 * m_ulWidth;
-	m_pComponent[i].m_pPtr            = m_pfImage + m_ulWidth * m_ulHeight * i;
+	m_pComponent[i].m_pPtr            = image + m_ulWidth * m_ulHeight * i;
 	m_pComponent[i].m_bFloat          = true;
 	m_pComponent[i].m_bSigned         = true;
       }
@@ -386,62 +537,41 @@ void SimplePpm::LoadImage(const char *basename,struct ImgSpecs &specs)
 	m_pComponent[i].m_ucBits          = bits;
 	m_pComponent[i].m_ulBytesPerPixel = m_usDepth * 4; // Notice the "per byte" indicator!
 	m_pComponent[i].m_ulBytesPerRow   = m_usDepth * 4 * m_ulWidth;
-	m_pComponent[i].m_pPtr            = m_pfImage + i;
+	m_pComponent[i].m_pPtr            = image + i;
 	m_pComponent[i].m_bFloat          = true;
 	m_pComponent[i].m_bSigned         = true;
       }
     }
   } else if (bits > 8) {
-    m_pusImage = new UWORD[m_ulWidth * m_ulHeight * m_usDepth];
+    UWORD *image = (UWORD *)mapped;
+    if (image == NULL)
+      image = m_pusImage = new UWORD[m_ulWidth * m_ulHeight * m_usDepth];
     //
     // Ok, now fill out the components.
     for(i = 0; i < m_usDepth; i++) {
       m_pComponent[i].m_ucBits          = bits;
       m_pComponent[i].m_ulBytesPerPixel = m_usDepth * 2; // Notice the "per byte" indicator!
       m_pComponent[i].m_ulBytesPerRow   = m_usDepth * 2 * m_ulWidth;
-      m_pComponent[i].m_pPtr            = m_pusImage + i;
+      m_pComponent[i].m_pPtr            = image + i;
     }
   } else {
-    m_pucImage = new UBYTE[m_ulWidth * m_ulHeight * m_usDepth];
+    UBYTE *image = (UBYTE *)mapped;
+    if (image == NULL)
+      image = m_pucImage = new UBYTE[m_ulWidth * m_ulHeight * m_usDepth];
     //
     // Ok, now fill out the components.
     for(i = 0; i < m_usDepth; i++) {
       m_pComponent[i].m_ucBits          = bits;
       m_pComponent[i].m_ulBytesPerPixel = m_usDepth;
       m_pComponent[i].m_ulBytesPerRow   = m_usDepth * m_ulWidth;
-      m_pComponent[i].m_pPtr            = m_pucImage + i;
-    }
-  }
-  //
-  if (!pfs) {
-    // Skip a single whitespace character.
-    data = Get();
-    // Check for MS-Dos line separator \r\n
-    if (data == '\r') {
-      data = Get();
-      if (data != '\n') {
-	// no MS-Dos separator, MacOs separator! Iek!
-	LastUnDo();
-	data = '\r';
-      }
-    }
-    //
-    // A new line must be found here.
-    if (data != ' ' && data != '\n' && data != '\r' && data != '\t') {
-      PostError("Malformed PPM stream.\n");
+      m_pComponent[i].m_pPtr            = image + i;
     }
   }
   //
   // Now read the data, component wise interleaved. Depends on the representation.
-  if (flt) {
-    //
-    // Check what to do about the scale.
-    if (specs.AbsoluteRadiance != ImgSpecs::Yes) {
-      // Here keep the scale in the specs, write it out later.
-      specs.RadianceScale = scale;
-      scale = 1.0;
-    }
-    //
+  if (mapped) {
+    // Nothing to read.
+  } else if (flt) {
     FLOAT *buffer = m_pfImage; // assumes that the FPU endianness is equal to the integer endianness
     for(y=0;y<m_ulHeight;y++) {
       for(x=0;x<m_ulWidth;x++) {
@@ -546,6 +676,131 @@ void SimplePpm::LoadImage(const char *basename,struct ImgSpecs &specs)
   if (ferror(m_pFile)) {
     PostError("I/O error while reading the stream.\n");
   }
+  //
+  if (crop)
+    CropLoaded(specs,0);
+}
+///
+
+/// SimplePpm::OpenStripes
+// Open a binary PNM or PFM file for reading it in stripes. The
+// components describe the full image, but hold no data yet.
+void SimplePpm::OpenStripes(const char *basename,struct ImgSpecs &specs)
+{
+  UWORD i;
+  UBYTE bits;
+  double scale = 1.0;
+  bool raw;
+  bool flt = false;
+  bool pfs = false;
+  bool bigendian = true;
+  File file(basename,"rb");
+  //
+  if (m_pComponent) {
+    PostError("Image is already loaded.\n");
+  }
+  //
+  m_pFile = file;
+  //
+  ReadHeader(specs,raw,flt,pfs,bigendian,bits,scale);
+  //
+  // ASCII and bit-packed samples are not worth the trouble, and PFS
+  // stores the components one after another.
+  if (!raw || bits == 1 || pfs)
+    PostError("%s cannot be read in stripes, only binary PNM files with more than one bit per sample can",
+	      basename);
+  //
+  m_ucSampleBytes = (flt)?(sizeof(FLOAT)):((bits > 8)?(sizeof(UWORD)):(sizeof(UBYTE)));
+#ifdef WORDS_BIGENDIAN
+  m_bNative       = bigendian;
+#else
+  m_bNative       = !bigendian;
+#endif
+  m_dScale        = scale;
+  m_ulRows        = m_ulHeight;
+  m_ulNextRow     = 0;
+  //
+  for(i = 0; i < m_usDepth; i++) {
+    m_pComponent[i].m_ucBits          = bits;
+    m_pComponent[i].m_ulBytesPerPixel = m_usDepth * m_ucSampleBytes;
+    m_pComponent[i].m_ulBytesPerRow   = m_usDepth * m_ucSampleBytes * m_ulWidth;
+    m_pComponent[i].m_pPtr            = NULL;
+    if (flt) {
+      m_pComponent[i].m_bFloat        = true;
+      m_pComponent[i].m_bSigned       = true;
+    }
+  }
+  //
+  m_pStream = file.Detach();
+  m_pFile   = m_pStream;
+}
+///
+
+/// SimplePpm::ReadStripe
+// Read the next stripe of a file opened by OpenStripes(). Returns the
+// number of rows read.
+ULONG SimplePpm::ReadStripe(ULONG rows)
+{
+  size_t count;
+  UBYTE *buffer;
+  UWORD i;
+  
+  if (m_pStream == NULL)
+    return ImageLayout::ReadStripe(rows);
+  //
+  if (rows > m_ulRows - m_ulNextRow)
+    rows = m_ulRows - m_ulNextRow;
+  if (rows == 0)
+    return 0;
+  //
+  count = size_t(m_ulWidth) * rows * m_usDepth;
+  if (rows > m_ulBufferRows) {
+    delete[] m_pucImage;m_pucImage = NULL;
+    delete[] m_pusImage;m_pusImage = NULL;
+    delete[] m_pfImage;m_pfImage   = NULL;
+    switch(m_ucSampleBytes) {
+    case sizeof(UBYTE):
+      m_pucImage = new UBYTE[count];
+      break;
+    case sizeof(UWORD):
+      m_pusImage = new UWORD[count];
+      break;
+    default:
+      m_pfImage  = new FLOAT[count];
+      break;
+    }
+    m_ulBufferRows = rows;
+  }
+  //
+  switch(m_ucSampleBytes) {
+  case sizeof(UBYTE):
+    buffer = m_pucImage;
+    break;
+  case sizeof(UWORD):
+    buffer = (UBYTE *)m_pusImage;
+    break;
+  default:
+    buffer = (UBYTE *)m_pfImage;
+    break;
+  }
+  //
+  if (fread(buffer,m_ucSampleBytes,count,m_pStream) != count) {
+    if (ferror(m_pStream)) {
+      PostError("I/O error while reading the stream.\n");
+    } else {
+      PostError("Unexpected EOF in PPM stream.\n");
+    }
+  }
+  ConvertSamples(buffer,buffer,count,m_ucSampleBytes,m_bNative,m_dScale);
+  //
+  m_ulHeight = rows;
+  for(i = 0; i < m_usDepth; i++) {
+    m_pComponent[i].m_ulHeight = rows;
+    m_pComponent[i].m_pPtr     = buffer + i * m_ucSampleBytes;
+  }
+  m_ulNextRow += rows;
+  
+  return rows;
 }
 ///
 
@@ -36,6 +36,7 @@ and conversion framework.
 
 /// Forwards
 struct ImgSpecs;
+class MappedFile;
 ///
 
 /// SimplePpm
@@ -49,9 +50,27 @@ class SimplePpm : public ImageLayout {
   // This pointer is for floating point images.
   FLOAT *m_pfImage;
   //
+  // If the samples are used directly from the file, its mapping.
+  class MappedFile *m_pMap;
+  //
   // For shortcutting: The file we read from/write to.
   FILE  *m_pFile;
   //
+  // When reading in stripes, the file, which this class closes then,
+  // the height of the image and the next row to read.
+  FILE  *m_pStream;
+  ULONG  m_ulRows;
+  ULONG  m_ulNextRow;
+  //
+  // The number of rows the sample buffer has room for.
+  ULONG  m_ulBufferRows;
+  //
+  // The size of a sample, whether it is in the byte order of the
+  // machine, and the scale of floating point samples.
+  UBYTE  m_ucSampleBytes;
+  bool   m_bNative;
+  double m_dScale;
+  //
   // The last character we read. For un-getting.
   int    m_iLastChar;
   //
@@ -68,6 +87,21 @@ class SimplePpm : public ImageLayout {
   // Skip an entire line completely
   void SkipLine(void);
   //
+  // Read the header of the file up to the first sample, and build the
+  // component array from it.
+  void ReadHeader(struct ImgSpecs &specs,bool &raw,bool &flt,bool &pfs,bool &bigendian,
+		  UBYTE &bits,double &scale);
+  //
+  // Move binary samples from src to dst, bring them into the byte
+  // order of the machine and scale floating point samples.
+  static void ConvertSamples(const UBYTE *src,UBYTE *dst,size_t count,size_t bytes,bool native,double scale);
+  //
+  // Try to use the binary samples directly from a mapping of the file,
+  // starting at the current position. Only the samples of rows y1 to y2
+  // are made usable. Returns NULL if the file cannot be mapped, the
+  // samples must be read then.
+  APTR MapSamples(UBYTE bits,bool flt,bool pfs,bool bigendian,double scale,ULONG y1,ULONG y2);
+  //
   // Read a byte, throw on EOF.
   LONG Get(void)
   {
@@ -101,6 +135,12 @@ public:
   // the internals of this class. The accessor methods below
   // should be used to find out more about this image.
   void LoadImage(const char *basename,struct ImgSpecs &specs);
+  //
+  // Open a binary file for reading it in stripes.
+  void OpenStripes(const char *basename,struct ImgSpecs &specs);
+  //
+  // Read the next stripe of a file opened by OpenStripes().
+  virtual ULONG ReadStripe(ULONG rows);
 };
 ///
 
@@ -32,6 +32,7 @@ and conversion framework.
 #include "std/stdlib.hpp"
 #include "tools/halffloat.hpp"
 #include "tools/file.hpp"
+#include "tools/mappedfile.hpp"
 #include "img/imglayout.hpp"
 #include "img/imgspecs.hpp"
 #include "img/simpleraw.hpp"
@@ -42,7 +43,10 @@ and conversion framework.
 SimpleRaw::SimpleRaw(void)
   : m_pcFilename(NULL), m_pRawList(NULL), 
     m_ulNominalWidth(0), m_ulNominalHeight(0), m_usNominalDepth(0), 
-    m_usFields(0), m_bSeparate(false), m_ucBit(0), m_uqBitBuffer(0)
+    m_usFields(0), m_bSeparate(false), m_ucBit(0), m_uqBitBuffer(0),
+    m_pStream(NULL), m_ulNextRow(0), m_ulBufferRows(0),
+    m_pOps(NULL), m_usOps(0), m_ulPasses(0), m_ulRowBytes(0), m_Kernel(GenericKernel),
+    m_pMap(NULL), m_pucCursor(NULL), m_ulFrames(0)
 {
 }
 ///
@@ -52,7 +56,10 @@ SimpleRaw::SimpleRaw(void)
 SimpleRaw::SimpleRaw(const class ImageLayout &org)
   : ImageLayout(org), m_pcFilename(NULL), m_pRawList(NULL), 
     m_ulNominalWidth(0), m_ulNominalHeight(0), m_usNominalDepth(0), 
-    m_usFields(0), m_bSeparate(false), m_ucBit(0), m_uqBitBuffer(0)
+    m_usFields(0), m_bSeparate(false), m_ucBit(0), m_uqBitBuffer(0),
+    m_pStream(NULL), m_ulNextRow(0), m_ulBufferRows(0),
+    m_pOps(NULL), m_usOps(0), m_ulPasses(0), m_ulRowBytes(0), m_Kernel(GenericKernel),
+    m_pMap(NULL), m_pucCursor(NULL), m_ulFrames(0)
 {
 }
 ///
@@ -65,6 +72,12 @@ SimpleRaw::~SimpleRaw(void)
 
   delete[] m_pcFilename;
 
+  if (m_pStream)
+    fclose(m_pStream);
+
+  delete[] m_pOps;
+  delete m_pMap;
+
   while((rl = m_pRawList)) {
     UBYTE *mem = (UBYTE *)rl->m_pPtr;
     m_pRawList = rl->m_pNext;
@@ -554,30 +567,14 @@ UQUAD SimpleRaw::ReadData(FILE *in,UBYTE bitsize,UBYTE packsize,bool littleendia
 }
 ///
 
-/// SimpleRaw::LoadImage
-// Load an image from a level 1 file descriptor, keep it within
-// the internals of this class. The accessor methods below
-// should be used to find out more about this image.
-void SimpleRaw::LoadImage(const char *nameandspecs,struct ImgSpecs &specs)
+/// SimpleRaw::BuildComponents
+// Create the components from the raw layout, with memory for the
+// given number of rows, and fill in the specs.
+void SimpleRaw::BuildComponents(struct ImgSpecs &specs,ULONG rows)
 {
   struct RawLayout *rl;
   bool yuv = false;
   //
-  m_ulNominalWidth  = 0;
-  m_ulNominalHeight = 0;
-  m_usNominalDepth  = 0;
-  //
-  // First, parse off the filename.
-  ComponentLayoutFromFileName(nameandspecs);
-  //
-  if (m_ulNominalWidth == 0 || m_ulNominalHeight == 0 || m_usNominalDepth == 0) {
-    PostError("image dimensions must be specified when loading a raw image");
-    return;
-  }
-  File in       = File(m_pcFilename,"rb");
-  m_ucBit       = 0;
-  m_uqBitBuffer = 0;
-  //
   // Setup the component of the master layout.
   CreateComponents(m_ulNominalWidth,m_ulNominalHeight,m_usNominalDepth);
   //
@@ -621,12 +618,11 @@ void SimpleRaw::LoadImage(const char *nameandspecs,struct ImgSpecs &specs)
       rl->m_ulBytesPerPixel = ULONG(bpp);
       if (UQUAD(bpp) * cl->m_ulWidth > MAX_ULONG || UQUAD(bpp) * cl->m_ulWidth * cl->m_ulHeight > MAX_ULONG) {
 	PostError("image is too large, cannot load");
-	return;
       }
       cl->m_ulBytesPerRow   = ULONG(bpp * cl->m_ulWidth);
       rl->m_ulBytesPerRow   = ULONG(bpp * cl->m_ulWidth);
       if (cl->m_pPtr == NULL) {
-	cl->m_pPtr          = new UBYTE[bpp * cl->m_ulWidth * cl->m_ulHeight];
+	cl->m_pPtr          = new UBYTE[bpp * cl->m_ulWidth * ((rows < cl->m_ulHeight)?(rows):(cl->m_ulHeight))];
 	rl->m_pPtr          = cl->m_pPtr;
       }
       //
@@ -653,10 +649,577 @@ void SimpleRaw::LoadImage(const char *nameandspecs,struct ImgSpecs &specs)
   // Insert the yuv flag into the specs, unless the user knows any better
   if (specs.YUVEncoded == ImgSpecs::Unspecified)
     specs.YUVEncoded  = yuv?(ImgSpecs::Yes):(ImgSpecs::No);
+}
+///
+
+/// SimpleRaw::AllocateRows
+// Replace the component memory by memory for the given number of
+// rows, or all rows of components that have less.
+void SimpleRaw::AllocateRows(ULONG rows)
+{
+  struct RawLayout *rl;
+  
+  for(rl = m_pRawList;rl;rl = rl->m_pNext) {
+    if (rl->m_pPtr) {
+      struct ComponentLayout *cl = m_pComponent + rl->m_usTargetChannel;
+      ULONG height               = (rl->m_ulHeight + rl->m_ucSubY - 1) / (rl->m_ucSubY);
+      ULONG h                    = (rows < height)?(rows):(height);
+      delete[] (UBYTE *)rl->m_pPtr;
+      rl->m_pPtr = cl->m_pPtr = NULL;
+      rl->m_pPtr = cl->m_pPtr = new UBYTE[size_t(rl->m_ulBytesPerRow) * h];
+    }
+  }
+  m_ulBufferRows = rows;
+}
+///
+
+/// SimpleRaw::ReadInterleavedRow
+// Read a row of an interleaved image into the given row of the
+// component memory.
+void SimpleRaw::ReadInterleavedRow(FILE *in,ULONG row)
+{
+  struct RawLayout *rl;
+  ULONG x[MAX_UWORD];
+  bool rowdone;
   //
-  // Now read the stuff.
-  if (m_bSeparate) {
+  memset(x,0,sizeof(x));
+  do {
+    for(rl = m_pRawList,rowdone = true;rl;rl = rl->m_pNext) {
+      UQUAD data = ReadData(in,rl->m_ucBits,rl->m_ucBitsPacked,
+			    rl->m_bLittleEndian,rl->m_bSigned,rl->m_bLefty);
+
+      if (!rl->m_bIsPadding) {
+	UWORD i = rl->m_usTargetChannel;
+	struct ComponentLayout *cl = m_pComponent + i;
+	if (x[i] < cl->m_ulWidth) {
+	  UBYTE *ptr = (UBYTE *)cl->m_pPtr + (row * rl->m_ulBytesPerRow) + (x[i] * rl->m_ulBytesPerPixel);
+	  //
+	  if (rl->m_ucBits <= 8) {
+	    *(UBYTE *)ptr = UBYTE(data);
+	  } else if (rl->m_ucBits <= 16) {
+	    if (rl->m_bFloat) {
+	      FLOAT dt = H2F(data);
+	      // Half float is stored as float.
+	      *(FLOAT *)ptr = ULONG(dt);
+	    } else {
+	      *(UWORD *)ptr = UWORD(data);
+	    }
+	  } else if (rl->m_ucBits <= 32) {
+	    *(ULONG *)ptr = ULONG(data);
+	  } else if (rl->m_ucBits <= 64) {
+	    *(UQUAD *)ptr = UQUAD(data);
+	  } else {
+	    assert(0);
+	  }
+	  // Advance to the next display position for this channel.
+	  x[i]++;
+	}
+      }
+      if (rl->m_ucBitsPacked && ((rl->m_pNext == NULL) || rl->m_pNext->m_bStartPacking ||
+				 (rl->m_pNext->m_ucBitsPacked == 0))) {
+	BitAlignIn();
+      }
+    }
+    for(UWORD i = 0;i < m_usDepth;i++) {
+      if (x[i] < m_pComponent[i].m_ulWidth)
+	rowdone = false;
+    }
+  } while(rowdone == false);
+}
+///
+
+/// LoadRawWord
+// Load a word of the given number of bytes from memory.
+static inline UQUAD LoadRawWord(const UBYTE *p,UBYTE bytes,bool littleendian)
+{
+  UQUAD w = 0;
+
+  if (littleendian) {
+    p += bytes;
+    while(bytes--)
+      w = (w << 8) | *--p;
+  } else {
+    while(bytes--)
+      w = (w << 8) | *p++;
+  }
+
+  return w;
+}
+///
+
+/// SimpleRaw::StoreSample
+// Store a sample of the given field at the given position of the
+// component memory.
+inline void SimpleRaw::StoreSample(UBYTE *ptr,const struct RawLayout *rl,UQUAD data)
+{
+  if (rl->m_ucBits <= 8) {
+    *(UBYTE *)ptr = UBYTE(data);
+  } else if (rl->m_ucBits <= 16) {
+    if (rl->m_bFloat) {
+      FLOAT dt = H2F(data);
+      // Half float is stored as float.
+      *(FLOAT *)ptr = ULONG(dt);
+    } else {
+      *(UWORD *)ptr = UWORD(data);
+    }
+  } else if (rl->m_ucBits <= 32) {
+    *(ULONG *)ptr = ULONG(data);
+  } else if (rl->m_ucBits <= 64) {
+    *(UQUAD *)ptr = UQUAD(data);
+  } else {
+    assert(0);
+  }
+}
+///
+
+/// SimpleRaw::UnpackField
+// Extract the field of the given compiled operation, loading data
+// from p as required. word is the last word loaded.
+inline UQUAD SimpleRaw::UnpackField(const struct RawOp *op,const UBYTE *&p,UQUAD &word)
+{
+  ULONG res;
+  
+  if (op->m_bDirect) {
+    UQUAD data = LoadRawWord(p,op->m_ucLoad,op->m_pLayout->m_bLittleEndian);
+    p += op->m_ucLoad;
+    return data;
+  }
+  
+  if (op->m_ucLoad) {
+    word = LoadRawWord(p,op->m_ucLoad,op->m_pLayout->m_bLittleEndian);
+    p   += op->m_ucLoad;
+  }
+  
+  res = ULONG(word >> op->m_ucShift) & op->m_ulMask;
+  if (op->m_bSigned && (res & ((op->m_ulMask >> 1) + 1)))
+    res |= ~op->m_ulMask;
+
+  return res;
+}
+///
+
+/// SimpleRaw::CompileLayout
+// Compile the raw layout into a list of operations unpacking it from
+// memory. As the bit position of each field within its word follows
+// from the layout alone, this mirrors ReadData() once at compile time.
+// Returns false if the layout requires bit-wise reading, e.g. because
+// fields straddle word boundaries.
+bool SimpleRaw::CompileLayout(void)
+{
+  struct RawLayout *rl;
+  struct RawOp *op;
+  ULONG *count;
+  ULONG bytes = 0;
+  UBYTE left  = 0; // bits not yet consumed in the last word.
+  UWORD i;
+  
+  delete[] m_pOps;
+  m_pOps   = NULL;
+  m_usOps  = 0;
+  m_Kernel = GenericKernel;
+
+  op    = m_pOps = new struct RawOp[m_usFields];
+  count = new ULONG[m_usDepth];
+  memset(count,0,sizeof(ULONG) * m_usDepth);
+
+  for(rl = m_pRawList;rl;rl = rl->m_pNext,op++) {
+    UBYTE bits = rl->m_ucBits;
+    UBYTE pack = (m_bSeparate && rl->m_ucBitsPacked == 0)?(8):(rl->m_ucBitsPacked);
+    bool  last = (rl->m_pNext == NULL || rl->m_pNext->m_bStartPacking || rl->m_pNext->m_ucBitsPacked == 0);
+    //
+    op->m_pLayout  = rl;
+    op->m_ucLoad   = 0;
+    op->m_bDirect  = false;
+    op->m_bSigned  = false;
+    op->m_ucShift  = 0;
+    op->m_ulMask   = 0;
+    op->m_ulOffset = 0;
+    op->m_ulStep   = 0;
+    //
+    if (bits == 8 || bits == 16 || bits == 32 || bits == 64) {
+      // Read as a word of its own.
+      op->m_bDirect = true;
+      op->m_ucLoad  = bits >> 3;
+    } else {
+      if (bits > 32)
+	break;
+      if (left == 0) {
+	if (pack == 0)
+	  break;
+	op->m_ucLoad = pack >> 3;
+	left         = pack;
+      }
+      if (left < bits)
+	break;
+      op->m_ucShift  = (rl->m_bLefty)?(pack - left):(left - bits);
+      op->m_ulMask   = (1UL << bits) - 1;
+      op->m_bSigned  = rl->m_bSigned;
+      left          -= bits;
+    }
+    bytes += op->m_ucLoad;
+    //
+    if (m_bSeparate) {
+      // Separate planes align to bytes at the end of rows only, hence
+      // a pixel must consume all its words.
+      if ((rl->m_ucBitsPacked == 0 || last) && left)
+	break;
+    } else if (rl->m_ucBitsPacked && last) {
+      left = 0;
+    }
+    //
+    if (!rl->m_bIsPadding)
+      op->m_ulOffset = count[rl->m_usTargetChannel]++;
+  }
+  //
+  if (rl || left) {
+    delete[] count;
+    delete[] m_pOps;
+    m_pOps = NULL;
+    return false;
+  }
+  //
+  for(i = 0,op = m_pOps;i < m_usFields;i++,op++) {
+    if (!op->m_pLayout->m_bIsPadding)
+      op->m_ulStep = count[op->m_pLayout->m_usTargetChannel];
+  }
+  //
+  // Interleaved rows take as many passes over the fields as the
+  // channel requiring the most of them.
+  m_ulPasses = 0;
+  for(i = 0;i < m_usDepth;i++) {
+    ULONG passes = (m_pComponent[i].m_ulWidth + count[i] - 1) / count[i];
+    if (passes > m_ulPasses)
+      m_ulPasses = passes;
+  }
+  m_ulRowBytes = m_ulPasses * bytes;
+  delete[] count;
+  //
+  // Check whether one of the word kernels applies.
+  if (!m_bSeparate) {
+    UBYTE words   = 0;
+    UBYTE samples = 0;
+    bool  little  = m_pOps[0].m_pLayout->m_bLittleEndian;
+    //
+    for(i = 0,op = m_pOps;i < m_usFields;i++,op++) {
+      rl = op->m_pLayout;
+      if (op->m_bDirect || op->m_bSigned || rl->m_bLittleEndian != little)
+	break;
+      if (op->m_ucLoad) {
+	if ((op->m_ucLoad != 2 && op->m_ucLoad != 4) || (words && op->m_ucLoad != words))
+	  break;
+	words = op->m_ucLoad;
+      }
+      if (!rl->m_bIsPadding) {
+	UBYTE size = (rl->m_ucBits <= 8)?(1):(2);
+	if (rl->m_bFloat || (samples && size != samples))
+	  break;
+	samples = size;
+      }
+    }
+    if (i == m_usFields) {
+      if (words == 2 && samples == 1) {
+	m_Kernel = Word16Byte;
+      } else if (words == 4 && samples == 1) {
+	m_Kernel = Word32Byte;
+      } else if (words == 2 && samples == 2) {
+	m_Kernel = Word16Word;
+      } else if (words == 4 && samples == 2) {
+	m_Kernel = Word32Word;
+      }
+    }
+  }
+  //
+  m_usOps = m_usFields;
+  return true;
+}
+///
+
+/// SimpleRaw::MapFile
+// Map the file into memory for reading a compiled layout. Returns
+// false if the file cannot be mapped.
+bool SimpleRaw::MapFile(FILE *in)
+{
+  assert(m_pMap == NULL);
+
+  m_pMap = new class MappedFile;
+  if (!m_pMap->Map(in)) {
+    delete m_pMap;
+    m_pMap = NULL;
+    return false;
+  }
+  m_pucCursor = m_pMap->DataOf();
+
+  return true;
+}
+///
+
+/// SimpleRaw::UnpackWords
+// Unpack a row of interleaved samples that are all bit fields within
+// words of type W, stored as samples of type S.
+template<typename W,typename S>
+void SimpleRaw::UnpackWords(ULONG row,bool littleendian)
+{
+  const struct RawOp *ops = m_pOps;
+  const struct RawOp *end = m_pOps + m_usOps;
+  const UBYTE *p          = m_pucCursor;
+  ULONG pass;
+  W word = 0;
+
+  for(pass = 0;pass < m_ulPasses;pass++) {
+    const struct RawOp *op;
+    for(op = ops;op < end;op++) {
+      const struct RawLayout *rl = op->m_pLayout;
+      if (op->m_ucLoad) {
+	word = W(LoadRawWord(p,sizeof(W),littleendian));
+	p   += sizeof(W);
+      }
+      if (!rl->m_bIsPadding) {
+	const struct ComponentLayout *cl = m_pComponent + rl->m_usTargetChannel;
+	ULONG x = pass * op->m_ulStep + op->m_ulOffset;
+	if (x < cl->m_ulWidth)
+	  ((S *)((UBYTE *)cl->m_pPtr + row * rl->m_ulBytesPerRow))[x] = S((word >> op->m_ucShift) & op->m_ulMask);
+      }
+    }
+  }
+  assert(p == m_pucCursor + m_ulRowBytes);
+}
+///
+
+/// SimpleRaw::UnpackInterleavedRow
+// Unpack a row of an interleaved image from the mapped file into the
+// given row of the component memory.
+void SimpleRaw::UnpackInterleavedRow(ULONG row)
+{
+  bool little = m_pOps[0].m_pLayout->m_bLittleEndian;
+  
+  switch(m_Kernel) {
+  case Word16Byte:
+    UnpackWords<UWORD,UBYTE>(row,little);
+    break;
+  case Word32Byte:
+    UnpackWords<ULONG,UBYTE>(row,little);
+    break;
+  case Word16Word:
+    UnpackWords<UWORD,UWORD>(row,little);
+    break;
+  case Word32Word:
+    UnpackWords<ULONG,UWORD>(row,little);
+    break;
+  case GenericKernel:
+    {
+      const struct RawOp *end = m_pOps + m_usOps;
+      const UBYTE *p          = m_pucCursor;
+      UQUAD word              = 0;
+      ULONG pass;
+      
+      for(pass = 0;pass < m_ulPasses;pass++) {
+	const struct RawOp *op;
+	for(op = m_pOps;op < end;op++) {
+	  const struct RawLayout *rl = op->m_pLayout;
+	  UQUAD data                 = UnpackField(op,p,word);
+	  if (!rl->m_bIsPadding) {
+	    const struct ComponentLayout *cl = m_pComponent + rl->m_usTargetChannel;
+	    ULONG x = pass * op->m_ulStep + op->m_ulOffset;
+	    if (x < cl->m_ulWidth)
+	      StoreSample((UBYTE *)cl->m_pPtr + row * rl->m_ulBytesPerRow + x * rl->m_ulBytesPerPixel,rl,data);
+	  }
+	}
+      }
+      assert(p == m_pucCursor + m_ulRowBytes);
+    }
+    break;
+  }
+  m_pucCursor += m_ulRowBytes;
+}
+///
+
+/// SimpleRaw::UnpackPlanes
+// Unpack all planes of a separate image from the mapped file. Planes
+// of plain 8 or 16 bit samples are copied row by row.
+void SimpleRaw::UnpackPlanes(void)
+{
+  const struct RawOp *op  = m_pOps;
+  const struct RawOp *end = m_pOps + m_usOps;
+  const UBYTE *p          = m_pucCursor;
+  const UBYTE *eof        = m_pMap->DataOf() + m_pMap->SizeOf();
+  ULONG x,y;
+
+  while(op < end) {
+    const struct RawOp *stop   = op + 1;
+    const struct RawLayout *rl = op->m_pLayout;
+    ULONG width  = (rl->m_ulWidth  + rl->m_ucSubX - 1) / (rl->m_ucSubX);
+    ULONG height = (rl->m_ulHeight + rl->m_ucSubY - 1) / (rl->m_ucSubY);
+    ULONG bpp    = op->m_ucLoad;
+    //
+    // Collect the fields packed together with this one.
+    if (rl->m_bStartPacking) {
+      while(stop < end && stop->m_pLayout->m_bStartPacking == false && stop->m_pLayout->m_ucBitsPacked) {
+	bpp += stop->m_ucLoad;
+	stop++;
+      }
+    }
+    //
+    if (UQUAD(eof - p) < UQUAD(bpp) * width * height)
+      PostError("unexpected EOF while reading %s",m_pcFilename);
+    //
+    if (stop == op + 1 && op->m_bDirect && rl->m_bIsPadding) {
+      p += bpp * width * height;
+    } else if (stop == op + 1 && op->m_bDirect && rl->m_ucBits == 8) {
+      UBYTE *dst = (UBYTE *)rl->m_pPtr;
+      for(y = 0;y < height;y++) {
+	memcpy(dst,p,width);
+	dst += rl->m_ulBytesPerRow;
+	p   += width;
+      }
+    } else if (stop == op + 1 && op->m_bDirect && rl->m_ucBits == 16 && !rl->m_bFloat) {
+      UBYTE *dst = (UBYTE *)rl->m_pPtr;
+      for(y = 0;y < height;y++) {
+	UWORD *row = (UWORD *)dst;
+	if (rl->m_bLittleEndian) {
+	  for(x = 0;x < width;x++,p += 2)
+	    row[x] = UWORD(p[0] | (p[1] << 8));
+	} else {
+	  for(x = 0;x < width;x++,p += 2)
+	    row[x] = UWORD((p[0] << 8) | p[1]);
+	}
+	dst += rl->m_ulBytesPerRow;
+      }
+    } else {
+      UQUAD word = 0;
+      for(y = 0;y < height;y++) {
+	for(x = 0;x < width;x++) {
+	  const struct RawOp *ro;
+	  for(ro = op;ro < stop;ro++) {
+	    UQUAD data = UnpackField(ro,p,word);
+	    if (!ro->m_pLayout->m_bIsPadding) {
+	      const struct ComponentLayout *cl = m_pComponent + ro->m_pLayout->m_usTargetChannel;
+	      StoreSample((UBYTE *)cl->m_pPtr + y * cl->m_ulBytesPerRow + x * cl->m_ulBytesPerPixel,
+			  ro->m_pLayout,data);
+	    }
+	  }
+	}
+      }
+    }
+    op = stop;
+  }
+  m_pucCursor = p;
+}
+///
+
+/// SimpleRaw::FrameBytesOf
+// Return the number of bytes a frame of a compiled layout takes in
+// the file.
+UQUAD SimpleRaw::FrameBytesOf(void) const
+{
+  const struct RawOp *op  = m_pOps;
+  const struct RawOp *end = m_pOps + m_usOps;
+  UQUAD bytes             = 0;
+
+  if (!m_bSeparate)
+    return UQUAD(m_ulRowBytes) * m_ulHeight;
+  //
+  // Separate planes, grouped as in UnpackPlanes().
+  while(op < end) {
+    const struct RawOp *stop   = op + 1;
+    const struct RawLayout *rl = op->m_pLayout;
+    ULONG width  = (rl->m_ulWidth  + rl->m_ucSubX - 1) / (rl->m_ucSubX);
+    ULONG height = (rl->m_ulHeight + rl->m_ucSubY - 1) / (rl->m_ucSubY);
+    ULONG bpp    = op->m_ucLoad;
+    //
+    if (rl->m_bStartPacking) {
+      while(stop < end && stop->m_pLayout->m_bStartPacking == false && stop->m_pLayout->m_ucBitsPacked) {
+	bpp += stop->m_ucLoad;
+	stop++;
+      }
+    }
+    bytes += UQUAD(bpp) * width * height;
+    op     = stop;
+  }
+
+  return bytes;
+}
+///
+
+/// SimpleRaw::LoadImage
+// Load an image from a level 1 file descriptor, keep it within
+// the internals of this class. The accessor methods below
+// should be used to find out more about this image.
+void SimpleRaw::LoadImage(const char *nameandspecs,struct ImgSpecs &specs)
+{
+  LoadFrame(nameandspecs,specs,0);
+}
+///
+
+/// SimpleRaw::LoadFrame
+// Load the given frame of a file holding a sequence of images of
+// the same format, stored back to back.
+void SimpleRaw::LoadFrame(const char *nameandspecs,struct ImgSpecs &specs,ULONG frame)
+{
+  struct RawLayout *rl;
+  //
+  m_ulNominalWidth  = 0;
+  m_ulNominalHeight = 0;
+  m_usNominalDepth  = 0;
+  //
+  // First, parse off the filename.
+  ComponentLayoutFromFileName(nameandspecs);
+  //
+  if (m_ulNominalWidth == 0 || m_ulNominalHeight == 0 || m_usNominalDepth == 0) {
+    PostError("image dimensions must be specified when loading a raw image");
+    return;
+  }
+  File in       = File(m_pcFilename,"rb");
+  m_ucBit       = 0;
+  m_uqBitBuffer = 0;
+  //
+  // Setup the component of the master layout. The memory follows once
+  // it is known which rows are read.
+  BuildComponents(specs,1);
+  //
+  // Now read the stuff, from memory if possible.
+  if (CompileLayout() && MapFile(in)) {
+    UQUAD size = FrameBytesOf();
+    //
+    m_ulFrames = (size)?(ULONG(m_pMap->SizeOf() / size)):(0);
+    if (frame > 0) {
+      if (frame >= m_ulFrames)
+	PostError("frame %lu is beyond the end of %s, which holds %lu frames",
+		  (unsigned long)frame,m_pcFilename,(unsigned long)m_ulFrames);
+      m_pucCursor += size * frame;
+    }
+    if (m_bSeparate) {
+      AllocateRows(m_ulNominalHeight);
+      UnpackPlanes();
+    } else {
+      ULONG y,y1 = 0,y2 = m_ulHeight - 1;
+      //
+      // If the image is cropped right away, only the rows of the
+      // window are unpacked.
+      bool crop = CropRowsOf(specs,y1,y2);
+      //
+      AllocateRows(y2 - y1 + 1);
+      if (UQUAD(m_pMap->DataOf() + m_pMap->SizeOf() - m_pucCursor) < size)
+	PostError("unexpected EOF while reading %s",m_pcFilename);
+      m_pucCursor += UQUAD(m_ulRowBytes) * y1;
+      for(y = y1;y <= y2;y++) {
+	UnpackInterleavedRow(y - y1);
+      }
+      if (crop) {
+	m_ulHeight = y2 - y1 + 1;
+	for(UWORD i = 0;i < m_usDepth;i++) {
+	  m_pComponent[i].m_ulHeight = m_ulHeight;
+	}
+	CropLoaded(specs,y1);
+      }
+    }
+    delete m_pMap;
+    m_pMap = NULL;
+  } else if (frame > 0) {
+    PostError("cannot locate frame %lu of %s as its layout requires bit-wise reading",
+	      (unsigned long)frame,m_pcFilename);
+  } else if (m_bSeparate) {
     ULONG x,y;
+    AllocateRows(m_ulNominalHeight);
     for(rl = m_pRawList;rl;rl = rl->m_pNext) {
       UBYTE *rptr  = (UBYTE *)rl->m_pPtr;
       ULONG width  = (rl->m_ulWidth  + rl->m_ucSubX - 1) / (rl->m_ucSubX);
@@ -733,54 +1296,90 @@ void SimpleRaw::LoadImage(const char *nameandspecs,struct ImgSpecs &specs)
     }
   } else {
     ULONG y;
+    AllocateRows(m_ulNominalHeight);
     for(y = 0;y < m_ulHeight;y++) {
-      ULONG x[MAX_UWORD];
-      bool rowdone;
-      memset(x,0,sizeof(x));
-      do {
-	for(rl = m_pRawList,rowdone = true;rl;rl = rl->m_pNext) {
-	  UQUAD data = ReadData(in,rl->m_ucBits,rl->m_ucBitsPacked,
-				rl->m_bLittleEndian,rl->m_bSigned,rl->m_bLefty);
+      ReadInterleavedRow(in,y);
+    }
+  }
+}
+///
 
-	  if (!rl->m_bIsPadding) {
-	    UWORD i = rl->m_usTargetChannel;
-	    struct ComponentLayout *cl = m_pComponent + i;
-	    if (x[i] < cl->m_ulWidth) {
-	      UBYTE *ptr = (UBYTE *)cl->m_pPtr + (y * rl->m_ulBytesPerRow) + (x[i] * rl->m_ulBytesPerPixel);
-	      //
-	      if (rl->m_ucBits <= 8) {
-		*(UBYTE *)ptr = UBYTE(data);
-	      } else if (rl->m_ucBits <= 16) {
-		if (rl->m_bFloat) {
-		  FLOAT dt = H2F(data);
-		  // Half float is stored as float.
-		  *(FLOAT *)ptr = ULONG(dt);
-		} else {
-		  *(UWORD *)ptr = UWORD(data);
-		}
-	      } else if (rl->m_ucBits <= 32) {
-		*(ULONG *)ptr = ULONG(data);
-	      } else if (rl->m_ucBits <= 64) {
-		*(UQUAD *)ptr = UQUAD(data);
-	      } else {
-		assert(0);
-	      }
-	      // Advance to the next display position for this channel.
-	      x[i]++;
-	    }
-	  }
-	  if (rl->m_ucBitsPacked && ((rl->m_pNext == NULL) || rl->m_pNext->m_bStartPacking ||
-				     (rl->m_pNext->m_ucBitsPacked == 0))) {
-	    BitAlignIn();
-	  }
-	}
-	for(UWORD i = 0;i < m_usDepth;i++) {
-	  if (x[i] < m_pComponent[i].m_ulWidth)
-	    rowdone = false;
-	}
-      } while(rowdone == false);
+/// SimpleRaw::OpenStripes
+// Open an interleaved raw file for reading it in stripes. The
+// components describe the full image, but hold no data yet.
+void SimpleRaw::OpenStripes(const char *nameandspecs,struct ImgSpecs &specs)
+{
+  m_ulNominalWidth  = 0;
+  m_ulNominalHeight = 0;
+  m_usNominalDepth  = 0;
+  //
+  ComponentLayoutFromFileName(nameandspecs);
+  //
+  if (m_ulNominalWidth == 0 || m_ulNominalHeight == 0 || m_usNominalDepth == 0)
+    PostError("image dimensions must be specified when loading a raw image");
+  //
+  if (m_bSeparate)
+    PostError("%s stores the components in separate planes and cannot be read in stripes",m_pcFilename);
+  //
+  File in       = File(m_pcFilename,"rb");
+  m_ucBit       = 0;
+  m_uqBitBuffer = 0;
+  //
+  BuildComponents(specs,1);
+  m_ulBufferRows = 1;
+  m_ulNextRow    = 0;
+  //
+  for(UWORD i = 0;i < m_usDepth;i++) {
+    if (m_pComponent[i].m_ucSubY != 1)
+      PostError("%s contains vertically subsampled components and cannot be read in stripes",m_pcFilename);
+  }
+  //
+  // Unpack from memory if possible, the mapping remains valid when the
+  // file is closed.
+  if (!(CompileLayout() && MapFile(in)))
+    m_pStream = in.Detach();
+}
+///
+
+/// SimpleRaw::ReadStripe
+// Read the next stripe of a file opened by OpenStripes(). Returns the
+// number of rows read.
+ULONG SimpleRaw::ReadStripe(ULONG rows)
+{
+  ULONG y;
+  
+  if (m_pStream == NULL && m_pMap == NULL)
+    return ImageLayout::ReadStripe(rows);
+  //
+  if (rows > m_ulNominalHeight - m_ulNextRow)
+    rows = m_ulNominalHeight - m_ulNextRow;
+  if (rows == 0)
+    return 0;
+  //
+  if (rows > m_ulBufferRows)
+    AllocateRows(rows);
+  //
+  if (m_pMap) {
+    if (UQUAD(m_pMap->DataOf() + m_pMap->SizeOf() - m_pucCursor) < UQUAD(m_ulRowBytes) * rows)
+      PostError("unexpected EOF while reading %s",m_pcFilename);
+    for(y = 0;y < rows;y++) {
+      UnpackInterleavedRow(y);
     }
+  } else {
+    for(y = 0;y < rows;y++) {
+      ReadInterleavedRow(m_pStream,y);
+    }
+    if (ferror(m_pStream))
+      PostError("I/O error while reading %s",m_pcFilename);
+  }
+  //
+  m_ulHeight = rows;
+  for(UWORD i = 0;i < m_usDepth;i++) {
+    m_pComponent[i].m_ulHeight = rows;
   }
+  m_ulNextRow += rows;
+
+  return rows;
 }
 ///
 
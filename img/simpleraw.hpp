@@ -143,6 +143,114 @@ class SimpleRaw : public ImageLayout {
   // The input or output bit buffer.
   UQUAD m_uqBitBuffer;
   //
+  // When reading in stripes, the file, which this class closes then,
+  // the next row to read and the rows the component memory can hold.
+  FILE *m_pStream;
+  ULONG m_ulNextRow;
+  ULONG m_ulBufferRows;
+  //
+  // A field of the raw layout compiled for unpacking from memory. The
+  // bit positions of all fields within their words are fixed by the
+  // layout, hence can be computed upfront.
+  struct RawOp {
+    //
+    // The field this is compiled from.
+    struct RawLayout *m_pLayout;
+    //
+    // The number of bytes to load before extracting the field, or
+    // zero if it is extracted from the last word loaded.
+    UBYTE             m_ucLoad;
+    //
+    // Set if the field is a complete word of its own, which does not
+    // replace the last word loaded.
+    bool              m_bDirect;
+    //
+    // Set if the field is to be sign-extended.
+    bool              m_bSigned;
+    //
+    // Position and mask of the field within the word.
+    UBYTE             m_ucShift;
+    ULONG             m_ulMask;
+    //
+    // The index of the sample within its channel for the first pass
+    // over the fields, and the number of samples each pass adds.
+    ULONG             m_ulOffset;
+    ULONG             m_ulStep;
+  }    *m_pOps;
+  //
+  // Number of fields compiled, equal to the number of fields. Zero if
+  // the layout could not be compiled.
+  UWORD m_usOps;
+  //
+  // For interleaved images, the number of passes over the fields
+  // required for a row, and the bytes these passes read.
+  ULONG m_ulPasses;
+  ULONG m_ulRowBytes;
+  //
+  // Kernels for interleaved layouts whose fields are all unsigned
+  // bit fields in words of equal size, such as V210, BGR101010 or
+  // RGB565, stored in samples of equal size.
+  enum RawKernel {
+    GenericKernel,
+    Word16Byte,   // 16 bit words, samples up to 8 bits
+    Word32Byte,   // 32 bit words, samples up to 8 bits
+    Word16Word,   // 16 bit words, samples up to 16 bits
+    Word32Word    // 32 bit words, samples up to 16 bits
+  }     m_Kernel;
+  //
+  // The file mapped into memory, and the read position within it,
+  // if the layout is compiled.
+  class MappedFile *m_pMap;
+  const UBYTE      *m_pucCursor;
+  //
+  // The number of complete frames in the file, if the file holds a
+  // sequence of images. Zero if unknown.
+  ULONG m_ulFrames;
+  //
+  // Compile the raw layout into a list of operations unpacking it
+  // from memory. Returns false if the layout requires bit-wise
+  // reading, e.g. because fields straddle word boundaries.
+  bool CompileLayout(void);
+  //
+  // Map the file into memory for reading a compiled layout. Returns
+  // false if the file cannot be mapped.
+  bool MapFile(FILE *in);
+  //
+  // Extract the field of the given compiled operation, loading data
+  // from p as required. word is the last word loaded.
+  static UQUAD UnpackField(const struct RawOp *op,const UBYTE *&p,UQUAD &word);
+  //
+  // Store a sample of the given field at the given position of the
+  // component memory.
+  static void StoreSample(UBYTE *ptr,const struct RawLayout *rl,UQUAD data);
+  //
+  // Unpack a row of an interleaved image from the mapped file into the
+  // given row of the component memory.
+  void UnpackInterleavedRow(ULONG row);
+  //
+  // Unpack rows of interleaved samples that are all bit fields within
+  // words of type W, stored as samples of type S.
+  template<typename W,typename S>
+  void UnpackWords(ULONG row,bool littleendian);
+  //
+  // Unpack all planes of a separate image from the mapped file.
+  void UnpackPlanes(void);
+  //
+  // Return the number of bytes a frame of a compiled layout takes.
+  UQUAD FrameBytesOf(void) const;
+  //
+  // Create the components from the raw layout, with memory for the
+  // given number of rows, and fill in the specs.
+  void BuildComponents(struct ImgSpecs &specs,ULONG rows);
+  //
+  // Replace the component memory by memory for the given number of
+  // rows, or all rows of components that have less.
+  void AllocateRows(ULONG rows);
+  //
+  // Read a row of an interleaved image into the given row of the
+  // component memory.
+  void ReadInterleavedRow(FILE *in,ULONG row);
+  //
   // Read a single pixel from the specified file.
   UQUAD ReadData(FILE *in,UBYTE bitsize,UBYTE packsize,bool littleendian,bool issigned,bool lefty);
   //
@@ -176,6 +284,23 @@ public:
   // should be used to find out more about this image.
   void LoadImage(const char *nameandspecs,struct ImgSpecs &specs);
   //
+  // Load the given frame, counting from zero, of a file that holds a
+  // sequence of images of the same format back to back.
+  void LoadFrame(const char *nameandspecs,struct ImgSpecs &specs,ULONG frame);
+  //
+  // Return the number of complete frames in the file loaded from, or
+  // zero if the layout does not allow to tell.
+  ULONG FramesOf(void) const
+  {
+    return m_ulFrames;
+  }
+  //
+  // Open an interleaved file for reading it in stripes.
+  void OpenStripes(const char *nameandspecs,struct ImgSpecs &specs);
+  //
+  // Read the next stripe of a file opened by OpenStripes().
+  virtual ULONG ReadStripe(ULONG rows);
+  //
 };
 ///
 
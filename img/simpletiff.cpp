@@ -41,12 +41,14 @@ and conversion framework.
 #include "tiff/packbitsdecoder.hpp"
 #include "tiff/trivialdecoder.hpp"
 #include "img/imgspecs.hpp"
+#include "tools/threadpool.hpp"
 ///
 
 /// SimpleTiff::SimpleTiff
 // default constructor
 SimpleTiff::SimpleTiff(void)
-  : m_ppComponents(NULL), m_usCount(0)
+  : m_ppComponents(NULL), m_usCount(0), m_pParser(NULL),
+    m_pulBits(NULL), m_pulFormat(NULL), m_pulRed(NULL), m_pulGreen(NULL), m_pulBlue(NULL)
 {
 }
 ///
@@ -55,7 +57,8 @@ SimpleTiff::SimpleTiff(void)
 // copy the layout and reference from a
 // different layout.
 SimpleTiff::SimpleTiff(const class ImageLayout &layout)
-  : ImageLayout(layout), m_ppComponents(NULL), m_usCount(0)
+  : ImageLayout(layout), m_ppComponents(NULL), m_usCount(0), m_pParser(NULL),
+    m_pulBits(NULL), m_pulFormat(NULL), m_pulRed(NULL), m_pulGreen(NULL), m_pulBlue(NULL)
 {
 }
 ///
@@ -73,18 +76,83 @@ SimpleTiff::~SimpleTiff(void)
 
     delete[] m_ppComponents;
   }
+
+  delete m_pParser;
 }
 ///
 
+/// class TiffStripJob
+// The job packing and encoding the strips of an image to be saved in
+// parallel, one strip per slice. Separate planes follow each other.
+class TiffStripJob : public Job {
+  //
+  // The image to save and the writer keeping the strips.
+  class SimpleTiff *m_pImage;
+  class TiffWriter *m_pWriter;
+  //
+  // Rows per strip, in full resolution, and strips per plane.
+  ULONG             m_ulRowsPerStrip;
+  ULONG             m_ulStrips;
+  //
+  // The bits of all components together, or zero if the planes are
+  // separate.
+  ULONG             m_ulBitsPerPixel;
+  //
+  // The bit depth if equal for all samples, or zero.
+  UBYTE             m_ucBits;
+  //
+public:
+  TiffStripJob(class SimpleTiff *image,class TiffWriter *writer,
+	       ULONG rowsperstrip,ULONG strips,ULONG bitsperpixel,UBYTE bits)
+    : m_pImage(image), m_pWriter(writer), m_ulRowsPerStrip(rowsperstrip), m_ulStrips(strips),
+      m_ulBitsPerPixel(bitsperpixel), m_ucBits(bits)
+  { }
+  //
+  virtual void Run(ULONG slice,ULONG)
+  {
+    class SimpleTiff *img = m_pImage;
+    ULONG w     = img->WidthOf();
+    ULONG h     = img->HeightOf();
+    ULONG y     = (slice % m_ulStrips) * m_ulRowsPerStrip;
+    ULONG rows  = m_ulRowsPerStrip;
+    ULONG bpp   = m_ulBitsPerPixel;
+    UWORD comp  = 0;
+    UWORD count = img->DepthOf();
+    ULONG bytesperrow;
+    UBYTE *buffer;
+
+    if (rows > h - y)
+      rows = h - y;
+
+    if (bpp == 0) {
+      comp  = slice / m_ulStrips;
+      count = 1;
+      bpp   = img->BitsOf(comp);
+      if (comp == 1 || comp == 2) {
+	UBYTE sx = img->SubXOf(comp);
+	UBYTE sy = img->SubYOf(comp);
+	w        = (w + sx - 1) / sx;
+	rows     = (y + rows + sy - 1) / sy - y / sy;
+	y       /= sy;
+      }
+    }
+    
+    bytesperrow = (bpp * w + 7) >> 3;
+    buffer      = m_pWriter->GetStripBuffer(slice,bytesperrow * rows);
+    img->PackRows(*m_pWriter,buffer,comp,count,w,y,rows,bytesperrow,m_ucBits);
+    m_pWriter->EncodeStrip(slice,bytesperrow,count,m_ucBits);
+  }
+};
+///
+
 /// SimpleTiff::SaveImage
 // Save an image to a level 1 file descriptor, given its
 // width, height and depth. We only support grey level and
 // RGB here, no palette images.
 void SimpleTiff::SaveImage(const char *filename,const struct ImgSpecs &specs)
 {
-  UBYTE *buffer = 0;
-  UWORD comp,comq,t;
-  ULONG x,y;
+  UWORD comp;
+  ULONG i;
   ULONG w   = WidthOf();
   ULONG h   = HeightOf();
   UWORD d   = DepthOf();
@@ -95,6 +163,9 @@ void SimpleTiff::SaveImage(const char *filename,const struct ImgSpecs &specs)
   bool  ycc      = false;
   bool  separate = false;
   bool  isfloat  = false;
+  bool  predict  = false;
+  UWORD compression = TiffTag::Compression::NONE;
+  ULONG rows,strips,offset,bytes;
   ULONG bytesperrow;
   
   for(comp = 0;comp < d;comp++) {
@@ -136,10 +207,8 @@ void SimpleTiff::SaveImage(const char *filename,const struct ImgSpecs &specs)
 
   class TiffWriter writer(filename,(specs.LittleEndian == ImgSpecs::No)?(true):(false));
 
-  writer.DefineScalarTag(TiffTag::COMPRESSION,TiffTag::Compression::NONE);
   writer.DefineScalarTag(TiffTag::IMAGEWIDTH,w);
   writer.DefineScalarTag(TiffTag::IMAGELENGTH,h);
-  writer.DefineScalarTag(TiffTag::ROWSPERSTRIP,h); // one strip is enough.
   writer.DefineScalarTag(TiffTag::SAMPLESPERPIXEL,d);
 
   if (isfloat && specs.RadianceScale != 1.0) {
@@ -188,7 +257,6 @@ void SimpleTiff::SaveImage(const char *filename,const struct ImgSpecs &specs)
   
   void *bpt = writer.DefineTag(TiffTag::BITSPERSAMPLE,3,d);
   void *fmt = writer.DefineTag(TiffTag::SAMPLEFORMAT,3,d);
-  void *ofs = writer.DefineTag(TiffTag::STRIPOFFSETS,4,(separate)?(d):(1));
 
   for(comp = 0;comp < d;comp++) {
     if (isFloat(comp)) {
@@ -201,148 +269,186 @@ void SimpleTiff::SaveImage(const char *filename,const struct ImgSpecs &specs)
     writer.DefineTagValue(bpt,comp,BitsOf(comp));
   }
 
+  switch(specs.Compression) {
+  case ImgSpecs::Uncompressed:
+    compression = TiffTag::Compression::NONE;
+    break;
+  case ImgSpecs::LZW:
+    compression = TiffTag::Compression::LZW;
+    break;
+  case ImgSpecs::PackBits:
+    compression = TiffTag::Compression::PACKBITS;
+    break;
+  }
+  //
+  // Horizontal prediction is only defined for LZW, and here only for
+  // integer samples of a common, byte-aligned bit depth.
+  if (compression == TiffTag::Compression::LZW && specs.Predictor == ImgSpecs::Yes &&
+      !isfloat && (bps == 8 || bps == 16 || bps == 32))
+    predict = true;
+  
+  writer.DefineCompression(compression,predict);
+
+  rows = specs.RowsPerStrip;
+  if (rows == 0) {
+    if (compression == TiffTag::Compression::NONE) {
+      rows = h; // one strip is enough.
+    } else {
+      // Strips of about 64K, such that they can be compressed in parallel.
+      bytesperrow = ((((separate)?(BitsOf(0)):(bpp)) * w) + 7) >> 3;
+      rows        = (bytesperrow > 0)?((1UL << 16) / bytesperrow):(h);
+      if (rows == 0)
+	rows = 1;
+    }
+  }
+  //
+  // Strips of subsampled components must cover complete rows of them.
+  if (rows < h) {
+    rows  = ((rows + sy - 1) / sy) * sy;
+  } else {
+    rows  = h;
+  }
+  if (rows == 0)
+    rows = 1;
+  strips  = (h + rows - 1) / rows;
+  writer.DefineScalarTag(TiffTag::ROWSPERSTRIP,rows);
+
   if (separate) {
-    void *bcn    = writer.DefineTag(TiffTag::STRIPBYTECOUNTS,4,d);
     writer.DefineScalarTag(TiffTag::PLANARCONFIG,TiffTag::Planarconfig::SEPARATE);
-    ULONG offset = writer.LayoutTags();
-    for (comp = 0;comp < d;comp++) {
-      if (comp == 1 || comp == 2) {
-	bytesperrow  = (BitsOf(comp)  * ((w + sx - 1) / sx) + 7) >> 3;
-	bytesperrow *= (h + sy - 1) / sy;
-      } else {
-	bytesperrow  = ((BitsOf(comp) * w) + 7) >> 3;
-	bytesperrow *= h;
-      }
-      writer.DefineTagValue(bcn,comp,bytesperrow);
-      writer.DefineTagValue(ofs,comp,offset);
-      if (offset + bytesperrow < offset)
-	throw "TIFF image growing too large";
-      offset += bytesperrow;
-    }
+    strips *= d;
   } else {
-    bytesperrow = ((bpp * w) + 7) >> 3;
     writer.DefineScalarTag(TiffTag::PLANARCONFIG,TiffTag::Planarconfig::CONTIG);
-    writer.DefineScalarTag(TiffTag::STRIPBYTECOUNTS,h * bytesperrow);
-    writer.DefineTagValue(ofs,0,writer.LayoutTags());
+  }
+  //
+  // Pack and encode the strips, plane after plane if separate.
+  writer.DefineStrips(strips);
+  {
+    class TiffStripJob job(this,&writer,rows,(separate)?(strips / d):(strips),
+			   (separate)?(0):(bpp),bps);
+    ThreadPool::Run(&job,strips);
+  }
+  //
+  // Now that their sizes are known, the strips can be located.
+  void *ofs = writer.DefineTag(TiffTag::STRIPOFFSETS,4,strips);
+  void *bcn = NULL;
+  if (separate || strips > 1) {
+    bcn = writer.DefineTag(TiffTag::STRIPBYTECOUNTS,4,strips);
+  } else {
+    writer.DefineScalarTag(TiffTag::STRIPBYTECOUNTS,writer.StripSizeOf(0));
+  }
+  offset = writer.LayoutTags();
+  for(i = 0;i < strips;i++) {
+    bytes = writer.StripSizeOf(i);
+    writer.DefineTagValue(ofs,i,offset);
+    if (bcn)
+      writer.DefineTagValue(bcn,i,bytes);
+    if (offset + bytes < offset)
+      throw "TIFF image growing too large";
+    offset += bytes;
   }
   
-  // Tags are now complete. Now write the IFD.
+  // Tags are now complete. Now write the IFD and the strips.
   writer.WriteIFD();
+  writer.WriteStrips();
+}
+///
 
-    
-  if (separate) {
-    t = d;
-    d = 1;
-  } else {
-    t = 1;
-  }
+/// SimpleTiff::PackRows
+// Pack rows y to y + rows - 1 of the components comq to
+// comq + d - 1, w samples wide, interleaved into the buffer, each row
+// starting at a byte boundary. bps is the number of bits per sample if
+// constant, or zero if the bit depth varies.
+void SimpleTiff::PackRows(class TiffWriter &writer,UBYTE *buffer,UWORD comq,UWORD d,
+			  ULONG w,ULONG y,ULONG rows,ULONG bytesperrow,UBYTE bps)
+{
+  ULONG x,end = y + rows;
+  UWORD comp;
 
-  for(comq = 0;comq < t;comq ++) { 
-    
-    if (separate) {
-      if (comq == 1 || comq == 2) {
-	w          = (WidthOf()  + sx - 1) / sx;
-	h          = (HeightOf() + sy - 1) / sy;
-      } else {
-	w          = WidthOf();
-	h          = HeightOf();
+  for(;y < end;y++) {
+    UBYTE *bptr = buffer;
+    switch(bps) {
+    case 8:
+      for(x = 0;x < w;x++) {
+	for(comp = 0;comp < d;comp++) {
+	  struct ComponentLayout *cl = m_pComponent + comp + comq;
+	  *bptr = *(((UBYTE *)cl->m_pPtr) + (cl->m_ulBytesPerRow * y) + (cl->m_ulBytesPerPixel * x));
+	  bptr++;
+	}
       }
-      bytesperrow  = (BitsOf(comq)  * w + 7) >> 3;
-      buffer       = writer.GetStripBuffer(bytesperrow * h);
-    } else { 
-      w            = WidthOf();
-      h            = HeightOf();
-      bytesperrow  = ((bpp * w) + 7) >> 3;
-      buffer       = writer.GetStripBuffer(bytesperrow * h);
-    }
-    
-    for(y = 0;y < h;y++) {
-      UBYTE *bptr = buffer;
-      switch(bps) {
-      case 8:
+      break;
+    case 16:
+      // Special hack for half-float which is internally represented as FLOAT
+      if (isFloat(0)) {
 	for(x = 0;x < w;x++) {
 	  for(comp = 0;comp < d;comp++) {
 	    struct ComponentLayout *cl = m_pComponent + comp + comq;
-	    *bptr = *(((UBYTE *)cl->m_pPtr) + (cl->m_ulBytesPerRow * y) + (cl->m_ulBytesPerPixel * x));
-	    bptr++;
+	    writer.PutUWORD(bptr,F2H(*(FLOAT *)(((UBYTE *)cl->m_pPtr)+(cl->m_ulBytesPerRow * y)+(cl->m_ulBytesPerPixel * x))));
 	  }
 	}
-	break;
-      case 16:
-	// Special hack for half-float which is internally represented as FLOAT
-	if (isFloat(0)) {
-	  for(x = 0;x < w;x++) {
-	    for(comp = 0;comp < d;comp++) {
-	      struct ComponentLayout *cl = m_pComponent + comp + comq;
-	      writer.PutUWORD(bptr,F2H(*(FLOAT *)(((UBYTE *)cl->m_pPtr)+(cl->m_ulBytesPerRow * y)+(cl->m_ulBytesPerPixel * x))));
-	    }
-	  }
-	} else {
-	  for(x = 0;x < w;x++) {
-	    for(comp = 0;comp < d;comp++) {
-	      struct ComponentLayout *cl = m_pComponent + comp + comq;
-	      writer.PutUWORD(bptr,*(UWORD *)(((UBYTE *)cl->m_pPtr)+(cl->m_ulBytesPerRow * y)+(cl->m_ulBytesPerPixel * x)));
-	    }
-	  }
-	}
-	break;
-      case 32:
+      } else {
 	for(x = 0;x < w;x++) {
 	  for(comp = 0;comp < d;comp++) {
 	    struct ComponentLayout *cl = m_pComponent + comp + comq;
-	    writer.PutULONG(bptr,*(ULONG *)(((UBYTE *)cl->m_pPtr)+(cl->m_ulBytesPerRow * y)+(cl->m_ulBytesPerPixel * x)));
+	    writer.PutUWORD(bptr,*(UWORD *)(((UBYTE *)cl->m_pPtr)+(cl->m_ulBytesPerRow * y)+(cl->m_ulBytesPerPixel * x)));
 	  }
 	}
-	break;
-      case 64:
+      }
+      break;
+    case 32:
+      for(x = 0;x < w;x++) {
+	for(comp = 0;comp < d;comp++) {
+	  struct ComponentLayout *cl = m_pComponent + comp + comq;
+	  writer.PutULONG(bptr,*(ULONG *)(((UBYTE *)cl->m_pPtr)+(cl->m_ulBytesPerRow * y)+(cl->m_ulBytesPerPixel * x)));
+	}
+      }
+      break;
+    case 64:
+      for(x = 0;x < w;x++) {
+	for(comp = 0;comp < d;comp++) {
+	  struct ComponentLayout *cl = m_pComponent + comp + comq;
+	  writer.PutUQUAD(bptr,*(UQUAD *)(((UBYTE *)cl->m_pPtr)+(cl->m_ulBytesPerRow * y)+(cl->m_ulBytesPerPixel * x)));
+	}
+      }
+      break;
+    default: // bit-packing, and bit depths vary.
+      // Bit-packing.
+      memset(buffer,0,bytesperrow);
+      {
+	UBYTE bitpos = 8;
 	for(x = 0;x < w;x++) {
 	  for(comp = 0;comp < d;comp++) {
 	    struct ComponentLayout *cl = m_pComponent + comp + comq;
-	    writer.PutUQUAD(bptr,*(UQUAD *)(((UBYTE *)cl->m_pPtr)+(cl->m_ulBytesPerRow * y)+(cl->m_ulBytesPerPixel * x)));
-	  }
-	}
-	break;
-      default: // bit-packing, and bit depths vary.
-	// Bit-packing.
-	memset(buffer,0,bytesperrow);
-	{
-	  UBYTE bitpos = 8;
-	  for(x = 0;x < w;x++) {
-	    for(comp = 0;comp < d;comp++) {
-	      struct ComponentLayout *cl = m_pComponent + comp + comq;
-	      UBYTE b = BitsOf(comp);
+	    UBYTE b = BitsOf(comp + comq);
 	      
-	      if (b <= 8) {
-		writer.PutBits(bptr,bitpos,b,
-			       *(((UBYTE *)cl->m_pPtr) + (cl->m_ulBytesPerRow * y) + (cl->m_ulBytesPerPixel * x)));
-	      } else if (b < 16) {
-		writer.PutBits(bptr,bitpos,b,
-			       *(UWORD *)(((UBYTE *)cl->m_pPtr) + (cl->m_ulBytesPerRow * y) + (cl->m_ulBytesPerPixel * x)));
-	      } else if (b == 16) {
-		if (isFloat(comp)) {
-		  writer.PutBits(bptr,bitpos,16,
-				 F2H(*(FLOAT *)(((UBYTE *)cl->m_pPtr) + (cl->m_ulBytesPerRow * y) + (cl->m_ulBytesPerPixel * x))));
-		} else {
-		  writer.PutBits(bptr,bitpos,16,
-				 *(UWORD *)(((UBYTE *)cl->m_pPtr) + (cl->m_ulBytesPerRow * y) + (cl->m_ulBytesPerPixel * x)));
-		}
-	      } else if (b <= 32) {
-		writer.PutBits(bptr,bitpos,32,
-			       *(ULONG *)(((UBYTE *)cl->m_pPtr) + (cl->m_ulBytesPerRow * y) + (cl->m_ulBytesPerPixel * x)));
+	    if (b <= 8) {
+	      writer.PutBits(bptr,bitpos,b,
+			     *(((UBYTE *)cl->m_pPtr) + (cl->m_ulBytesPerRow * y) + (cl->m_ulBytesPerPixel * x)));
+	    } else if (b < 16) {
+	      writer.PutBits(bptr,bitpos,b,
+			     *(UWORD *)(((UBYTE *)cl->m_pPtr) + (cl->m_ulBytesPerRow * y) + (cl->m_ulBytesPerPixel * x)));
+	    } else if (b == 16) {
+	      if (isFloat(comp + comq)) {
+		writer.PutBits(bptr,bitpos,16,
+			       F2H(*(FLOAT *)(((UBYTE *)cl->m_pPtr) + (cl->m_ulBytesPerRow * y) + (cl->m_ulBytesPerPixel * x))));
 	      } else {
-		throw "cannot write image files with varying bit depths containing more than 32 bits per pixel, sorry";
+		writer.PutBits(bptr,bitpos,16,
+			       *(UWORD *)(((UBYTE *)cl->m_pPtr) + (cl->m_ulBytesPerRow * y) + (cl->m_ulBytesPerPixel * x)));
 	      }
+	    } else if (b <= 32) {
+	      writer.PutBits(bptr,bitpos,32,
+			     *(ULONG *)(((UBYTE *)cl->m_pPtr) + (cl->m_ulBytesPerRow * y) + (cl->m_ulBytesPerPixel * x)));
+	    } else {
+	      throw "cannot write image files with varying bit depths containing more than 32 bits per pixel, sorry";
 	    }
 	  }
-	  if (bitpos < 8) {
-	    // bitpos = 8; // superflous, done anyhow.
-	    bptr++;
-	  }
+	}
+	if (bitpos < 8) {
+	  // bitpos = 8; // superflous, done anyhow.
+	  bptr++;
 	}
       }
-      buffer += bytesperrow;
     }
-    writer.PushStripBuffer();
+    buffer += bytesperrow;
   }
 }
 ///
@@ -648,43 +754,192 @@ void SimpleTiff::UnpackDataPaletized(UBYTE *buffer,bool bigendian,bool predictio
 }
 ///
 
+/// class TiffUnitJob
+// The job decoding the strips or tiles of a mapped file in parallel,
+// one per slice. The units cover disjoint regions of the components.
+class TiffUnitJob : public Job {
+  //
+  // The image to decode into.
+  class SimpleTiff                   *m_pImage;
+  //
+  // The units to decode.
+  const struct SimpleTiff::TiffUnit *m_pUnits;
+  //
+public:
+  TiffUnitJob(class SimpleTiff *image,const struct SimpleTiff::TiffUnit *units)
+    : m_pImage(image), m_pUnits(units)
+  { }
+  //
+  virtual void Run(ULONG slice,ULONG)
+  {
+    const struct SimpleTiff::TiffUnit &unit = m_pUnits[slice];
+    
+    m_pImage->DecodeUnit(unit.m_pucData,unit.m_ulBytes,unit);
+  }
+};
+///
+
+/// SimpleTiff::InitDecoding
+// Take the sample layout from the parser for decoding the strips or
+// tiles. The parser must stay alive while decoding.
+void SimpleTiff::InitDecoding(class TiffParser &parser)
+{
+  UWORD comp;
+  
+  m_pulBits    = parser.GetBitsPerPixel();
+  m_pulFormat  = parser.GetSampleFormat();
+  m_usConfig   = parser.GetPlanarConfig();
+  m_bBigEndian = parser.isBigEndian();
+  //
+  // The bit depth if it is the same for all samples, zero otherwise.
+  m_ucBits     = m_pulBits[0];
+  for(comp = 0;comp < parser.GetImageDepth();comp++) {
+    if (m_pulBits[comp] != m_ucBits || m_pulFormat[comp] != m_pulFormat[0]) {
+      m_ucBits = 0;
+      break;
+    }
+  }
+}
+///
+
+/// SimpleTiff::DecodeUnit
+// Decode a strip or tile from the given buffer into the component
+// region it covers. Subsampled components are addressed in full
+// resolution coordinates.
+void SimpleTiff::DecodeUnit(UBYTE *buffer,ULONG bytes,const struct TiffUnit &unit)
+{
+  bool  be     = m_bBigEndian;
+  bool  hdiff  = m_bPredictor;
+  UWORD comp   = unit.m_usComp;
+  ULONG x      = unit.m_ulX;
+  ULONG y      = unit.m_ulY;
+  ULONG width  = unit.m_ulWidth;
+  ULONG height = unit.m_ulHeight;
+  UWORD d      = DepthOf();
+  UBYTE sx     = (d > 1)?(m_pComponent[1].m_ucSubX):(1);
+  UBYTE sy     = (d > 1)?(m_pComponent[1].m_ucSubY):(1);
+
+  if (m_pulRed) {
+    assert(comp == 0 && d == 3);
+    switch(m_iCompression) {
+    case TiffTag::Compression::NONE:
+      UnpackDataPaletized<TrivialDecoder>(buffer,be,hdiff,x,y,width,height,m_pulBits[0],bytes,
+					  m_pulRed,m_pulGreen,m_pulBlue);
+      break;
+    case TiffTag::Compression::LZW:
+      UnpackDataPaletized<LZWDecoder>(buffer,be,hdiff,x,y,width,height,m_pulBits[0],bytes,
+				      m_pulRed,m_pulGreen,m_pulBlue);
+      break;
+    case TiffTag::Compression::PACKBITS:
+      UnpackDataPaletized<PackBitsDecoder>(buffer,be,hdiff,x,y,width,height,m_pulBits[0],bytes,
+					   m_pulRed,m_pulGreen,m_pulBlue);
+      break;
+    }
+  } else if (m_usConfig == TiffTag::Planarconfig::SEPARATE) {
+    UBYTE b = m_pulBits[comp];
+    //
+    if ((comp == 1 || comp == 2) && (sx > 1 || sy > 1)) {
+      x      /= sx;
+      y      /= sy;
+      width  /= sx;
+      height /= sy;
+    }
+    switch(m_iCompression) {
+    case TiffTag::Compression::LZW:
+      UnpackData<LZWDecoder>(buffer,be,hdiff,comp,1,x,y,width,height,
+			     b,m_pulBits,m_pulFormat,bytes,m_ulInvert,m_dScale);
+      break;
+    case TiffTag::Compression::PACKBITS:
+      UnpackData<PackBitsDecoder>(buffer,be,hdiff,comp,1,x,y,width,height,
+				  b,m_pulBits,m_pulFormat,bytes,m_ulInvert,m_dScale);
+      break;
+    case TiffTag::Compression::NONE:
+      UnpackData<TrivialDecoder>(buffer,be,hdiff,comp,1,x,y,width,height,
+				 b,m_pulBits,m_pulFormat,bytes,m_ulInvert,m_dScale);
+      break;
+    }
+  } else if (sx > 1 || sy > 1) {
+    switch(m_iCompression) {
+    case TiffTag::Compression::NONE:
+      UnpackDataYCbCr<TrivialDecoder>(buffer,be,hdiff,x,y,width,height,m_ucBits,bytes,sx,sy);
+      break;
+    case TiffTag::Compression::LZW:
+      UnpackDataYCbCr<LZWDecoder>(buffer,be,hdiff,x,y,width,height,m_ucBits,bytes,sx,sy);
+      break;
+    case TiffTag::Compression::PACKBITS:
+      UnpackDataYCbCr<PackBitsDecoder>(buffer,be,hdiff,x,y,width,height,m_ucBits,bytes,sx,sy);
+      break;
+    }
+  } else {
+    switch(m_iCompression) {
+    case TiffTag::Compression::LZW:
+      UnpackData<LZWDecoder>(buffer,be,hdiff,0,d,x,y,width,height,
+			     m_ucBits,m_pulBits,m_pulFormat,bytes,m_ulInvert,m_dScale);
+      break;
+    case TiffTag::Compression::PACKBITS:
+      UnpackData<PackBitsDecoder>(buffer,be,hdiff,0,d,x,y,width,height,
+				  m_ucBits,m_pulBits,m_pulFormat,bytes,m_ulInvert,m_dScale);
+      break;
+    case TiffTag::Compression::NONE:
+      UnpackData<TrivialDecoder>(buffer,be,hdiff,0,d,x,y,width,height,
+				 m_ucBits,m_pulBits,m_pulFormat,bytes,m_ulInvert,m_dScale);
+      break;
+    }
+  }
+}
+///
+
+/// SimpleTiff::DecodeUnits
+// Decode the given strips or tiles of the file. If the file can be
+// mapped, the units are decoded in parallel, otherwise one after another.
+void SimpleTiff::DecodeUnits(class TiffParser &parser,struct TiffUnit *units,ULONG count)
+{
+  ULONG i;
+
+  if (parser.MapUnits()) {
+    for(i = 0;i < count;i++) {
+      units[i].m_pucData = parser.MappedDataOfUnit(units[i].m_ulIndex,units[i].m_ulBytes);
+    }
+    class TiffUnitJob job(this,units);
+    ThreadPool::Run(&job,count);
+  } else {
+    for(i = 0;i < count;i++) {
+      ULONG  bytes;
+      UBYTE *buffer = parser.GetDataOfUnit(units[i].m_ulIndex,bytes);
+      DecodeUnit(buffer,bytes,units[i]);
+    }
+  }
+}
+///
+
 /// SimpleTiff::ReadTiled
-// Read tiled data through the tiff interface.
-void SimpleTiff::ReadTiled(class TiffParser &parser,int lzw,bool hdiff,
-			   UWORD imgconfig,
-			   ULONG tw,ULONG th,ULONG inv,
-			   const ULONG *bits,const ULONG *fmt,
-			   const ULONG *rm,const ULONG *gm,const ULONG *bm,
-			   DOUBLE scale)
+// Read tiled data through the tiff interface. Only the tiles
+// overlapping rows top to bottom - 1 and columns left to right - 1
+// are decoded, into the component buffers that start at row top.
+void SimpleTiff::ReadTiled(class TiffParser &parser,ULONG top,ULONG bottom,ULONG left,ULONG right)
 {
   ULONG   tilecount = parser.GetAddressableTiles();
+  ULONG   tw        = parser.GetTileWidth();
+  ULONG   th        = parser.GetTileHeight();
   ULONG   tile;
+  ULONG   count     = 0;
   UWORD   comp      = 0; // current plane = tile.
   ULONG   x         = 0;
   ULONG   y         = 0;
-  ULONG   iwidth    = WidthOf();
-  ULONG   iheight   = HeightOf();
+  ULONG   iwidth    = parser.GetImageWidth();
+  ULONG   iheight   = parser.GetImageHeight();
   UWORD   d         = DepthOf();
-  UBYTE   b         = bits[0];
   UBYTE   sx        = (d > 1)?(m_pComponent[1].m_ucSubX):(1);
   UBYTE   sy        = (d > 1)?(m_pComponent[1].m_ucSubY):(1);
+  struct TiffUnit *units = new struct TiffUnit[tilecount];
 
-  for(comp = 0;comp < d;comp++) {
-    if (bits[comp] != b || fmt[comp] != fmt[0]) {
-      b = 0;
-      break;
-    }
-  }
-  comp = 0;
-  
-  for(tile = 0;tile < tilecount;tile++) {
-    if (comp >= d) {
-      throw "extra data at end of TIFF file";
-    } else {
+  try {
+    for(tile = 0;tile < tilecount;tile++) {
       ULONG  width  = tw;
       ULONG  height = th;
-      ULONG  bytes;
-      UBYTE *buffer;
+      //
+      if (comp >= d)
+	throw "extra data at end of TIFF file";
       
       if (x + width  > iwidth) {
 	if (x >= iwidth)
@@ -700,90 +955,21 @@ void SimpleTiff::ReadTiled(class TiffParser &parser,int lzw,bool hdiff,
       if (width == 0 || height == 0)
 	throw "extra data at end of TIFF file";
       
-      buffer = parser.GetDataOfUnit(tile,bytes);
+      if (m_pulRed == NULL && m_usConfig == TiffTag::Planarconfig::SEPARATE &&
+	  (comp == 1 || comp == 2) && (sx > 1 || sy > 1)) {
+	// Sizes must be divisible by the subsampling factors to be valid.
+	if (width % sx != 0 || height % sx != 0 || x % sx != 0 || y % sy != 0)
+	  throw "invalid TIFF tile dimensions not divisible by subsampling factors";
+      }
       
-      if (rm) {
-	assert(comp == 0 && d == 3);
-	switch(lzw) {
-	case TiffTag::Compression::NONE:
-	  UnpackDataPaletized<TrivialDecoder>(buffer,parser.isBigEndian(),hdiff,x,y,width,height,bits[comp],bytes,
-					      rm,gm,bm);
-	  break;
-	case TiffTag::Compression::PACKBITS:
-	  UnpackDataPaletized<PackBitsDecoder>(buffer,parser.isBigEndian(),hdiff,x,y,width,height,bits[comp],bytes,
-					       rm,gm,bm);
-	  break;
-	case TiffTag::Compression::LZW:
-	  UnpackDataPaletized<LZWDecoder>(buffer,parser.isBigEndian(),hdiff,x,y,width,height,bits[comp],bytes,
-					  rm,gm,bm);
-	  break;
-	}
-      } else {
-	switch(imgconfig) {
-	case TiffTag::Planarconfig::SEPARATE: 
-	  if ((comp == 1 || comp == 2) && (sx > 1 || sy > 1)) {
-	    // Sizes must be divisible by the subsampling factors to be valid.
-	    if (width % sx != 0 || height % sx != 0 || x % sx != 0 || y % sy != 0)
-	      throw "invalid TIFF tile dimensions not divisible by subsampling factors";
-	    switch(lzw) {
-	    case TiffTag::Compression::LZW:
-	      UnpackData<LZWDecoder>(buffer,parser.isBigEndian(),hdiff,comp,1,x / sx,y / sy,width / sx,height / sy,
-				     bits[comp],bits,fmt,bytes,inv,scale);
-	      break;
-	    case TiffTag::Compression::PACKBITS:
-	      UnpackData<PackBitsDecoder>(buffer,parser.isBigEndian(),hdiff,comp,1,x / sx,y / sy,width / sx,height / sy,
-					  bits[comp],bits,fmt,bytes,inv,scale);
-	      break;
-	    case TiffTag::Compression::NONE:
-	      UnpackData<TrivialDecoder>(buffer,parser.isBigEndian(),hdiff,comp,1,x / sx,y / sy,width / sx,height / sy,
-					 bits[comp],bits,fmt,bytes,inv,scale);
-	      break;
-	    }
-	  } else { 
-	    switch(lzw) {
-	    case TiffTag::Compression::LZW:
-	      UnpackData<LZWDecoder>(buffer,parser.isBigEndian(),hdiff,comp,1,x     ,y     ,width     ,height     ,
-				     bits[comp],bits,fmt,bytes,inv,scale);
-	      break;
-	    case TiffTag::Compression::PACKBITS:
-	      UnpackData<PackBitsDecoder>(buffer,parser.isBigEndian(),hdiff,comp,1,x     ,y     ,width     ,height     ,
-					  bits[comp],bits,fmt,bytes,inv,scale);
-	      break;
-	    case TiffTag::Compression::NONE:
-	      UnpackData<TrivialDecoder>(buffer,parser.isBigEndian(),hdiff,comp,1,x     ,y     ,width     ,height     ,
-					 bits[comp],bits,fmt,bytes,inv,scale);
-	      break;
-	    }
-	  }
-	  break;
-	case TiffTag::Planarconfig::CONTIG: 
-	  if (sx > 1 || sy > 1) {
-	    switch(lzw) {
-	    case TiffTag::Compression::NONE:
-	      UnpackDataYCbCr<TrivialDecoder>(buffer  ,parser.isBigEndian(),hdiff,x,y,width,height     ,b,bytes,sx,sy);
-	      break;
-	    case TiffTag::Compression::LZW:
-	      UnpackDataYCbCr<LZWDecoder>(buffer  ,parser.isBigEndian(),hdiff,x,y,width,height     ,b,bytes,sx,sy);
-	      break;
-	    case TiffTag::Compression::PACKBITS:
-	      UnpackDataYCbCr<PackBitsDecoder>(buffer  ,parser.isBigEndian(),hdiff,x,y,width,height     ,b,bytes,sx,sy);
-	      break;
-	    }
-	  } else { 
-	    switch(lzw) {
-	    case TiffTag::Compression::LZW:
-	      UnpackData<LZWDecoder>(buffer,parser.isBigEndian(),hdiff,0,d,x,y,width,height,b,bits,fmt,bytes,inv,scale);
-	      break;
-	    case TiffTag::Compression::PACKBITS:
-	      UnpackData<PackBitsDecoder>(buffer,parser.isBigEndian(),hdiff,0,d,x,y,width,height,b,bits,fmt,bytes,inv,scale);
-	      break;
-	    case TiffTag::Compression::NONE:
-	      UnpackData<TrivialDecoder>(buffer,parser.isBigEndian(),hdiff,0,d,x,y,width,height,b,bits,fmt,bytes,inv,scale);
-	      break;
-	    }
-	  }
-	  break;
-	}
+      if (y < bottom && y + height > top && x < right && x + width > left) {
+	units[count].m_ulIndex  = tile;
+	units[count].m_usComp   = comp;
+	units[count].m_ulX      = x;
+	units[count].m_ulY      = y - top;
+	units[count].m_ulWidth  = width;
+	units[count].m_ulHeight = height;
+	count++;
       }
       
       x += tw;
@@ -791,7 +977,7 @@ void SimpleTiff::ReadTiled(class TiffParser &parser,int lzw,bool hdiff,
 	x  = 0;
 	y += th;
 	if (y >= iheight) {
-	  if (imgconfig == TiffTag::Planarconfig::SEPARATE) {
+	  if (m_usConfig == TiffTag::Planarconfig::SEPARATE) {
 	    comp++;
 	    x = 0;
 	    y = 0;
@@ -799,49 +985,42 @@ void SimpleTiff::ReadTiled(class TiffParser &parser,int lzw,bool hdiff,
 	}
       }
     }
+    //
+    DecodeUnits(parser,units,count);
+  } catch(...) {
+    delete[] units;
+    throw;
   }
+  
+  delete[] units;
 }
 ///
 
 /// SimpleTiff::ReadStriped
-// Read striped data through the tiff interface.
-void SimpleTiff::ReadStriped(class TiffParser &parser,int lzw,bool hdiff,
-			     UWORD imgconfig,
-			     ULONG inv,const ULONG *bits,const ULONG *fmt,
-			     const ULONG *rm,const ULONG *gm,const ULONG *bm,
-			     DOUBLE scale)
+// Read striped data through the tiff interface. Only the strips
+// overlapping rows top to bottom - 1 are decoded, into the component
+// buffers that start at row top.
+void SimpleTiff::ReadStriped(class TiffParser &parser,ULONG top,ULONG bottom)
 {
-  ULONG rps = 0;  // rows per strip
-  ULONG nos;      // number of strips
+  ULONG rps     = parser.GetRowsPerStrip(); // rows per strip
+  ULONG nos     = parser.GetAddressableStrips(); // number of strips
   ULONG strip;    // strip counter.
-  UWORD comp = 0; // component counter (was: plane)
-  ULONG y = 0;
+  ULONG count   = 0;
+  UWORD comp    = 0; // component counter (was: plane)
+  ULONG y       = 0;
   ULONG h;
   ULONG width   = WidthOf();
-  ULONG height  = HeightOf();
+  ULONG height  = parser.GetImageHeight();
   UWORD d       = DepthOf();
-  UBYTE b       = bits[0];
   UBYTE sx      = (d > 1)?(m_pComponent[1].m_ucSubX):(1);
   UBYTE sy      = (d > 1)?(m_pComponent[1].m_ucSubY):(1);
+  struct TiffUnit *units = new struct TiffUnit[nos];
   
-  rps     = parser.GetRowsPerStrip();
-  nos     = parser.GetAddressableStrips();
-
-  for(comp = 0;comp < d;comp++) {
-    if (bits[comp] != b || fmt[comp] != fmt[0]) {
-      b = 0;
-      break;
-    }
-  }
-  comp = 0;
-  
-  for(strip = 0;strip < nos;strip++) {
-    if (comp >= d) {
-      throw "unexpected extra data in TIFF image";
-    } else {
-      UBYTE *buffer;
-      ULONG  bytes;
-
+  try {
+    for(strip = 0;strip < nos;strip++) {
+      if (comp >= d)
+	throw "unexpected extra data in TIFF image";
+      
       // Compute the expected stripe height.
       if (y + rps < height) {
 	h = rps;
@@ -851,124 +1030,67 @@ void SimpleTiff::ReadStriped(class TiffParser &parser,int lzw,bool hdiff,
 	h = height - y;
       }
       
-      buffer = parser.GetDataOfUnit(strip,bytes);
-      if (rm) {
-	assert(comp == 0 && d == 3);
-	switch(lzw) {
-	  case TiffTag::Compression::NONE:
-	    UnpackDataPaletized<TrivialDecoder>(buffer,parser.isBigEndian(),hdiff,0,y,width,h,bits[comp],bytes,rm,gm,bm);
-	    break;
-	  case TiffTag::Compression::LZW:
-	    UnpackDataPaletized<LZWDecoder>(buffer,parser.isBigEndian(),hdiff,0,y,width,h,bits[comp],bytes,rm,gm,bm);
-	    break;
-	  case TiffTag::Compression::PACKBITS:
-	    UnpackDataPaletized<PackBitsDecoder>(buffer,parser.isBigEndian(),hdiff,0,y,width,h,bits[comp],bytes,rm,gm,bm);
-	    break;
-	}
-      } else {
-	switch(imgconfig) {
-	case TiffTag::Planarconfig::SEPARATE:
-	  if ((comp == 1 || comp == 2) && (sx > 1 || sy > 1)) {
-	    // Sizes must be divisible by the subsampling factors to be valid.
-	    if (width % sx != 0 || h % sy != 0 || y % sy != 0)
-	      throw "invalid TIFF stripe dimensions not divisible by subsampling factors";
-	    switch(lzw) {
-	    case TiffTag::Compression::LZW:
-	      UnpackData<LZWDecoder>(buffer,parser.isBigEndian(),hdiff,comp,1,0,y / sy,width / sx,h / sy,
-				     bits[comp],bits,fmt,bytes,inv,scale);
-	      break;
-	    case TiffTag::Compression::PACKBITS:
-	      UnpackData<PackBitsDecoder>(buffer,parser.isBigEndian(),hdiff,comp,1,0,y / sy,width / sx,h / sy,
-					  bits[comp],bits,fmt,bytes,inv,scale);
-	      break;
-	    case TiffTag::Compression::NONE:
-	      UnpackData<TrivialDecoder>(buffer,parser.isBigEndian(),hdiff,comp,1,0,y / sy,width / sx,h / sy,
-					 bits[comp],bits,fmt,bytes,inv,scale);
-	      break;
-	    }
-	  } else {
-	    switch(lzw) {
-	    case TiffTag::Compression::LZW:
-	      UnpackData<LZWDecoder>(buffer,parser.isBigEndian(),hdiff,comp,1,0,y     ,width     ,h     ,
-				     bits[comp],bits,fmt,bytes,inv,scale);
-	      break;
-	    case TiffTag::Compression::PACKBITS:
-	      UnpackData<PackBitsDecoder>(buffer,parser.isBigEndian(),hdiff,comp,1,0,y     ,width     ,h     ,
-					  bits[comp],bits,fmt,bytes,inv,scale);
-	      break;
-	    case TiffTag::Compression::NONE:
-	      UnpackData<TrivialDecoder>(buffer,parser.isBigEndian(),hdiff,comp,1,0,y     ,width     ,h     ,
-					 bits[comp],bits,fmt,bytes,inv,scale);
-	      break;
-	    }
-	  }
-	  break;
-	case TiffTag::Planarconfig::CONTIG:
-	  if (sx > 1 || sy > 1) {
-	    switch(lzw) {
-	    case TiffTag::Compression::NONE:
-	      UnpackDataYCbCr<TrivialDecoder>(buffer,parser.isBigEndian(),hdiff,0,y,width,h     ,b,bytes,sx,sy);
-	      break;
-	    case TiffTag::Compression::LZW:
-	      UnpackDataYCbCr<LZWDecoder>(buffer,parser.isBigEndian(),hdiff,0,y,width,h     ,b,bytes,sx,sy);
-	      break;
-	    case TiffTag::Compression::PACKBITS:
-	      UnpackDataYCbCr<PackBitsDecoder>(buffer,parser.isBigEndian(),hdiff,0,y,width,h     ,b,bytes,sx,sy);
-	      break;
-	    }
-	  } else {
-	    switch(lzw) {
-	    case TiffTag::Compression::LZW:
-	      UnpackData<LZWDecoder>(buffer,parser.isBigEndian(),hdiff,0   ,d,0,y,width,h,b,bits,fmt,bytes,inv,scale);
-	      break;
-	    case TiffTag::Compression::PACKBITS:
-	      UnpackData<PackBitsDecoder>(buffer,parser.isBigEndian(),hdiff,0   ,d,0,y,width,h,b,bits,fmt,bytes,inv,scale);
-	      break;
-	    case TiffTag::Compression::NONE:
-	      UnpackData<TrivialDecoder>(buffer,parser.isBigEndian(),hdiff,0   ,d,0,y,width,h,b,bits,fmt,bytes,inv,scale);
-	      break;
-	    }
-	  }
-	  break;
-	}
+      if (m_pulRed == NULL && m_usConfig == TiffTag::Planarconfig::SEPARATE &&
+	  (comp == 1 || comp == 2) && (sx > 1 || sy > 1)) {
+	// Sizes must be divisible by the subsampling factors to be valid.
+	if (width % sx != 0 || h % sy != 0 || y % sy != 0)
+	  throw "invalid TIFF stripe dimensions not divisible by subsampling factors";
+      }
+      
+      if (y < bottom && y + h > top) {
+	units[count].m_ulIndex  = strip;
+	units[count].m_usComp   = comp;
+	units[count].m_ulX      = 0;
+	units[count].m_ulY      = y - top;
+	units[count].m_ulWidth  = width;
+	units[count].m_ulHeight = h;
+	count++;
       }
+      
       y  += rps;
       if (y >= height) {
 	y = 0;
-	if (imgconfig == TiffTag::Planarconfig::SEPARATE) {
+	if (m_usConfig == TiffTag::Planarconfig::SEPARATE) {
 	  comp++;
 	}
       }
     }
+    //
+    DecodeUnits(parser,units,count);
+  } catch(...) {
+    delete[] units;
+    throw;
   }
+  
+  delete[] units;
 }
 ///
 
-/// SimpleTiff::LoadImage
-// Load an image from a level 1 file descriptor, keep it within
-// the internals of this class. The accessor methods below
-// should be used to find out more about this image.
-void SimpleTiff::LoadImage(const char *basename,struct ImgSpecs &specs)
-{ 
-  class TiffParser parser(basename);
+/// SimpleTiff::ReadHeader
+// Check the image properties and create the components from them. The
+// sample memory is not allocated here. Delivers the decoding parameters.
+void SimpleTiff::ReadHeader(class TiffParser &parser,struct ImgSpecs &specs,
+			    int &lzw,bool &hdiff,ULONG &inv,DOUBLE &scale,
+			    const ULONG *&rpal,const ULONG *&gpal,const ULONG *&bpal)
+{
   ULONG w     = parser.GetImageWidth();
   ULONG h     = parser.GetImageHeight();
   ULONG photo = parser.GetPhotometricInterpretation();
   ULONG depth = parser.GetImageDepth();
-  const ULONG *rpal = NULL;
-  const ULONG *gpal = NULL;
-  const ULONG *bpal = NULL;
   const ULONG *fmt  = parser.GetSampleFormat();
   const ULONG *bps  = parser.GetBitsPerPixel();
   ULONG cnf   = parser.GetPlanarConfig();
   ULONG subh  = 1;
   ULONG subv  = 1; // subsampling for YCbCr and related.
-  ULONG  inv  = 0;
   UWORD  comp;
   ULONG  i;
-  int    lzw   = TiffTag::Compression::NONE;
-  bool   hdiff = false;
-  DOUBLE scale = 1.0;
+
+  rpal  = NULL;
+  gpal  = NULL;
+  bpal  = NULL;
+  inv   = 0;
+  lzw   = TiffTag::Compression::NONE;
+  hdiff = false;
 
   if (parser.isBigEndian()) {
     specs.LittleEndian = ImgSpecs::No;
@@ -1106,7 +1228,6 @@ void SimpleTiff::LoadImage(const char *basename,struct ImgSpecs &specs)
     c->m_bSigned         = (photo  == TiffTag::Photometric::PALETTE)?(false):
       (fmt[comp] != TiffTag::Sampleformat::UINT && 
        fmt[comp] != TiffTag::Sampleformat::VOID);
-    c->m_pData           = new UBYTE[c->m_ulWidth * c->m_ulHeight * bytesperpixel];
     cl->m_ulWidth        = c->m_ulWidth;
     cl->m_ulHeight       = c->m_ulHeight;
     cl->m_ucBits         = c->m_ucDepth;
@@ -1123,15 +1244,222 @@ void SimpleTiff::LoadImage(const char *basename,struct ImgSpecs &specs)
     cl->m_ulBytesPerRow  = c->m_ulWidth * cl->m_ulBytesPerPixel;
     cl->m_pPtr           = c->m_pData;
   }
+}
+///
+
+/// SimpleTiff::AllocateRows
+// Allocate the memory of the components for the given number of
+// rows. Unless these are all rows, the components must not be
+// subsampled.
+void SimpleTiff::AllocateRows(ULONG rows)
+{
+  UWORD comp;
+
+  for(comp = 0;comp < m_usDepth;comp++) {
+    struct TiffComponent *c    = m_ppComponents[comp];
+    struct ComponentLayout *cl = m_pComponent + comp;
+    //
+    if (rows != m_ulHeight) {
+      assert(cl->m_ucSubY == 1 && rows < m_ulHeight);
+      c->m_ulHeight  = rows;
+      cl->m_ulHeight = rows;
+    }
+    delete[] c->m_pData;
+    c->m_pData = NULL;
+    c->m_pData = new UBYTE[size_t(cl->m_ulBytesPerRow) * c->m_ulHeight];
+    cl->m_pPtr = c->m_pData;
+  }
+  m_ulHeight = rows;
+}
+///
+
+/// SimpleTiff::LoadImage
+// Load an image from a level 1 file descriptor, keep it within
+// the internals of this class. The accessor methods below
+// should be used to find out more about this image.
+void SimpleTiff::LoadImage(const char *basename,struct ImgSpecs &specs)
+{ 
+  class TiffParser parser(basename);
+  ULONG height,top,bottom,left,right,y1,y2;
+  bool  crop;
+
+  ReadHeader(parser,specs,m_iCompression,m_bPredictor,m_ulInvert,m_dScale,
+	     m_pulRed,m_pulGreen,m_pulBlue);
+  InitDecoding(parser);
+  //
+  // If the image is cropped right away, only the strips or tiles
+  // covering the window are decoded. The buffers then start at the
+  // first row of the first of them.
+  height = m_ulHeight;
+  top    = 0;
+  bottom = height;
+  left   = 0;
+  right  = m_ulWidth;
+  crop   = CropRowsOf(specs,y1,y2);
+  if (crop) {
+    ULONG rows = (parser.isTiled())?(parser.GetTileHeight()):(parser.GetRowsPerStrip());
+    if (rows == 0 || rows > height)
+      rows = height;
+    top    = y1 - y1 % rows;
+    bottom = y2 - y2 % rows;
+    bottom = (height - bottom > rows)?(bottom + rows):(height);
+    left   = specs.CropX1;
+    if (specs.CropX2 < right)
+      right = specs.CropX2 + 1;
+  }
+  AllocateRows(bottom - top);
   
   if (parser.isTiled()) {
-    ULONG tw        = parser.GetTileWidth();
-    ULONG th        = parser.GetTileHeight();
-    //
-    ReadTiled(parser,lzw,hdiff,cnf,tw,th,inv,bps,fmt,rpal,gpal,bpal,scale);
+    ReadTiled(parser,top,bottom,left,right);
+  } else {
+    ReadStriped(parser,top,bottom);
+  }
+  //
+  // The tables belong to the parser which goes away now.
+  m_pulBits   = NULL;
+  m_pulFormat = NULL;
+  m_pulRed    = NULL;
+  m_pulGreen  = NULL;
+  m_pulBlue   = NULL;
+  //
+  if (crop)
+    CropLoaded(specs,top);
+}
+///
+
+/// SimpleTiff::OpenStripes
+// Open a striped TIFF file for reading it in stripes. The components
+// describe the full image, but hold no data yet.
+void SimpleTiff::OpenStripes(const char *basename,struct ImgSpecs &specs)
+{
+  UWORD comp;
+  
+  m_pParser = new class TiffParser(basename);
+  //
+  if (m_pParser->isTiled())
+    PostError("%s is tiled, only striped TIFF files can be read in stripes",basename);
+  //
+  ReadHeader(*m_pParser,specs,m_iCompression,m_bPredictor,m_ulInvert,m_dScale,
+	     m_pulRed,m_pulGreen,m_pulBlue);
+  //
+  for(comp = 0;comp < m_usDepth;comp++) {
+    if (m_pComponent[comp].m_ucSubX != 1 || m_pComponent[comp].m_ucSubY != 1)
+      PostError("%s contains subsampled components and cannot be read in stripes",basename);
+  }
+  //
+  InitDecoding(*m_pParser);
+  m_ulRowsPerStrip  = m_pParser->GetRowsPerStrip();
+  m_ulRows          = m_ulHeight;
+  if (m_ulRowsPerStrip > m_ulRows)
+    m_ulRowsPerStrip = m_ulRows;
+  m_ulStrips        = (m_ulRows + m_ulRowsPerStrip - 1) / m_ulRowsPerStrip;
+  m_ulNextStrip     = 0;
+  m_ulNextRow       = 0;
+  m_ulBufferRows    = 0;
+  m_ulBuffered      = 0;
+  m_ulDelivered     = 0;
+  //
+  if (m_usConfig == TiffTag::Planarconfig::SEPARATE) {
+    if (m_pParser->GetAddressableStrips() < m_ulStrips * m_usDepth)
+      throw "unexpected end of data in TIFF image";
   } else {
+    if (m_pParser->GetAddressableStrips() < m_ulStrips)
+      throw "unexpected end of data in TIFF image";
+  }
+}
+///
+
+/// SimpleTiff::DecodeStrip
+// Decode the given strip of the given component to row y of the
+// component buffers.
+void SimpleTiff::DecodeStrip(ULONG strip,UWORD comp,ULONG y,ULONG h)
+{
+  struct TiffUnit unit;
+  ULONG  bytes;
+  UBYTE *buffer = m_pParser->GetDataOfUnit(strip,bytes);
+
+  unit.m_usComp   = comp;
+  unit.m_ulX      = 0;
+  unit.m_ulY      = y;
+  unit.m_ulWidth  = m_ulWidth;
+  unit.m_ulHeight = h;
+
+  DecodeUnit(buffer,bytes,unit);
+}
+///
+
+/// SimpleTiff::ReadStripe
+// Read the next stripe of a file opened by OpenStripes(). Strips are
+// decoded as a whole, rows beyond the stripe are kept for the next one.
+// Returns the number of rows read.
+ULONG SimpleTiff::ReadStripe(ULONG rows)
+{
+  UWORD comp;
+  
+  if (m_pParser == NULL)
+    return ImageLayout::ReadStripe(rows);
+  //
+  // The rows delivered last are consumed now, move the remaining ones
+  // to the top.
+  if (m_ulDelivered) {
+    for(comp = 0;comp < m_usDepth;comp++) {
+      ULONG bpr   = m_pComponent[comp].m_ulBytesPerRow;
+      UBYTE *data = m_ppComponents[comp]->m_pData;
+      memmove(data,data + bpr * m_ulDelivered,bpr * (m_ulBuffered - m_ulDelivered));
+    }
+    m_ulBuffered -= m_ulDelivered;
+    m_ulDelivered = 0;
+  }
+  //
+  if (rows > m_ulRows - m_ulNextRow)
+    rows = m_ulRows - m_ulNextRow;
+  if (rows == 0)
+    return 0;
+  //
+  // The buffer needs to hold the stripe and the remainder of the
+  // last strip decoded for it.
+  if (rows + m_ulRowsPerStrip > m_ulBufferRows) {
+    ULONG size = rows + m_ulRowsPerStrip;
+    for(comp = 0;comp < m_usDepth;comp++) {
+      struct TiffComponent *c = m_ppComponents[comp];
+      ULONG bpr   = m_pComponent[comp].m_ulBytesPerRow;
+      UBYTE *data = new UBYTE[size_t(bpr) * size];
+      if (m_ulBuffered)
+	memcpy(data,c->m_pData,bpr * m_ulBuffered);
+      delete[] c->m_pData;
+      c->m_pData = data;
+    }
+    m_ulBufferRows = size;
+  }
+  //
+  for(comp = 0;comp < m_usDepth;comp++) {
+    m_pComponent[comp].m_pPtr = m_ppComponents[comp]->m_pData;
+  }
+  //
+  while(m_ulBuffered < rows) {
+    ULONG y = m_ulNextStrip * m_ulRowsPerStrip;
+    ULONG h = m_ulRowsPerStrip;
+    //
+    if (y + h > m_ulRows)
+      h = m_ulRows - y;
     //
-    ReadStriped(parser,lzw,hdiff,cnf,inv,bps,fmt,rpal,gpal,bpal,scale);
+    if (m_usConfig == TiffTag::Planarconfig::SEPARATE) {
+      for(comp = 0;comp < m_usDepth;comp++)
+	DecodeStrip(comp * m_ulStrips + m_ulNextStrip,comp,m_ulBuffered,h);
+    } else {
+      DecodeStrip(m_ulNextStrip,0,m_ulBuffered,h);
+    }
+    m_ulBuffered += h;
+    m_ulNextStrip++;
   }
+  //
+  m_ulHeight = rows;
+  for(comp = 0;comp < m_usDepth;comp++) {
+    m_pComponent[comp].m_ulHeight = rows;
+  }
+  m_ulDelivered  = rows;
+  m_ulNextRow   += rows;
+  
+  return rows;
 }
 ///
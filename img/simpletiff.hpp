@@ -38,6 +38,7 @@ and conversion framework.
 
 /// Forwards
 struct ImgSpecs;
+class TiffParser;
 ///
 
 /// SimpleTiff
@@ -70,17 +71,106 @@ class SimpleTiff : public ImageLayout {
   // Number of entries here, required to release them properly.
   UWORD m_usCount;
   //
-  // Copy data for TIFF images written in "striped mode".
-  void ReadStriped(class TiffParser &parser,int lzw,bool hdiff,UWORD imgconfig,
-		   ULONG inv,const ULONG *bits,const ULONG *fmt,
-		   const ULONG *r,const ULONG *g,const ULONG *b,
-		   DOUBLE scale);
-  //
-  // Read tiled data through the tiff interface.
-  void ReadTiled(class TiffParser &parser,int lzw,bool hdiff,UWORD imgconfig,ULONG tw,ULONG th,
-		 ULONG inv,const ULONG *bits,const ULONG *fmt,
-		 const ULONG *r,const ULONG *g,const ULONG *b,
-		 DOUBLE scale);
+  // When reading in stripes, the parser, which stays open then, and
+  // the decoding parameters.
+  class TiffParser *m_pParser;
+  int               m_iCompression;
+  bool              m_bPredictor;
+  UWORD             m_usConfig;
+  ULONG             m_ulInvert;
+  DOUBLE            m_dScale;
+  const ULONG      *m_pulBits;
+  const ULONG      *m_pulFormat;
+  const ULONG      *m_pulRed;
+  const ULONG      *m_pulGreen;
+  const ULONG      *m_pulBlue;
+  //
+  // The bit depth if equal for all samples, or zero.
+  UBYTE             m_ucBits;
+  //
+  // Height of the image, rows per strip and strips per plane.
+  ULONG             m_ulRows;
+  ULONG             m_ulRowsPerStrip;
+  ULONG             m_ulStrips;
+  //
+  // The next strip to decode and the next row to deliver.
+  ULONG             m_ulNextStrip;
+  ULONG             m_ulNextRow;
+  //
+  // The number of rows the component buffers have room for, the
+  // number of rows decoded into them, and the number of rows at
+  // their top delivered by the last stripe.
+  ULONG             m_ulBufferRows;
+  ULONG             m_ulBuffered;
+  ULONG             m_ulDelivered;
+  //
+  // Check the image properties and create the components, without
+  // their memory. Delivers the decoding parameters.
+  void ReadHeader(class TiffParser &parser,struct ImgSpecs &specs,
+		  int &lzw,bool &hdiff,ULONG &inv,DOUBLE &scale,
+		  const ULONG *&rpal,const ULONG *&gpal,const ULONG *&bpal);
+  //
+  // Allocate the memory of the components for the given number of
+  // rows. Unless these are all rows, the components must not be
+  // subsampled.
+  void AllocateRows(ULONG rows);
+  //
+  // The byte order of the file.
+  bool              m_bBigEndian;
+  //
+public:
+  // A strip or tile of the file, its index, and the region of the
+  // component buffers it covers in full resolution coordinates. The
+  // data pointer and size are only filled in if the file is mapped.
+  struct TiffUnit {
+    ULONG  m_ulIndex;
+    UWORD  m_usComp;
+    ULONG  m_ulX;
+    ULONG  m_ulY;
+    ULONG  m_ulWidth;
+    ULONG  m_ulHeight;
+    UBYTE *m_pucData;
+    ULONG  m_ulBytes;
+  };
+  //
+private:
+  // The jobs decoding units and encoding strips in parallel.
+  friend class TiffUnitJob;
+  friend class TiffStripJob;
+  //
+  // Pack rows y to y + rows - 1 of the components comp to
+  // comp + count - 1, w samples wide, interleaved into the buffer,
+  // each row starting at a byte boundary. b is the number of bits
+  // per sample if constant, or zero if the bit depth varies.
+  void PackRows(class TiffWriter &writer,UBYTE *buffer,UWORD comp,UWORD count,
+		ULONG w,ULONG y,ULONG rows,ULONG bytesperrow,UBYTE b);
+  //
+  // Take the sample layout from the parser for decoding the strips or
+  // tiles.
+  void InitDecoding(class TiffParser &parser);
+  //
+  // Decode a strip or tile from the given buffer into the component
+  // region it covers.
+  void DecodeUnit(UBYTE *buffer,ULONG bytes,const struct TiffUnit &unit);
+  //
+  // Decode the given strips or tiles of the file, in parallel if the
+  // file can be mapped.
+  void DecodeUnits(class TiffParser &parser,struct TiffUnit *units,ULONG count);
+  //
+  // Decode a strip of the given component, or of all components if
+  // interleaved, into row y of the component buffers, h rows high.
+  // Only used for stripes.
+  void DecodeStrip(ULONG strip,UWORD comp,ULONG y,ULONG h);
+  //
+  // Copy data for TIFF images written in "striped mode". Only the
+  // strips overlapping rows top to bottom - 1 are decoded, into the
+  // component buffers that start at row top.
+  void ReadStriped(class TiffParser &parser,ULONG top,ULONG bottom);
+  //
+  // Read tiled data through the tiff interface. Only the tiles
+  // overlapping rows top to bottom - 1 and columns left to right - 1
+  // are decoded, into the component buffers that start at row top.
+  void ReadTiled(class TiffParser &parser,ULONG top,ULONG bottom,ULONG left,ULONG right);
 
   // Unpack the data from the source buffer into the destination component.
   // The parser is the data source, comp the start component and cnt the number of
@@ -139,6 +229,12 @@ public:
   // the internals of this class. The accessor methods below
   // should be used to find out more about this image.
   void LoadImage(const char *basename,struct ImgSpecs &specs);
+  //
+  // Open a striped file for reading it in stripes.
+  void OpenStripes(const char *basename,struct ImgSpecs &specs);
+  //
+  // Read the next stripe of a file opened by OpenStripes().
+  virtual ULONG ReadStripe(ULONG rows);
 };
 ///
 
@@ -34,83 +34,180 @@ and conversion framework.
 #include "tiff/lzwdecoder.hpp"
 #include "tiff/tiffparser.hpp"
 #include "std/assert.hpp"
+#include "std/string.hpp"
 ///
 
 /// LZWDecoder::LZWDecoder
 // Start an LZW decoder on the given data buffer with the given number of bytes in the buffer.
 LZWDecoder::LZWDecoder(UBYTE *buffer,ULONG size,bool bigendian)
-  : DecoderBase(buffer,size), DecoderFunctions<LZWDecoder>(this,bigendian),
-    m_ucBitPos(8), m_ucBitsPerCode(9), m_usTableSize(0), 
-    m_pucNextOutput(&m_ucOutputBuffer[0])
+  : DecoderFunctions<LZWDecoder>(this,bigendian),
+    m_pucInput(buffer), m_pucInputEnd(buffer + size), m_uqBits(0), m_ucAvail(0),
+    m_ucBitsPerCode(9), m_usTableSize(0), m_pucWindow(NULL), m_ulWindowSize(WindowSize),
+    m_ulBase(0), m_ulRead(0), m_ulWrite(0), m_ulTableStart(0),
+    m_ulOldPosition(0), m_usOldLength(0), m_pcError(NULL), m_pucNext(NULL), m_pucEnd(NULL)
 {
   if (size >= 2 && buffer[0] == 0 && (buffer[1] & 0x01)) {
     m_bLefty = true; // old style LZW code
   } else {
     m_bLefty = false;
   }
+
+  m_pucWindow = new UBYTE[m_ulWindowSize];
 }
 ///
 
 /// LZWDecoder::~LZWDecoder
 LZWDecoder::~LZWDecoder(void)
 {
+  delete[] m_pucWindow;
 }
 ///
 
-/// LZWDecoder::InitializeTable
-// Initialize the table, including ClearCode and EOICode
-void LZWDecoder::InitializeTable()
+/// LZWDecoder::FillBits
+// Fill the bit reservoir with as many bytes as fit.
+void LZWDecoder::FillBits(void)
 {
-  int i;
+  const UBYTE *in = m_pucInput;
+  ULONG bytes     = (64 - m_ucAvail) >> 3;
+
+  if (ULONG(m_pucInputEnd - in) < bytes)
+    bytes = m_pucInputEnd - in;
 
-  for(i = 0;i < 256;i++) {
-    m_ucCodeTable[i]   = i;          // this is the identity table
-    m_usPrefixTable[i] = LastPrefix; // doesn't have a prefix anymore.
+  if (m_bLefty) {
+    while(bytes) {
+      m_uqBits  |= UQUAD(*in++) << m_ucAvail;
+      m_ucAvail += 8;
+      bytes--;
+    }
+  } else {
+    while(bytes) {
+      m_ucAvail += 8;
+      m_uqBits  |= UQUAD(*in++) << (64 - m_ucAvail);
+      bytes--;
+    }
   }
 
+  m_pucInput = in;
+}
+///
+
+/// LZWDecoder::InitializeTable
+// Initialize the table, including ClearCode and EOICode
+void LZWDecoder::InitializeTable(void)
+{
   // Entries 256 and 257 are reserved.
-  m_usTableSize   = EOICode + 1;
+  m_usTableSize   = FirstCode;
   m_ucBitsPerCode = 9;
+  m_ulTableStart  = m_ulWrite;
 }
 ///
 
-/// LZWDecoder::StringFromCode
-// Fill in the string encoded by the given code into the output table,
-// possibly enlarging the table. Note that this string is filled in in reverse
-// order, it is inverted by the read-out procedure. If reserve is given,
-// the indicated number of bytes are additionally reserved at the end of
-// the string (and thus at the beginning of the buffer)
-void LZWDecoder::StringFromCode(UWORD code,int reserve)
+/// LZWDecoder::MakeRoom
+// Make room for at least StringSpace bytes at the end of the window,
+// discarding bytes that are no longer needed, i.e. the bytes that are
+// delivered and not part of a string in the table.
+void LZWDecoder::MakeRoom(void)
 {
-  UBYTE *output = m_ucOutputBuffer + reserve;
+  ULONG bytes = StringSpace;
+  ULONG keep,live;
   
-  do {
-    assert(code != EOICode && code != ClearCode && code < m_usTableSize);
-    
-    // If there is no room in the table, something strange happened.
-    if (output >= &m_ucOutputBuffer[OutputBufferSize])
-      throw "LZW output buffer overflow, probably a corrupt LZW?";
+  if (m_ulWrite - m_ulBase + bytes <= m_ulWindowSize)
+    return;
 
-    *output++ = m_ucCodeTable[code];
-    code      = m_usPrefixTable[code];
-  } while(code != LastPrefix);
-    
-  m_pucNextOutput = output;
+  keep = (m_ulRead < m_ulTableStart)?(m_ulRead):(m_ulTableStart);
+  live = m_ulWrite - keep;
+  //
+  // If more than half of the window would remain in use, grow it such
+  // that bytes are not moved over and over again.
+  if (live + bytes > (m_ulWindowSize >> 1)) {
+    ULONG  size   = m_ulWindowSize << 1;
+    UBYTE *window;
+    while(live + bytes > (size >> 1))
+      size <<= 1;
+    window = new UBYTE[size];
+    memcpy(window,m_pucWindow + (keep - m_ulBase),live);
+    delete[] m_pucWindow;
+    m_pucWindow    = window;
+    m_ulWindowSize = size;
+  } else {
+    memmove(m_pucWindow,m_pucWindow + (keep - m_ulBase),live);
+  }
+  m_ulBase = keep;
 }
 ///
 
-/// LZWDecoder::AddToTable
-// Add an entry into the table which has as prefix the string that
-// belongs to the prefix code, and that has the given postfix character.
-void LZWDecoder::AddToTable(UWORD prefix,UBYTE postfix)
+/// LZWDecoder::DecodeCode
+// Decode the next code into the window, which must have room for
+// StringSpace bytes. Returns an error message, or NULL on success.
+const char *LZWDecoder::DecodeCode(void)
 {
-  assert(prefix != ClearCode && prefix != EOICode);
+  UWORD code = GetNextCode();
+  UWORD length;
+  UBYTE *out;
+
+  if (code == MAX_UWORD)
+    return "run out of data in TIFF decompression, input stream is possibly corrupt";
   
+  if (code == EOICode)
+    return "reading past EOF of LZW input buffer";
+
+  if (code == ClearCode) {
+    InitializeTable();
+
+    code = GetNextCode();
+
+    if (code == MAX_UWORD)
+      return "run out of data in TIFF decompression, input stream is possibly corrupt";
+    
+    if (code == EOICode)
+      return "reading past EOF of LZW input buffer";
+    
+    if (code == ClearCode)
+      return "detected double ClearCode in LZW input buffer, LZW stream corrupt";
+
+    if (code >= FirstCode)
+      return "detected invalid LZW code in TIFF input, LZW stream corrupt";
+
+    m_pucWindow[m_ulWrite - m_ulBase] = code;
+    m_ulOldPosition = m_ulWrite++;
+    m_usOldLength   = 1;
+    
+    return NULL;
+  }
+  //
+  // Here: Not EOI, not ClearCode.
+  if (m_usTableSize < FirstCode)
+    return "initial ClearCode missing in LZW stream";
+  //
+  out = m_pucWindow + (m_ulWrite - m_ulBase);
+  if (code < FirstCode) {
+    // A single character.
+    length = 1;
+    *out   = code;
+  } else if (code < m_usTableSize) {
+    // A string in the table, copy it over.
+    length = m_usLength[code];
+    CopyString(out,m_pucWindow + (m_ulPosition[code] - m_ulBase),length);
+  } else if (code == m_usTableSize) {
+    // Not in table. The new string is just the string from the previous
+    // code, extended by a single character which is given by the
+    // first character of the output string.
+    length = m_usOldLength + 1;
+    CopyString(out,m_pucWindow + (m_ulOldPosition - m_ulBase),m_usOldLength);
+    out[m_usOldLength] = out[0];
+  } else {
+    return "detected invalid LZW code in TIFF input, LZW stream corrupt";
+  }
+  //
+  // Add the string of the previous code, extended by the first
+  // character of the string just decoded, to the table. As the latter
+  // follows the former in the window, the new string is found at the
+  // position of the previous string.
   if (m_usTableSize >= MaxTableSize)
-    throw "LZW dictionary overflow, probably a corrupt LZW stream";
+    return "LZW dictionary overflow, probably a corrupt LZW stream";
 
-  m_ucCodeTable[m_usTableSize]   = postfix;
-  m_usPrefixTable[m_usTableSize] = prefix;
+  m_ulPosition[m_usTableSize] = m_ulOldPosition;
+  m_usLength[m_usTableSize]   = m_usOldLength + 1;
 
   m_usTableSize++;
   if (m_bLefty) {
@@ -128,59 +225,41 @@ void LZWDecoder::AddToTable(UWORD prefix,UBYTE postfix)
     if (m_usTableSize == 2047)
       m_ucBitsPerCode = 12;
   }
+  
+  m_ulOldPosition = m_ulWrite;
+  m_usOldLength   = length;
+  m_ulWrite      += length;
+
+  return NULL;
 }
 ///
 
 /// LZWDecoder::RefillBuffer
-// Refill the output buffer of the LZW decoder
+// Refill the output window of the LZW decoder by decoding the next
+// codes in the input buffer, as many as fit into the window. Errors
+// found while decoding ahead are only reported once the bytes decoded
+// before them are requested.
 void LZWDecoder::RefillBuffer(void)
-{   
-  UWORD code;
-  
-  code = GetNextCode();
-  if (code == EOICode)
-    throw "reading past EOF of LZW input buffer";
-  
-  if (code == ClearCode) {
-    InitializeTable();
+{
+  const char *error;
 
-    code = GetNextCode();
+  if (m_pcError)
+    throw m_pcError;
+  //
+  // All bytes decoded so far are delivered.
+  m_ulRead = m_ulWrite;
+  MakeRoom();
+  
+  do {
+    if ((error = DecodeCode())) {
+      if (m_ulRead >= m_ulWrite)
+	throw error;
+      m_pcError = error;
+      break;
+    }
+  } while(m_ulWrite - m_ulBase + StringSpace <= m_ulWindowSize);
 
-    if (code == EOICode)
-      throw "reading past EOF of LZW input buffer";
-    
-    if (code == ClearCode)
-      throw "detected double ClearCode in LZW input buffer, LZW stream corrupt";
-    
-    StringFromCode(code);
-  } else {
-    //
-    // Here: Not EOI, not ClearCode.
-    if (m_usTableSize < EOICode + 1)
-      throw "initial ClearCode missing in LZW stream";
-    //
-    // Is the just decoded code in the table?
-    if (code < m_usTableSize) {
-      StringFromCode(code); // Write out the code
-      // Add a new string into the table which has the prefix
-      // given from the previous code, and has a new postfix which is
-      // given by the first character of the string just decoded.
-      // ... below ...
-    } else if (code == m_usTableSize) {
-      // Not in table. The new string is just the string from the previous
-      // code, extended by a single character which is given by the
-      // first character of the output string.
-      StringFromCode(m_usOldCode,1);
-      // Extend the string by one character, namely the first in
-      // the buffer.
-      m_ucOutputBuffer[0] = m_pucNextOutput[-1];
-      //
-      // Add this code to the table. The new string is the old
-      // string extended by the first character.
-      // ... below ...
-    } else throw "detected invalid LZW code in TIFF input, LZW stream corrupt";
-    AddToTable(m_usOldCode,m_pucNextOutput[-1]);
-  }
-  m_usOldCode = code;
+  m_pucNext = m_pucWindow + (m_ulRead  - m_ulBase);
+  m_pucEnd  = m_pucWindow + (m_ulWrite - m_ulBase);
 }
 ///
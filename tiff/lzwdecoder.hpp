@@ -36,15 +36,28 @@ and conversion framework.
 /// Includes
 #include "interface/types.hpp"
 #include "tiff/tiffparser.hpp"
-#include "tiff/decoderbase.hpp"
 #include "tiff/decoderfunctions.hpp"
+#include "std/string.hpp"
 ///
 
 /// class LZWDecoder
-class LZWDecoder : public DecoderBase, public DecoderFunctions<LZWDecoder> {
-  //
-  // The current bit position in the code
-  UBYTE  m_ucBitPos;
+// Decodes strings into an output window from which the bytes are
+// delivered. As the string of a new table entry is the string of the
+// previous code followed by the first character of the string of the
+// current code, it is always found in the window at the position the
+// previous code was decoded to. Table entries thus only keep this
+// position and the length, and strings are copied in one go.
+class LZWDecoder : public DecoderFunctions<LZWDecoder> {
+  //
+  // The input buffer and its end.
+  const UBYTE *m_pucInput;
+  const UBYTE *m_pucInputEnd;
+  //
+  // The bit reservoir and the number of valid bits in it. For new
+  // style codes, the bits are aligned at the most significant end,
+  // for old style codes at the least significant end.
+  UQUAD  m_uqBits;
+  UBYTE  m_ucAvail;
   //
   // Number of bits per code, depends on the table size.
   UBYTE  m_ucBitsPerCode;
@@ -52,67 +65,122 @@ class LZWDecoder : public DecoderBase, public DecoderFunctions<LZWDecoder> {
   // Number of entries in the table.
   UWORD  m_usTableSize;
   //
-  // The previous code just decoded before.
-  UWORD  m_usOldCode;
-  //
-  // Pointer in the output string buffer, namely where the next string
-  // from the output table is removed. Note that this is read end to start,
-  // in reverse order.
-  UBYTE *m_pucNextOutput;
-  //
   // Set for old-style compatibility LZW-codes that use a different bit-filling
   // order.
   bool   m_bLefty;
   //
   enum {
     MaxTableSize     = (1 << 12) - 1 + 1024, // maximal number of entries allowed here.
-    OutputBufferSize = (1 << 16)
+    WindowSize       = (1 << 16),            // initial size of the output window.
+    StringSpace      = MaxTableSize + 8      // room for the longest string and the copy overrun.
   };
   //
-  // The table is encoded in the following way: The first array contains the postfix,
-  // the second table the offset of the prefix in the postfix if there is one, or MAX_UWORD
-  // in case there is no prefix and the entry is the start of the string.
-  UBYTE m_ucCodeTable[MaxTableSize];
+  // Special codes
+  enum {
+    ClearCode  = 256,		// re-initialize the string table
+    EOICode    = 257,           // end of data
+    FirstCode  = 258            // the first string in the table
+  };
   //
-  UWORD m_usPrefixTable[MaxTableSize];
+  // The table. For each string, the position of its first character in
+  // the output, counted from the start of the strip, and its length.
+  // Entries below FirstCode are single characters and not kept here.
+  ULONG  m_ulPosition[MaxTableSize];
+  UWORD  m_usLength[MaxTableSize];
   //
-  // The output buffer.
-  UBYTE m_ucOutputBuffer[OutputBufferSize];
+  // The output window and its size.
+  UBYTE *m_pucWindow;
+  ULONG  m_ulWindowSize;
   //
-  // Initialize the table, including ClearCode and EOICode
-  void InitializeTable();
+  // The position of the first byte in the window, counted from the start
+  // of the strip.
+  ULONG  m_ulBase;
+  //
+  // The position of the first byte not yet delivered when decoding,
+  // of the next byte to decode, and of the first string of the current
+  // table, all counted from the start of the strip.
+  ULONG  m_ulRead;
+  ULONG  m_ulWrite;
+  ULONG  m_ulTableStart;
+  //
+  // Position and length of the string decoded by the previous code.
+  ULONG  m_ulOldPosition;
+  UWORD  m_usOldLength;
+  //
+  // An error found while decoding ahead, to be reported once the
+  // bytes decoded before are used up.
+  const char *m_pcError;
   //
-  // Return the next code from the buffer.
+  // The next byte to deliver and the end of the decoded bytes.
+  const UBYTE *m_pucNext;
+  const UBYTE *m_pucEnd;
+  //
+  // Fill the bit reservoir with as many bytes as fit.
+  void FillBits(void);
+  //
+  // Return the next code from the input, or MAX_UWORD if the input is
+  // exhausted.
   UWORD GetNextCode(void)
   {
+    UWORD code;
+    UBYTE bits = m_ucBitsPerCode;
+    
+    if (m_ucAvail < bits) {
+      FillBits();
+      if (m_ucAvail == 0)
+	return MAX_UWORD;
+      if (m_ucAvail < bits) // pad the last code with zeros.
+	m_ucAvail = bits;
+    }
+
     if (m_bLefty) {
-      return ReadBitsReversed(m_ucBitPos,m_ucBitsPerCode,false);
+      code       = m_uqBits & ((1UL << bits) - 1);
+      m_uqBits >>= bits;
     } else {
-      return ReadBits(m_ucBitPos,m_ucBitsPerCode,false);
+      code       = m_uqBits >> (64 - bits);
+      m_uqBits <<= bits;
     }
+    m_ucAvail   -= bits;
+
+    return code;
   }
   //
-  // Special codes
-  enum {
-    ClearCode  = 256,		// re-initialize the string table
-    EOICode    = 257,           // end of data
-    LastPrefix = 0xffff         // last entry, no prefix anymore.
-  };
+  // Copy a string within the window. The source string ends at or
+  // before the destination, the copy goes in units of eight bytes and
+  // may write up to seven bytes beyond the string.
+  static void CopyString(UBYTE *dst,const UBYTE *src,UWORD length)
+  {
+    UQUAD v;
+    //
+    // A string shorter than eight bytes is copied through a register,
+    // hence even overlapping the destination. A longer one is at least
+    // eight bytes away from its destination.
+    for(;;) {
+      memcpy(&v,src,sizeof(v));
+      memcpy(dst,&v,sizeof(v));
+      if (length <= sizeof(v))
+	break;
+      src    += sizeof(v);
+      dst    += sizeof(v);
+      length -= sizeof(v);
+    }
+  }
   //
-  // Add an entry into the table which has as prefix the string that
-  // belongs to the prefix code, and that has the given postfix character.
-  void AddToTable(UWORD prefix,UBYTE postfix);
+  // Initialize the table, including ClearCode and EOICode
+  void InitializeTable(void);
+  //
+  // Make room for at least StringSpace bytes at the end of the window,
+  // discarding bytes that are no longer needed.
+  void MakeRoom(void);
   //
-  // Fill in the string encoded by the given code into the output table,
-  // possibly enlarging the table. Note that this string is filled in in reverse
-  // order, it is inverted by the read-out procedure. If reserve is given,
-  // the indicated number of bytes are additionally reserved at the end of
-  // the string (and thus at the beginning of the buffer)
-  void StringFromCode(UWORD code,int reserve = 0);
+  // Decode the next code into the window, which must have room for
+  // StringSpace bytes. Returns an error message, or NULL on success.
+  const char *DecodeCode(void);
   //
-  // Refill the output buffer of the LZW decoder by decoding the next
-  // codeword in the input buffer
+  // Refill the output window of the LZW decoder by decoding the next
+  // codes in the input buffer.
   void RefillBuffer(void);
+  //
 public:
   // Start an LZW decoder on the given data buffer with the given number of bytes in the buffer.
   LZWDecoder(UBYTE *buffer,ULONG size,bool bigendian);
@@ -123,13 +191,11 @@ public:
   UBYTE GetUBYTE(void)
   {
     // Need to refill the output buffer?
-    if (m_pucNextOutput <= m_ucOutputBuffer) {
+    if (m_pucNext >= m_pucEnd) {
       RefillBuffer();
     }
     
-    // Deliver the next output character.
-    // Note that this is reversed.
-    return *(--m_pucNextOutput);
+    return *m_pucNext++;
   }  
   //
 };
@@ -0,0 +1,132 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software) for Accusoft	        **
+** All Rights Reserved							**
+**************************************************************************
+
+This source file is part of difftest_ng, a universal image measuring
+and conversion framework.
+
+    difftest_ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    difftest_ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with difftest_ng.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/*
+**
+** This file contains the logic to encode TIFF strips with LZW, the
+** counterpart of the LZW decoder.
+**
+** $Id: lzwencoder.cpp,v 1.1 2022/09/21 10:12:44 thor Exp $
+**
+*/
+
+/// Includes
+#include "tiff/lzwencoder.hpp"
+#include "std/string.hpp"
+///
+
+/// LZWEncoder::LZWEncoder
+LZWEncoder::LZWEncoder(void)
+  : m_usNextCode(FirstCode), m_ucBitsPerCode(9), m_ulBitBuffer(0), m_ucBits(0),
+    m_pucOutput(NULL)
+{
+}
+///
+
+/// LZWEncoder::~LZWEncoder
+LZWEncoder::~LZWEncoder(void)
+{
+}
+///
+
+/// LZWEncoder::InitializeTable
+// Remove all strings from the table.
+void LZWEncoder::InitializeTable(void)
+{
+  memset(m_ulHashKey,0xff,sizeof(m_ulHashKey));
+
+  m_usNextCode    = FirstCode;
+  m_ucBitsPerCode = 9;
+}
+///
+
+/// LZWEncoder::AdvanceCode
+// Advance to the next code after having emitted a code. Grows the
+// code size or clears the table if it is full. The decoder adds its
+// strings one code late, hence switches to the next code size once
+// the code just assigned no longer fits into the current size.
+void LZWEncoder::AdvanceCode(void)
+{
+  m_usNextCode++;
+  if (m_usNextCode == LastCode) {
+    PutCode(ClearCode);
+    InitializeTable();
+  } else if (m_usNextCode > (1UL << m_ucBitsPerCode) - 1) {
+    m_ucBitsPerCode++;
+  }
+}
+///
+
+/// LZWEncoder::Encode
+// Encode the given data into the output buffer, which must be at
+// least MaxSizeOf() large. Returns the number of bytes generated.
+ULONG LZWEncoder::Encode(const UBYTE *data,ULONG size,UBYTE *out)
+{
+  const UBYTE *end = data + size;
+  UWORD prefix;
+
+  m_pucOutput     = out;
+  m_ulBitBuffer   = 0;
+  m_ucBits        = 0;
+  m_ucBitsPerCode = 9;
+
+  PutCode(ClearCode);
+  InitializeTable();
+
+  if (data < end) {
+    prefix = *data++;
+    while(data < end) {
+      UBYTE postfix = *data++;
+      ULONG key     = (ULONG(prefix) << 8) | postfix;
+      ULONG hash    = ((key * 0x9e3779b1UL) & MAX_ULONG) >> (32 - HashBits);
+      //
+      // Find the extended string in the table, or the slot to put it.
+      while(m_ulHashKey[hash] != key && m_ulHashKey[hash] != MAX_ULONG)
+	hash = (hash + 1) & (HashSize - 1);
+      //
+      if (m_ulHashKey[hash] == key) {
+	prefix = m_usHashCode[hash];
+      } else {
+	// Not in the table. Write the prefix, add the extended string
+	// and continue with the postfix.
+	PutCode(prefix);
+	m_ulHashKey[hash]  = key;
+	m_usHashCode[hash] = m_usNextCode;
+	AdvanceCode();
+	prefix = postfix;
+      }
+    }
+    //
+    // The decoder adds a string for the last code as well.
+    PutCode(prefix);
+    AdvanceCode();
+  }
+  PutCode(EOICode);
+  //
+  // Flush the remaining bits.
+  if (m_ucBits)
+    *m_pucOutput++ = m_ulBitBuffer << (8 - m_ucBits);
+
+  return m_pucOutput - out;
+}
+///
@@ -0,0 +1,118 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software) for Accusoft	        **
+** All Rights Reserved							**
+**************************************************************************
+
+This source file is part of difftest_ng, a universal image measuring
+and conversion framework.
+
+    difftest_ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    difftest_ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with difftest_ng.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/*
+**
+** This file contains the logic to encode TIFF strips with LZW, the
+** counterpart of the LZW decoder.
+**
+** $Id: lzwencoder.hpp,v 1.1 2022/09/21 10:12:44 thor Exp $
+**
+*/
+
+#ifndef TIFF_LZWENCODER_HPP
+#define TIFF_LZWENCODER_HPP
+
+/// Includes
+#include "interface/types.hpp"
+///
+
+/// class LZWEncoder
+// Generates new-style LZW codes, most significant bit first, with the
+// code size growing one code early as TIFF requires. The table is
+// cleared whenever it runs full.
+class LZWEncoder {
+  //
+  // Special codes
+  enum {
+    ClearCode  = 256,		// re-initialize the string table
+    EOICode    = 257,           // end of data
+    FirstCode  = 258,           // first string in the table
+    LastCode   = 4094           // clear the table when reaching this code
+  };
+  //
+  enum {
+    HashBits   = 13,            // a multiplicative hash, spreads similar strings
+    HashSize   = 1 << HashBits  // entries of the hash table
+  };
+  //
+  // The strings in the table, hashed by their prefix code and their
+  // postfix character. An entry contains prefix << 8 | postfix, or
+  // MAX_ULONG if unused.
+  ULONG  m_ulHashKey[HashSize];
+  //
+  // The codes of the strings in the hash table.
+  UWORD  m_usHashCode[HashSize];
+  //
+  // The next code to be assigned.
+  UWORD  m_usNextCode;
+  //
+  // Number of bits per code, depends on the table size.
+  UBYTE  m_ucBitsPerCode;
+  //
+  // The bits not yet written, and their count.
+  ULONG  m_ulBitBuffer;
+  UBYTE  m_ucBits;
+  //
+  // The output buffer.
+  UBYTE *m_pucOutput;
+  //
+  // Remove all strings from the table.
+  void InitializeTable(void);
+  //
+  // Write a code with the current number of bits.
+  void PutCode(UWORD code)
+  {
+    m_ulBitBuffer = (m_ulBitBuffer << m_ucBitsPerCode) | code;
+    m_ucBits     += m_ucBitsPerCode;
+    while(m_ucBits >= 8) {
+      m_ucBits      -= 8;
+      *m_pucOutput++ = m_ulBitBuffer >> m_ucBits;
+    }
+  }
+  //
+  // Advance to the next code after having emitted a code. Grows the
+  // code size or clears the table if it is full.
+  void AdvanceCode(void);
+  //
+public:
+  LZWEncoder(void);
+  //
+  ~LZWEncoder(void);
+  //
+  // Return the maximal size of the encoded data for the given number
+  // of input bytes.
+  static UQUAD MaxSizeOf(ULONG size)
+  {
+    // At most one twelve bit code per byte, plus the clear codes and
+    // the end of data.
+    return ((UQUAD(size) + size / (LastCode - FirstCode) + 4) * 3 + 1) / 2;
+  }
+  //
+  // Encode the given data into the output buffer, which must be at
+  // least MaxSizeOf() large. Returns the number of bytes generated.
+  ULONG Encode(const UBYTE *data,ULONG size,UBYTE *out);
+};
+///
+
+#endif
@@ -0,0 +1,101 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software) for Accusoft	        **
+** All Rights Reserved							**
+**************************************************************************
+
+This source file is part of difftest_ng, a universal image measuring
+and conversion framework.
+
+    difftest_ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    difftest_ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with difftest_ng.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/*
+**
+** This file contains the logic to encode TIFF strips with packbits,
+** the counterpart of the packbits decoder.
+**
+** $Id: packbitsencoder.cpp,v 1.1 2022/09/21 10:12:44 thor Exp $
+**
+*/
+
+/// Includes
+#include "interface/types.hpp"
+#include "tiff/packbitsencoder.hpp"
+#include "std/string.hpp"
+///
+
+/// PackBitsEncoder::EncodeRow
+// Encode a single row into the output, return the end of the output.
+UBYTE *PackBitsEncoder::EncodeRow(const UBYTE *row,ULONG bytes,UBYTE *out)
+{
+  const UBYTE *end     = row + bytes;
+  const UBYTE *literal = row; // start of the bytes not yet written.
+
+  while(row < end) {
+    const UBYTE *run = row + 1;
+    //
+    while(run < end && *run == *row && run - row < 128)
+      run++;
+    //
+    // Runs of two are cheaper as part of the literal.
+    if (run - row >= 3) {
+      out     = EncodeLiteral(literal,row,out);
+      *out++  = 257 - (run - row); // the negative repeat count minus one
+      *out++  = *row;
+      literal = run;
+    }
+    row = run;
+  }
+
+  return EncodeLiteral(literal,end,out);
+}
+///
+
+/// PackBitsEncoder::EncodeLiteral
+// Write the bytes from start to end as literal runs, return the end
+// of the output.
+UBYTE *PackBitsEncoder::EncodeLiteral(const UBYTE *start,const UBYTE *end,UBYTE *out)
+{
+  while(start < end) {
+    ULONG count = end - start;
+    if (count > 128)
+      count = 128;
+    *out++ = count - 1;
+    memcpy(out,start,count);
+    out   += count;
+    start += count;
+  }
+
+  return out;
+}
+///
+
+/// PackBitsEncoder::Encode
+// Encode the given number of rows of the given size into the output
+// buffer, which must be at least MaxSizeOf() large. Returns the
+// number of bytes generated.
+ULONG PackBitsEncoder::Encode(const UBYTE *data,ULONG bytesperrow,ULONG rows,UBYTE *out)
+{
+  UBYTE *start = out;
+
+  while(rows) {
+    out   = EncodeRow(data,bytesperrow,out);
+    data += bytesperrow;
+    rows--;
+  }
+
+  return out - start;
+}
+///
@@ -0,0 +1,68 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software) for Accusoft	        **
+** All Rights Reserved							**
+**************************************************************************
+
+This source file is part of difftest_ng, a universal image measuring
+and conversion framework.
+
+    difftest_ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    difftest_ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with difftest_ng.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/*
+**
+** This file contains the logic to encode TIFF strips with packbits,
+** the counterpart of the packbits decoder.
+**
+** $Id: packbitsencoder.hpp,v 1.1 2022/09/21 10:12:44 thor Exp $
+**
+*/
+
+#ifndef TIFF_PACKBITSENCODER_HPP
+#define TIFF_PACKBITSENCODER_HPP
+
+/// Includes
+#include "interface/types.hpp"
+///
+
+/// class PackBitsEncoder
+// Packbits encodes runs of equal bytes as a count and the byte, and
+// everything else as literal runs of up to 128 bytes. As required by
+// TIFF, runs do not extend over row boundaries.
+class PackBitsEncoder {
+  //
+  // Encode a single row into the output, return the end of the output.
+  static UBYTE *EncodeRow(const UBYTE *row,ULONG bytes,UBYTE *out);
+  //
+  // Write the bytes from start to end as literal runs, return the end
+  // of the output.
+  static UBYTE *EncodeLiteral(const UBYTE *start,const UBYTE *end,UBYTE *out);
+  //
+public:
+  // Return the maximal size of the encoded data for the given number
+  // of rows of the given size.
+  static UQUAD MaxSizeOf(ULONG bytesperrow,ULONG rows)
+  {
+    return (UQUAD(bytesperrow) + (bytesperrow + 127) / 128) * rows;
+  }
+  //
+  // Encode the given number of rows of the given size into the output
+  // buffer, which must be at least MaxSizeOf() large. Returns the
+  // number of bytes generated.
+  static ULONG Encode(const UBYTE *data,ULONG bytesperrow,ULONG rows,UBYTE *out);
+};
+///
+
+#endif
@@ -37,6 +37,7 @@ and conversion framework.
 #include "img/imglayout.hpp"
 #include "tiff/tifftags.hpp"
 #include "std/string.hpp"
+#include "tools/mappedfile.hpp"
 ///
 
 /// TiffParser::TiffParser
@@ -45,7 +46,7 @@ TiffParser::TiffParser(const char *filename)
   : m_pFile(NULL), m_pulBitsPerPixel(NULL), m_pulColorMap(NULL), 
     m_pulSubsampling(NULL), m_pulSampleFormats(NULL),
     m_pulStripByteCount(NULL), m_pulStripOffset(NULL),
-    m_ulUnits(0), m_pucBuffer(NULL), m_ulBufferSize(0)
+    m_ulUnits(0), m_pucBuffer(NULL), m_ulBufferSize(0), m_pMap(NULL)
 {
   char header[4];
   
@@ -99,6 +100,7 @@ TiffParser::~TiffParser(void)
   delete[] m_pulStripByteCount;
   delete[] m_pulStripOffset;
   delete[] m_pucBuffer;
+  delete m_pMap;
 }
 ///
 
@@ -918,14 +920,10 @@ const ULONG *TiffParser::GetTileOffset(void)
 }
 ///
 
-/// TiffParser::GetDataOfUnit
-// Return the data for addressable unit "i" (where i is either
-// a tile, tile component, stripe or stripe component). The
-// data is *not* endian-corrected, but read in in raw.
-UBYTE *TiffParser::GetDataOfUnit(ULONG i,ULONG &size)
+/// TiffParser::LoadUnits
+// Load the offsets and sizes of all units.
+void TiffParser::LoadUnits(void)
 {
-  ULONG bufsiz;
-  
   if (m_pulStripOffset == NULL || m_pulStripByteCount == NULL) {
     if (isTiled()) {
       GetTileByteCount();
@@ -935,6 +933,18 @@ UBYTE *TiffParser::GetDataOfUnit(ULONG i,ULONG &size)
       GetStripOffset();
     }
   }
+}
+///
+
+/// TiffParser::GetDataOfUnit
+// Return the data for addressable unit "i" (where i is either
+// a tile, tile component, stripe or stripe component). The
+// data is *not* endian-corrected, but read in in raw.
+UBYTE *TiffParser::GetDataOfUnit(ULONG i,ULONG &size)
+{
+  ULONG bufsiz;
+  
+  LoadUnits();
   assert(m_ulUnits > 0);
   assert(i < m_ulUnits);
 
@@ -959,3 +969,39 @@ UBYTE *TiffParser::GetDataOfUnit(ULONG i,ULONG &size)
   return m_pucBuffer;
 }
 ///
+
+/// TiffParser::MapUnits
+// Map the file into memory such that the data of all units is
+// available at once. Returns false if the file cannot be mapped.
+bool TiffParser::MapUnits(void)
+{
+  LoadUnits();
+
+  if (m_pMap == NULL) {
+    m_pMap = new class MappedFile;
+    if (!m_pMap->Map(m_pFile)) {
+      delete m_pMap;
+      m_pMap = NULL;
+      return false;
+    }
+  }
+
+  return true;
+}
+///
+
+/// TiffParser::MappedDataOfUnit
+// Return the data of unit "i" within the mapped file, requires
+// that MapUnits() succeeded.
+UBYTE *TiffParser::MappedDataOfUnit(ULONG i,ULONG &size)
+{
+  assert(m_pMap);
+  assert(i < m_ulUnits);
+
+  size = m_pulStripByteCount[i];
+  if (m_pulStripOffset[i] > m_pMap->SizeOf() || size > m_pMap->SizeOf() - m_pulStripOffset[i])
+    ImageLayout::PostError("unexpected EOF, file %s is truncated",m_pcFilename);
+
+  return m_pMap->DataOf() + m_pulStripOffset[i];
+}
+///
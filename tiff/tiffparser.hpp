@@ -38,6 +38,10 @@ and conversion framework.
 #include "std/stdio.hpp"
 ///
 
+/// Forwards
+class MappedFile;
+///
+
 /// class TiffParser
 // This is a simple tiff parser for most basic TIFF support.
 class TiffParser {
@@ -80,6 +84,12 @@ class TiffParser {
   UBYTE      *m_pucBuffer;
   ULONG       m_ulBufferSize;
   //
+  // The file mapped into memory, if requested and possible.
+  class MappedFile *m_pMap;
+  //
+  // Load the offsets and sizes of all units.
+  void LoadUnits(void);
+  //
   //
   // Read a one-byte entry from the file.
   UBYTE GetByte(void);
@@ -222,6 +232,15 @@ public:
   // data is *not* endian-corrected, but read in in raw.
   UBYTE *GetDataOfUnit(ULONG i,ULONG &size);
   //
+  // Map the file into memory such that the data of all units is
+  // available at once. Returns false if the file cannot be mapped.
+  bool MapUnits(void);
+  //
+  // Return the data of unit "i" within the mapped file, requires
+  // that MapUnits() succeeded. Unlike the above, the data of all
+  // units remains available, and may be decoded concurrently.
+  UBYTE *MappedDataOfUnit(ULONG i,ULONG &size);
+  //
   // Get the sample value to NITS conversion factor, or 1.0 if it is
   // not recorded.
   DOUBLE GetScaleFactor(void);
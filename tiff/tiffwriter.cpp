@@ -32,6 +32,9 @@ and conversion framework.
 
 /// Includes
 #include "tiff/tiffwriter.hpp"
+#include "tiff/tifftags.hpp"
+#include "tiff/lzwencoder.hpp"
+#include "tiff/packbitsencoder.hpp"
 #include "img/imglayout.hpp"
 #include "std/errno.hpp"
 #include "std/string.hpp"
@@ -41,7 +44,8 @@ and conversion framework.
 // Create a new tiff writer from a file name.
 TiffWriter::TiffWriter(const char *filename,bool bigendian)
   : m_pFile(NULL), m_pcFilename(filename), 
-    m_pucStrip(NULL), m_ulBufferSize(0),
+    m_usCompression(TiffTag::Compression::NONE), m_bPredictor(false),
+    m_pStrips(NULL), m_ulStrips(0),
     m_pTags(NULL), m_bBigEndian(bigendian)
 {
   m_pFile = fopen(filename,"wb");
@@ -68,7 +72,7 @@ TiffWriter::~TiffWriter(void)
 
   fclose(m_pFile);
 
-  delete[] m_pucStrip;
+  delete[] m_pStrips;
 
   while((t = m_pTags)) {
     m_pTags = t->ti_pNext;
@@ -331,32 +335,166 @@ void TiffWriter::WriteIFD(void)
 }
 ///
 
+/// TiffWriter::DefineCompression
+// Define the compression of the strips, and whether horizontal
+// prediction is used. This also creates the tags for it.
+void TiffWriter::DefineCompression(UWORD compression,bool predictor)
+{
+  assert(compression == TiffTag::Compression::NONE ||
+	 compression == TiffTag::Compression::LZW  ||
+	 compression == TiffTag::Compression::PACKBITS);
+
+  m_usCompression = compression;
+  m_bPredictor    = predictor;
+
+  DefineScalarTag(TiffTag::COMPRESSION,compression);
+  if (predictor)
+    DefineScalarTag(TiffTag::PREDICTOR,TiffTag::Predictor::HDIFF);
+}
+///
+
+/// TiffWriter::DefineStrips
+// Create the given number of (empty) strips.
+void TiffWriter::DefineStrips(ULONG count)
+{
+  assert(m_pStrips == NULL);
+
+  m_pStrips  = new struct Strip[count];
+  m_ulStrips = count;
+}
+///
+
 /// TiffWriter::GetStripBuffer
-// Allocate a buffer for a stripe to put data into.
-UBYTE *TiffWriter::GetStripBuffer(ULONG sz)
+// Allocate a buffer for the given strip to put its data into.
+UBYTE *TiffWriter::GetStripBuffer(ULONG strip,ULONG sz)
 {
-  if (m_pucStrip && m_ulBufferSize >= sz) {
-    m_ulStripData = sz;
-    return m_pucStrip;
-  }
+  struct Strip *st = m_pStrips + strip;
 
-  delete[] m_pucStrip;m_pucStrip = NULL;
+  assert(strip < m_ulStrips);
 
-  m_pucStrip = new UBYTE[m_ulBufferSize = m_ulStripData = sz];
+  delete[] st->st_pucData;st->st_pucData = NULL;
 
-  return m_pucStrip;
+  st->st_pucData = new UBYTE[st->st_ulBytes = sz];
+
+  return st->st_pucData;
+}
+///
+
+/// TiffWriter::PredictRow
+// Replace each sample of a row by its difference to the sample
+// left of it. The row consists of interleaved samples of the
+// given bit depth, which is 8, 16 or 32. Runs from right to left
+// as the samples are replaced in place.
+void TiffWriter::PredictRow(UBYTE *row,ULONG bytesperrow,UWORD samples,UBYTE bits)
+{
+  ULONG i = bytesperrow / (bits >> 3);
+  UBYTE *p;
+
+  switch(bits) {
+  case 8:
+    while(i > samples) {
+      i--;
+      row[i] -= row[i - samples];
+    }
+    break;
+  case 16:
+    while(i > samples) {
+      i--;
+      p = row + (i << 1);
+      PutUWORD(p,GetUWORD(row + (i << 1)) - GetUWORD(row + ((i - samples) << 1)));
+    }
+    break;
+  case 32:
+    while(i > samples) {
+      i--;
+      p = row + (i << 2);
+      PutULONG(p,GetULONG(row + (i << 2)) - GetULONG(row + ((i - samples) << 2)));
+    }
+    break;
+  default:
+    assert(false);
+    break;
+  }
 }
 ///
 
-/// TiffWriter::PushStripBuffer
-// Write the strip buffer out.
-void TiffWriter::PushStripBuffer(void)
+/// TiffWriter::EncodeStrip
+// Predict and compress the data of the given strip, which consists
+// of rows of the given size, each holding interleaved samples of the
+// given bit depth. Strips may be encoded in parallel as each only
+// touches its own data.
+void TiffWriter::EncodeStrip(ULONG strip,ULONG bytesperrow,UWORD samples,UBYTE bits)
 {
-  if (m_pucStrip && m_ulStripData) {
-    if (fwrite(m_pucStrip,sizeof(UBYTE),m_ulStripData,m_pFile) != m_ulStripData) {
-      ImageLayout::PostError("%s: cannot write out TIFF image data to %s",strerror(errno),m_pcFilename);
+  struct Strip *st = m_pStrips + strip;
+  ULONG rows       = (bytesperrow)?(st->st_ulBytes / bytesperrow):(0);
+  UBYTE *out       = NULL;
+  ULONG bytes      = 0;
+  UQUAD max        = 0;
+  ULONG y;
+
+  assert(strip < m_ulStrips);
+
+  if (m_bPredictor) {
+    for(y = 0;y < rows;y++) {
+      PredictRow(st->st_pucData + y * bytesperrow,bytesperrow,samples,bits);
     }
   }
+
+  switch(m_usCompression) {
+  case TiffTag::Compression::NONE:
+    return;
+  case TiffTag::Compression::LZW:
+    max = LZWEncoder::MaxSizeOf(st->st_ulBytes);
+    break;
+  case TiffTag::Compression::PACKBITS:
+    max = PackBitsEncoder::MaxSizeOf(bytesperrow,rows);
+    break;
+  }
+
+  if (max > MAX_ULONG)
+    ImageLayout::PostError("TIFF strip growing too large for %s, use less rows per strip",m_pcFilename);
+
+  out = new UBYTE[max];
+  
+  switch(m_usCompression) {
+  case TiffTag::Compression::LZW:
+    {
+      class LZWEncoder *lzw = new class LZWEncoder();
+      bytes = lzw->Encode(st->st_pucData,st->st_ulBytes,out);
+      delete lzw;
+    }
+    break;
+  case TiffTag::Compression::PACKBITS:
+    bytes = PackBitsEncoder::Encode(st->st_pucData,bytesperrow,rows,out);
+    break;
+  }
+  //
+  // Keep the encoded data in the strip buffer if it fits, otherwise
+  // keep the output buffer.
+  if (bytes <= st->st_ulBytes) {
+    memcpy(st->st_pucData,out,bytes);
+    delete[] out;
+  } else {
+    delete[] st->st_pucData;
+    st->st_pucData = out;
+  }
+  st->st_ulBytes = bytes;
 }
 ///
 
+/// TiffWriter::WriteStrips
+// Write all strips out, in order.
+void TiffWriter::WriteStrips(void)
+{
+  ULONG i;
+
+  for(i = 0;i < m_ulStrips;i++) {
+    struct Strip *st = m_pStrips + i;
+    if (st->st_ulBytes) {
+      if (fwrite(st->st_pucData,sizeof(UBYTE),st->st_ulBytes,m_pFile) != st->st_ulBytes) {
+	ImageLayout::PostError("%s: cannot write out TIFF image data to %s",strerror(errno),m_pcFilename);
+      }
+    }
+  }
+}
+///
@@ -48,14 +48,31 @@ class TiffWriter {
   // The name of the file.
   const char *m_pcFilename;
   //
-  // The stripe buffer and its buffer size.
-  UBYTE      *m_pucStrip;
+  // The compression of the strips, and whether the samples are
+  // horizontally predicted before.
+  UWORD       m_usCompression;
+  bool        m_bPredictor;
   //
-  // The stripe buffer size.
-  ULONG       m_ulBufferSize;
+  // The strips of the image, with their data as written to the file.
+  struct Strip {
+    // The data of the strip.
+    UBYTE      *st_pucData;
+    //
+    // Its size in bytes.
+    ULONG       st_ulBytes;
+    //
+    Strip(void)
+      : st_pucData(NULL), st_ulBytes(0)
+    { }
+    //
+    ~Strip(void)
+    {
+      delete[] st_pucData;
+    }
+  }          *m_pStrips;
   //
-  // Valid data in the buffer.
-  ULONG       m_ulStripData;
+  // The number of strips.
+  ULONG       m_ulStrips;
   //
   // A single tag. These get sorted into a singly-linked list, then
   // offset-allocated.
@@ -106,6 +123,11 @@ class TiffWriter {
   // Write a long.
   void PutLong(ULONG out);
   //
+  // Replace each sample of a row by its difference to the sample
+  // left of it. The row consists of interleaved samples of the
+  // given bit depth, which is 8, 16 or 32.
+  void PredictRow(UBYTE *row,ULONG bytesperrow,UWORD samples,UBYTE bits);
+  //
   //
 public:
   TiffWriter(const char *filename,bool bigendian = false);
@@ -132,11 +154,29 @@ public:
   // Write out the IFD for the image and the tag data
   void WriteIFD(void);
   //
-  // Allocate a buffer for a stripe to put data into.
-  UBYTE *GetStripBuffer(ULONG sz);
+  // Define the compression of the strips, and whether horizontal
+  // prediction is used. This also creates the tags for it.
+  void DefineCompression(UWORD compression,bool predictor);
+  //
+  // Create the given number of (empty) strips.
+  void DefineStrips(ULONG count);
+  //
+  // Allocate a buffer for the given strip to put its data into.
+  UBYTE *GetStripBuffer(ULONG strip,ULONG sz);
+  //
+  // Predict and compress the data of the given strip, which consists
+  // of rows of the given size, each holding interleaved samples of the
+  // given bit depth. Strips may be encoded in parallel.
+  void EncodeStrip(ULONG strip,ULONG bytesperrow,UWORD samples,UBYTE bits);
+  //
+  // Return the size of the given strip as it will be written.
+  ULONG StripSizeOf(ULONG strip) const
+  {
+    return m_pStrips[strip].st_ulBytes;
+  }
   //
-  // Write the strip buffer out.
-  void PushStripBuffer(void);
+  // Write all strips out, in order.
+  void WriteStrips(void);
   //
   // Write bits aligned into a buffer
   static void PutBits(UBYTE *&buffer,UBYTE &bitpos,UBYTE bps,ULONG value)
@@ -160,6 +200,26 @@ public:
     bitpos  -= bps;
   }
   //
+  // Read an UWORD from a buffer.
+  UWORD GetUWORD(const UBYTE *buffer) const
+  {
+    if (m_bBigEndian) {
+      return (buffer[0] << 8) | buffer[1];
+    } else {
+      return (buffer[1] << 8) | buffer[0];
+    }
+  }
+  //
+  // Read an ULONG from a buffer.
+  ULONG GetULONG(const UBYTE *buffer) const
+  {
+    if (m_bBigEndian) {
+      return (ULONG(buffer[0]) << 24) | (ULONG(buffer[1]) << 16) | (buffer[2] << 8) | buffer[3];
+    } else {
+      return (ULONG(buffer[3]) << 24) | (ULONG(buffer[2]) << 16) | (buffer[1] << 8) | buffer[0];
+    }
+  }
+  //
   // Write UWORD into a buffer.
   void PutUWORD(UBYTE *&buffer,UWORD d)
   {
@@ -25,32 +25,522 @@ and conversion framework.
 **
 ** Fast Fourier Transform
 **
-** $Id: fft.cpp,v 1.8 2017/01/31 11:58:05 thor Exp $
+** $Id: fft.cpp,v 1.9 2022/09/08 10:02:17 thor Exp $
 **
-** This class implements a complex fast fourier transformation.
+** This class implements a two-dimensional fast fourier transformation
+** of real data.
 **
 */
 
 /// Includes
 #include "interface/types.hpp"
 #include "tools/fft.hpp"
+#include "tools/threadpool.hpp"
 #include "std/string.hpp"
 #include "std/math.hpp"
-#ifdef USE_GSL
-#include <new>
+///
+
+/// class ComplexFFT
+// A one-dimensional complex fast fourier transformation of a fixed
+// length. Lengths whose prime factors are all small run through a
+// mixed radix Stockham transformation, all others are computed as a
+// convolution of power-of-two length (Bluestein's algorithm). The
+// transformation is not normalized.
+class ComplexFFT {
+  //
+  // The length of the transformation in complex numbers.
+  ULONG              m_ulLength;
+  //
+  // The radices of the passes, and their number.
+  ULONG              m_ulFactor[32];
+  ULONG              m_ulFactors;
+  //
+  // The twiddle factors exp(-2 pi i k / n), re/im interleaved.
+  double            *m_pdTwiddle;
+  //
+  // For Bluestein's algorithm: The transformation the convolution
+  // runs through, the chirp exp(pi i k^2 / n), and the transformed
+  // convolution kernel, scaled by the inverse convolution length.
+  class ComplexFFT  *m_pConvolution;
+  double            *m_pdChirp;
+  double            *m_pdKernel;
+  //
+  // Prime factors larger than this are not run through the generic
+  // radix pass, but the convolution.
+  enum {
+    MaxRadix = 61
+  };
+  //
+  // The radix 2, 3 and 4 passes, and the generic pass for all other
+  // radices. m is the length of the remaining transformation after
+  // this pass, s the number of interleaved sequences.
+  void Radix2(const double *x,double *y,ULONG m,ULONG s) const;
+  void Radix3(const double *x,double *y,ULONG m,ULONG s) const;
+  void Radix4(const double *x,double *y,ULONG m,ULONG s) const;
+  void RadixN(const double *x,double *y,ULONG p,ULONG m,ULONG s) const;
+  //
+  // Run the forwards transformation as a convolution.
+  void Convolve(double *data,double *scratch) const;
+  //
+  // Run the forwards transformation through the radix passes.
+  void Passes(double *data,double *scratch) const;
+  //
+  // Multiply the complex number c by the complex number w.
+  static void Multiply(double *c,const double *w)
+  {
+    double re = c[0] * w[0] - c[1] * w[1];
+    double im = c[0] * w[1] + c[1] * w[0];
+    c[0] = re;
+    c[1] = im;
+  }
+  //
+public:
+  ComplexFFT(ULONG length);
+  //
+  ~ComplexFFT(void);
+  //
+  // Return the number of doubles of scratch memory the transformation
+  // requires.
+  ULONG ScratchSizeOf(void) const
+  {
+    if (m_ulLength <= 1)
+      return 0;
+    if (m_pConvolution)
+      return m_pConvolution->m_ulLength << 2;
+    return m_ulLength << 1;
+  }
+  //
+  // Transform the data in place, re/im interleaved. The backwards
+  // transformation is not normalized.
+  void Transform(double *data,double *scratch,bool inverse) const;
+};
+///
+
+/// struct FFTPlan
+// Everything the transformation of a given size requires that does
+// not depend on the data. Plans are never modified once created, and
+// shared between all transformations of the same size.
+struct FFTPlan {
+  //
+  // Next plan in the list.
+  struct FFTPlan    *m_pNext;
+  //
+  // The size of the transformation.
+  ULONG              m_ulWidth;
+  ULONG              m_ulHeight;
+  //
+  // The transformation of the rows. For even widths, this is a
+  // complex transformation of half the width, the even and odd
+  // samples forming real and imaginary parts. For odd widths, this
+  // is a complex transformation of the full width.
+  class ComplexFFT  *m_pRows;
+  //
+  // The transformation of the columns of the half spectrum.
+  class ComplexFFT  *m_pColumns;
+  //
+  // For even widths, the twiddle factors exp(-2 pi i k / width)
+  // separating the spectrum of the even and odd samples, for k up
+  // to width/2.
+  double            *m_pdTwiddle;
+  //
+  FFTPlan(ULONG width,ULONG height)
+    : m_pNext(NULL), m_ulWidth(width), m_ulHeight(height),
+      m_pRows(NULL), m_pColumns(NULL), m_pdTwiddle(NULL)
+  { }
+  //
+  ~FFTPlan(void)
+  {
+    delete m_pRows;
+    delete m_pColumns;
+    delete[] m_pdTwiddle;
+  }
+};
+///
+
+/// class FFTJob
+// The job running the row or column passes in parallel. Each slice
+// covers SliceSize rows or columns.
+class FFTJob : public Job {
+  //
+  // The transformation.
+  class FFT *m_pFFT;
+  //
+  // Transform rows or columns, and the direction.
+  bool       m_bRows;
+  bool       m_bInverse;
+  //
+  // Number of rows or columns.
+  ULONG      m_ulCount;
+  //
+public:
+  FFTJob(class FFT *fft,bool rows,bool inverse)
+    : m_pFFT(fft), m_bRows(rows), m_bInverse(inverse),
+      m_ulCount(rows?fft->HeightOf():fft->SpectrumWidthOf())
+  { }
+  //
+  // Return the number of slices.
+  ULONG SlicesOf(void) const
+  {
+    return (m_ulCount + FFT::SliceSize - 1) / FFT::SliceSize;
+  }
+  //
+  virtual void Run(ULONG slice,ULONG worker)
+  {
+    ULONG first   = slice * FFT::SliceSize;
+    ULONG last    = first + FFT::SliceSize;
+    double *data  = m_pFFT->m_pdScratch + worker * m_pFFT->m_ulScratchSize;
+
+    if (last > m_ulCount)
+      last = m_ulCount;
+
+    if (m_bRows) {
+      m_pFFT->TransformRows(first,last,data,m_bInverse);
+    } else {
+      m_pFFT->TransformColumns(first,last,data,m_bInverse);
+    }
+  }
+};
+///
+
+/// ComplexFFT::ComplexFFT
+ComplexFFT::ComplexFFT(ULONG length)
+  : m_ulLength(length), m_ulFactors(0), m_pdTwiddle(NULL),
+    m_pConvolution(NULL), m_pdChirp(NULL), m_pdKernel(NULL)
+{
+  ULONG n = length;
+  ULONG p = 5;
+  ULONG k;
+
+  if (length <= 1)
+    return;
+  //
+  // Split off the radices. Radix 4 first as it is the cheapest.
+  while((n & 3) == 0) {
+    m_ulFactor[m_ulFactors++] = 4;
+    n >>= 2;
+  }
+  while((n & 1) == 0) {
+    m_ulFactor[m_ulFactors++] = 2;
+    n >>= 1;
+  }
+  while(n % 3 == 0) {
+    m_ulFactor[m_ulFactors++] = 3;
+    n /= 3;
+  }
+  while(n > 1 && p <= MaxRadix) {
+    while(n % p == 0) {
+      m_ulFactor[m_ulFactors++] = p;
+      n /= p;
+    }
+    p += 2;
+  }
+  //
+  if (n > 1) {
+    ULONG m = 1;
+    double *conv;
+    //
+    // A large prime factor remains, compute as a convolution
+    // of at least 2n-1 samples.
+    while(m < (length << 1) - 1)
+      m <<= 1;
+    m_pConvolution = new class ComplexFFT(m);
+    m_pdChirp      = new double[length << 1];
+    m_pdKernel     = new double[m << 1];
+    for(k = 0;k < length;k++) {
+      // k^2 modulo 2n keeps the argument small.
+      double phi = M_PI * double((UQUAD(k) * k) % (UQUAD(length) << 1)) / length;
+      m_pdChirp[(k << 1) + 0] = cos(phi);
+      m_pdChirp[(k << 1) + 1] = sin(phi);
+    }
+    memset(m_pdKernel,0,sizeof(double) * (m << 1));
+    for(k = 0;k < length;k++) {
+      m_pdKernel[(k << 1) + 0] = m_pdChirp[(k << 1) + 0] / m;
+      m_pdKernel[(k << 1) + 1] = m_pdChirp[(k << 1) + 1] / m;
+      if (k > 0) {
+	m_pdKernel[((m - k) << 1) + 0] = m_pdChirp[(k << 1) + 0] / m;
+	m_pdKernel[((m - k) << 1) + 1] = m_pdChirp[(k << 1) + 1] / m;
+      }
+    }
+    conv = new double[m_pConvolution->ScratchSizeOf()];
+    m_pConvolution->Transform(m_pdKernel,conv,false);
+    delete[] conv;
+  } else {
+    m_pdTwiddle = new double[length << 1];
+    for(k = 0;k < length;k++) {
+      double phi = 2.0 * M_PI * k / length;
+      m_pdTwiddle[(k << 1) + 0] =  cos(phi);
+      m_pdTwiddle[(k << 1) + 1] = -sin(phi);
+    }
+  }
+}
+///
+
+/// ComplexFFT::~ComplexFFT
+ComplexFFT::~ComplexFFT(void)
+{
+  delete[] m_pdTwiddle;
+  delete   m_pConvolution;
+  delete[] m_pdChirp;
+  delete[] m_pdKernel;
+}
+///
+
+/// ComplexFFT::Radix2
+void ComplexFFT::Radix2(const double *x,double *y,ULONG m,ULONG s) const
+{
+  ULONG j,q;
+
+  for(j = 0;j < m;j++) {
+    const double *w  = m_pdTwiddle + ((s * j) << 1);
+    const double *a0 = x + ((s * j) << 1);
+    const double *a1 = x + ((s * (j + m)) << 1);
+    double *y0       = y + ((s * (j << 1)) << 1);
+    double *y1       = y0 + (s << 1);
+    for(q = 0;q < s;q++) {
+      y0[0] = a0[0] + a1[0];
+      y0[1] = a0[1] + a1[1];
+      y1[0] = a0[0] - a1[0];
+      y1[1] = a0[1] - a1[1];
+      Multiply(y1,w);
+      a0 += 2,a1 += 2,y0 += 2,y1 += 2;
+    }
+  }
+}
+///
+
+/// ComplexFFT::Radix3
+void ComplexFFT::Radix3(const double *x,double *y,ULONG m,ULONG s) const
+{
+  static const double sin60 = 0.86602540378443864676;
+  ULONG j,q;
+
+  for(j = 0;j < m;j++) {
+    const double *w1 = m_pdTwiddle + ((s * j) << 1);
+    const double *w2 = m_pdTwiddle + ((s * j * 2) << 1);
+    const double *a0 = x + ((s * j) << 1);
+    const double *a1 = x + ((s * (j + m)) << 1);
+    const double *a2 = x + ((s * (j + (m << 1))) << 1);
+    double *y0       = y + ((s * j * 3) << 1);
+    double *y1       = y0 + (s << 1);
+    double *y2       = y1 + (s << 1);
+    for(q = 0;q < s;q++) {
+      double tre = a1[0] + a2[0];
+      double tim = a1[1] + a2[1];
+      double dre = (a1[1] - a2[1]) * sin60;
+      double dim = (a2[0] - a1[0]) * sin60;
+      double mre = a0[0] - 0.5 * tre;
+      double mim = a0[1] - 0.5 * tim;
+      y0[0] = a0[0] + tre;
+      y0[1] = a0[1] + tim;
+      y1[0] = mre + dre;
+      y1[1] = mim + dim;
+      y2[0] = mre - dre;
+      y2[1] = mim - dim;
+      Multiply(y1,w1);
+      Multiply(y2,w2);
+      a0 += 2,a1 += 2,a2 += 2,y0 += 2,y1 += 2,y2 += 2;
+    }
+  }
+}
+///
+
+/// ComplexFFT::Radix4
+void ComplexFFT::Radix4(const double *x,double *y,ULONG m,ULONG s) const
+{
+  ULONG j,q;
+
+  for(j = 0;j < m;j++) {
+    const double *w1 = m_pdTwiddle + ((s * j) << 1);
+    const double *w2 = m_pdTwiddle + ((s * j * 2) << 1);
+    const double *w3 = m_pdTwiddle + ((s * j * 3) << 1);
+    const double *a0 = x + ((s * j) << 1);
+    const double *a1 = x + ((s * (j + m)) << 1);
+    const double *a2 = x + ((s * (j + (m << 1))) << 1);
+    const double *a3 = x + ((s * (j + m * 3)) << 1);
+    double *y0       = y + ((s * (j << 2)) << 1);
+    double *y1       = y0 + (s << 1);
+    double *y2       = y1 + (s << 1);
+    double *y3       = y2 + (s << 1);
+    for(q = 0;q < s;q++) {
+      double t0re = a0[0] + a2[0];
+      double t0im = a0[1] + a2[1];
+      double t1re = a0[0] - a2[0];
+      double t1im = a0[1] - a2[1];
+      double t2re = a1[0] + a3[0];
+      double t2im = a1[1] + a3[1];
+      // (a1 - a3) * -i
+      double t3re = a1[1] - a3[1];
+      double t3im = a3[0] - a1[0];
+      y0[0] = t0re + t2re;
+      y0[1] = t0im + t2im;
+      y1[0] = t1re + t3re;
+      y1[1] = t1im + t3im;
+      y2[0] = t0re - t2re;
+      y2[1] = t0im - t2im;
+      y3[0] = t1re - t3re;
+      y3[1] = t1im - t3im;
+      Multiply(y1,w1);
+      Multiply(y2,w2);
+      Multiply(y3,w3);
+      a0 += 2,a1 += 2,a2 += 2,a3 += 2,y0 += 2,y1 += 2,y2 += 2,y3 += 2;
+    }
+  }
+}
+///
+
+/// ComplexFFT::RadixN
+void ComplexFFT::RadixN(const double *x,double *y,ULONG p,ULONG m,ULONG s) const
+{
+  double a[MaxRadix << 1];
+  ULONG step = m_ulLength / p;
+  ULONG j,q,r,u;
+
+  for(j = 0;j < m;j++) {
+    for(q = 0;q < s;q++) {
+      for(r = 0;r < p;r++) {
+	a[(r << 1) + 0] = x[((q + s * (j + r * m)) << 1) + 0];
+	a[(r << 1) + 1] = x[((q + s * (j + r * m)) << 1) + 1];
+      }
+      for(u = 0;u < p;u++) {
+	double *t = y + ((q + s * (p * j + u)) << 1);
+	double re = 0.0,im = 0.0;
+	ULONG idx = 0;
+	for(r = 0;r < p;r++) {
+	  const double *w = m_pdTwiddle + ((step * idx) << 1);
+	  re  += a[(r << 1) + 0] * w[0] - a[(r << 1) + 1] * w[1];
+	  im  += a[(r << 1) + 0] * w[1] + a[(r << 1) + 1] * w[0];
+	  idx += u;
+	  if (idx >= p)
+	    idx -= p;
+	}
+	t[0] = re;
+	t[1] = im;
+	Multiply(t,m_pdTwiddle + ((s * j * u) << 1));
+      }
+    }
+  }
+}
+///
+
+/// ComplexFFT::Passes
+// Run the forwards transformation through the radix passes.
+void ComplexFFT::Passes(double *data,double *scratch) const
+{
+  double *x = data;
+  double *y = scratch;
+  ULONG n   = m_ulLength;
+  ULONG s   = 1;
+  ULONG i;
+
+  for(i = 0;i < m_ulFactors;i++) {
+    ULONG p = m_ulFactor[i];
+    double *t;
+    //
+    n /= p;
+    switch(p) {
+    case 2:
+      Radix2(x,y,n,s);
+      break;
+    case 3:
+      Radix3(x,y,n,s);
+      break;
+    case 4:
+      Radix4(x,y,n,s);
+      break;
+    default:
+      RadixN(x,y,p,n,s);
+      break;
+    }
+    s *= p;
+    t  = x;
+    x  = y;
+    y  = t;
+  }
+
+  if (x != data)
+    memcpy(data,x,sizeof(double) * (m_ulLength << 1));
+}
+///
+
+/// ComplexFFT::Convolve
+// Run the forwards transformation as a convolution.
+void ComplexFFT::Convolve(double *data,double *scratch) const
+{
+  ULONG m       = m_pConvolution->m_ulLength;
+  double *a     = scratch;
+  double *inner = scratch + (m << 1);
+  ULONG k;
+
+  for(k = 0;k < m_ulLength;k++) {
+    const double *c = m_pdChirp + (k << 1);
+    a[(k << 1) + 0] = data[(k << 1) + 0] * c[0] + data[(k << 1) + 1] * c[1];
+    a[(k << 1) + 1] = data[(k << 1) + 1] * c[0] - data[(k << 1) + 0] * c[1];
+  }
+  memset(a + (m_ulLength << 1),0,sizeof(double) * ((m - m_ulLength) << 1));
+
+  m_pConvolution->Transform(a,inner,false);
+  for(k = 0;k < m;k++) {
+    Multiply(a + (k << 1),m_pdKernel + (k << 1));
+  }
+  m_pConvolution->Transform(a,inner,true);
+
+  for(k = 0;k < m_ulLength;k++) {
+    const double *c = m_pdChirp + (k << 1);
+    data[(k << 1) + 0] = a[(k << 1) + 0] * c[0] + a[(k << 1) + 1] * c[1];
+    data[(k << 1) + 1] = a[(k << 1) + 1] * c[0] - a[(k << 1) + 0] * c[1];
+  }
+}
+///
+
+/// ComplexFFT::Transform
+// Transform the data in place, re/im interleaved. The backwards
+// transformation is not normalized.
+void ComplexFFT::Transform(double *data,double *scratch,bool inverse) const
+{
+  ULONG k;
+
+  if (m_ulLength <= 1)
+    return;
+  //
+  // The backwards transformation is the forwards transformation
+  // of the conjugate, conjugated.
+  if (inverse) {
+    for(k = 0;k < m_ulLength;k++)
+      data[(k << 1) + 1] = -data[(k << 1) + 1];
+  }
+
+  if (m_pConvolution) {
+    Convolve(data,scratch);
+  } else {
+    Passes(data,scratch);
+  }
+
+  if (inverse) {
+    for(k = 0;k < m_ulLength;k++)
+      data[(k << 1) + 1] = -data[(k << 1) + 1];
+  }
+}
+///
+
+/// FFT statics
+struct FFTPlan *FFT::m_pPlans = NULL;
+class Mutex     FFT::m_PlanLock;
 ///
 
 /// FFT::FFT
 // Create an FFT class for a window of the given dimensions.
 FFT::FFT(ULONG width,ULONG height,bool window)
-  : m_ulWidth(width), m_ulHeight(height), m_pdData(new double[(width << 1) * height]),
-    m_pdHWindow(window?new double[width]:NULL), m_pdVWindow(window?new double[height]:NULL), m_bWindow(window),
-    m_pHorizontalTable(NULL), m_pVerticalTable(NULL),
-    m_pHorizontalWorkspace(NULL), m_pVerticalWorkspace(NULL)
+  : m_ulWidth(width), m_ulHeight(height), m_pdData(NULL),
+    m_pdHWindow(NULL), m_pdVWindow(NULL), m_bWindow(window),
+    m_pPlan(NULL), m_pdScratch(NULL), m_ulScratchSize(0), m_ulWorkers(0)
 {
   ULONG i;
-  
+
+  m_pdData = new double[ModuloOf() * height];
+
   if (window) {
+    m_pdHWindow = new double[width];
+    m_pdVWindow = new double[height];
     for(i = 0;i < width;i++) {
       m_pdHWindow[i] = sin(M_PI * i / (width - 1));
     }
@@ -58,7 +548,6 @@ FFT::FFT(ULONG width,ULONG height,bool window)
       m_pdVWindow[i] = sin(M_PI * i / (height - 1));
     }
   }
-  //memset(m_pdData,0,(width << 1) * height * sizeof(double));
 }
 ///
 
@@ -69,62 +558,224 @@ FFT::~FFT(void)
   delete[] m_pdData;
   delete[] m_pdHWindow;
   delete[] m_pdVWindow;
+  delete[] m_pdScratch;
+}
+///
 
-  if (m_pHorizontalTable)
-    gsl_fft_complex_wavetable_free(m_pHorizontalTable);
+/// FFT::PlanOf
+// Return the plan for the given dimensions, create it if it does
+// not exist yet.
+const struct FFTPlan *FFT::PlanOf(ULONG width,ULONG height)
+{
+  struct FFTPlan *plan;
 
-  if (m_pVerticalTable)
-    gsl_fft_complex_wavetable_free(m_pVerticalTable);
+  m_PlanLock.Lock();
+  for(plan = m_pPlans;plan;plan = plan->m_pNext) {
+    if (plan->m_ulWidth == width && plan->m_ulHeight == height)
+      break;
+  }
 
-  if (m_pHorizontalWorkspace)
-    gsl_fft_complex_workspace_free(m_pHorizontalWorkspace);
+  if (plan == NULL) {
+    try {
+      plan = new struct FFTPlan(width,height);
+      if (width & 1) {
+	plan->m_pRows = new class ComplexFFT(width);
+      } else {
+	ULONG half = width >> 1;
+	ULONG k;
+	//
+	plan->m_pRows     = new class ComplexFFT(half);
+	plan->m_pdTwiddle = new double[(half + 1) << 1];
+	for(k = 0;k <= half;k++) {
+	  double phi = 2.0 * M_PI * k / width;
+	  plan->m_pdTwiddle[(k << 1) + 0] =  cos(phi);
+	  plan->m_pdTwiddle[(k << 1) + 1] = -sin(phi);
+	}
+      }
+      plan->m_pColumns = new class ComplexFFT(height);
+    } catch(...) {
+      delete plan;
+      m_PlanLock.Unlock();
+      throw;
+    }
+    plan->m_pNext = m_pPlans;
+    m_pPlans      = plan;
+  }
+  m_PlanLock.Unlock();
 
-  if (m_pVerticalWorkspace)
-    gsl_fft_complex_workspace_free(m_pVerticalWorkspace);
+  return plan;
 }
 ///
 
-/// FFT::initTables
-// Create and initialize the prequisites for the FFT.
-void FFT::initTables(void)
+/// FFT::ReleasePlans
+// Release all plans. No transformation may be in use.
+void FFT::ReleasePlans(void)
 {
-  std::bad_alloc err;
-  
-  if (m_pHorizontalTable == NULL) {
-    m_pHorizontalTable = gsl_fft_complex_wavetable_alloc(m_ulWidth);
-    if (m_pHorizontalTable == NULL)
-      throw err;
-  }  
-  if (m_pVerticalTable == NULL) {
-    m_pVerticalTable = gsl_fft_complex_wavetable_alloc(m_ulHeight);
-    if (m_pVerticalTable == NULL)
-      throw err;
+  m_PlanLock.Lock();
+  while(m_pPlans) {
+    struct FFTPlan *next = m_pPlans->m_pNext;
+    delete m_pPlans;
+    m_pPlans = next;
   }
+  m_PlanLock.Unlock();
+}
+///
+
+/// FFT::initScratch
+// Create the scratch memory for the given number of workers.
+void FFT::initScratch(ULONG workers)
+{
+  ULONG rows    = m_pPlan->m_pRows->ScratchSizeOf();
+  ULONG columns = m_pPlan->m_pColumns->ScratchSizeOf() + ((SliceSize * m_ulHeight) << 1);
+
+  if (m_ulWidth & 1)
+    rows       += m_ulWidth << 1;
 
-  if (m_pHorizontalWorkspace == NULL) {
-    m_pHorizontalWorkspace = gsl_fft_complex_workspace_alloc(m_ulWidth);
-    if (m_pHorizontalWorkspace == NULL)
-      throw err;
+  if (m_pdScratch == NULL || m_ulWorkers < workers) {
+    delete[] m_pdScratch;
+    m_pdScratch     = NULL;
+    m_ulScratchSize = (rows > columns)?(rows):(columns);
+    m_pdScratch     = new double[m_ulScratchSize * workers];
+    m_ulWorkers     = workers;
   }
-  
-  if (m_pVerticalWorkspace == NULL) {
-    m_pVerticalWorkspace = gsl_fft_complex_workspace_alloc(m_ulHeight);
-    if (m_pVerticalWorkspace == NULL)
-      throw err;
+}
+///
+
+/// FFT::TransformRows
+// Transform rows first to last-1 from real data to the half spectrum,
+// or back.
+void FFT::TransformRows(ULONG first,ULONG last,double *scratch,bool inverse)
+{
+  const class ComplexFFT *fft = m_pPlan->m_pRows;
+  const double *tw            = m_pPlan->m_pdTwiddle;
+  ULONG w                     = m_ulWidth;
+  ULONG half                  = w >> 1;
+  ULONG y,k;
+
+  for(y = first;y < last;y++) {
+    double *row = m_pdData + y * ModuloOf();
+    //
+    if (inverse == false && m_bWindow) {
+      double v = m_pdVWindow[y];
+      for(k = 0;k < w;k++)
+	row[k] *= m_pdHWindow[k] * v;
+    }
+    //
+    if (w & 1) {
+      // Odd widths run through the complex transformation of the
+      // full width.
+      double *c = scratch + fft->ScratchSizeOf();
+      if (inverse) {
+	for(k = 0;k <= half;k++) {
+	  c[(k << 1) + 0] = row[(k << 1) + 0];
+	  c[(k << 1) + 1] = row[(k << 1) + 1];
+	}
+	for(k = half + 1;k < w;k++) {
+	  c[(k << 1) + 0] =  row[((w - k) << 1) + 0];
+	  c[(k << 1) + 1] = -row[((w - k) << 1) + 1];
+	}
+	fft->Transform(c,scratch,true);
+	for(k = 0;k < w;k++)
+	  row[k] = c[k << 1];
+      } else {
+	for(k = 0;k < w;k++) {
+	  c[(k << 1) + 0] = row[k];
+	  c[(k << 1) + 1] = 0.0;
+	}
+	fft->Transform(c,scratch,false);
+	memcpy(row,c,sizeof(double) * ((half + 1) << 1));
+      }
+    } else if (inverse) {
+      double re,im;
+      // Recombine the spectrum Z of the even samples plus i times
+      // the odd samples, Z(k) = X(k) + X*(h-k) + i W*(k) (X(k) - X*(h-k)),
+      // pairwise for k and h-k to work in place.
+      re     = row[0] + row[half << 1];
+      im     = row[0] - row[half << 1];
+      row[0] = re;
+      row[1] = im;
+      for(k = 1;k <= (half >> 1);k++) {
+	double *a = row + (k << 1);
+	double *b = row + ((half - k) << 1);
+	const double *wa = tw + (k << 1);
+	const double *wb = tw + ((half - k) << 1);
+	double sre = a[0] + b[0],sim = a[1] - b[1]; // X(k) + X*(h-k)
+	double dre = a[0] - b[0],dim = a[1] + b[1]; // X(k) - X*(h-k)
+	double ure = -dre       ,uim = dim;         // X(h-k) - X*(k)
+	// i W*(k) (X(k) - X*(h-k)), and the same for h-k.
+	double pre = wa[1] * dre - wa[0] * dim;
+	double pim = wa[0] * dre + wa[1] * dim;
+	double qre = wb[1] * ure - wb[0] * uim;
+	double qim = wb[0] * ure + wb[1] * uim;
+	a[0] = sre + pre;
+	a[1] = sim + pim;
+	b[0] = sre + qre;
+	b[1] = qim - sim;
+      }
+      fft->Transform(row,scratch,true);
+    } else {
+      double re,im;
+      // Transform the even samples as real and the odd samples as
+      // imaginary part, then separate the spectra.
+      fft->Transform(row,scratch,false);
+      re               = row[0];
+      im               = row[1];
+      row[0]           = re + im;
+      row[1]           = 0.0;
+      row[half << 1]   = re - im;
+      row[(half << 1) + 1] = 0.0;
+      for(k = 1;k <= (half >> 1);k++) {
+	double *a = row + (k << 1);
+	double *b = row + ((half - k) << 1);
+	const double *wk = tw + (k << 1);
+	// E = (Z(k) + Z*(h-k))/2, O = (Z(k) - Z*(h-k))/2i
+	double ere = 0.5 * (a[0] + b[0]),eim = 0.5 * (a[1] - b[1]);
+	double ore = 0.5 * (a[1] + b[1]),oim = 0.5 * (b[0] - a[0]);
+	double pre = wk[0] * ore - wk[1] * oim;
+	double pim = wk[0] * oim + wk[1] * ore;
+	// X(k) = E + W(k) O, X(h-k) = (E - W(k) O)*
+	a[0] =   ere + pre;
+	a[1] =   eim + pim;
+	b[0] =   ere - pre;
+	b[1] = -(eim - pim);
+      }
+    }
   }
 }
 ///
 
-/// FFT::Window
-// Apply the hamming window function
-void FFT::Window(double *data,double *window,ULONG stride,ULONG dimension)
+/// FFT::TransformColumns
+// Transform the columns first to last-1 of the half spectrum.
+void FFT::TransformColumns(ULONG first,ULONG last,double *scratch,bool inverse)
 {
-  ULONG x;
+  const class ComplexFFT *fft = m_pPlan->m_pColumns;
+  ULONG h                     = m_ulHeight;
+  ULONG mod                   = ModuloOf();
+  double *buffer              = scratch + fft->ScratchSizeOf();
+  ULONG x,y;
+  //
+  // Gather the columns into contiguous buffers, transform them and
+  // scatter them back.
+  for(y = 0;y < h;y++) {
+    const double *src = m_pdData + y * mod;
+    for(x = first;x < last;x++) {
+      double *dst = buffer + ((((x - first) * h) + y) << 1);
+      dst[0] = src[(x << 1) + 0];
+      dst[1] = src[(x << 1) + 1];
+    }
+  }
 
-  for(x = 0;x < dimension;x++) {
-    *data *= *window;
-    data  += stride;
-    window++;
+  for(x = first;x < last;x++) {
+    fft->Transform(buffer + (((x - first) * h) << 1),scratch,inverse);
+  }
+
+  for(y = 0;y < h;y++) {
+    double *dst = m_pdData + y * mod;
+    for(x = first;x < last;x++) {
+      const double *src = buffer + ((((x - first) * h) + y) << 1);
+      dst[(x << 1) + 0] = src[0];
+      dst[(x << 1) + 1] = src[1];
+    }
   }
 }
 ///
@@ -133,23 +784,22 @@ void FFT::Window(double *data,double *window,ULONG stride,ULONG dimension)
 // Run the forwards FFT. The result is then again in DataOf().
 void FFT::ForwardsFFT(void)
 {
-  ULONG x,y;
+  if (m_ulWidth == 0 || m_ulHeight == 0)
+    return;
 
-  initTables();
+  if (m_pPlan == NULL)
+    m_pPlan = PlanOf(m_ulWidth,m_ulHeight);
 
-  // First horizontally,
-  for(y = 0;y < m_ulHeight;y++) {
-    if (m_bWindow)
-      Window(m_pdData + (y * ModuloOf()),m_pdHWindow,2,m_ulWidth);
-    if (gsl_fft_complex_forward(m_pdData + (y * ModuloOf()),1,m_ulWidth,m_pHorizontalTable,m_pHorizontalWorkspace))
-      throw "FFT forwards transformation failed";
+  initScratch(ThreadPool::ThreadCountOf());
+  //
+  // First horizontally, then vertically.
+  {
+    class FFTJob rows(this,true,false);
+    ThreadPool::Run(&rows,rows.SlicesOf());
   }
-  // then vertically.
-  for(x = 0;x < m_ulWidth;x++) {
-    if (m_bWindow)
-      Window(m_pdData + (x << 1),m_pdVWindow,ModuloOf(),m_ulHeight);
-    if (gsl_fft_complex_forward(m_pdData + (x << 1),ModuloOf() >> 1,m_ulHeight,m_pVerticalTable,m_pVerticalWorkspace))
-      throw "FFT forwards transformation failed";
+  {
+    class FFTJob columns(this,false,false);
+    ThreadPool::Run(&columns,columns.SlicesOf());
   }
 }
 ///
@@ -157,25 +807,23 @@ void FFT::ForwardsFFT(void)
 /// FFT::BackwardsFFT
 // Run the backwards FFT.
 void FFT::BackwardsFFT(void)
-{ 
-  ULONG x,y;
-  
-  initTables();
+{
+  if (m_ulWidth == 0 || m_ulHeight == 0)
+    return;
+
+  if (m_pPlan == NULL)
+    m_pPlan = PlanOf(m_ulWidth,m_ulHeight);
 
-  for(x = 0;x < m_ulWidth;x++) {
-    if (m_bWindow)
-      Window(m_pdData + (x << 1),m_pdVWindow,ModuloOf(),m_ulHeight);
-    if (gsl_fft_complex_backward(m_pdData + (x << 1),ModuloOf() >> 1,m_ulHeight,m_pVerticalTable,m_pVerticalWorkspace))
-      throw "FFT backwards transformation failed";
+  initScratch(ThreadPool::ThreadCountOf());
+  //
+  // First vertically, then horizontally.
+  {
+    class FFTJob columns(this,false,true);
+    ThreadPool::Run(&columns,columns.SlicesOf());
   }
-  for(y = 0;y < m_ulHeight;y++) {
-    if (m_bWindow)
-      Window(m_pdData + (y * ModuloOf()),m_pdHWindow,2,m_ulWidth);
-    if (gsl_fft_complex_backward(m_pdData + (y * ModuloOf()),1,m_ulWidth,m_pHorizontalTable,m_pHorizontalWorkspace))
-      throw "FFT backwards transformation failed";
+  {
+    class FFTJob rows(this,true,true);
+    ThreadPool::Run(&rows,rows.SlicesOf());
   }
-  
 }
 ///
-
-#endif
@@ -25,9 +25,10 @@ and conversion framework.
 **
 ** Fast Fourier Transform
 **
-** $Id: fft.hpp,v 1.7 2017/01/31 11:58:05 thor Exp $
+** $Id: fft.hpp,v 1.8 2022/09/08 10:02:17 thor Exp $
 **
-** This class implements a complex fast fourier transformation.
+** This class implements a two-dimensional fast fourier transformation
+** of real data.
 **
 */
 
@@ -36,43 +37,72 @@ and conversion framework.
 
 /// Includes
 #include "interface/types.hpp"
-#ifdef USE_GSL
-#include <gsl/gsl_fft_complex.h>
+///
+
+/// Forwards
+class Mutex;
+struct FFTPlan;
 ///
 
 /// Class FFT
 class FFT {
   // This class works, unlike most other classes here, on floating point data.
+  // The input is real, hence the spectrum is hermitian symmetric and only
+  // its left half, columns 0 to width/2, is stored.
   //
   // Dimensions of the array here.
   ULONG   m_ulWidth;
   ULONG   m_ulHeight;
   //
-  // The data itself.
+  // The data itself. Rows are padded such that they can hold either
+  // the real input or the half spectrum.
   double *m_pdData;
   //
   // The horizontal window function.
   double *m_pdHWindow;
-  // 
+  //
   // The vertical window function.
   double *m_pdVWindow;
   //
   // Apply windowing?
   bool    m_bWindow;
   //
-  // The wave tables for horizontal and vertical transformation.
-  gsl_fft_complex_wavetable *m_pHorizontalTable;
-  gsl_fft_complex_wavetable *m_pVerticalTable;
+  // The plan for the dimensions of this transformation, shared with
+  // all other transformations of the same dimensions.
+  const struct FFTPlan *m_pPlan;
+  //
+  // The scratch memory of the workers, and its size per worker in
+  // doubles.
+  double *m_pdScratch;
+  ULONG   m_ulScratchSize;
+  ULONG   m_ulWorkers;
+  //
+  // The plans created so far, and the lock protecting them.
+  static struct FFTPlan *m_pPlans;
+  static class Mutex     m_PlanLock;
+  //
+  // Number of rows or columns transformed by one slice of the parallel
+  // transformation.
+  enum {
+    SliceSize = 8
+  };
   //
-  // Workspaces
-  gsl_fft_complex_workspace *m_pHorizontalWorkspace;
-  gsl_fft_complex_workspace *m_pVerticalWorkspace;
+  // Return the plan for the given dimensions, create it if it does
+  // not exist yet.
+  static const struct FFTPlan *PlanOf(ULONG width,ULONG height);
   //
-  // Create and initialize the prequisites for the FFT.
-  void initTables(void);
+  // Create the scratch memory for the given number of workers.
+  void initScratch(ULONG workers);
   //
-  // Apply the hamming window function
-  void Window(double *data,double *window,ULONG stride,ULONG dimension);
+  // Transform rows first to last-1 from real data to the half spectrum,
+  // or back.
+  void TransformRows(ULONG first,ULONG last,double *scratch,bool inverse);
+  //
+  // Transform the columns first to last-1 of the half spectrum.
+  void TransformColumns(ULONG first,ULONG last,double *scratch,bool inverse);
+  //
+  // The job running the passes in parallel.
+  friend class FFTJob;
   //
 public:
   // Create an FFT class for a window of the given dimensions.
@@ -81,27 +111,37 @@ public:
   // Destroy the FFT again.
   ~FFT(void);
   //
-  // Get access to the origin of the FFT window. This contains real/imaginary components
-  // interleaved
+  // Get access to the origin of the FFT window. Before the forwards
+  // transformation, this holds the real input, one sample per entry.
+  // After it, this holds the real/imaginary components of the half
+  // spectrum interleaved.
   double *DataOf(void)
   {
     return m_pdData;
   }
   //
-  // The modulo/stride of the above array. This is in elements in the array entries, not in numbers
-  // because each number takes two slots.
-  ULONG ModuloOf(void)
+  const double *DataOf(void) const
   {
-    return m_ulWidth << 1;
+    return m_pdData;
   }
   //
-  // Run the forwards FFT. The result is then again in DataOf().
+  // The modulo/stride of the above array in doubles. This is large enough for
+  // SpectrumWidthOf() complex numbers.
+  ULONG ModuloOf(void) const
+  {
+    return ((m_ulWidth >> 1) + 1) << 1;
+  }
+  //
+  // Run the forwards FFT. The result is then again in DataOf(). Windowing, if
+  // enabled, is applied to the input.
   void ForwardsFFT(void);
   //
-  // Run the backwards FFT.
+  // Run the backwards FFT on the half spectrum. The result is the real
+  // data, scaled by width times height.
   void BackwardsFFT(void);
   //
-  // Return width and height of the array. Note that this counts complex entries, not real ones.
+  // Return width and height of the array. This is the size of the real
+  // input, and of the full spectrum.
   ULONG WidthOf(void) const
   {
     return m_ulWidth;
@@ -111,10 +151,37 @@ public:
   {
     return m_ulHeight;
   }
+  //
+  // Return the number of complex entries of a row of the half spectrum.
+  ULONG SpectrumWidthOf(void) const
+  {
+    return (m_ulWidth >> 1) + 1;
+  }
+  //
+  // Return a coefficient of the full spectrum after the forwards
+  // transformation. Coefficients that are not stored are reconstructed
+  // from the symmetry.
+  void CoefficientOf(ULONG x,ULONG y,double &re,double &im) const
+  {
+    const double *c;
+
+    if (x <= (m_ulWidth >> 1)) {
+      c  = m_pdData + y * ModuloOf() + (x << 1);
+      re = c[0];
+      im = c[1];
+    } else {
+      if (y > 0)
+	y = m_ulHeight - y;
+      c  = m_pdData + y * ModuloOf() + ((m_ulWidth - x) << 1);
+      re =  c[0];
+      im = -c[1];
+    }
+  }
+  //
+  // Release all plans. No transformation may be in use.
+  static void ReleasePlans(void);
 };
 ///
 
 ///
 #endif
-#endif
-  
@@ -61,6 +61,15 @@ public:
   {
     return m_pFile;
   }
+  //
+  // Give up the ownership of the file, the caller closes it.
+  FILE *Detach(void)
+  {
+    FILE *file = m_pFile;
+    
+    m_pFile = NULL;
+    return file;
+  }
 };
 ///
 
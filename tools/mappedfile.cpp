@@ -0,0 +1,89 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software) for Accusoft	        **
+** All Rights Reserved							**
+**************************************************************************
+
+This source file is part of difftest_ng, a universal image measuring
+and conversion framework.
+
+    difftest_ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    difftest_ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with difftest_ng.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/*
+**
+** This class maps the contents of an open file into memory such that
+** image data can be used directly from the file, without reading it
+** into a buffer first. Where mapping is not available, it fails and
+** the caller has to read the data.
+**
+** $Id: mappedfile.cpp,v 1.1 2022/09/08 11:37:20 thor Exp $
+**
+*/
+
+/// Includes
+#include "tools/mappedfile.hpp"
+#include "std/unistd.hpp"
+#include "std/assert.hpp"
+#if defined(HAVE_UNISTD_H) && defined(HAVE_SYS_STAT_H) && defined(_POSIX_MAPPED_FILES) && _POSIX_MAPPED_FILES > 0
+# define USE_MMAP
+# include <sys/types.h>
+# include <sys/stat.h>
+# include <sys/mman.h>
+#endif
+///
+
+/// MappedFile::~MappedFile
+MappedFile::~MappedFile(void)
+{
+#ifdef USE_MMAP
+  if (m_pucBase)
+    munmap(m_pucBase,m_Size);
+#endif
+}
+///
+
+/// MappedFile::Map
+// Map the complete file the stream reads from. Returns false if the
+// file cannot be mapped, e.g. because it is a pipe or the system
+// does not support mapping.
+bool MappedFile::Map(FILE *file)
+{
+#ifdef USE_MMAP
+  struct stat st;
+  void *base;
+  int fd = fileno(file);
+
+  assert(m_pucBase == NULL);
+
+  if (fd < 0 || fstat(fd,&st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0)
+    return false;
+  if (off_t(size_t(st.st_size)) != st.st_size)
+    return false;
+  //
+  // Pages written to become private copies, the file is not touched.
+  base = mmap(NULL,size_t(st.st_size),PROT_READ | PROT_WRITE,MAP_PRIVATE,fd,0);
+  if (base == MAP_FAILED)
+    return false;
+
+  m_pucBase = (UBYTE *)base;
+  m_Size    = size_t(st.st_size);
+
+  return true;
+#else
+  (void)file;
+  return false;
+#endif
+}
+///
@@ -0,0 +1,84 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software) for Accusoft	        **
+** All Rights Reserved							**
+**************************************************************************
+
+This source file is part of difftest_ng, a universal image measuring
+and conversion framework.
+
+    difftest_ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    difftest_ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with difftest_ng.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/*
+**
+** This class maps the contents of an open file into memory such that
+** image data can be used directly from the file, without reading it
+** into a buffer first. Where mapping is not available, it fails and
+** the caller has to read the data.
+**
+** $Id: mappedfile.hpp,v 1.1 2022/09/08 11:37:20 thor Exp $
+**
+*/
+
+#ifndef TOOLS_MAPPEDFILE_HPP
+#define TOOLS_MAPPEDFILE_HPP
+
+/// Includes
+#include "interface/types.hpp"
+#include "std/stdio.hpp"
+///
+
+/// Class MappedFile
+// This class maps the contents of an open file into memory. The
+// mapping is private: It can be modified, e.g. to convert samples in
+// place, without modifying the file. The mapping remains valid after
+// the file is closed.
+class MappedFile {
+  //
+  // The mapped memory, or NULL.
+  UBYTE  *m_pucBase;
+  //
+  // Size of the mapping in bytes.
+  size_t  m_Size;
+  //
+public:
+  MappedFile(void)
+    : m_pucBase(NULL), m_Size(0)
+  {
+  }
+  //
+  ~MappedFile(void);
+  //
+  // Map the complete file the stream reads from. Returns false if the
+  // file cannot be mapped, e.g. because it is a pipe or the system
+  // does not support mapping.
+  bool Map(FILE *file);
+  //
+  // Return the start of the file contents.
+  UBYTE *DataOf(void) const
+  {
+    return m_pucBase;
+  }
+  //
+  // Return the size of the file in bytes.
+  size_t SizeOf(void) const
+  {
+    return m_Size;
+  }
+};
+///
+
+///
+#endif
@@ -0,0 +1,574 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software) for Accusoft	        **
+** All Rights Reserved							**
+**************************************************************************
+
+This source file is part of difftest_ng, a universal image measuring
+and conversion framework.
+
+    difftest_ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    difftest_ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with difftest_ng.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/*
+**
+** A simple pool of worker threads that runs the independent slices
+** of a job in parallel. Without pthreads, all slices are run in
+** the calling thread.
+**
+** $Id: threadpool.cpp,v 1.1 2022/09/05 14:21:09 thor Exp $
+**
+*/
+
+/// Includes
+#include "tools/threadpool.hpp"
+#include "std/string.hpp"
+#include "std/unistd.hpp"
+#include "std/assert.hpp"
+#include <new>
+#ifdef USE_PTHREADS
+#include <pthread.h>
+#endif
+///
+
+/// Statics
+ULONG ThreadPool::m_ulRequested      = 0;
+class ThreadPool *ThreadPool::m_pPool = NULL;
+#ifdef USE_PTHREADS
+// Protects the requested thread count and the creation, resizing and
+// release of the pool, which may be attempted from several threads.
+static pthread_mutex_t PoolLock       = PTHREAD_MUTEX_INITIALIZER;
+#endif
+///
+
+/// struct PoolData
+// Private data of the pool.
+struct PoolData {
+#ifdef USE_PTHREADS
+  //
+  // Protects everything below.
+  pthread_mutex_t m_Mutex;
+  //
+  // Signalled when a new job arrives, or the pool shuts down.
+  pthread_cond_t  m_Wake;
+  //
+  // Signalled when the last slice of a job is done.
+  pthread_cond_t  m_Done;
+  //
+  // The worker threads, not including the caller.
+  pthread_t      *m_pThreads;
+  ULONG           m_ulStarted;
+  //
+  // The currently running job, the next slice to hand out and the
+  // number of slices.
+  class Job      *m_pJob;
+  ULONG           m_ulNext;
+  ULONG           m_ulCount;
+  //
+  // Number of slices currently being worked on.
+  ULONG           m_ulActive;
+  //
+  // Set if a job is running. A second job is run serially then.
+  bool            m_bBusy;
+  //
+  // Set if the workers shall terminate.
+  bool            m_bShutdown;
+  //
+  // Error indicators of the current job.
+  bool            m_bFailed;
+  bool            m_bOutOfMemory;
+#endif
+  //
+  // The pool, required for the thread entry point.
+  class ThreadPool *m_pPool;
+};
+///
+
+/// struct MutexData
+// Private data of a mutex.
+struct MutexData {
+#ifdef USE_PTHREADS
+  pthread_mutex_t m_Mutex;
+#endif
+};
+///
+
+/// Mutex::Mutex
+Mutex::Mutex(void)
+  : m_pData(new struct MutexData)
+{
+#ifdef USE_PTHREADS
+  pthread_mutex_init(&m_pData->m_Mutex,NULL);
+#endif
+}
+///
+
+/// Mutex::~Mutex
+Mutex::~Mutex(void)
+{
+#ifdef USE_PTHREADS
+  pthread_mutex_destroy(&m_pData->m_Mutex);
+#endif
+  delete m_pData;
+}
+///
+
+/// Mutex::Lock
+// Acquire the lock, wait until it is available.
+void Mutex::Lock(void)
+{
+#ifdef USE_PTHREADS
+  pthread_mutex_lock(&m_pData->m_Mutex);
+#endif
+}
+///
+
+/// Mutex::Unlock
+// Release the lock.
+void Mutex::Unlock(void)
+{
+#ifdef USE_PTHREADS
+  pthread_mutex_unlock(&m_pData->m_Mutex);
+#endif
+}
+///
+
+/// struct ThreadData
+// Private data of a background thread.
+struct ThreadData {
+#ifdef USE_PTHREADS
+  pthread_t m_Thread;
+  //
+  // Set if the thread has been created and is not yet joined.
+  bool      m_bStarted;
+#endif
+};
+///
+
+/// Thread::Thread
+Thread::Thread(void)
+  : m_pData(new struct ThreadData), m_pJob(NULL), m_bFailed(false), m_bOutOfMemory(false)
+{
+  m_cError[0] = 0;
+#ifdef USE_PTHREADS
+  m_pData->m_bStarted = false;
+#endif
+}
+///
+
+/// Thread::~Thread
+Thread::~Thread(void)
+{
+  try {
+    Wait();
+  } catch(...) {
+  }
+  delete m_pData;
+}
+///
+
+/// Thread::Execute
+// Run the job and keep its error, if any.
+void Thread::Execute(void)
+{
+  try {
+    m_pJob->Run(0,0);
+  } catch(const char *error) {
+    strncpy(m_cError,error,sizeof(m_cError) - 1);
+    m_cError[sizeof(m_cError) - 1] = 0;
+    m_bFailed = true;
+  } catch(const std::bad_alloc &) {
+    m_bOutOfMemory = true;
+  } catch(...) {
+    strcpy(m_cError,"unknown error in background thread");
+    m_bFailed = true;
+  }
+}
+///
+
+/// Thread::ThreadEntry
+#ifdef USE_PTHREADS
+// The entry point of the thread.
+void *Thread::ThreadEntry(void *thread)
+{
+  ((class Thread *)thread)->Execute();
+
+  return NULL;
+}
+#endif
+///
+
+/// Thread::Start
+// Start running slice zero of the job in the background.
+void Thread::Start(class Job *job)
+{
+  assert(m_pJob == NULL);
+
+  m_pJob         = job;
+  m_bFailed      = false;
+  m_bOutOfMemory = false;
+#ifdef USE_PTHREADS
+  if (pthread_create(&m_pData->m_Thread,NULL,&ThreadEntry,this) == 0) {
+    m_pData->m_bStarted = true;
+    return;
+  }
+#endif
+  //
+  // No thread available, run it now.
+  Execute();
+}
+///
+
+/// Thread::Wait
+// Wait until the job is done and re-throw its error.
+void Thread::Wait(void)
+{
+  if (m_pJob == NULL)
+    return;
+  //
+#ifdef USE_PTHREADS
+  if (m_pData->m_bStarted) {
+    pthread_join(m_pData->m_Thread,NULL);
+    m_pData->m_bStarted = false;
+  }
+#endif
+  m_pJob = NULL;
+  //
+  if (m_bOutOfMemory)
+    throw std::bad_alloc();
+  if (m_bFailed) {
+    // The message must survive the thread, hence this is static.
+    static char error[sizeof(m_cError)];
+    strcpy(error,m_cError);
+    throw (const char *)error;
+  }
+}
+///
+
+/// ThreadPool::ThreadPool
+ThreadPool::ThreadPool(ULONG threads)
+  : m_pData(NULL), m_ulThreads(1)
+{
+  m_cError[0] = 0;
+#ifdef USE_PTHREADS
+  m_pData = new struct PoolData;
+  m_pData->m_pPool        = this;
+  m_pData->m_pThreads     = NULL;
+  m_pData->m_ulStarted    = 0;
+  m_pData->m_pJob         = NULL;
+  m_pData->m_ulNext       = 0;
+  m_pData->m_ulCount      = 0;
+  m_pData->m_ulActive     = 0;
+  m_pData->m_bBusy        = false;
+  m_pData->m_bShutdown    = false;
+  m_pData->m_bFailed      = false;
+  m_pData->m_bOutOfMemory = false;
+  pthread_mutex_init(&m_pData->m_Mutex,NULL);
+  pthread_cond_init(&m_pData->m_Wake,NULL);
+  pthread_cond_init(&m_pData->m_Done,NULL);
+  //
+  if (threads > 1) {
+    ULONG i;
+    m_pData->m_pThreads = new pthread_t[threads - 1];
+    //
+    // Worker zero is the caller of Run(). The workers wait for the
+    // mutex until all of them are registered.
+    pthread_mutex_lock(&m_pData->m_Mutex);
+    for(i = 1;i < threads;i++) {
+      if (pthread_create(m_pData->m_pThreads + i - 1,NULL,&WorkerEntry,m_pData) != 0)
+	break;
+      m_pData->m_ulStarted++;
+    }
+    pthread_mutex_unlock(&m_pData->m_Mutex);
+  }
+  m_ulThreads = m_pData->m_ulStarted + 1;
+#else
+  (void)threads;
+#endif
+}
+///
+
+/// ThreadPool::~ThreadPool
+ThreadPool::~ThreadPool(void)
+{
+#ifdef USE_PTHREADS
+  if (m_pData) {
+    ULONG i;
+    //
+    pthread_mutex_lock(&m_pData->m_Mutex);
+    m_pData->m_bShutdown = true;
+    pthread_cond_broadcast(&m_pData->m_Wake);
+    pthread_mutex_unlock(&m_pData->m_Mutex);
+    //
+    for(i = 0;i < m_pData->m_ulStarted;i++) {
+      pthread_join(m_pData->m_pThreads[i],NULL);
+    }
+    //
+    pthread_cond_destroy(&m_pData->m_Done);
+    pthread_cond_destroy(&m_pData->m_Wake);
+    pthread_mutex_destroy(&m_pData->m_Mutex);
+    delete[] m_pData->m_pThreads;
+  }
+#endif
+  delete m_pData;
+}
+///
+
+/// ThreadPool::SetThreadCount
+// Set the number of threads to use, zero for one per processor.
+// Takes effect on the next job.
+void ThreadPool::SetThreadCount(ULONG threads)
+{
+#ifdef USE_PTHREADS
+  pthread_mutex_lock(&PoolLock);
+  m_ulRequested = threads;
+  pthread_mutex_unlock(&PoolLock);
+#else
+  m_ulRequested = threads;
+#endif
+}
+///
+
+/// ThreadPool::ThreadCountOf
+// Return the number of threads jobs are distributed over.
+ULONG ThreadPool::ThreadCountOf(void)
+{
+  ULONG threads;
+
+#ifdef USE_PTHREADS
+  pthread_mutex_lock(&PoolLock);
+  threads = m_ulRequested;
+  pthread_mutex_unlock(&PoolLock);
+  //
+  if (threads == 0) {
+#if defined(HAVE_SYSCONF) && defined(_SC_NPROCESSORS_ONLN)
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus > 0)
+      threads = cpus;
+#endif
+  }
+  if (threads == 0)
+    threads = 1;
+#else
+  threads = 1;
+#endif
+
+  return threads;
+}
+///
+
+/// ThreadPool::RunSerial
+// Run all slices of a job in the calling thread.
+void ThreadPool::RunSerial(class Job *job,ULONG count)
+{
+  ULONG i;
+
+  for(i = 0;i < count;i++) {
+    job->Run(i,0);
+  }
+}
+///
+
+/// ThreadPool::WorkerEntry
+#ifdef USE_PTHREADS
+// The entry point of the workers.
+void *ThreadPool::WorkerEntry(void *data)
+{
+  struct PoolData *pd = (struct PoolData *)data;
+  ULONG worker;
+
+  //
+  // Find out which worker this is.
+  pthread_mutex_lock(&pd->m_Mutex);
+  for(worker = 0;worker < pd->m_ulStarted;worker++) {
+    if (pthread_equal(pd->m_pThreads[worker],pthread_self()))
+      break;
+  }
+  pthread_mutex_unlock(&pd->m_Mutex);
+  //
+  pd->m_pPool->Work(worker + 1);
+
+  return NULL;
+}
+#endif
+///
+
+/// ThreadPool::Work
+#ifdef USE_PTHREADS
+// Process slices of the current job until there are none left.
+// Worker zero is the caller of Run() and returns as soon as all
+// slices are handed out, all others wait for the next job.
+void ThreadPool::Work(ULONG worker)
+{
+  struct PoolData *pd = m_pData;
+
+  pthread_mutex_lock(&pd->m_Mutex);
+  for(;;) {
+    class Job *job;
+    ULONG slice;
+    //
+    while(!pd->m_bShutdown && (pd->m_pJob == NULL || pd->m_ulNext >= pd->m_ulCount)) {
+      if (worker == 0)
+	break;
+      pthread_cond_wait(&pd->m_Wake,&pd->m_Mutex);
+    }
+    if (pd->m_bShutdown || pd->m_pJob == NULL || pd->m_ulNext >= pd->m_ulCount)
+      break;
+    //
+    job   = pd->m_pJob;
+    slice = pd->m_ulNext++;
+    pd->m_ulActive++;
+    pthread_mutex_unlock(&pd->m_Mutex);
+    //
+    try {
+      job->Run(slice,worker);
+      pthread_mutex_lock(&pd->m_Mutex);
+    } catch(const char *error) {
+      pthread_mutex_lock(&pd->m_Mutex);
+      if (!pd->m_bFailed) {
+	strncpy(m_cError,error,sizeof(m_cError) - 1);
+	m_cError[sizeof(m_cError) - 1] = 0;
+	pd->m_bFailed = true;
+      }
+      pd->m_ulNext = pd->m_ulCount;
+    } catch(const std::bad_alloc &) {
+      pthread_mutex_lock(&pd->m_Mutex);
+      pd->m_bOutOfMemory = true;
+      pd->m_ulNext       = pd->m_ulCount;
+    } catch(...) {
+      pthread_mutex_lock(&pd->m_Mutex);
+      if (!pd->m_bFailed) {
+	strcpy(m_cError,"unknown error in worker thread");
+	pd->m_bFailed = true;
+      }
+      pd->m_ulNext = pd->m_ulCount;
+    }
+    //
+    if (--pd->m_ulActive == 0 && pd->m_ulNext >= pd->m_ulCount)
+      pthread_cond_broadcast(&pd->m_Done);
+  }
+  pthread_mutex_unlock(&pd->m_Mutex);
+}
+#endif
+///
+
+/// ThreadPool::Run
+// Run slices 0 to count-1 of the given job and return when all
+// of them are done.
+void ThreadPool::Run(class Job *job,ULONG count)
+{
+  ULONG threads = ThreadCountOf();
+
+  if (threads <= 1 || count <= 1) {
+    RunSerial(job,count);
+    return;
+  }
+
+#ifdef USE_PTHREADS
+  {
+    class ThreadPool *pool;
+    struct PoolData *pd;
+    bool failed,nomem;
+    //
+    // Create the pool or adjust its size, and claim it for this
+    // job. The pool is never re-created while it is busy, and
+    // the static lock keeps concurrent callers from creating or
+    // replacing it at the same time.
+    pthread_mutex_lock(&PoolLock);
+    try {
+      if (m_pPool == NULL) {
+	m_pPool = new class ThreadPool(threads);
+      } else if (m_pPool->m_ulThreads != threads) {
+	pd = m_pPool->m_pData;
+	pthread_mutex_lock(&pd->m_Mutex);
+	if (pd->m_bBusy) {
+	  pthread_mutex_unlock(&pd->m_Mutex);
+	  pthread_mutex_unlock(&PoolLock);
+	  RunSerial(job,count);
+	  return;
+	}
+	pthread_mutex_unlock(&pd->m_Mutex);
+	delete m_pPool;
+	m_pPool = NULL;
+	m_pPool = new class ThreadPool(threads);
+      }
+    } catch(...) {
+      pthread_mutex_unlock(&PoolLock);
+      throw;
+    }
+    //
+    pool = m_pPool;
+    pd   = pool->m_pData;
+    pthread_mutex_lock(&pd->m_Mutex);
+    if (pd->m_bBusy) {
+      // Nested or concurrent job: Run it here.
+      pthread_mutex_unlock(&pd->m_Mutex);
+      pthread_mutex_unlock(&PoolLock);
+      RunSerial(job,count);
+      return;
+    }
+    pd->m_bBusy        = true;
+    pd->m_pJob         = job;
+    pd->m_ulNext       = 0;
+    pd->m_ulCount      = count;
+    pd->m_bFailed      = false;
+    pd->m_bOutOfMemory = false;
+    pthread_cond_broadcast(&pd->m_Wake);
+    pthread_mutex_unlock(&pd->m_Mutex);
+    //
+    // The pool is busy now and cannot be replaced until the job is
+    // done, so the static lock is no longer required. Releasing it
+    // lets nested jobs run from the slices.
+    pthread_mutex_unlock(&PoolLock);
+    //
+    // Participate until all slices are handed out.
+    pool->Work(0);
+    //
+    // Wait for the stragglers.
+    pthread_mutex_lock(&pd->m_Mutex);
+    while(pd->m_ulActive > 0 || pd->m_ulNext < pd->m_ulCount) {
+      pthread_cond_wait(&pd->m_Done,&pd->m_Mutex);
+    }
+    failed         = pd->m_bFailed;
+    nomem          = pd->m_bOutOfMemory;
+    pd->m_pJob     = NULL;
+    pd->m_bBusy    = false;
+    pthread_mutex_unlock(&pd->m_Mutex);
+    //
+    if (nomem)
+      throw std::bad_alloc();
+    if (failed)
+      throw (const char *)pool->m_cError;
+  }
+#else
+  RunSerial(job,count);
+#endif
+}
+///
+
+/// ThreadPool::Shutdown
+// Stop and release all worker threads.
+void ThreadPool::Shutdown(void)
+{
+#ifdef USE_PTHREADS
+  pthread_mutex_lock(&PoolLock);
+  delete m_pPool;
+  m_pPool = NULL;
+  pthread_mutex_unlock(&PoolLock);
+#else
+  delete m_pPool;
+  m_pPool = NULL;
+#endif
+}
+///
@@ -0,0 +1,187 @@
+/*************************************************************************
+** Written by Thomas Richter (THOR Software) for Accusoft	        **
+** All Rights Reserved							**
+**************************************************************************
+
+This source file is part of difftest_ng, a universal image measuring
+and conversion framework.
+
+    difftest_ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    difftest_ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with difftest_ng.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/*
+**
+** A simple pool of worker threads that runs the independent slices
+** of a job in parallel. Without pthreads, all slices are run in
+** the calling thread.
+**
+** $Id: threadpool.hpp,v 1.1 2022/09/05 14:21:09 thor Exp $
+**
+*/
+
+#ifndef TOOLS_THREADPOOL_HPP
+#define TOOLS_THREADPOOL_HPP
+
+/// Includes
+#include "interface/types.hpp"
+///
+
+/// Class Job
+// A unit of work that consists of a number of independent slices.
+// Each slice is run exactly once, in an undefined order and by an
+// undefined thread. The worker index passed in is unique among the
+// threads running slices of the same job at a time, and smaller than
+// ThreadPool::ThreadCountOf().
+class Job {
+  //
+public:
+  virtual ~Job(void)
+  {
+  }
+  //
+  // Run the given slice of the job.
+  virtual void Run(ULONG slice,ULONG worker) = 0;
+};
+///
+
+/// Class Mutex
+// A lock protecting data shared between the slices of a job.
+// Without pthreads, locking does nothing.
+class Mutex {
+  //
+  // The lock itself, depends on the threading library.
+  struct MutexData   *m_pData;
+  //
+  // Not copyable.
+  Mutex(const class Mutex &);
+  class Mutex &operator=(const class Mutex &);
+  //
+public:
+  Mutex(void);
+  //
+  ~Mutex(void);
+  //
+  // Acquire the lock, wait until it is available.
+  void Lock(void);
+  //
+  // Release the lock.
+  void Unlock(void);
+};
+///
+
+/// Class Thread
+// Runs a job of a single slice in a background thread while the
+// caller goes on, e.g. to read ahead. Without pthreads, the job is
+// run when it is started.
+class Thread {
+  //
+  // The thread, depends on the threading library.
+  struct ThreadData  *m_pData;
+  //
+  // The job currently running, if any.
+  class Job          *m_pJob;
+  //
+  // Error indicators of the job.
+  bool                m_bFailed;
+  bool                m_bOutOfMemory;
+  char                m_cError[256];
+  //
+  // Not copyable.
+  Thread(const class Thread &);
+  class Thread &operator=(const class Thread &);
+  //
+  // Run the job and keep its error, if any.
+  void Execute(void);
+  //
+#ifdef USE_PTHREADS
+  // The entry point of the thread.
+  static void *ThreadEntry(void *thread);
+#endif
+  //
+public:
+  Thread(void);
+  //
+  // Waits for the job, but drops its error.
+  ~Thread(void);
+  //
+  // Start running slice zero of the job in the background. The job
+  // started before must have been waited for.
+  void Start(class Job *job);
+  //
+  // Wait until the job is done. If it threw, the error is re-thrown
+  // here. Does nothing if no job is running.
+  void Wait(void);
+};
+///
+
+/// Class ThreadPool
+// The thread pool. There is only one, created on demand.
+class ThreadPool {
+  //
+  // Private data of the pool, depends on the threading library.
+  struct PoolData    *m_pData;
+  //
+  // Number of workers, including the calling thread.
+  ULONG               m_ulThreads;
+  //
+  // The requested number of threads, zero for one per processor.
+  static ULONG        m_ulRequested;
+  //
+  // The pool, if already created.
+  static class ThreadPool *m_pPool;
+  //
+  // Error message of a failed slice, to be passed on to the
+  // caller.
+  char                m_cError[256];
+  //
+  ThreadPool(ULONG threads);
+  //
+  ~ThreadPool(void);
+  //
+  // Run all slices of a job in the calling thread.
+  static void RunSerial(class Job *job,ULONG count);
+  //
+#ifdef USE_PTHREADS
+  // The entry point of the workers.
+  static void *WorkerEntry(void *pool);
+  //
+  // Process slices of the current job until there are none left.
+  void Work(ULONG worker);
+#endif
+  //
+public:
+  //
+  // Set the number of threads to use, zero for one per processor.
+  // Takes effect on the next job.
+  static void SetThreadCount(ULONG threads);
+  //
+  // Return the number of threads jobs are distributed over.
+  static ULONG ThreadCountOf(void);
+  //
+  // Run slices 0 to count-1 of the given job and return when all
+  // of them are done. If a slice throws, the first error is
+  // re-thrown here once all workers are idle. If the pool is
+  // already busy, e.g. because this is called from within a slice,
+  // the job runs in the calling thread.
+  static void Run(class Job *job,ULONG count);
+  //
+  // Stop and release all worker threads. Must not be called while
+  // a job is running.
+  static void Shutdown(void);
+};
+///
+
+///
+#endif